@@ -0,0 +1,69 @@
+/*
+ * Нагрузочный тест log_hexdump(): скорость формирования дампа буферов разного размера.
+ *
+ * Использование: bench_hexdump [мегабайт-на-размер]
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "log_hexdump.h"
+
+/**
+ * Возвращает время монотонных часов в наносекундах.
+ *
+ * @return время, нс
+ */
+static
+uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+    static const size_t sizes[] = { 16, 100, 4096, 1 << 20 };
+    size_t megabytes = (argc > 1) ? (size_t)atoi(argv[1]) : 256;
+    size_t max_size = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+    unsigned char *buf;
+    char *out;
+    size_t checksum = 0;
+    size_t i;
+
+    if (megabytes == 0)
+    {
+        fprintf(stderr, "usage: %s [megabytes per size]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    buf = malloc(max_size);
+    out = malloc((max_size + 15) / 16 * LOG_HEXDUMP_LINE_MAX_SIZE);
+    if (buf == NULL || out == NULL) return EXIT_FAILURE;
+    for (i = 0; i < max_size; i++)
+    {
+        buf[i] = (unsigned char)(i * 37 + 11);
+    }
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        size_t size = sizes[i];
+        size_t iterations = megabytes * 1024 * 1024 / size;
+        uint64_t start = now_ns();
+        double elapsed;
+        size_t n;
+
+        for (n = 0; n < iterations; n++)
+        {
+            checksum += log_hexdump(out, buf, size, 0, (size + 15) / 16);
+        }
+        elapsed = (double)(now_ns() - start) / 1e9;
+        printf("size %7zu: %7.2f GB/s input, %8.1f ns/dump\n",
+               size, (double)(iterations * size) / elapsed / 1e9, elapsed * 1e9 / (double)iterations);
+    }
+    free(out);
+    free(buf);
+    return (checksum != 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
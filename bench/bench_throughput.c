@@ -0,0 +1,113 @@
+/*
+ * Нагрузочный тест пропускной способности синхронного вывода: 1, 4, 16 и 64 потока
+ * логгируют через _LOG_INFO в файловый приёмник /dev/null.
+ *
+ * Использование: bench_throughput [записей-на-поток]
+ */
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define _LOG_SRC "BENCH"
+#include "log.h"
+
+/**
+ * Максимальное количество потоков
+ */
+#define BENCH_MAX_THREADS 64
+
+static
+unsigned records_per_thread; ///< количество записей каждого потока.
+
+/**
+ * Возвращает время монотонных часов в наносекундах.
+ *
+ * @return время, нс
+ */
+static
+uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Тело логгирующего потока.
+ *
+ * @param arg [in] номер потока
+ * @return NULL
+ */
+static
+void *logger_thread(void *arg)
+{
+    unsigned id = (unsigned)(uintptr_t)arg;
+    unsigned i;
+
+    for (i = 0; i < records_per_thread; i++)
+    {
+        _LOG_INFO("thread %u record %u value %d", id, i, (int)(i * 7));
+    }
+    return NULL;
+}
+
+/**
+ * Логгирует заданным количеством потоков и выводит пропускную способность.
+ *
+ * @param num_threads [in] количество потоков (<= BENCH_MAX_THREADS)
+ * @return true - OK, false - Fail
+ */
+static
+bool run(unsigned num_threads)
+{
+    pthread_t threads[BENCH_MAX_THREADS];
+    uint64_t start = now_ns();
+    double elapsed;
+    double total = (double)num_threads * records_per_thread;
+    unsigned i;
+
+    for (i = 0; i < num_threads; i++)
+    {
+        if (pthread_create(&threads[i], NULL, logger_thread, (void *)(uintptr_t)i) != 0) return false;
+    }
+    for (i = 0; i < num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    elapsed = (double)(now_ns() - start) / 1e9;
+    printf("threads %2u: %8.0f krecords/s, %6.0f ns/record\n", num_threads, total / elapsed / 1e3, elapsed * 1e9 / total);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    static const unsigned thread_counts[] = { 1, 4, 16, 64 };
+    int fd;
+    size_t i;
+
+    records_per_thread = (argc > 1) ? (unsigned)atoi(argv[1]) : 100000;
+    if (records_per_thread == 0)
+    {
+        fprintf(stderr, "usage: %s [records per thread]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    fd = open("/dev/null", O_WRONLY);
+    if (fd < 0) return EXIT_FAILURE;
+    if (!log_init(LL_INFO, true)) return EXIT_FAILURE;
+    if (!log_register(_LOG_SRC, LL_INFO)) return EXIT_FAILURE;
+    if (log_sink_add_fd(fd, LL_INFO) == NULL) return EXIT_FAILURE;
+
+    for (i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++)
+    {
+        if (!run(thread_counts[i])) return EXIT_FAILURE;
+    }
+    (void)log_destroy();
+    close(fd);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+/*
+ * Нагрузочный тест читателей хранилища источников: N потоков вызывают log_will_be_printed(),
+ * пока один поток перерегистрирует источники.
+ *
+ * Использование: bench_will_be_printed [потоков-читателей [секунд]]
+ */
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define _LOG_SRC "BENCH"
+#include "log.h"
+
+/**
+ * Количество источников, по которым проходят читатели
+ */
+#define BENCH_NUM_SOURCES 64
+
+/**
+ * Максимальное количество потоков-читателей
+ */
+#define BENCH_MAX_THREADS 256
+
+/**
+ * Счётчик потока на отдельной кеш-линии
+ */
+typedef struct tag_bench_counter
+{
+    uint64_t value __attribute__((aligned(64))); /*!< количество выполненных операций */
+}
+bench_counter_t;
+
+static
+char sources[BENCH_NUM_SOURCES][16]; ///< имена источников.
+
+static
+bool stop; ///< запрос остановки потоков.
+
+static
+bench_counter_t counters[BENCH_MAX_THREADS + 1]; ///< счётчики читателей и (последний) писателя.
+
+static
+uint64_t printed_total; ///< количество положительных ответов (чтобы проверки не были выброшены компилятором).
+
+/**
+ * Возвращает время монотонных часов в наносекундах.
+ *
+ * @return время, нс
+ */
+static
+uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Тело потока-читателя: проверяет уровни источников по кругу.
+ *
+ * @param arg [in] счётчик потока
+ * @return NULL
+ */
+static
+void *reader_thread(void *arg)
+{
+    bench_counter_t *counter = arg;
+    uint64_t count = 0;
+    unsigned printed = 0;
+
+    while (!__atomic_load_n(&stop, __ATOMIC_RELAXED))
+    {
+        unsigned i;
+
+        for (i = 0; i < BENCH_NUM_SOURCES; i++)
+        {
+            printed += log_will_be_printed(sources[i], LL_INFO);
+        }
+        count += BENCH_NUM_SOURCES;
+    }
+    __atomic_store_n(&counter->value, count, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&printed_total, printed, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+/**
+ * Тело потока-писателя: перерегистрирует источники по кругу, чередуя их уровни.
+ *
+ * @param arg [in] счётчик потока
+ * @return NULL
+ */
+static
+void *writer_thread(void *arg)
+{
+    bench_counter_t *counter = arg;
+    uint64_t count = 0;
+
+    while (!__atomic_load_n(&stop, __ATOMIC_RELAXED))
+    {
+        (void)log_register(sources[count % BENCH_NUM_SOURCES], (count & 1) ? LL_INFO : LL_WARNING);
+        count++;
+    }
+    __atomic_store_n(&counter->value, count, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned num_threads = (argc > 1) ? (unsigned)atoi(argv[1]) : 4;
+    unsigned seconds = (argc > 2) ? (unsigned)atoi(argv[2]) : 2;
+    pthread_t threads[BENCH_MAX_THREADS + 1];
+    struct timespec duration;
+    uint64_t reads = 0;
+    uint64_t start;
+    double elapsed;
+    unsigned i;
+
+    if (num_threads == 0 || num_threads > BENCH_MAX_THREADS || seconds == 0)
+    {
+        fprintf(stderr, "usage: %s [reader threads 1..%u [seconds]]\n", argv[0], BENCH_MAX_THREADS);
+        return EXIT_FAILURE;
+    }
+    if (!log_init(LL_RAW, true)) return EXIT_FAILURE;
+    for (i = 0; i < BENCH_NUM_SOURCES; i++)
+    {
+        snprintf(sources[i], sizeof(sources[i]), "SRC%u", i);
+        if (!log_register(sources[i], LL_INFO)) return EXIT_FAILURE;
+    }
+
+    start = now_ns();
+    for (i = 0; i < num_threads; i++)
+    {
+        if (pthread_create(&threads[i], NULL, reader_thread, &counters[i]) != 0) return EXIT_FAILURE;
+    }
+    if (pthread_create(&threads[num_threads], NULL, writer_thread, &counters[num_threads]) != 0) return EXIT_FAILURE;
+    duration.tv_sec = (time_t)seconds;
+    duration.tv_nsec = 0;
+    nanosleep(&duration, NULL);
+    __atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+    for (i = 0; i <= num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    elapsed = (double)(now_ns() - start) / 1e9;
+
+    for (i = 0; i < num_threads; i++)
+    {
+        reads += counters[i].value;
+    }
+    printf("readers %u: %.1f Mlookups/s total, %.1f Mlookups/s per thread, %.1f kregistrations/s\n",
+           num_threads, (double)reads / elapsed / 1e6, (double)reads / elapsed / 1e6 / num_threads,
+           (double)counters[num_threads].value / elapsed / 1e3);
+    (void)log_destroy();
+    return EXIT_SUCCESS;
+}
@@ -4,9 +4,43 @@
 #include <errno.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "macros.h"
 
+/**
+ * Числовые значения уровней логгирования для препроцессора (совпадают с log_level_t)
+ */
+#define LOG_LVL_RAW     1
+#define LOG_LVL_TRACE   2
+#define LOG_LVL_DEBUG   3
+#define LOG_LVL_INFO    4
+#define LOG_LVL_WARNING 5
+#define LOG_LVL_ERROR   6
+#define LOG_LVL_NONE    7
+
+/**
+ * Минимальный уровень логгирования, попадающий в бинарный файл.
+ * Макросы более низких уровней не генерируют ни вызова, ни строки формата, ни вычисления аргументов.
+ * Задаётся опцией сборки LOG_COMPILE_MIN_LEVEL (одно из значений LOG_LVL_*).
+ */
+#ifndef LOG_COMPILE_MIN_LEVEL
+#define LOG_COMPILE_MIN_LEVEL LOG_LVL_RAW
+#endif
+
+/**
+ * 1 - источники из манифеста (опции сборки LOG_SOURCE_MANIFEST, LOG_SOURCE_SCAN_DIRS) получают
+ *     идентификаторы при компиляции, таблица источников генерируется в log_src_manifest.h
+ * 0 - выключено
+ */
+#ifndef DO_LOG_SRC_MANIFEST
+#define DO_LOG_SRC_MANIFEST 0
+#endif
+
+#if DO_LOG_SRC_MANIFEST
+#include "log_src_manifest.h"
+#endif
+
 /**
  * Множество уровней логгирования
  */
@@ -14,13 +48,13 @@ typedef enum tag_log_level
 {
     LL_INVALID,
 
-    LL_RAW,
-    LL_TRACE,
-    LL_DEBUG,
-    LL_INFO,
-    LL_WARNING,
-    LL_ERROR,
-    LL_NONE,
+    LL_RAW     = LOG_LVL_RAW,
+    LL_TRACE   = LOG_LVL_TRACE,
+    LL_DEBUG   = LOG_LVL_DEBUG,
+    LL_INFO    = LOG_LVL_INFO,
+    LL_WARNING = LOG_LVL_WARNING,
+    LL_ERROR   = LOG_LVL_ERROR,
+    LL_NONE    = LOG_LVL_NONE,
 
     LL_CNT
 }
@@ -33,6 +67,8 @@ typedef struct tag_log_src_descr
 {
     const char  *source;        ///< Источник лога (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL).
     log_level_t  min_log_level; ///< Минимальный уровень выводимого лога (LL_NONE - отключает вывод).
+    log_level_t  sample_level;  ///< Записи уровней ниже sample_level сэмплируются (LL_INVALID - без сэмплирования).
+    double       sample_ratio;  ///< Доля сохраняемых записей сэмплируемых уровней (0.0 ... 1.0).
 }
 log_src_descr_t;
 
@@ -48,10 +84,286 @@ typedef struct tag_log_src_dump
 }
 log_src_dump_t;
 
+/**
+ * Параметры системы логгирования для log_init_ex().
+ * Нулевые значения числовых параметров означают значения по-умолчанию.
+ */
+typedef struct tag_log_config
+{
+    log_level_t min_log_level;           ///< глобально (для всех источников) минимально выводимый уровень логов (LL_NONE - отключает вывод).
+    bool        is_thread_safe;          ///< флаг необходимости использовать примитивы синхронизации.
+    bool        async;                   ///< асинхронный вывод: записи помещаются в кольцо и выводятся фоновым потоком.
+    size_t      async_ring_size;         ///< количество записей в кольце (округляется вверх до степени 2, по-умолчанию 4096).
+    size_t      async_record_size;       ///< размер ячейки кольца в байтах, более длинные записи копируются в кучу (по-умолчанию 512).
+    unsigned    async_flush_interval_ms; ///< страховочный период пробуждения фонового потока при отсутствии записей (новые записи будят его сразу, по-умолчанию 1000 мс).
+    bool        async_no_drain;          ///< true - log_destroy() отбрасывает записи, оставшиеся в кольце, false - выводит их.
+    bool        deferred;                ///< отложенное форматирование (включает async): макросы сохраняют в кольцо аргументы в двоичном виде, форматирует фоновый поток.
+    const char *binary_path;             ///< двоичный файл журнала (включает deferred): записи сохраняются как идентификаторы точек и аргументы, текст восстанавливает cos_log_decode (NULL - текстовый вывод в stderr).
+    size_t      flight_recorder_size;    ///< размер кольца бортового самописца в байтах (0 - выключен): последние записи от flight_recorder_level хранятся в памяти независимо от уровней вывода.
+    log_level_t flight_recorder_level;   ///< минимальный уровень записей самописца (по-умолчанию LL_TRACE), источник должен быть зарегистрирован.
+    const char *flight_recorder_path;    ///< файл дампа самописца по сигналу и для log_flight_recorder_dump(NULL) (NULL - "cos_log_flight.log").
+    bool        flight_recorder_crash_dump; ///< сохранять дамп самописца при SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT (затем вызывается прежний обработчик).
+    int         flight_recorder_signal;  ///< сигнал, по которому сохраняется дамп самописца, например SIGUSR2 (0 - нет).
+    int         signal_safe_fd;          ///< дескриптор вывода log_log_signal_safe(), открытый заранее (0 - stderr).
+    unsigned    dedup_window_ms;         ///< окно подавления повторов (0 - выключено): совпадающая с предыдущей записью источника запись (уровень, точка логгирования, сообщение) не выводится, а подсчитывается; "last message repeated N times" выводится перед следующей записью источника вне серии, в log_flush() и log_destroy() (не по таймеру окончания окна). Не применяется к RAW и в режиме deferred.
+    size_t      backtrace_records;       ///< ёмкость буфера предыстории каждого потока в записях (0 - выключен): записи ниже уровня вывода хранятся в буфере потока и выводятся перед его ошибкой (LL_ERROR и выше) с её уровнем.
+    unsigned    backtrace_window_ms;     ///< максимальный возраст выводимых записей предыстории (0 - без ограничения).
+    log_level_t backtrace_level;         ///< минимальный уровень записей предыстории (по-умолчанию LL_TRACE), источник должен быть зарегистрирован.
+    size_t      backtrace_record_size;   ///< максимальный размер записи предыстории в байтах, более длинные обрезаются (0 - 512).
+}
+log_config_t;
+
+/**
+ * Операции приёмника записей лога (см. log_sink_add()).
+ * Вызываются последовательно (под мьютексом приёмников) из потока, выводящего записи:
+ * логгирующего потока или фонового потока асинхронного вывода. Из операций нельзя логгировать.
+ */
+typedef struct tag_log_sink_ops
+{
+    void (*write)(void *ctx, const char *data, size_t len, log_level_t level); ///< вывод пачки сформированных записей уровня не ниже level (!= NULL).
+    void (*flush)(void *ctx);                                                  ///< сброс буферов приёмника (может быть NULL).
+    void (*close)(void *ctx);                                                  ///< закрытие приёмника при удалении (может быть NULL).
+}
+log_sink_ops_t;
+
+/**
+ * Приёмник записей лога (см. log_sink_add()).
+ */
+typedef struct tag_log_sink log_sink_t;
+
+/**
+ * Параметры буферизованного файлового приёмника (см. log_sink_add_buffered_file()).
+ * Нулевые значения параметров означают значения по-умолчанию.
+ */
+typedef struct tag_log_file_sink_config
+{
+    size_t      buffer_size;   ///< размер буфера в байтах (по-умолчанию 65536).
+    unsigned    idle_flush_ms; ///< максимальное время нахождения записей в буфере (по-умолчанию 1000 мс).
+    log_level_t flush_level;   ///< уровень, записи которого сбрасывают буфер немедленно (по-умолчанию LL_ERROR).
+}
+log_file_sink_config_t;
+
+/**
+ * Параметры ротации файлового приёмника (см. log_sink_add_rotating_file()).
+ */
+typedef struct tag_log_rotate_config
+{
+    size_t   max_size;     ///< размер файла в байтах, после которого выполняется ротация (0 - без ротации по размеру).
+    unsigned interval_sec; ///< период ротации в секундах (0 - без ротации по времени).
+    unsigned max_files;    ///< количество хранимых старых файлов "<path>.1" ... "<path>.<max_files>" (0 - 5).
+}
+log_rotate_config_t;
+
+/**
+ * Параметры приёмника в отображаемые в память сегменты (см. log_sink_add_mmap()).
+ * Нулевые значения параметров означают значения по-умолчанию.
+ */
+typedef struct tag_log_mmap_sink_config
+{
+    size_t segment_size; ///< размер файла сегмента в байтах, округляется вверх до размера страницы (по-умолчанию 16 МиБ).
+}
+log_mmap_sink_config_t;
+
+/**
+ * Дескриптор источника лога (см. log_source_get(), log_register_handle()).
+ * Позволяет логгировать без поиска источника по строке. Действителен до log_destroy().
+ */
+typedef struct tag_log_source log_source_t;
+
+/**
+ * Маска уровней в слове состояния точки логгирования.
+ * Оставшиеся старшие 52 бита слова занимает поколение конфигурации: за время работы процесса
+ * оно не переполняется, поэтому кеш, вычисленный при старом поколении, не может совпасть с текущим.
+ */
+#define LOG_CALLSITE_LEVEL_MASK 0xFFFu
+
+/**
+ * Маска минимального уровня, с которого записи точки формируются (для вывода или бортового самописца).
+ */
+#define LOG_CALLSITE_GATE_MASK 0x0Fu
+
+/**
+ * Смещение минимального уровня вывода в слове состояния точки логгирования.
+ */
+#define LOG_CALLSITE_OUTPUT_SHIFT 4
+
+/**
+ * Смещение уровня, ниже которого записи сэмплируются, в слове состояния точки логгирования.
+ */
+#define LOG_CALLSITE_SAMPLE_SHIFT 8
+
+/**
+ * Кеш точки логгирования (статический объект, создаваемый логгирующими макросами).
+ * Хранит вычисленный для источника минимальный уровень вместе с поколением конфигурации,
+ * для которого он был вычислен.
+ */
+typedef struct tag_log_callsite
+{
+    uint64_t state;            ///< поколение конфигурации | уровень сэмплирования << LOG_CALLSITE_SAMPLE_SHIFT | уровень вывода << LOG_CALLSITE_OUTPUT_SHIFT | уровень формирования (0 - не вычислен).
+    uint32_t deferred_id;      ///< идентификатор точки для отложенного форматирования (0 - не зарегистрирована).
+    uint32_t sample_threshold; ///< порог сэмплирования источника (см. log_sample_draw()).
+}
+log_callsite_t;
+
+/**
+ * Состояние ограничителя частоты точки логгирования (статический объект, создаваемый макросами _LOG_*_RL).
+ */
+typedef struct tag_log_ratelimit
+{
+    uint64_t tat;        ///< теоретическое время прибытия следующей записи, нс монотонных часов (0 - записей не было).
+    uint32_t suppressed; ///< количество записей, подавленных с прошлой разрешённой записи.
+}
+log_ratelimit_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * Текущее поколение конфигурации логгирования.
+ * Увеличивается при каждом изменении уровней или состава источников.
+ * Не предназначено для прямого использования, читается логгирующими макросами.
+ */
+extern
+uint64_t log_cfg_generation;
+
+/**
+ * Состояние генератора случайных чисел сэмплирования текущего потока.
+ * Не предназначено для прямого использования, читается логгирующими макросами.
+ */
+extern __thread
+uint64_t log_sample_rng;
+
+/**
+ * Выбирает начальное значение генератора сэмплирования текущего потока.
+ *
+ * @return начальное значение (!= 0).
+ */
+extern
+uint64_t log_sample_seed(void) __attribute__((warn_unused_result));
+
+/**
+ * Вычисляет минимальный уровень для источника и сохраняет его в кеше точки логгирования.
+ * Не изменяет errno.
+ *
+ * @param callsite  [in/out] кеш точки логгирования (!= NULL).
+ * @param source    [in]     источник лога (!= NULL).
+ * @param source_id [in]     идентификатор источника в манифесте (-1 - нет, источник ищется в хэше).
+ * @return новое слово состояния точки логгирования.
+ */
+extern
+uint64_t log_callsite_resolve(log_callsite_t *callsite,
+                              const char     *source,
+                              int             source_id) __attribute__((nonnull(1, 2)));
+
+/**
+ * Проверяет по кешу точки логгирования, будет ли сформирован лог заданного уровня
+ * (для вывода или для бортового самописца).
+ * При совпадении поколения конфигурации обходится без вызова функций, блокировок и поиска в хэше.
+ *
+ * @param callsite  [in/out] кеш точки логгирования (!= NULL).
+ * @param source    [in]     источник лога (!= NULL).
+ * @param source_id [in]     идентификатор источника в манифесте (-1 - нет).
+ * @param log_level [in]     уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ * @return true - будет сформирован, false - не будет.
+ */
+static inline
+bool log_callsite_enabled(log_callsite_t *callsite,
+                          const char     *source,
+                          int             source_id,
+                          log_level_t     log_level)
+{
+    uint64_t state = __atomic_load_n(&callsite->state, __ATOMIC_RELAXED);
+
+    if ((state & ~(uint64_t)LOG_CALLSITE_LEVEL_MASK) != __atomic_load_n(&log_cfg_generation, __ATOMIC_RELAXED))
+    {
+        state = log_callsite_resolve(callsite, source, source_id);
+    }
+    return ((uint32_t)log_level >= (state & LOG_CALLSITE_GATE_MASK));
+}
+
+/**
+ * Проверяет ограничение частоты точки логгирования (алгоритм GCRA - эквивалент корзины маркеров):
+ * запись разрешена, если теоретическое время прибытия опережает текущее не более чем на burst - 1 интервалов.
+ * Не берёт блокировок и не изменяет errno.
+ *
+ * @param ratelimit  [in/out] состояние ограничителя точки логгирования (!= NULL).
+ * @param rate       [in]     разрешённое количество записей в секунду (0 - без ограничения).
+ * @param burst      [in]     максимальная пачка записей подряд (0 - 1).
+ * @param suppressed [out]    количество записей, подавленных с прошлой разрешённой записи (!= NULL).
+ * @return true - запись разрешена, false - подавлена.
+ */
+extern
+bool log_ratelimit_allow(log_ratelimit_t *ratelimit,
+                         unsigned         rate,
+                         unsigned         burst,
+                         uint32_t        *suppressed) __attribute__((nonnull(1, 4))) __attribute__((warn_unused_result));
+
+/**
+ * Возвращает очередное случайное число генератора сэмплирования текущего потока (xorshift64).
+ *
+ * @return случайное число, равномерно распределённое на [0, 2^32).
+ */
+static inline
+uint32_t log_sample_draw(void)
+{
+    uint64_t x = log_sample_rng;
+
+    if (x == 0) x = log_sample_seed();
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    log_sample_rng = x;
+    return (uint32_t)(x >> 32);
+}
+
+/**
+ * Разыгрывает сэмплирование записи точки логгирования (после log_callsite_enabled()).
+ * Для уровней без сэмплирования обходится одним сравнением.
+ *
+ * @param callsite  [in] кеш точки логгирования (!= NULL).
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ * @return true - запись сохраняется, false - отброшена.
+ */
+static inline
+bool log_callsite_sampled(const log_callsite_t *callsite,
+                          log_level_t           log_level)
+{
+    uint64_t state = __atomic_load_n(&callsite->state, __ATOMIC_RELAXED);
+
+    if ((uint32_t)log_level >= ((state >> LOG_CALLSITE_SAMPLE_SHIFT) & LOG_CALLSITE_GATE_MASK)) return true;
+    return (log_sample_draw() < __atomic_load_n(&callsite->sample_threshold, __ATOMIC_RELAXED));
+}
+
+/**
+ * Проверяет по кешу точки логгирования, будет ли лог заданного уровня выведен (после log_callsite_enabled()).
+ * Записи, которые только сохраняются бортовым самописцем или буфером предыстории, не выводятся.
+ *
+ * @param callsite  [in] кеш точки логгирования (!= NULL).
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ * @return true - будет выведен, false - не будет.
+ */
+static inline
+bool log_callsite_printed(const log_callsite_t *callsite,
+                          log_level_t           log_level)
+{
+    uint64_t state = __atomic_load_n(&callsite->state, __ATOMIC_RELAXED);
+
+    return ((uint32_t)log_level >= ((state >> LOG_CALLSITE_OUTPUT_SHIFT) & LOG_CALLSITE_GATE_MASK));
+}
+
+/**
+ * Пустая функция, используемая только для проверки строки формата у вырезанных при сборке логов.
+ */
+static inline
+void log_printf_check(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static inline
+void log_printf_check(const char *fmt, ...)
+{
+    UNUSED_PARAM(fmt);
+}
+
 /**
  * Инициализирует систему логгирования.
  * Данный вызов не допускается 2 раза подряд.
@@ -64,6 +376,16 @@ extern
 bool log_init(log_level_t min_log_level,
               bool        is_thread_safe);
 
+/**
+ * Инициализирует систему логгирования с расширенными параметрами.
+ * Данный вызов не допускается 2 раза подряд.
+ *
+ * @param config [in] параметры (!= NULL).
+ * @return true - OK, false - Fail
+ */
+extern
+bool log_init_ex(const log_config_t *config) __attribute__((nonnull(1)));
+
 /**
  * Устанавливает глобальный уровень логгирования.
  *
@@ -85,6 +407,47 @@ extern
 bool log_register(const char  *source,
                   log_level_t  min_log_level) __attribute__((nonnull(1)));
 
+/**
+ * Регистрирует новый источник лога в системе логгирования и возвращает его дескриптор.
+ * Если заданный источник уже зерегистрирован, он перезаписывается.
+ *
+ * @param source        [in] источник лога (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
+ * @param min_log_level [in] минимальный уровень выводимого лога (LL_NONE - отключает вывод).
+ * @return дескриптор источника (действителен до log_destroy()) или NULL в случае ошибки.
+ */
+extern
+log_source_t *log_register_handle(const char  *source,
+                                  log_level_t  min_log_level) __attribute__((nonnull(1)));
+
+/**
+ * Возвращает дескриптор источника лога.
+ * Если источник ещё не зарегистрирован, создаётся незарегистрированный дескриптор:
+ * логи через него не выводятся до регистрации источника функцией log_register().
+ *
+ * @param source [in] источник лога (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
+ * @return дескриптор источника (действителен до log_destroy()) или NULL в случае ошибки.
+ */
+extern
+log_source_t *log_source_get(const char *source) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
+
+/**
+ * Регистрирует новый источник лога с сэмплированием записей низких уровней:
+ * из записей уровней ниже sample_level выводится случайная доля sample_ratio.
+ * Решение принимается логгирующими макросами до вычисления аргументов и форматирования.
+ * Если заданный источник уже зерегистрирован, он перезаписывается.
+ *
+ * @param source        [in] источник лога (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
+ * @param min_log_level [in] минимальный уровень выводимого лога (LL_NONE - отключает вывод).
+ * @param sample_level  [in] записи уровней ниже sample_level сэмплируются (LL_INVALID - без сэмплирования).
+ * @param sample_ratio  [in] доля сохраняемых записей сэмплируемых уровней (0.0 ... 1.0).
+ * @return true - OK, false - fail.
+ */
+extern
+bool log_register_sampled(const char  *source,
+                          log_level_t  min_log_level,
+                          log_level_t  sample_level,
+                          double       sample_ratio) __attribute__((nonnull(1)));
+
 /**
  * Регистрирует новые источники лога в системе логгирования.
  * Если один из источников уже зерегистрирован, он перезаписывается.
@@ -106,6 +469,9 @@ void log_unregister(const char *source) __attribute__((nonnull(1)));
 
 /**
  * Удаляет регистрацию всех источников в системе логгирования.
+ * В асинхронном режиме останавливает фоновый поток (выводя или отбрасывая оставшиеся записи).
+ * Дескрипторы источников становятся недействительными, после вызова систему можно снова
+ * инициализировать log_init().
  *
  * @return true - OK, false -Fail
  */
@@ -131,6 +497,29 @@ void log_log(const char  *source,
              log_level_t  log_level,
              const char  *fmt, ...) __attribute__((format(printf, 6, 7), nonnull(1, 2, 3, 4, 6)));
 
+/**
+ * Логгирует в стиле printf от имени точки логгирования (используется макросами _LOG_*).
+ * В режиме отложенного форматирования сохраняет в кольцо строку формата по ссылке и аргументы
+ * в двоичном виде, форматирование выполняет фоновый поток. Строки file, line, function и fmt
+ * должны существовать всё время работы процесса.
+ *
+ * @param callsite  [in/out] кеш точки логгирования (!= NULL).
+ * @param source    [in] источник (строка - источника лога) (!= NULL)
+ * @param file      [in] имя файла.
+ * @param line      [in] номер строки в файле.
+ * @param function  [in] имя функции.
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ * @param fmt       [in] (!= NULL).
+ */
+extern
+void log_log_cs(log_callsite_t *callsite,
+                const char     *source,
+                const char     *file,
+                const char     *line,
+                const char     *function,
+                log_level_t     log_level,
+                const char     *fmt, ...) __attribute__((format(printf, 7, 8), nonnull(1, 2, 3, 4, 5, 7)));
+
 /**
  * Логгирует RAW буфер.
  * Печатает prefix и время перед логом.
@@ -150,6 +539,92 @@ void log_raw(const char *source,
              const void *buffer,
              size_t      length) __attribute__((nonnull(1, 2, 3, 4)));
 
+/**
+ * Логгирует в стиле printf от имени дескриптора источника (без поиска источника по строке).
+ * Печатает prefix и время перед логом.
+ *
+ * @param source    [in] дескриптор источника (!= NULL)
+ * @param file      [in] имя файла (максимальная длина LOG_FUNCTION_NAME_MAX_SIZE).
+ * @param line      [in] номер строки в файле.
+ * @param function  [in] имя функции (максимальная длина LOG_FILE_NAME_MAX_SIZE).
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ * @param fmt       [in] (!= NULL).
+ */
+extern
+void log_log_h(const log_source_t *source,
+               const char         *file,
+               const char         *line,
+               const char         *function,
+               log_level_t         log_level,
+               const char         *fmt, ...) __attribute__((format(printf, 6, 7), nonnull(1, 2, 3, 4, 6)));
+
+/**
+ * Логгирует RAW буфер от имени дескриптора источника (без поиска источника по строке).
+ * Печатает prefix и время перед логом.
+ *
+ * @param source   [in] дескриптор источника (!= NULL)
+ * @param file     [in] имя файла  (максимальная длина LOG_FUNCTION_NAME_MAX_SIZE).
+ * @param line     [in] номер строки в файле
+ * @param function [in] имя функции (максимальная длина LOG_FILE_NAME_MAX_SIZE).
+ * @param buffer   [in] указатель на буфер (может быть NULL)
+ * @param length   [in] размер буфера в байтах
+ */
+extern
+void log_raw_h(const log_source_t *source,
+               const char         *file,
+               const char         *line,
+               const char         *function,
+               const void         *buffer,
+               size_t              length) __attribute__((nonnull(1, 2, 3, 4)));
+
+/**
+ * Логгирует из обработчика сигнала (в том числе аварийного, когда другой поток держит мьютекс логгера).
+ * Не выделяет память и не берёт блокировок: запись формируется на стеке минимальным форматтером
+ * (%d, %i, %u, %x, %X, %o, %p, %s, %c с флагами '-', '0', '#', шириной, точностью и модификаторами размера;
+ * прочие преобразования выводятся как есть) и выводится одним вызовом write(2) в
+ * log_config_t.signal_safe_fd мимо асинхронного кольца и приёмников, а также сохраняется в бортовой самописец.
+ * Не изменяет errno.
+ *
+ * @param source    [in] источник (строка - источника лога) (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
+ * @param file      [in] имя файла (максимальная длина LOG_FUNCTION_NAME_MAX_SIZE).
+ * @param line      [in] номер строки в файле.
+ * @param function  [in] имя функции (максимальная длина LOG_FILE_NAME_MAX_SIZE).
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ * @param fmt       [in] (!= NULL).
+ */
+extern
+void log_log_signal_safe(const char  *source,
+                         const char  *file,
+                         const char  *line,
+                         const char  *function,
+                         log_level_t  log_level,
+                         const char  *fmt, ...) __attribute__((format(printf, 6, 7), nonnull(1, 2, 3, 4, 6)));
+
+/**
+ * Сообщает будет ли выведен лог от дескриптора источника с данным уровнем.
+ *
+ * @param source    [in] дескриптор источника (!= NULL)
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ *
+ * @return true - будет выведен, false - не будет.
+ */
+extern
+bool log_will_be_printed_h(const log_source_t *source,
+                           log_level_t         log_level) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
+
+/**
+ * Сообщает, будет ли сформирован лог от дескриптора источника с данным уровнем:
+ * выведен или сохранён бортовым самописцем, с учётом сэмплирования источника (используется макросами _LOG_H_*).
+ *
+ * @param source    [in] дескриптор источника (!= NULL)
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ *
+ * @return true - будет сформирован, false - не будет.
+ */
+extern
+bool log_will_be_formed_h(const log_source_t *source,
+                          log_level_t         log_level) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
+
 /**
  * Преобразует строку в элемент множества log_level_t.
  * Нечувствительна к регистру.
@@ -199,6 +674,150 @@ log_level_t log_get_src_level(const char *source) __attribute__((nonnull(1))) __
 extern
 log_level_t log_get_global_level(void) __attribute__((warn_unused_result));
 
+/**
+ * Добавляет приёмник записей лога. Каждая сформированная запись один раз передаётся всем приёмникам,
+ * минимальный уровень которых не выше уровня записи.
+ * Пока не добавлено ни одного приёмника, записи выводятся в stderr.
+ * Приёмники можно добавлять до log_init(), log_destroy() закрывает и удаляет все приёмники.
+ * В режиме binary_path записи выводятся в двоичный файл, а не в приёмники.
+ *
+ * @param ops           [in] операции приёмника (копируются) (!= NULL, ops->write != NULL).
+ * @param ctx           [in] контекст, передаваемый операциям.
+ * @param min_log_level [in] минимальный уровень записей для приёмника (LL_NONE - не выводить).
+ * @return приёмник или NULL в случае ошибки.
+ */
+extern
+log_sink_t *log_sink_add(const log_sink_ops_t *ops,
+                         void                 *ctx,
+                         log_level_t           min_log_level) __attribute__((nonnull(1)));
+
+/**
+ * Добавляет приёмник, выводящий записи в файловый дескриптор (дескриптор не закрывается).
+ *
+ * @param fd            [in] файловый дескриптор (>= 0).
+ * @param min_log_level [in] минимальный уровень записей для приёмника.
+ * @return приёмник или NULL в случае ошибки.
+ */
+extern
+log_sink_t *log_sink_add_fd(int         fd,
+                            log_level_t min_log_level);
+
+/**
+ * Добавляет приёмник, дописывающий записи в файл (файл создаётся при необходимости и закрывается при удалении приёмника).
+ *
+ * @param path          [in] путь к файлу (!= NULL).
+ * @param min_log_level [in] минимальный уровень записей для приёмника.
+ * @return приёмник или NULL в случае ошибки.
+ */
+extern
+log_sink_t *log_sink_add_file(const char  *path,
+                              log_level_t  min_log_level) __attribute__((nonnull(1)));
+
+/**
+ * Добавляет приёмник, дописывающий записи в файл через буфер: записи накапливаются в буфере и выводятся
+ * одним вызовом writev(2) вместе с записью, не поместившейся в буфер. Буфер также сбрасывается
+ * через idle_flush_ms после попадания в него данных (фоновым потоком приёмника) и сразу после
+ * записи уровня flush_level и выше.
+ *
+ * @param path          [in] путь к файлу (!= NULL).
+ * @param min_log_level [in] минимальный уровень записей для приёмника.
+ * @param config        [in] параметры (NULL - по-умолчанию).
+ * @return приёмник или NULL в случае ошибки.
+ */
+extern
+log_sink_t *log_sink_add_buffered_file(const char                   *path,
+                                       log_level_t                   min_log_level,
+                                       const log_file_sink_config_t *config) __attribute__((nonnull(1)));
+
+/**
+ * Добавляет приёмник, дописывающий записи в файл с ротацией по размеру и/или по времени:
+ * файл переименовывается в "<path>.1" (старые файлы сдвигаются, самый старый удаляется) и создаётся заново.
+ * Переименование и создание файла выполняет фоновый поток приёмника, после чего атомарно
+ * подменяет дескриптор: до подмены записи дописываются в прежний файл и не теряются,
+ * логгирующие потоки не ожидают ввода-вывода ротации.
+ *
+ * @param path          [in] путь к файлу (!= NULL).
+ * @param min_log_level [in] минимальный уровень записей для приёмника.
+ * @param config        [in] параметры ротации (!= NULL).
+ * @return приёмник или NULL в случае ошибки.
+ */
+extern
+log_sink_t *log_sink_add_rotating_file(const char                *path,
+                                       log_level_t                min_log_level,
+                                       const log_rotate_config_t *config) __attribute__((nonnull(1, 3)));
+
+/**
+ * Добавляет приёмник, копирующий записи в отображённые в память (mmap) файлы сегментов
+ * "<path_prefix>.<номер>" фиксированного размера: вывод записи не требует системных вызовов.
+ * Следующий сегмент заранее создаётся и отображается фоновым потоком приёмника, он же
+ * синхронизирует (msync) и освобождает заполненные сегменты. Скопированные в отображение
+ * записи не теряются при аварийном завершении процесса. Последний сегмент при удалении
+ * приёмника усекается до размера записанных данных (после аварии остаток сегмента заполнен нулями).
+ * Нумерация начинается с первого свободного номера.
+ * Записи не отбрасываются: если фоновый поток не успевает (следующий сегмент ещё не создан или
+ * предыдущий заполненный ещё не освобождён), вывод, заполнивший сегмент, блокируется до его готовности.
+ *
+ * @param path_prefix   [in] префикс путей файлов сегментов (!= NULL).
+ * @param min_log_level [in] минимальный уровень записей для приёмника.
+ * @param config        [in] параметры (NULL - по-умолчанию).
+ * @return приёмник или NULL в случае ошибки.
+ */
+extern
+log_sink_t *log_sink_add_mmap(const char                   *path_prefix,
+                              log_level_t                   min_log_level,
+                              const log_mmap_sink_config_t *config) __attribute__((nonnull(1)));
+
+/**
+ * Добавляет приёмник, передающий пачки записей функции пользователя.
+ *
+ * @param callback      [in] функция вывода пачки записей (!= NULL).
+ * @param arg           [in] аргумент функции.
+ * @param min_log_level [in] минимальный уровень записей для приёмника.
+ * @return приёмник или NULL в случае ошибки.
+ */
+extern
+log_sink_t *log_sink_add_callback(void        (*callback)(void *arg, const char *data, size_t len, log_level_t level),
+                                  void         *arg,
+                                  log_level_t   min_log_level) __attribute__((nonnull(1)));
+
+/**
+ * Изменяет минимальный уровень записей для приёмника.
+ * В асинхронном режиме новый уровень применяется и к записям, ещё не выведенным из кольца.
+ *
+ * @param sink          [in/out] приёмник (!= NULL).
+ * @param min_log_level [in] минимальный уровень записей для приёмника.
+ * @return true - OK, false - Fail
+ */
+extern
+bool log_sink_set_level(log_sink_t  *sink,
+                        log_level_t  min_log_level) __attribute__((nonnull(1)));
+
+/**
+ * Удаляет приёмник (вызывая его операции flush и close).
+ *
+ * @param sink [in] приёмник (!= NULL).
+ * @return true - OK, false - приёмник не найден.
+ */
+extern
+bool log_sink_remove(log_sink_t *sink) __attribute__((nonnull(1)));
+
+/**
+ * Сбрасывает буферы всех приёмников. В асинхронном режиме предварительно дожидается
+ * вывода записей, помещённых в кольцо до вызова.
+ */
+extern
+void log_flush(void);
+
+/**
+ * Сохраняет дамп бортового самописца в файл (см. log_config_t.flight_recorder_size).
+ * Записи, добавляемые во время дампа, могут оказаться в нём частично.
+ *
+ * @param path [in] путь к файлу (NULL - log_config_t.flight_recorder_path).
+ * @return true - OK, false - самописец выключен или файл не создан.
+ */
+extern
+bool log_flight_recorder_dump(const char *path);
+
 /**
  * Выполняет дамп источников лога.
  * Вызывающая сторона обязана после прекращения использования вызвать free().
@@ -229,15 +848,167 @@ void log_src_dump_delete(log_src_dump_t *dump);
 #endif
 
 /**
- * Логгирующие макросы
+ * Идентификатор источника _LOG_SRC в манифесте (-1 - источника нет в манифесте).
+ * С манифестом _LOG_SRC должен быть строковым литералом. Идентификатор вычисляется только при
+ * включённой оптимизации, когда компилятор сворачивает его в константу; без оптимизации точки
+ * логгирования находят источник поиском в хэше.
+ */
+#if DO_LOG_SRC_MANIFEST && defined(__OPTIMIZE__)
+#define _LOG_SRC_ID LOG_SRC_MANIFEST_ID(_LOG_SRC)
+#else
+#define _LOG_SRC_ID (-1)
+#endif
+
+/**
+ * Логгирующие макросы.
+ * Уровень проверяется до вычисления аргументов: если лог не будет выведен,
+ * аргументы (включая buf, len, err_code, err_text) не вычисляются.
+ */
+#if LOG_COMPILE_MIN_LEVEL <= LOG_LVL_RAW
+#define _LOG_RAW(buf,len)                                                                           \
+    do                                                                                              \
+    {                                                                                               \
+        static log_callsite_t _log_callsite;                                                        \
+        if (log_callsite_enabled(&_log_callsite, _LOG_SRC, _LOG_SRC_ID, LL_RAW) &&                  \
+            log_callsite_sampled(&_log_callsite, LL_RAW))                                           \
+        {                                                                                           \
+            log_raw(_LOG_SRC, __FILE__, STRX(__LINE__), __FUNCTION__, buf, len);                    \
+        }                                                                                           \
+    } while (0)
+#define _LOG_H_RAW(src_h, buf, len)                                                                 \
+    do                                                                                              \
+    {                                                                                               \
+        const log_source_t *_log_src_h = (src_h);                                                   \
+        if (log_will_be_formed_h(_log_src_h, LL_RAW))                                               \
+        {                                                                                           \
+            log_raw_h(_log_src_h, __FILE__, STRX(__LINE__), __FUNCTION__, buf, len);                \
+        }                                                                                           \
+    } while (0)
+#else
+#define _LOG_RAW(buf,len) do { if (0) { (void)(buf); (void)(len); } } while (0)
+#define _LOG_H_RAW(src_h, buf, len) do { if (0) { (void)(src_h); (void)(buf); (void)(len); } } while (0)
+#endif
+#define _LOG_LEVEL(level, ...)                                                                      \
+    do                                                                                              \
+    {                                                                                               \
+        static log_callsite_t _log_callsite;                                                        \
+        const log_level_t _log_level = (level);                                                     \
+        if (log_callsite_enabled(&_log_callsite, _LOG_SRC, _LOG_SRC_ID, _log_level) &&              \
+            log_callsite_sampled(&_log_callsite, _log_level))                                       \
+        {                                                                                           \
+            log_log_cs(&_log_callsite, _LOG_SRC, __FILE__, STRX(__LINE__), __FUNCTION__,          \
+                       _log_level, __VA_ARGS__);                                                    \
+        }                                                                                           \
+    } while (0)
+
+/**
+ * Логгирующие макросы для дескриптора источника (log_source_t *), полученного заранее
+ * через log_source_get() или log_register_handle().
+ */
+#define _LOG_H_LEVEL(src_h, level, ...)                                                             \
+    do                                                                                              \
+    {                                                                                               \
+        const log_source_t *_log_src_h = (src_h);                                                   \
+        const log_level_t _log_level = (level);                                                     \
+        if (log_will_be_formed_h(_log_src_h, _log_level))                                           \
+        {                                                                                           \
+            log_log_h(_log_src_h, __FILE__, STRX(__LINE__), __FUNCTION__, _log_level, __VA_ARGS__); \
+        }                                                                                           \
+    } while (0)
+
+/**
+ * Логгирующие макросы с ограничением частоты: не более rate записей в секунду с пачками до burst записей.
+ * Подавленные вызовы стоят только проверки уровня и ограничителя, аргументы не вычисляются.
+ * Следующая выведенная запись дополняется количеством подавленных: "(N messages suppressed)".
+ * fmt должен быть строковым литералом. Запись с количеством подавленных имеет свою строку формата,
+ * поэтому у неё своя точка логгирования (в режиме deferred точка запоминает свою строку формата).
+ */
+#define _LOG_LEVEL_RL(level, rate, burst, fmt, ...)                                                 \
+    do                                                                                              \
+    {                                                                                               \
+        static log_callsite_t _log_callsite;                                                        \
+        static log_callsite_t _log_callsite_suppressed;                                             \
+        static log_ratelimit_t _log_ratelimit;                                                      \
+        const log_level_t _log_level = (level);                                                     \
+        uint32_t _log_suppressed;                                                                   \
+        if (log_callsite_enabled(&_log_callsite, _LOG_SRC, _LOG_SRC_ID, _log_level) &&              \
+            log_callsite_sampled(&_log_callsite, _log_level) &&                                     \
+            log_ratelimit_allow(&_log_ratelimit, (rate), (burst), &_log_suppressed))                \
+        {                                                                                           \
+            if (_log_suppressed == 0)                                                               \
+            {                                                                                       \
+                log_log_cs(&_log_callsite, _LOG_SRC, __FILE__, STRX(__LINE__), __FUNCTION__,      \
+                           _log_level, fmt, ##__VA_ARGS__);                                         \
+            }                                                                                       \
+            else if (log_callsite_enabled(&_log_callsite_suppressed, _LOG_SRC, _LOG_SRC_ID,         \
+                                          _log_level))                                              \
+            {                                                                                       \
+                log_log_cs(&_log_callsite_suppressed, _LOG_SRC, __FILE__, STRX(__LINE__),           \
+                           __FUNCTION__, _log_level, fmt " (%u messages suppressed)",               \
+                           ##__VA_ARGS__, (unsigned)_log_suppressed);                               \
+            }                                                                                       \
+        }                                                                                           \
+    } while (0)
+
+/**
+ * Лог, вырезанный при сборке: аргументы не вычисляются, но строка формата проверяется компилятором.
  */
-#define _LOG_RAW(buf,len) log_raw(_LOG_SRC, __FILE__, STRX(__LINE__), __FUNCTION__, buf, len)
-#define _LOG_LEVEL(level, ...) log_log(_LOG_SRC, __FILE__, STRX(__LINE__), __FUNCTION__, level, __VA_ARGS__)
+#define _LOG_STRIPPED(...) do { if (0) log_printf_check(__VA_ARGS__); } while (0)
+#define _LOG_H_STRIPPED(src_h, ...) do { if (0) { (void)(src_h); log_printf_check(__VA_ARGS__); } } while (0)
+#define _LOG_RL_STRIPPED(rate, burst, ...) do { if (0) { (void)(rate); (void)(burst); log_printf_check(__VA_ARGS__); } } while (0)
+
+#if LOG_COMPILE_MIN_LEVEL <= LOG_LVL_TRACE
 #define _LOG_TRACE(...)   _LOG_LEVEL(LL_TRACE,   __VA_ARGS__)
+#define _LOG_H_TRACE(src_h, ...) _LOG_H_LEVEL(src_h, LL_TRACE,   __VA_ARGS__)
+#define _LOG_TRACE_RL(rate, burst, ...) _LOG_LEVEL_RL(LL_TRACE,   rate, burst, __VA_ARGS__)
+#else
+#define _LOG_TRACE(...)   _LOG_STRIPPED(__VA_ARGS__)
+#define _LOG_H_TRACE(src_h, ...) _LOG_H_STRIPPED(src_h, __VA_ARGS__)
+#define _LOG_TRACE_RL(rate, burst, ...) _LOG_RL_STRIPPED(rate, burst, __VA_ARGS__)
+#endif
+#if LOG_COMPILE_MIN_LEVEL <= LOG_LVL_DEBUG
 #define _LOG_DEBUG(...)   _LOG_LEVEL(LL_DEBUG,   __VA_ARGS__)
+#define _LOG_H_DEBUG(src_h, ...) _LOG_H_LEVEL(src_h, LL_DEBUG,   __VA_ARGS__)
+#define _LOG_DEBUG_RL(rate, burst, ...) _LOG_LEVEL_RL(LL_DEBUG,   rate, burst, __VA_ARGS__)
+#else
+#define _LOG_DEBUG(...)   _LOG_STRIPPED(__VA_ARGS__)
+#define _LOG_H_DEBUG(src_h, ...) _LOG_H_STRIPPED(src_h, __VA_ARGS__)
+#define _LOG_DEBUG_RL(rate, burst, ...) _LOG_RL_STRIPPED(rate, burst, __VA_ARGS__)
+#endif
+#if LOG_COMPILE_MIN_LEVEL <= LOG_LVL_INFO
 #define _LOG_INFO(...)    _LOG_LEVEL(LL_INFO,    __VA_ARGS__)
+#define _LOG_H_INFO(src_h, ...) _LOG_H_LEVEL(src_h, LL_INFO,    __VA_ARGS__)
+#define _LOG_INFO_RL(rate, burst, ...) _LOG_LEVEL_RL(LL_INFO,    rate, burst, __VA_ARGS__)
+#else
+#define _LOG_INFO(...)    _LOG_STRIPPED(__VA_ARGS__)
+#define _LOG_H_INFO(src_h, ...) _LOG_H_STRIPPED(src_h, __VA_ARGS__)
+#define _LOG_INFO_RL(rate, burst, ...) _LOG_RL_STRIPPED(rate, burst, __VA_ARGS__)
+#endif
+#if LOG_COMPILE_MIN_LEVEL <= LOG_LVL_WARNING
 #define _LOG_WARNING(...) _LOG_LEVEL(LL_WARNING, __VA_ARGS__)
+#define _LOG_H_WARNING(src_h, ...) _LOG_H_LEVEL(src_h, LL_WARNING, __VA_ARGS__)
+#define _LOG_WARNING_RL(rate, burst, ...) _LOG_LEVEL_RL(LL_WARNING, rate, burst, __VA_ARGS__)
+#else
+#define _LOG_WARNING(...) _LOG_STRIPPED(__VA_ARGS__)
+#define _LOG_H_WARNING(src_h, ...) _LOG_H_STRIPPED(src_h, __VA_ARGS__)
+#define _LOG_WARNING_RL(rate, burst, ...) _LOG_RL_STRIPPED(rate, burst, __VA_ARGS__)
+#endif
+#if LOG_COMPILE_MIN_LEVEL <= LOG_LVL_ERROR
 #define _LOG_ERROR(...)   _LOG_LEVEL(LL_ERROR,   __VA_ARGS__)
+#define _LOG_H_ERROR(src_h, ...) _LOG_H_LEVEL(src_h, LL_ERROR,   __VA_ARGS__)
+#define _LOG_ERROR_RL(rate, burst, ...) _LOG_LEVEL_RL(LL_ERROR,   rate, burst, __VA_ARGS__)
+#else
+#define _LOG_ERROR(...)   _LOG_STRIPPED(__VA_ARGS__)
+#define _LOG_H_ERROR(src_h, ...) _LOG_H_STRIPPED(src_h, __VA_ARGS__)
+#define _LOG_ERROR_RL(rate, burst, ...) _LOG_RL_STRIPPED(rate, burst, __VA_ARGS__)
+#endif
+
+/**
+ * Логгирующий макрос для обработчиков сигналов (см. log_log_signal_safe()).
+ * Не вырезается при сборке: аварийные записи выводятся независимо от LOG_COMPILE_MIN_LEVEL.
+ */
+#define _LOG_SIGNAL_SAFE(level, ...) \
+    log_log_signal_safe(_LOG_SRC, __FILE__, STRX(__LINE__), __FUNCTION__, level, __VA_ARGS__)
 
 /**
  * Расширенный вывод лог сообщения об ошибке с кодом err_code и текстовым описанием err_text.
@@ -246,7 +1017,8 @@ void log_src_dump_delete(log_src_dump_t *dump);
     _LOG_ERROR(msg" :[%6d]: %s", ##__VA_ARGS__, err_code, err_text)
 
 /**
- * Использовать в случаях, когда нужно вывести errno
+ * Использовать в случаях, когда нужно вывести errno.
+ * Проверка уровня не изменяет errno, поэтому выводится значение на момент вызова макроса.
  */
 #define _LOG_ERROR_ERRNO(msg, ...) \
     _LOG_ERROR_EX(errno, strerror(errno), msg, ##__VA_ARGS__)
@@ -258,8 +1030,18 @@ void log_src_dump_delete(log_src_dump_t *dump);
     _LOG_ERROR_EX(err_status, strerror(err_status), msg, ##__VA_ARGS__)
 
 /**
- * Проверяет будет ли напечатан лог заданного уровня из текущего источника
+ * Проверяет будет ли напечатан лог заданного уровня из текущего источника.
+ * Для уровней ниже LOG_COMPILE_MIN_LEVEL всегда false.
+ * Результат детерминирован: сэмплирование не разыгрывается, а записи, которые только сохраняются
+ * бортовым самописцем или буфером предыстории, напечатанными не считаются.
  */
-#define _LOG_WILL_BE_PRINTED(log_level) log_will_be_printed(_LOG_SRC, log_level)
+#define _LOG_WILL_BE_PRINTED(log_level)                                                             \
+    ({                                                                                              \
+        static log_callsite_t _log_callsite;                                                        \
+        const log_level_t _log_level = (log_level);                                                 \
+        ((int)_log_level >= LOG_COMPILE_MIN_LEVEL) &&                                               \
+            log_callsite_enabled(&_log_callsite, _LOG_SRC, _LOG_SRC_ID, _log_level) &&              \
+            log_callsite_printed(&_log_callsite, _log_level);                                       \
+    })
 
 #endif /* LOG_H_ */
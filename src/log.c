@@ -1,17 +1,26 @@
 #include <assert.h>
-#include <ctype.h>
+#include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
-#include <sys/time.h>
 #include <time.h>
+#include <unistd.h>
 
-#include "uthash.h"
+#include "log_hexdump.h"
+#include "log_uring.h"
 
 #define _LOG_SRC "UNKNOWN"
 #include "log.h"
+#include "log_async.h"
+#include "log_backtrace.h"
+#include "log_deferred.h"
+#include "log_flight.h"
+#include "log_signal.h"
+#include "log_src_table.h"
 
 /**
  * Максимальный размер отображаемой части источника лога
@@ -19,7 +28,7 @@
 #define LOG_SRC_MAX_SIZE 16
 
 /**
- * Максимальный размер хрянящегося источника в хэше
+ * Максимальная длина хранящегося имени источника
  */
 #define LOG_SRC_STORED_MAX_SIZE 128
 
@@ -50,9 +59,82 @@
 #endif
 
 /**
- * Ширина поля адреса в строке log_raw
+ * 1 - время берётся с грубых (быстрых, с точностью до тиков ядра) часов CLOCK_REALTIME_COARSE
+ * 0 - с точных часов CLOCK_REALTIME
  */
-#define LOG_RAW_ADDR_FIELD_WIDTH 8
+#ifndef DO_LOG_COARSE_TIME
+#define DO_LOG_COARSE_TIME 0
+#endif
+
+#if DO_LOG_COARSE_TIME && defined(CLOCK_REALTIME_COARSE)
+#define LOG_TIME_CLOCK CLOCK_REALTIME_COARSE
+#else
+#define LOG_TIME_CLOCK CLOCK_REALTIME
+#endif
+
+/**
+ * Часы ограничителя частоты и окна подавления повторов: грубые часы на порядок дешевле точных,
+ * а их точности (тик ядра) достаточно для ограничения в сотни записей в секунду
+ */
+#ifdef CLOCK_MONOTONIC_COARSE
+#define LOG_MONOTONIC_CLOCK CLOCK_MONOTONIC_COARSE
+#else
+#define LOG_MONOTONIC_CLOCK CLOCK_MONOTONIC
+#endif
+
+/**
+ * Начальное значение и множитель хэша FNV-1a (64 бита)
+ */
+#define LOG_FNV_OFFSET_BASIS 14695981039346656037ull
+#define LOG_FNV_PRIME        1099511628211ull
+
+/**
+ * Максимальный размер одной записи лога (префикс + сообщение), остальное обрезается
+ */
+#define LOG_RECORD_MAX_SIZE 8192
+
+/**
+ * Параметры асинхронного вывода по-умолчанию
+ */
+#define LOG_ASYNC_DEFAULT_RING_SIZE         4096
+#define LOG_ASYNC_DEFAULT_RECORD_SIZE       512
+#define LOG_ASYNC_DEFAULT_FLUSH_INTERVAL_MS 1000
+
+/**
+ * Максимальный размер записи log_log_signal_safe() (формируется на стеке обработчика сигнала)
+ */
+#define LOG_SIGNAL_RECORD_MAX_SIZE 1024
+
+/**
+ * Параметры буфера предыстории потока по-умолчанию
+ */
+#define LOG_BACKTRACE_DEFAULT_RECORD_SIZE 512
+
+/**
+ * Файл дампа бортового самописца по-умолчанию
+ */
+#define LOG_FLIGHT_DEFAULT_PATH "cos_log_flight.log"
+
+/**
+ * Шаг поколения конфигурации (младшие биты слова состояния точки логгирования занимают уровни)
+ */
+#define LOG_CFG_GENERATION_STEP ((uint64_t)LOG_CALLSITE_LEVEL_MASK + 1)
+
+/**
+ * Количество счётчиков читателей на каждую копию хранилища источников
+ * (потоки распределяются по счётчикам, чтобы не делить одну кеш-линию)
+ */
+#define LOG_SRC_HM_READER_SLOTS 16
+
+/**
+ * Размер кеш-линии
+ */
+#define LOG_CACHE_LINE_SIZE 64
+
+/**
+ * Максимальное количество приёмников записей лога
+ */
+#define LOG_MAX_SINKS 16
 
 #define MUTEX_CHECK_LOCK(p_mutex)                                             \
 {                                                                             \
@@ -71,48 +153,201 @@
 }
 
 /**
- * Контекст источника лога
+ * Последняя выведенная запись источника для подавления повторов.
+ * Создаётся вместе с дескриптором источника, только если подавление повторов включено.
+ */
+typedef struct tag_log_dedup
+{
+    pthread_mutex_t mutex;                                    /*!< мьютекс состояния */
+    bool            active;                                   /*!< запись уже выводилась */
+    log_level_t     level;                                    /*!< уровень записи */
+    uint64_t        callsite_hash;                            /*!< хэш файла и строки точки логгирования */
+    uint64_t        body_hash;                                /*!< хэш сообщения (без префикса) */
+    uint64_t        start_ns;                                 /*!< время вывода записи (начало окна) */
+    uint32_t        repeats;                                  /*!< количество подавленных повторов */
+    char            file[LOG_FILE_NAME_MAX_SIZE + 1];         /*!< имя файла для итоговой строки */
+    char            line[16];                                 /*!< номер строки для итоговой строки */
+    char            function[LOG_FUNCTION_NAME_MAX_SIZE + 1]; /*!< имя функции для итоговой строки */
+}
+log_dedup_t;
+
+/**
+ * Назначение сформированной записи
+ */
+typedef enum tag_log_dispatch
+{
+    LOG_DISPATCH_OUTPUT,  /*!< выводится (и сохраняется бортовым самописцем) */
+    LOG_DISPATCH_HIDDEN,  /*!< ниже уровня вывода: сохраняется бортовым самописцем и буфером предыстории потока */
+    LOG_DISPATCH_RECORDER /*!< уже выведена (отложенно или с подавлением повторов): только бортовой самописец */
+}
+log_dispatch_t;
+
+/**
+ * Дескриптор источника лога.
+ * Создаётся один раз для каждого имени источника и существует до log_destroy(),
+ * в том числе после удаления регистрации источника.
+ */
+struct tag_log_source
+{
+    const char     *source;                          /*!< источник (в арене имён) */
+    size_t          source_len;                      /*!< длина имени источника */
+    uint32_t        source_hash;                     /*!< хэш имени источника (см. log_src_hash()) */
+    log_level_t     min_log_level;                   /*!< минимально выводимый уровень логов (LL_CNT - источник не зарегистрирован) */
+    log_level_t     sample_level;                    /*!< записи уровней ниже сэмплируются (LL_INVALID - без сэмплирования) */
+    uint32_t        sample_threshold;                /*!< запись сохраняется, если случайное число меньше порога */
+    double          sample_ratio;                    /*!< доля сохраняемых записей (для log_src_dump()) */
+    log_dedup_t    *dedup;                           /*!< состояние подавления повторов (в арене, NULL - подавление выключено) */
+};
+
+/**
+ * Счётчик читателей копии хранилища источников (занимает отдельную кеш-линию)
+ */
+typedef struct tag_log_reader_slot
+{
+    uint32_t readers; /*!< количество читателей, работающих с копией */
+}
+__attribute__((aligned(LOG_CACHE_LINE_SIZE)))
+log_reader_slot_t;
+
+/**
+ * Приёмник записей лога
+ */
+struct tag_log_sink
+{
+    log_sink_ops_t ops;           /*!< операции */
+    void          *ctx;           /*!< контекст операций */
+    log_level_t    min_log_level; /*!< минимальный уровень записей */
+};
+
+/**
+ * Контекст приёмника, выводящего в файловый дескриптор
+ */
+typedef struct tag_log_fd_sink
+{
+    int  fd;    /*!< файловый дескриптор */
+    bool owned; /*!< дескриптор открыт приёмником и закрывается при его удалении */
+}
+log_fd_sink_t;
+
+/**
+ * Список приёмников записей лога.
+ * Существует независимо от log_init()/log_destroy(), поэтому инициализируется статически.
  */
-typedef struct tag_log_source_hm_elt
+typedef struct tag_log_sinks
 {
-    UT_hash_handle hh;
-    char           source[LOG_SRC_STORED_MAX_SIZE]; /*!< источник */
-    log_level_t    min_log_level;                   /*!< минимально выводимый уровень логов (для всех источников)*/
+    pthread_mutex_t  mutex;                /*!< мьютекс вывода в приёмники и изменения списка (вывод берёт его,
+                                                если список или приёмники могут изменяться из других потоков,
+                                                см. sinks_need_mutex) */
+    size_t           num_sinks;            /*!< количество приёмников */
+    log_sink_t      *sinks[LOG_MAX_SINKS]; /*!< приёмники */
 }
-log_source_hm_elt_t;
+log_sinks_t;
 
 /**
  * Контекст системы логирования
+ *
+ * Хранилище источников существует в двух копиях (схема left-right): читатели без блокировок
+ * работают с активной копией, писатель (под мьютексом) изменяет неактивную, переключает
+ * активную, дожидается ухода читателей со старой и повторяет изменение в ней.
+ * Уровни источников в обеих копиях изменяются атомарно, без переключения.
  */
 typedef struct tag_log_ctx
 {
     bool                 initialized;   /*!< конекст уже инициализирован */
     bool                 use_mutex;     /*!< флаг необходимости использования мьютекса */
+    bool                 async_drain;   /*!< выводить оставшиеся в кольце записи при log_destroy() */
+    bool                 uring;         /*!< фоновый поток выводит в файловые дескрипторы через io_uring */
+    bool                 deferred;      /*!< отложенное форматирование записей фоновым потоком */
+    bool                 binary;        /*!< вывод в двоичный файл журнала */
+    bool                 flight;        /*!< бортовой самописец включен */
+    log_level_t          flight_level;  /*!< минимальный уровень записей самописца */
+    bool                 backtrace;     /*!< буферы предыстории потоков включены */
+    log_level_t          backtrace_level; /*!< минимальный уровень записей буфера предыстории */
+    log_level_t          retain_level;  /*!< минимальный уровень записей, сохраняемых ниже уровня вывода (LL_CNT - нет) */
+    int                  binary_fd;     /*!< дескриптор двоичного файла журнала */
+    int                  signal_fd;     /*!< дескриптор вывода log_log_signal_safe() */
+    long                 utc_offset;    /*!< смещение местного времени от UTC для log_log_signal_safe(), секунды */
+    uint64_t             dedup_window_ns; /*!< окно подавления повторов, нс (0 - выключено) */
+    uint32_t             binary_sites;  /*!< количество точек логгирования, записанных в словарь файла (только фоновый поток) */
+    log_bin_packer_t     binary_packer; /*!< состояние упаковки записей двоичного файла (только фоновый поток) */
     log_level_t          min_log_level; /*!< минимально выводимый уровень логов для всех источников */
     pthread_mutex_t      mutex;         /*!< мьютекс */
-    log_source_hm_elt_t *source_hm;     /*!< хранилище зарегистрированнных источников лога */
-    char                 log_buf[8192]; /*!< буфер логгирования. */
+    log_arena_t          src_arena;     /*!< арена дескрипторов и имён источников */
+    log_src_table_t      handles_hm;    /*!< хранилище всех дескрипторов источников (только для писателей) */
+#if DO_LOG_SRC_MANIFEST
+    log_source_t        *manifest_handles[LOG_SRC_MANIFEST_SIZE]; /*!< дескрипторы источников манифеста по идентификатору */
+#endif
+    log_src_table_t      source_hm[2];  /*!< две копии хранилища зарегистрированнных источников лога */
+    uint32_t             active_hm;     /*!< индекс копии хранилища, с которой работают читатели */
+    log_reader_slot_t    hm_readers[2][LOG_SRC_HM_READER_SLOTS]; /*!< счётчики читателей каждой копии */
 }
 log_ctx_t;
 
 
+#if DO_LOG_CURRENT_TIME
 /**
- * Структура, с описанием даты и времени
+ * Кеш потока для отображения времени: дата и время с точностью до секунды
+ * формируются один раз в секунду, в каждую запись подставляются только миллисекунды.
  */
-struct tag_log_datetime
+struct tag_log_time_cache
 {
-    int year;  /*!< год */
-    int month; /*!< месяц года */
-    int day;   /*!< день месяца */
-    int hour;  /*!< час (0-23) */
-    int min;   /*!< минута (0-59) */
-    int sec;   /*!< секунда (0-59) */
-    int usec;  /*!< микросекунда (0-999999) */
+    time_t sec;      /*!< секунда, для которой сформирована строка (-1 - не сформирована) */
+    size_t len;      /*!< длина строки */
+    char   str[32];  /*!< строка ГГГГ.ММ.ДД-ЧЧ:ММ:СС: */
 };
+#endif
 
 static
 log_ctx_t log_ctx; ///< глобальный контекст системы логгирования.
 
+static
+log_sinks_t log_sinks = { PTHREAD_MUTEX_INITIALIZER, 0, { NULL } }; ///< приёмники записей лога.
+
+#if DO_LOG_CURRENT_TIME
+/**
+ * Кеш потока для отображения времени
+ */
+static __thread
+struct tag_log_time_cache tls_time_cache = { (time_t)-1, 0, "" };
+#endif
+
+/**
+ * Текущее поколение конфигурации логгирования (никогда не равно 0,
+ * поэтому обнулённый кеш точки логгирования всегда считается устаревшим).
+ */
+uint64_t log_cfg_generation = LOG_CFG_GENERATION_STEP;
+
+/**
+ * Состояние генератора случайных чисел сэмплирования (0 - не инициализирован)
+ */
+__thread
+uint64_t log_sample_rng;
+
+/**
+ * Счётчик для различия начальных значений генераторов потоков
+ */
+static
+uint64_t sample_seed_seq;
+
+/**
+ * Номер счётчика читателей текущего потока + 1 (0 - ещё не назначен)
+ */
+static __thread
+uint32_t tls_reader_slot;
+
+/**
+ * Счётчик для распределения потоков по счётчикам читателей
+ */
+static
+uint32_t reader_slot_seq;
+
+/**
+ * Буфер потока для сформированной записи лога.
+ * Формирование записей идёт в буферах потоков параллельно, под мьютексом выполняется только вывод.
+ */
+static __thread
+char tls_record_buf[LOG_RECORD_MAX_SIZE];
+
 /**
  * mapping уровней лога в текст
  */
@@ -131,24 +366,24 @@ const char * const log_level_map[LL_CNT] =
 
 #if DO_LOG_CURRENT_TIME
 /**
- * Возвращает текущие дату и время.
+ * Обновляет кеш потока для отображения времени, если наступила новая секунда.
  *
- * @param dt [out] дата и время (!= NULL)
+ * @param sec [in] текущее время в секундах
  */
 static
-void get_current_time(struct tag_log_datetime *dt) __attribute__((nonnull(1)));
+void update_time_cache(time_t sec);
 
 /**
- * Преобразует дату и время log_datetime в строку
- * @param dt               [in]  преобразуемая дата и время
+ * Преобразует дату и время в строку ГГГГ.ММ.ДД-ЧЧ:ММ:СС:ХХХ
  * @param result           [out] строка
  * @param result_max_size  [in]  максимальный размер буфера для строки в байтах (не забудь учесть конечный 0)
+ * @param ts               [in]  время (NULL - текущее)
  * @return result
  */
 static
-char *print_current_time(const struct tag_log_datetime *dt,
-                         char                          *result,
-                         size_t                         result_max_size) __attribute__((nonnull(1, 2)));
+char *print_current_time(char                  *result,
+                         size_t                 result_max_size,
+                         const struct timespec *ts) __attribute__((nonnull(1)));
 #endif
 
 /**
@@ -198,449 +433,2521 @@ bool is_log_allowed(const char  *source,
                     log_level_t  log_level) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
 
 /**
- * Производит hexdump буфера в строку (без символа перевода строки). Максимальная длина дампа - 16 байт
+ * Проверяет, сохраняется ли лог указанного источника с заданным уровнем ниже уровня вывода
+ * (бортовым самописцем или буфером предыстории потока).
  *
- * @param buf_in      [in]  буфер, дамп котогого требуется сделать (!= NULL)
- * @param buf_in_size [in]  размер буфера в байтах
- * @param offset      [in]  смещение в буфере (байты / 16)
- * @param buf_out     [out] результирующий текстовый буфер с дампом строки. Минимальный размер - 100 байт (!= NULL)
+ * @param source    [in] источник (!= NULL)
+ * @param log_level [in] уровень лога ( LL_INVALID < log_level < LL_CNT ).
+ * @return true - сохраняет, false - нет.
  */
 static
-void compose_hexdump_line(const void *buf_in,
-                          size_t      buf_in_size,
-                          size_t      offset,
-                          char       *buf_out) __attribute__((nonnull(1,4)));
+bool is_log_recorded(const char  *source,
+                     log_level_t  log_level) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
 
 /**
- * Генерирует префикс лога.
+ * Проверяет, сохраняется ли лог дескриптора источника с заданным уровнем ниже уровня вывода
+ * (бортовым самописцем или буфером предыстории потока).
  *
- * @param prefix_buf      [out] буфер для строки со сформированным префиксом (!= NULL).
- * @param prefix_buf_size [in]  размер буфера выше в байтах.
- * @param source          [in]  источник (строка - источника лога) (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
- * @param file            [in]  имя файла (максимальная длина LOG_FUNCTION_NAME_MAX_SIZE).
- * @param line            [in]  номер строки в файле.
- * @param function        [in]  имя функции (максимальная длина LOG_FILE_NAME_MAX_SIZE).
- * @param log_level       [in]  уровень выводимого лога (< LL_CNT).
- * @return log_buf.
+ * @param handle    [in] дескриптор источника (!= NULL)
+ * @param log_level [in] уровень лога ( LL_INVALID < log_level < LL_CNT ).
+ * @return true - сохраняет, false - нет.
  */
 static
-char *compose_log_prefix(char        *prefix_buf,
-                         size_t       prefix_buf_size,
-                         const char  *source,
-                         const char  *file,
-                         const char  *line,
-                         const char  *function,
-                         log_level_t  log_level) __attribute__((nonnull(1, 3, 4, 5, 6)));
+bool is_handle_recorded(const log_source_t *handle,
+                        log_level_t         log_level) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
 
 /**
- * Генерирует префикс лога.
+ * Возвращает минимальный уровень, с которого формируются записи (для вывода, самописца или буфера предыстории).
  *
- * @param prefix_buf      [out] буфер для строки со сформированным префиксом (!= NULL).
- * @param prefix_buf_size [in]  размер буфера выше в байтах.
- * @param source          [in]  источник (строка - источника лога) (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
- * @param file            [in]  имя файла (максимальная длина LOG_FUNCTION_NAME_MAX_SIZE).
- * @param line            [in]  номер строки в файле.
- * @param function        [in]  имя функции (максимальная длина LOG_FILE_NAME_MAX_SIZE).
- * @param log_level       [in]  уровень выводимого лога (< LL_CNT).
- * @return log_buf.
+ * @param output_level [in] минимальный уровень вывода (LL_CNT - источник не зарегистрирован)
+ * @return минимальный уровень формирования записей.
  */
 static
-char *compose_log_prefix(char        *prefix_buf,
-                         size_t       prefix_buf_size,
-                         const char  *source,
-                         const char  *file,
-                         const char  *line,
-                         const char  *function,
-                         log_level_t  log_level)
-{
-    #if DO_LOG_CURRENT_TIME
-    struct tag_log_datetime dt;
-    char time_buf[32];
-    #endif
-
-    assert(prefix_buf != NULL);
-    assert(source != NULL);
-    assert(file != NULL);
-    assert(line != NULL);
-    #if DO_LOG_FUNCTION_NAME
-    assert(function != NULL);
-    #endif
-
-    UNUSED_PARAM(function);
-    #if DO_LOG_CURRENT_TIME
-    get_current_time(&dt);
-    #endif
-    snprintf(prefix_buf,
-             prefix_buf_size,
-             #if DO_LOG_CURRENT_TIME
-             "%s:"
-             #endif
-             "[%-1.1s][%-"STRX(LOG_SRC_MAX_SIZE)"."STRX(LOG_SRC_MAX_SIZE)"s][%-"STRX(LOG_FILE_NAME_MAX_SIZE)"."STRX(LOG_FILE_NAME_MAX_SIZE)"s:%5s]"
-             #if DO_LOG_FUNCTION_NAME
-             " in %-"STRX(LOG_FUNCTION_NAME_MAX_SIZE)"."STRX(LOG_FUNCTION_NAME_MAX_SIZE)"s()",
-             #else
-             "",
-             #endif
-             #if DO_LOG_CURRENT_TIME
-             print_current_time(&dt, time_buf, sizeof(time_buf)),
-             #endif
-             log_level_map[log_level],
-             source,
-             extract_file_name(file),
-             #if DO_LOG_FUNCTION_NAME
-             line,
-             function);
-             #else
-             line);
-             #endif
-    return prefix_buf;
-}
+log_level_t get_formed_level(log_level_t output_level) __attribute__((warn_unused_result));
 
-#if DO_LOG_CURRENT_TIME
 /**
- * Возвращает текущие дату и время.
+ * Возвращает итоговый (с учётом глобального) минимальный уровень лога для дескриптора источника.
  *
- * @param dt [out] дата и время (!= NULL)
+ * @param handle [in] дескриптор источника (!= NULL)
+ * @return минимальный уровень или LL_CNT, если источник не зарегистрирован.
  */
 static
-void get_current_time(struct tag_log_datetime *dt)
-{
-    time_t _time;
+log_level_t get_handle_effective_level(const log_source_t *handle) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
 
-    assert(dt != NULL);
-
-    memset(dt, 0, sizeof(struct tag_log_datetime));
-    _time = time(NULL);
-    if (_time != (time_t)(-1))
-    {
-        struct tm *local_time;
-
-        local_time = localtime(&_time);
-        if (local_time)
-        {
-            struct timeval tv;
-
-            dt->year  = 1900 + local_time->tm_year;
-            dt->month = local_time->tm_mon + 1;
-            dt->day   = local_time->tm_mday;
-            dt->hour  = local_time->tm_hour;
-            dt->min   = local_time->tm_min;
-            dt->sec   = local_time->tm_sec;
-            if (gettimeofday(&tv, NULL) == 0)
-            {
-                dt->usec = (int)(tv.tv_usec);
-            }
-        }
-    }
-}
+/**
+ * Находит дескриптор зарегистрированного источника без блокировок.
+ *
+ * @param source [in] источник (!= NULL)
+ * @return дескриптор или NULL, если источник не зарегистрирован.
+ */
+static
+log_source_t *find_src_handle(const char *source) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
 
 /**
- * Преобразует дату и время log_datetime в строку ГГГГ.ММ.ДД-ЧЧ:ММ:СС:ХХХ
- * @param dt               [in]  преобразуемая дата и время
- * @param result           [out] строка
- * @param result_max_size  [in]  максимальный размер буфера для строки в байтах (не забудь учесть конечный 0)
- * @return result
+ * Находит уровень зарегистрированного источника без блокировок (без обращения к дескриптору).
+ *
+ * @param source [in] источник (!= NULL)
+ * @return минимальный уровень источника или LL_CNT, если источник не зарегистрирован.
  */
 static
-char *print_current_time(const struct tag_log_datetime *dt,
-                         char                          *result,
-                         size_t                         result_max_size)
-{
-    assert(dt != NULL);
-    assert(result != NULL);
+log_level_t find_src_level(const char *source) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
 
-    snprintf(result,
-             result_max_size,
-             "%.4d.%.2d.%.2d-%.2d:%.2d:%.2d:%-4.3d",
-             dt->year,
-             dt->month,
-             dt->day,
-             dt->hour,
-             dt->min,
-             dt->sec,
-             dt->usec/1000);
-    return result;
-}
-#endif
+/**
+ * Находит или создаёт (не зарегистрированным) дескриптор источника.
+ * Вызывается писателем (под мьютексом контекста, если он используется).
+ *
+ * @param source [in] источник (!= NULL)
+ * @return дескриптор или NULL при нехватке памяти.
+ */
+static
+log_source_t *get_or_create_src_handle(const char *source) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
 
 /**
- * Блокирует мьютекс контекста, если требуется
+ * Создаёт (не зарегистрированными) дескрипторы всех источников манифеста, чтобы точки логгирования
+ * находили их по идентификатору, вычисленному при компиляции, без поиска в хэше.
  *
- * @param ctx [in/out] контекст системы логгирования (!= NULL)
+ * @return true - OK, false - нехватка памяти.
  */
 static
-void lock_mutex_if_it_needs(log_ctx_t *ctx)
-{
-    assert(ctx != NULL);
+bool create_manifest_handles(void) __attribute__((warn_unused_result));
 
-    if (ctx->use_mutex) MUTEX_CHECK_LOCK(&ctx->mutex);
-}
+/**
+ * Освобождает все дескрипторы источников (вместе с хранилищем дескрипторов и ареной).
+ * Вызывается писателем (под мьютексом контекста, если он используется).
+ */
+static
+void destroy_src_handles(void);
 
 /**
- * Разблокирует мьютекс контекста, если требуется
+ * Добавляет дескриптор источника в обе копии хранилища или удаляет его из них.
+ * Вызывается писателем (под мьютексом контекста, если он используется).
  *
- * @param ctx [in/out] контекст системы логгирования (!= NULL)
+ * @param handle [in] дескриптор источника (!= NULL)
+ * @param add    [in] true - добавить, false - удалить.
+ * @return true - OK, false - нехватка памяти (хранилище не изменено).
  */
 static
-void unlock_mutex_if_it_needs(log_ctx_t *ctx)
-{
-    assert(ctx != NULL);
-
-    if (ctx->use_mutex) MUTEX_CHECK_UNLOCK(&ctx->mutex);
-}
+bool src_hm_update(log_source_t *handle,
+                   bool          add) __attribute__((nonnull(1)));
 
 /**
- * Извлекает имя файла на основе полного пути.
+ * Устанавливает уровень источника в дескрипторе и в обеих копиях хранилища.
+ * Вызывается писателем (под мьютексом контекста, если он используется).
  *
- * @param file_path [in] Полный путь к файлу (!= NULL)
- * @return имя файла
+ * @param handle [in/out] дескриптор источника (!= NULL)
+ * @param level  [in]     минимальный уровень (LL_CNT - источник не зарегистрирован)
  */
 static
-const char *extract_file_name(const char *file_path)
-{
-    assert(file_path != NULL);
+void set_src_level(log_source_t *handle,
+                   log_level_t   level) __attribute__((nonnull(1)));
 
-    const char *pos;
+/**
+ * Регистрирует источник (или перезаписывает зарегистрированный) с параметрами сэмплирования.
+ *
+ * @param source        [in] источник лога (!= NULL)
+ * @param min_log_level [in] минимальный уровень выводимого лога (LL_NONE - отключает вывод).
+ * @param sample_level  [in] записи уровней ниже sample_level сэмплируются (LL_INVALID - без сэмплирования).
+ * @param sample_ratio  [in] доля сохраняемых записей сэмплируемых уровней (0.0 ... 1.0).
+ * @return дескриптор источника или NULL в случае ошибки.
+ */
+static
+log_source_t *register_src_handle(const char  *source,
+                                  log_level_t  min_log_level,
+                                  log_level_t  sample_level,
+                                  double       sample_ratio) __attribute__((nonnull(1)));
 
-    pos = strrchr(file_path,'/');
-    if (pos)
-    {
-        return pos + 1;
-    }
-    pos = strrchr(file_path,'\\');
-    if (pos)
-    {
-        return pos + 1;
-    }
-    return file_path;
-}
+/**
+ * Увеличивает поколение конфигурации, делая недействительными кеши всех точек логгирования.
+ * Вызывается после изменения конфигурации (под мьютексом контекста, если он используется).
+ */
+static
+void bump_cfg_generation(void);
 
 /**
- * Проверяет, позволяет ли requested уровень лога логгировать, если установлен current уровень лога.
+ * Начинает чтение хранилища источников без блокировок.
+ * Каждому вызову должен соответствовать вызов src_hm_read_end().
  *
- * @param requested [in] запрашиваемый уровень лога.
- * @param current   [in] установленный уровень лога.
- * @return true - Да, false - Нет.
+ * @param hm [out] активная копия хранилища (!= NULL).
+ * @return индекс копии хранилища для передачи в src_hm_read_end().
  */
 static
-bool check_log_level(log_level_t requested, log_level_t current)
-{
-    return (requested >= current);
-}
+uint32_t src_hm_read_begin(const log_src_table_t **hm) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
 
 /**
- * Проверяет, позволено ли логгирование для указанного источника с заданным уровнем лога
+ * Заканчивает чтение хранилища источников, начатое src_hm_read_begin().
  *
- * @param source    [in] источник (!= NULL)
- * @param log_level [in] уровень лога ( LL_INVALID < log_level < LL_CNT ).
- * @return true - позволено, false - не позволено.
+ * @param idx [in] индекс копии хранилища, полученный от src_hm_read_begin().
  */
 static
-bool is_log_allowed(const char  *source,
-                    log_level_t  log_level)
-{
-    assert(source != NULL);
+void src_hm_read_end(uint32_t idx);
+
+/**
+ * Делает активной неактивную копию хранилища источников и дожидается,
+ * пока читатели покинут прежнюю активную копию.
+ * Вызывается писателем (под мьютексом контекста, если он используется).
+ */
+static
+void src_hm_switch(void);
+
+/**
+ * Выводит данные в файловый дескриптор одним вызовом write(2) (повторяя его только при частичной записи).
+ * Пачки фонового потока при доступном io_uring ставятся в очередь, их отправляет write_batch().
+ *
+ * @param fd   [in] файловый дескриптор
+ * @param data [in] данные (!= NULL)
+ * @param len  [in] размер данных в байтах
+ */
+static
+void write_fd(int         fd,
+              const char *data,
+              size_t      len) __attribute__((nonnull(2)));
+
+/**
+ * Выводит сформированные записи: в двоичный файл журнала, в приёмники с подходящим уровнем
+ * или, если приёмников нет, в stderr.
+ *
+ * @param data  [in] данные (!= NULL)
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void write_output(const char  *data,
+                  size_t       len,
+                  log_level_t  level) __attribute__((nonnull(1)));
+
+/**
+ * Сообщает, нужен ли при выводе мьютекс списка приёмников: в многопоточном режиме или
+ * при асинхронном выводе (фоновый поток выводит в приёмники, пока другие потоки изменяют
+ * список, уровни приёмников или сбрасывают их) приёмник не должен удаляться во время вывода.
+ *
+ * @return true - нужен, false - вывод и изменение списка выполняются одним потоком.
+ */
+static inline
+bool sinks_need_mutex(void) __attribute__((warn_unused_result));
+
+/**
+ * Выводит пачку сформированных записей: в двоичный файл журнала, в приёмники с подходящим уровнем
+ * или, если приёмников нет, в stderr. Каждый приёмник получает подряд идущие участки подходящего
+ * уровня одним вызовом.
+ *
+ * @param data     [in] данные (!= NULL), размер - runs[num_runs - 1].end байт
+ * @param runs     [in] участки записей одного уровня (!= NULL)
+ * @param num_runs [in] количество участков (> 0)
+ */
+static
+void write_batch(const char            *data,
+                 const log_async_run_t *runs,
+                 size_t                 num_runs) __attribute__((nonnull(1, 2)));
+
+/**
+ * Передаёт сформированную запись на вывод: в кольцо асинхронного вывода, если он запущен, иначе напрямую.
+ *
+ * @param data  [in] запись (!= NULL)
+ * @param len   [in] размер записи в байтах
+ * @param level [in] уровень записи
+ */
+static
+void emit_record(const char  *data,
+                 size_t       len,
+                 log_level_t  level) __attribute__((nonnull(1)));
+
+/**
+ * Передаёт сформированную запись в бортовой самописец (если уровень записи достаточен), затем
+ * на вывод (предварив ошибку предысторией потока) или в буфер предыстории потока.
+ *
+ * @param data     [in] запись (!= NULL)
+ * @param len      [in] размер записи в байтах
+ * @param level    [in] уровень записи
+ * @param dispatch [in] назначение записи.
+ */
+static
+void dispatch_record(const char     *data,
+                     size_t          len,
+                     log_level_t     level,
+                     log_dispatch_t  dispatch) __attribute__((nonnull(1)));
+
+/**
+ * Операция write приёмника, выводящего в файловый дескриптор.
+ *
+ * @param ctx   [in] контекст (log_fd_sink_t *) (!= NULL)
+ * @param data  [in] данные (!= NULL)
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей (не используется)
+ */
+static
+void fd_sink_write(void        *ctx,
+                   const char  *data,
+                   size_t       len,
+                   log_level_t  level) __attribute__((nonnull(1, 2)));
+
+/**
+ * Операция close приёмника, выводящего в файловый дескриптор.
+ *
+ * @param ctx [in] контекст (log_fd_sink_t *) (!= NULL)
+ */
+static
+void fd_sink_close(void *ctx) __attribute__((nonnull(1)));
+
+/**
+ * Добавляет приёмник, выводящий в файловый дескриптор.
+ *
+ * @param fd            [in] файловый дескриптор
+ * @param owned         [in] закрывать дескриптор при удалении приёмника
+ * @param min_log_level [in] минимальный уровень записей для приёмника
+ * @return приёмник или NULL в случае ошибки.
+ */
+static
+log_sink_t *add_fd_sink(int         fd,
+                        bool        owned,
+                        log_level_t min_log_level) __attribute__((warn_unused_result));
+
+/**
+ * Сбрасывает буферы, закрывает и освобождает приёмник (вызывается под мьютексом приёмников).
+ *
+ * @param sink [in] приёмник (!= NULL)
+ */
+static
+void destroy_sink(log_sink_t *sink) __attribute__((nonnull(1)));
+
+/**
+ * Возвращает текущее время часов LOG_TIME_CLOCK.
+ *
+ * @param ts [out] время (!= NULL)
+ */
+static
+void get_current_time(struct timespec *ts) __attribute__((nonnull(1)));
+
+/**
+ * Сохраняет лог в кольцо асинхронного вывода в двоичном виде для отложенного форматирования.
+ *
+ * @param callsite  [in/out] кеш точки логгирования (!= NULL).
+ * @param source    [in] источник (!= NULL)
+ * @param file      [in] имя файла.
+ * @param line      [in] номер строки в файле.
+ * @param function  [in] имя функции.
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ * @param fmt       [in] (!= NULL).
+ * @param args      [in] аргументы fmt.
+ * @return true - запись передана фоновому потоку, false - строка формата не поддерживается, лог нужно сформировать сразу.
+ */
+static
+bool push_deferred(log_callsite_t *callsite,
+                   const char     *source,
+                   const char     *file,
+                   const char     *line,
+                   const char     *function,
+                   log_level_t     log_level,
+                   const char     *fmt,
+                   va_list         args) __attribute__((nonnull(1, 2, 3, 4, 5, 7)));
+
+/**
+ * Преобразует отложенную запись в текст (вызывается фоновым потоком асинхронного вывода).
+ *
+ * @param rec      [in]  двоичная запись (!= NULL)
+ * @param len      [in]  размер записи в байтах
+ * @param out      [out] буфер для текста (!= NULL)
+ * @param out_size [in]  размер буфера в байтах
+ * @return длина текста в байтах, 0 - запись повреждена.
+ */
+static
+size_t render_deferred(const char *rec,
+                       size_t      len,
+                       char       *out,
+                       size_t      out_size) __attribute__((nonnull(1, 3)));
+
+/**
+ * Упаковывает отложенную запись в кадры двоичного файла журнала и дописывает
+ * кадры ещё не записанных точек логгирования, если они помещаются в буфер
+ * (вызывается фоновым потоком асинхронного вывода).
+ *
+ * @param rec      [in]  двоичная запись (!= NULL)
+ * @param len      [in]  размер записи в байтах
+ * @param out      [out] буфер для кадров (!= NULL)
+ * @param out_size [in]  размер буфера в байтах
+ * @return размер кадров в байтах.
+ */
+static
+size_t render_binary(const char *rec,
+                     size_t      len,
+                     char       *out,
+                     size_t      out_size) __attribute__((nonnull(1, 3)));
+
+/**
+ * Формирует заголовок кадра текста двоичного файла журнала.
+ *
+ * @param hdr [out] буфер размером LOG_ASYNC_FRAME_MAX_SIZE (!= NULL)
+ * @param len [in]  размер текста в байтах
+ * @return размер заголовка в байтах.
+ */
+static
+size_t frame_text(char   *hdr,
+                  size_t  len) __attribute__((nonnull(1)));
+
+/**
+ * Записывает в двоичный файл журнала кадры точек логгирования, ещё не попавшие в словарь.
+ */
+static
+void flush_binary_sites(void);
+
+/**
+ * Возвращает время монотонных часов LOG_MONOTONIC_CLOCK. Не изменяет errno.
+ *
+ * @param ns [out] время в наносекундах (!= NULL)
+ * @return true - OK, false - часы недоступны.
+ */
+static
+bool get_monotonic_ns(uint64_t *ns) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
+
+/**
+ * Продолжает вычисление хэша FNV-1a (64 бита).
+ *
+ * @param hash [in] текущее значение хэша (LOG_FNV_OFFSET_BASIS - начало)
+ * @param data [in] данные (!= NULL)
+ * @param len  [in] размер данных в байтах
+ * @return новое значение хэша.
+ */
+static
+uint64_t hash_bytes(uint64_t    hash,
+                    const char *data,
+                    size_t      len) __attribute__((nonnull(2)));
+
+/**
+ * Выводит итоговую строку "last message repeated N times", если у источника есть подавленные повторы.
+ * Вызывается под мьютексом подавления повторов источника.
+ *
+ * @param handle [in/out] дескриптор источника (!= NULL)
+ */
+static
+void emit_dedup_summary(log_source_t *handle) __attribute__((nonnull(1)));
+
+/**
+ * Выводит запись с подавлением повторов: запись, совпадающая с предыдущей записью источника по уровню,
+ * точке логгирования и сообщению, в пределах окна только подсчитывается. Итоговая строка выводится
+ * перед следующей записью источника, не попавшей в серию (другой или после окончания окна),
+ * в log_flush() и log_destroy(); само окончание окна её не выводит.
+ *
+ * @param source      [in] источник (!= NULL)
+ * @param file        [in] имя файла (!= NULL)
+ * @param line        [in] номер строки в файле (!= NULL)
+ * @param function    [in] имя функции (!= NULL)
+ * @param level       [in] уровень записи
+ * @param data        [in] запись (!= NULL)
+ * @param len         [in] размер записи в байтах
+ * @param body_offset [in] смещение сообщения (после префикса) в записи
+ */
+static
+void emit_deduped(const char  *source,
+                  const char  *file,
+                  const char  *line,
+                  const char  *function,
+                  log_level_t  level,
+                  const char  *data,
+                  size_t       len,
+                  size_t       body_offset) __attribute__((nonnull(1, 2, 3, 4, 6)));
+
+/**
+ * Выводит итоговые строки подавленных повторов всех источников.
+ */
+static
+void flush_dedup(void);
+
+/**
+ * Формирует лог в стиле printf (уровень уже проверен), выводит его и сохраняет в бортовой самописец.
+ *
+ * @param source    [in] источник (строка - источника лога) (!= NULL)
+ * @param file      [in] имя файла.
+ * @param line      [in] номер строки в файле.
+ * @param function  [in] имя функции.
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ * @param dispatch  [in] назначение записи.
+ * @param fmt       [in] (!= NULL).
+ * @param args      [in] аргументы fmt.
+ */
+static
+void write_log(const char     *source,
+               const char     *file,
+               const char     *line,
+               const char     *function,
+               log_level_t     log_level,
+               log_dispatch_t  dispatch,
+               const char     *fmt,
+               va_list         args) __attribute__((format(printf, 7, 0), nonnull(1, 2, 3, 4, 7)));
+
+/**
+ * Формирует hexdump RAW буфера (уровень уже проверен), выводит его и сохраняет в бортовой самописец.
+ *
+ * @param source   [in] источник (строка - источника лога) (!= NULL)
+ * @param file     [in] имя файла.
+ * @param line     [in] номер строки в файле
+ * @param function [in] имя функции.
+ * @param buffer   [in] указатель на буфер (может быть NULL)
+ * @param length   [in] размер буфера в байтах
+ * @param dispatch [in] назначение записи.
+ */
+static
+void write_raw(const char     *source,
+               const char     *file,
+               const char     *line,
+               const char     *function,
+               const void     *buffer,
+               size_t          length,
+               log_dispatch_t  dispatch) __attribute__((nonnull(1, 2, 3, 4)));
+
+/**
+ * Генерирует префикс лога.
+ *
+ * @param prefix_buf      [out] буфер для строки со сформированным префиксом (!= NULL).
+ * @param prefix_buf_size [in]  размер буфера выше в байтах.
+ * @param source          [in]  источник (строка - источника лога) (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
+ * @param file            [in]  имя файла (максимальная длина LOG_FUNCTION_NAME_MAX_SIZE).
+ * @param line            [in]  номер строки в файле.
+ * @param function        [in]  имя функции (максимальная длина LOG_FILE_NAME_MAX_SIZE).
+ * @param log_level       [in]  уровень выводимого лога (< LL_CNT).
+ * @param ts              [in]  время записи (NULL - текущее).
+ * @return log_buf.
+ */
+static
+char *compose_log_prefix(char                  *prefix_buf,
+                         size_t                 prefix_buf_size,
+                         const char            *source,
+                         const char            *file,
+                         const char            *line,
+                         const char            *function,
+                         log_level_t            log_level,
+                         const struct timespec *ts) __attribute__((nonnull(1, 3, 4, 5, 6)));
+
+/**
+ * Генерирует префикс лога.
+ *
+ * @param prefix_buf      [out] буфер для строки со сформированным префиксом (!= NULL).
+ * @param prefix_buf_size [in]  размер буфера выше в байтах.
+ * @param source          [in]  источник (строка - источника лога) (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
+ * @param file            [in]  имя файла (максимальная длина LOG_FUNCTION_NAME_MAX_SIZE).
+ * @param line            [in]  номер строки в файле.
+ * @param function        [in]  имя функции (максимальная длина LOG_FILE_NAME_MAX_SIZE).
+ * @param log_level       [in]  уровень выводимого лога (< LL_CNT).
+ * @param ts              [in]  время записи (NULL - текущее).
+ * @return log_buf.
+ */
+static
+char *compose_log_prefix(char                  *prefix_buf,
+                         size_t                 prefix_buf_size,
+                         const char            *source,
+                         const char            *file,
+                         const char            *line,
+                         const char            *function,
+                         log_level_t            log_level,
+                         const struct timespec *ts)
+{
+    #if DO_LOG_CURRENT_TIME
+    char time_buf[32];
+    #endif
+
+    assert(prefix_buf != NULL);
+    assert(source != NULL);
+    assert(file != NULL);
+    assert(line != NULL);
+    #if DO_LOG_FUNCTION_NAME
+    assert(function != NULL);
+    #endif
+
+    UNUSED_PARAM(function);
+    UNUSED_PARAM(ts);
+    snprintf(prefix_buf,
+             prefix_buf_size,
+             #if DO_LOG_CURRENT_TIME
+             "%s:"
+             #endif
+             "[%-1.1s][%-"STRX(LOG_SRC_MAX_SIZE)"."STRX(LOG_SRC_MAX_SIZE)"s][%-"STRX(LOG_FILE_NAME_MAX_SIZE)"."STRX(LOG_FILE_NAME_MAX_SIZE)"s:%5s]"
+             #if DO_LOG_FUNCTION_NAME
+             " in %-"STRX(LOG_FUNCTION_NAME_MAX_SIZE)"."STRX(LOG_FUNCTION_NAME_MAX_SIZE)"s()",
+             #else
+             "",
+             #endif
+             #if DO_LOG_CURRENT_TIME
+             print_current_time(time_buf, sizeof(time_buf), ts),
+             #endif
+             log_level_map[log_level],
+             source,
+             extract_file_name(file),
+             #if DO_LOG_FUNCTION_NAME
+             line,
+             function);
+             #else
+             line);
+             #endif
+    return prefix_buf;
+}
+
+#if DO_LOG_CURRENT_TIME
+/**
+ * Обновляет кеш потока для отображения времени, если наступила новая секунда.
+ *
+ * @param sec [in] текущее время в секундах
+ */
+static
+void update_time_cache(time_t sec)
+{
+    struct tm local_time;
+    int len;
+
+    if (tls_time_cache.sec == sec) return;
+    if (localtime_r(&sec, &local_time))
+    {
+        len = snprintf(tls_time_cache.str,
+                       sizeof(tls_time_cache.str),
+                       "%.4d.%.2d.%.2d-%.2d:%.2d:%.2d:",
+                       1900 + local_time.tm_year,
+                       local_time.tm_mon + 1,
+                       local_time.tm_mday,
+                       local_time.tm_hour,
+                       local_time.tm_min,
+                       local_time.tm_sec);
+    }
+    else
+    {
+        len = snprintf(tls_time_cache.str, sizeof(tls_time_cache.str), "0000.00.00-00:00:00:");
+    }
+    tls_time_cache.len = (size_t)MAX(len, 0);
+    tls_time_cache.sec = sec;
+}
+
+/**
+ * Преобразует дату и время в строку ГГГГ.ММ.ДД-ЧЧ:ММ:СС:ХХХ
+ * @param result           [out] строка
+ * @param result_max_size  [in]  максимальный размер буфера для строки в байтах (не забудь учесть конечный 0)
+ * @param ts               [in]  время (NULL - текущее)
+ * @return result
+ */
+static
+char *print_current_time(char                  *result,
+                         size_t                 result_max_size,
+                         const struct timespec *ts)
+{
+    struct timespec now;
+    unsigned msec;
+
+    assert(result != NULL);
+
+    if (ts == NULL)
+    {
+        get_current_time(&now);
+        ts = &now;
+    }
+    update_time_cache(ts->tv_sec);
+    assert(result_max_size > tls_time_cache.len + 4);
+    /* от записи к записи меняются только миллисекунды: "ХХХ " */
+    msec = (unsigned)(ts->tv_nsec / 1000000);
+    memcpy(result, tls_time_cache.str, tls_time_cache.len);
+    result[tls_time_cache.len + 0] = (char)('0' + msec / 100);
+    result[tls_time_cache.len + 1] = (char)('0' + msec / 10 % 10);
+    result[tls_time_cache.len + 2] = (char)('0' + msec % 10);
+    result[tls_time_cache.len + 3] = ' ';
+    result[tls_time_cache.len + 4] = '\0';
+    UNUSED_PARAM(result_max_size);
+    return result;
+}
+#endif
+
+/**
+ * Блокирует мьютекс контекста, если требуется
+ *
+ * @param ctx [in/out] контекст системы логгирования (!= NULL)
+ */
+static
+void lock_mutex_if_it_needs(log_ctx_t *ctx)
+{
+    assert(ctx != NULL);
+
+    if (ctx->use_mutex) MUTEX_CHECK_LOCK(&ctx->mutex);
+}
+
+/**
+ * Разблокирует мьютекс контекста, если требуется
+ *
+ * @param ctx [in/out] контекст системы логгирования (!= NULL)
+ */
+static
+void unlock_mutex_if_it_needs(log_ctx_t *ctx)
+{
+    assert(ctx != NULL);
+
+    if (ctx->use_mutex) MUTEX_CHECK_UNLOCK(&ctx->mutex);
+}
+
+/**
+ * Извлекает имя файла на основе полного пути.
+ *
+ * @param file_path [in] Полный путь к файлу (!= NULL)
+ * @return имя файла
+ */
+static
+const char *extract_file_name(const char *file_path)
+{
+    assert(file_path != NULL);
+
+    const char *pos;
+
+    pos = strrchr(file_path,'/');
+    if (pos)
+    {
+        return pos + 1;
+    }
+    pos = strrchr(file_path,'\\');
+    if (pos)
+    {
+        return pos + 1;
+    }
+    return file_path;
+}
+
+/**
+ * Проверяет, позволяет ли requested уровень лога логгировать, если установлен current уровень лога.
+ *
+ * @param requested [in] запрашиваемый уровень лога.
+ * @param current   [in] установленный уровень лога.
+ * @return true - Да, false - Нет.
+ */
+static
+bool check_log_level(log_level_t requested, log_level_t current)
+{
+    return (requested >= current);
+}
+
+/**
+ * Проверяет, позволено ли логгирование для указанного источника с заданным уровнем лога
+ *
+ * @param source    [in] источник (!= NULL)
+ * @param log_level [in] уровень лога ( LL_INVALID < log_level < LL_CNT ).
+ * @return true - позволено, false - не позволено.
+ */
+static
+bool is_log_allowed(const char  *source,
+                    log_level_t  log_level)
+{
+    assert(source != NULL);
+    assert(log_level > LL_INVALID);
+    assert(log_level < LL_CNT);
+
+    /* проверить сперва глобальную настройку */
+    if (check_log_level(log_level, __atomic_load_n(&log_ctx.min_log_level, __ATOMIC_RELAXED)))
+    {
+        /* уровень не зарегистрированного источника - LL_CNT, он не пропускает ни один лог */
+        return check_log_level(log_level, find_src_level(source));
+    }
+    return false;
+}
+
+/**
+ * Проверяет, сохраняется ли лог указанного источника с заданным уровнем ниже уровня вывода
+ * (бортовым самописцем или буфером предыстории потока).
+ *
+ * @param source    [in] источник (!= NULL)
+ * @param log_level [in] уровень лога ( LL_INVALID < log_level < LL_CNT ).
+ * @return true - сохраняет, false - нет.
+ */
+static
+bool is_log_recorded(const char  *source,
+                     log_level_t  log_level)
+{
+    assert(source != NULL);
+
+    /* записи зарегистрированных источников сохраняются независимо от их уровней вывода */
+    return (check_log_level(log_level, log_ctx.retain_level) && find_src_level(source) != LL_CNT);
+}
+
+/**
+ * Проверяет, сохраняется ли лог дескриптора источника с заданным уровнем ниже уровня вывода
+ * (бортовым самописцем или буфером предыстории потока).
+ *
+ * @param handle    [in] дескриптор источника (!= NULL)
+ * @param log_level [in] уровень лога ( LL_INVALID < log_level < LL_CNT ).
+ * @return true - сохраняет, false - нет.
+ */
+static
+bool is_handle_recorded(const log_source_t *handle,
+                        log_level_t         log_level)
+{
+    assert(handle != NULL);
+
+    /* записи зарегистрированных источников сохраняются независимо от их уровней вывода */
+    return (check_log_level(log_level, log_ctx.retain_level) &&
+            __atomic_load_n(&handle->min_log_level, __ATOMIC_RELAXED) != LL_CNT);
+}
+
+/**
+ * Возвращает минимальный уровень, с которого формируются записи (для вывода, самописца или буфера предыстории).
+ *
+ * @param output_level [in] минимальный уровень вывода (LL_CNT - источник не зарегистрирован)
+ * @return минимальный уровень формирования записей.
+ */
+static
+log_level_t get_formed_level(log_level_t output_level)
+{
+    if (output_level != LL_CNT) return MIN(output_level, log_ctx.retain_level);
+    return output_level;
+}
+
+/**
+ * Возвращает итоговый (с учётом глобального) минимальный уровень лога для дескриптора источника.
+ *
+ * @param handle [in] дескриптор источника (!= NULL)
+ * @return минимальный уровень или LL_CNT, если источник не зарегистрирован.
+ */
+static
+log_level_t get_handle_effective_level(const log_source_t *handle)
+{
+    assert(handle != NULL);
+
+    return MAX(__atomic_load_n(&log_ctx.min_log_level, __ATOMIC_RELAXED),
+               __atomic_load_n(&handle->min_log_level, __ATOMIC_RELAXED));
+}
+
+/**
+ * Находит дескриптор зарегистрированного источника без блокировок.
+ *
+ * @param source [in] источник (!= NULL)
+ * @return дескриптор или NULL, если источник не зарегистрирован.
+ */
+static
+log_source_t *find_src_handle(const char *source)
+{
+    const log_src_table_t *hm;
+    uint32_t hm_idx;
+    size_t len;
+    size_t idx;
+    uint32_t hash;
+    log_source_t *res = NULL;
+
+    assert(source != NULL);
+
+    /* хэш считается до входа в хранилище, чтобы не задерживать переключение копий писателем */
+    hash = log_src_hash(source, &len);
+    hm_idx = src_hm_read_begin(&hm);
+    idx = log_src_table_find(hm, source, len, hash);
+    if (idx != LOG_SRC_TABLE_NOT_FOUND)
+    {
+        /* дескриптор не освобождается до log_destroy(), поэтому доступен и после выхода из хранилища */
+        res = hm->entries[idx].handle;
+    }
+    src_hm_read_end(hm_idx);
+    return res;
+}
+
+/**
+ * Находит уровень зарегистрированного источника без блокировок (без обращения к дескриптору).
+ *
+ * @param source [in] источник (!= NULL)
+ * @return минимальный уровень источника или LL_CNT, если источник не зарегистрирован.
+ */
+static
+log_level_t find_src_level(const char *source)
+{
+    const log_src_table_t *hm;
+    uint32_t hm_idx;
+    size_t len;
+    size_t idx;
+    uint32_t hash;
+    log_level_t res = LL_CNT;
+
+    assert(source != NULL);
+
+    hash = log_src_hash(source, &len);
+    hm_idx = src_hm_read_begin(&hm);
+    idx = log_src_table_find(hm, source, len, hash);
+    if (idx != LOG_SRC_TABLE_NOT_FOUND)
+    {
+        res = (log_level_t)__atomic_load_n(&hm->levels[idx], __ATOMIC_RELAXED);
+    }
+    src_hm_read_end(hm_idx);
+    return res;
+}
+
+/**
+ * Увеличивает поколение конфигурации, делая недействительными кеши всех точек логгирования.
+ * Вызывается после изменения конфигурации (под мьютексом контекста, если он используется).
+ */
+static
+void bump_cfg_generation(void)
+{
+    uint64_t generation = log_cfg_generation + LOG_CFG_GENERATION_STEP;
+
+    /* 0 зарезервирован за не вычисленным кешем */
+    if (generation == 0) generation = LOG_CFG_GENERATION_STEP;
+    __atomic_store_n(&log_cfg_generation, generation, __ATOMIC_RELEASE);
+}
+
+/**
+ * Возвращает счётчик читателей текущего потока для указанной копии хранилища источников.
+ *
+ * @param idx [in] индекс копии хранилища (0 или 1).
+ * @return счётчик читателей.
+ */
+static inline
+uint32_t *get_reader_counter(uint32_t idx)
+{
+    if (tls_reader_slot == 0)
+    {
+        tls_reader_slot = (__atomic_fetch_add(&reader_slot_seq, 1, __ATOMIC_RELAXED) % LOG_SRC_HM_READER_SLOTS) + 1;
+    }
+    return &log_ctx.hm_readers[idx][tls_reader_slot - 1].readers;
+}
+
+/**
+ * Начинает чтение хранилища источников без блокировок.
+ * Каждому вызову должен соответствовать вызов src_hm_read_end().
+ *
+ * @param hm [out] активная копия хранилища (!= NULL).
+ * @return индекс копии хранилища для передачи в src_hm_read_end().
+ */
+static
+uint32_t src_hm_read_begin(const log_src_table_t **hm)
+{
+    assert(hm != NULL);
+
+    for (;;)
+    {
+        uint32_t idx = __atomic_load_n(&log_ctx.active_hm, __ATOMIC_SEQ_CST);
+        uint32_t *counter = get_reader_counter(idx);
+
+        __atomic_add_fetch(counter, 1, __ATOMIC_SEQ_CST);
+        /* писатель мог переключить копии между чтением индекса и регистрацией читателя */
+        if (__atomic_load_n(&log_ctx.active_hm, __ATOMIC_SEQ_CST) == idx)
+        {
+            *hm = &log_ctx.source_hm[idx];
+            return idx;
+        }
+        __atomic_sub_fetch(counter, 1, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * Заканчивает чтение хранилища источников, начатое src_hm_read_begin().
+ *
+ * @param idx [in] индекс копии хранилища, полученный от src_hm_read_begin().
+ */
+static
+void src_hm_read_end(uint32_t idx)
+{
+    __atomic_sub_fetch(get_reader_counter(idx), 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Делает активной неактивную копию хранилища источников и дожидается,
+ * пока читатели покинут прежнюю активную копию.
+ * Вызывается писателем (под мьютексом контекста, если он используется).
+ */
+static
+void src_hm_switch(void)
+{
+    uint32_t old_idx = log_ctx.active_hm;
+    size_t i;
+
+    __atomic_store_n(&log_ctx.active_hm, 1 - old_idx, __ATOMIC_SEQ_CST);
+    for (i = 0; i < LOG_SRC_HM_READER_SLOTS; i++)
+    {
+        while (__atomic_load_n(&log_ctx.hm_readers[old_idx][i].readers, __ATOMIC_ACQUIRE) != 0)
+        {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * Находит или создаёт (не зарегистрированным) дескриптор источника.
+ * Вызывается писателем (под мьютексом контекста, если он используется).
+ *
+ * @param source [in] источник (!= NULL)
+ * @return дескриптор или NULL при нехватке памяти.
+ */
+static
+log_source_t *get_or_create_src_handle(const char *source)
+{
+    log_source_t *handle;
+    const char *name;
+    size_t len;
+    size_t idx;
+    uint32_t hash;
+
+    assert(source != NULL);
+
+    hash = log_src_hash(source, &len);
+    idx = log_src_table_find(&log_ctx.handles_hm, source, len, hash);
+    if (idx != LOG_SRC_TABLE_NOT_FOUND) return log_ctx.handles_hm.entries[idx].handle;
+    /* дескрипторы и имена живут до log_destroy(): при ошибке выделенная из арены память просто не используется */
+    handle = log_arena_alloc(&log_ctx.src_arena, sizeof(log_source_t));
+    name = handle ? log_arena_strndup(&log_ctx.src_arena, source, len) : NULL;
+    if (name == NULL) return NULL;
+    handle->dedup = NULL;
+    if (log_ctx.dedup_window_ns)
+    {
+        handle->dedup = log_arena_alloc(&log_ctx.src_arena, sizeof(log_dedup_t));
+        if (handle->dedup == NULL) return NULL;
+        memset(handle->dedup, 0, sizeof(log_dedup_t));
+        if (pthread_mutex_init(&handle->dedup->mutex, NULL) != 0) return NULL;
+    }
+    handle->source = name;
+    handle->source_len = len;
+    handle->source_hash = hash;
+    handle->min_log_level = LL_CNT;
+    if (!log_src_table_insert(&log_ctx.handles_hm, name, len, hash, handle, (uint8_t)LL_CNT))
+    {
+        if (handle->dedup) pthread_mutex_destroy(&handle->dedup->mutex);
+        return NULL;
+    }
+    return handle;
+}
+
+/**
+ * Создаёт (не зарегистрированными) дескрипторы всех источников манифеста, чтобы точки логгирования
+ * находили их по идентификатору, вычисленному при компиляции, без поиска в хэше.
+ *
+ * @return true - OK, false - нехватка памяти.
+ */
+static
+bool create_manifest_handles(void)
+{
+#if DO_LOG_SRC_MANIFEST
+    size_t i;
+
+    for (i = 0; i < LOG_SRC_MANIFEST_SIZE; i++)
+    {
+        if (log_src_manifest_names[i][0] == '\0') continue;
+        log_ctx.manifest_handles[i] = get_or_create_src_handle(log_src_manifest_names[i]);
+        if (log_ctx.manifest_handles[i] == NULL) return false;
+    }
+#endif
+    return true;
+}
+
+/**
+ * Освобождает все дескрипторы источников (вместе с хранилищем дескрипторов и ареной).
+ * Вызывается писателем (под мьютексом контекста, если он используется).
+ */
+static
+void destroy_src_handles(void)
+{
+    size_t i;
+
+    for (i = 0; log_ctx.handles_hm.hashes && i <= log_ctx.handles_hm.mask; i++)
+    {
+        log_source_t *handle = log_ctx.handles_hm.entries[i].handle;
+
+        if (log_ctx.handles_hm.hashes[i] && handle->dedup) pthread_mutex_destroy(&handle->dedup->mutex);
+    }
+    log_src_table_destroy(&log_ctx.handles_hm);
+#if DO_LOG_SRC_MANIFEST
+    memset(log_ctx.manifest_handles, 0, sizeof(log_ctx.manifest_handles));
+#endif
+    /* дескрипторы и имена источников освобождаются вместе с ареной */
+    log_arena_destroy(&log_ctx.src_arena);
+}
+
+/**
+ * Добавляет дескриптор источника в обе копии хранилища или удаляет его из них.
+ * Вызывается писателем (под мьютексом контекста, если он используется).
+ *
+ * @param handle [in] дескриптор источника (!= NULL)
+ * @param add    [in] true - добавить, false - удалить.
+ * @return true - OK, false - нехватка памяти (хранилище не изменено).
+ */
+static
+bool src_hm_update(log_source_t *handle,
+                   bool          add)
+{
+    size_t i;
+
+    assert(handle != NULL);
+
+    /* изменить сперва неактивную копию, затем прежнюю активную */
+    for (i = 0; i < 2; i++)
+    {
+        log_src_table_t *hm;
+
+        if (i) src_hm_switch();
+        hm = &log_ctx.source_hm[1 - log_ctx.active_hm];
+        if (add)
+        {
+            if (!log_src_table_insert(hm, handle->source, handle->source_len, handle->source_hash, handle,
+                                      (uint8_t)handle->min_log_level))
+            {
+                if (i)
+                {
+                    /* первая копия уже активна: вернуть её в неактивные и откатить в ней добавление */
+                    src_hm_switch();
+                    hm = &log_ctx.source_hm[1 - log_ctx.active_hm];
+                    log_src_table_remove(hm, log_src_table_find(hm, handle->source, handle->source_len, handle->source_hash));
+                }
+                return false;
+            }
+        }
+        else
+        {
+            size_t idx = log_src_table_find(hm, handle->source, handle->source_len, handle->source_hash);
+
+            assert(idx != LOG_SRC_TABLE_NOT_FOUND);
+            log_src_table_remove(hm, idx);
+        }
+    }
+    return true;
+}
+
+/**
+ * Устанавливает уровень источника в дескрипторе и в обеих копиях хранилища.
+ * Вызывается писателем (под мьютексом контекста, если он используется).
+ *
+ * @param handle [in/out] дескриптор источника (!= NULL)
+ * @param level  [in]     минимальный уровень (LL_CNT - источник не зарегистрирован)
+ */
+static
+void set_src_level(log_source_t *handle,
+                   log_level_t   level)
+{
+    size_t i;
+
+    assert(handle != NULL);
+
+    __atomic_store_n(&handle->min_log_level, level, __ATOMIC_RELEASE);
+    /* читатели обращаются к уровню атомарно, поэтому он изменяется и в активной копии, без переключения */
+    for (i = 0; i < 2; i++)
+    {
+        log_src_table_t *hm = &log_ctx.source_hm[i];
+        size_t idx = log_src_table_find(hm, handle->source, handle->source_len, handle->source_hash);
+
+        if (idx != LOG_SRC_TABLE_NOT_FOUND) __atomic_store_n(&hm->levels[idx], (uint8_t)level, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Вычисляет минимальный уровень для источника и сохраняет его в кеше точки логгирования.
+ * Не изменяет errno.
+ *
+ * @param callsite  [in/out] кеш точки логгирования (!= NULL).
+ * @param source    [in]     источник лога (!= NULL).
+ * @param source_id [in]     идентификатор источника в манифесте (-1 - нет, источник ищется в хэше).
+ * @return новое слово состояния точки логгирования.
+ */
+extern
+uint64_t log_callsite_resolve(log_callsite_t *callsite,
+                              const char     *source,
+                              int             source_id)
+{
+    int saved_errno = errno;
+    uint64_t generation;
+    log_level_t level = LL_CNT;
+    log_level_t sample_level = LL_INVALID;
+    uint64_t state;
+
+    assert(callsite != NULL);
+    assert(source != NULL);
+#if !DO_LOG_SRC_MANIFEST
+    UNUSED_PARAM(source_id);
+#endif
+
+    /* поколение читается до конфигурации: конкурентное изменение сделает результат устаревшим */
+    generation = __atomic_load_n(&log_cfg_generation, __ATOMIC_ACQUIRE);
+    if (log_ctx.initialized)
+    {
+        const log_source_t *handle;
+
+#if DO_LOG_SRC_MANIFEST
+        if (source_id >= 0)
+        {
+            assert((unsigned)source_id < LOG_SRC_MANIFEST_SIZE);
+            /* дескриптор источника манифеста существует с log_init(), зарегистрирован он или нет - по его уровню */
+            handle = log_ctx.manifest_handles[source_id];
+            if (__atomic_load_n(&handle->min_log_level, __ATOMIC_RELAXED) == LL_CNT) handle = NULL;
+        }
+        else
+#endif
+        {
+            handle = find_src_handle(source);
+        }
+        if (handle)
+        {
+            level = get_handle_effective_level(handle);
+            sample_level = __atomic_load_n(&handle->sample_level, __ATOMIC_RELAXED);
+            __atomic_store_n(&callsite->sample_threshold, __atomic_load_n(&handle->sample_threshold, __ATOMIC_RELAXED),
+                             __ATOMIC_RELAXED);
+        }
+    }
+    /* уровень вывода хранится рядом с уровнем формирования: с самописцем записи формируются и ниже уровня вывода */
+    state = generation | ((uint64_t)sample_level << LOG_CALLSITE_SAMPLE_SHIFT) |
+            ((uint64_t)level << LOG_CALLSITE_OUTPUT_SHIFT) | (uint64_t)get_formed_level(level);
+    __atomic_store_n(&callsite->state, state, __ATOMIC_RELAXED);
+    errno = saved_errno;
+    return state;
+}
+
+/**
+ * Выбирает начальное значение генератора сэмплирования текущего потока.
+ *
+ * @return начальное значение (!= 0).
+ */
+extern
+uint64_t log_sample_seed(void)
+{
+    uint64_t seed = 0;
+
+    /* адрес переменной потока, время и счётчик перемешиваются финализатором splitmix64 */
+    if (!get_monotonic_ns(&seed)) seed = 0;
+    seed ^= (uint64_t)(uintptr_t)&log_sample_rng;
+    seed += __atomic_add_fetch(&sample_seed_seq, 1, __ATOMIC_RELAXED) * 0x9E3779B97F4A7C15ull;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ull;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBull;
+    seed ^= seed >> 31;
+    return seed ? seed : 1;
+}
+
+/**
+ * Проверяет ограничение частоты точки логгирования (алгоритм GCRA - эквивалент корзины маркеров):
+ * запись разрешена, если теоретическое время прибытия опережает текущее не более чем на burst - 1 интервалов.
+ * Не берёт блокировок и не изменяет errno.
+ *
+ * @param ratelimit  [in/out] состояние ограничителя точки логгирования (!= NULL).
+ * @param rate       [in]     разрешённое количество записей в секунду (0 - без ограничения).
+ * @param burst      [in]     максимальная пачка записей подряд (0 - 1).
+ * @param suppressed [out]    количество записей, подавленных с прошлой разрешённой записи (!= NULL).
+ * @return true - запись разрешена, false - подавлена.
+ */
+extern
+bool log_ratelimit_allow(log_ratelimit_t *ratelimit,
+                         unsigned         rate,
+                         unsigned         burst,
+                         uint32_t        *suppressed)
+{
+    uint64_t now;
+    uint64_t interval;
+    uint64_t tolerance;
+    uint64_t tat;
+
+    assert(ratelimit != NULL);
+    assert(suppressed != NULL);
+
+    *suppressed = 0;
+    if (rate == 0) return true;
+    if (!get_monotonic_ns(&now)) return true;
+    interval = MAX(1000000000u / rate, 1u);
+    tolerance = interval * (MAX(burst, 1u) - 1);
+    tat = __atomic_load_n(&ratelimit->tat, __ATOMIC_RELAXED);
+    do
+    {
+        uint64_t start = MAX(tat, now);
+
+        if (start - now > tolerance)
+        {
+            __atomic_add_fetch(&ratelimit->suppressed, 1, __ATOMIC_RELAXED);
+            return false;
+        }
+        /* при неудаче tat обновляется текущим значением и проверка повторяется */
+        if (__atomic_compare_exchange_n(&ratelimit->tat, &tat, start + interval, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+            break;
+        }
+    } while (true);
+    *suppressed = __atomic_exchange_n(&ratelimit->suppressed, 0, __ATOMIC_RELAXED);
+    return true;
+}
+
+/**
+ * Инициализирует систему логгирования.
+ * Данный вызов не допускается 2 раза подряд.
+ *
+ * @param min_log_level  [in] глобально (для всех источников) минимально выводимый уровень логов (LL_NONE - отключает вывод).
+ * @param is_thread_safe [in] флаг необходимости использовать примитивы синхронизации при каждом логгировании
+ * @return true - OK, false - Fail
+ */
+extern
+bool log_init(log_level_t min_log_level,
+              bool        is_thread_safe)
+{
+    log_config_t config;
+
+    ZEROIZE_STRUCT(config);
+    config.min_log_level = min_log_level;
+    config.is_thread_safe = is_thread_safe;
+    return log_init_ex(&config);
+}
+
+/**
+ * Инициализирует систему логгирования с расширенными параметрами.
+ * Данный вызов не допускается 2 раза подряд.
+ *
+ * @param config [in] параметры (!= NULL).
+ * @return true - OK, false - Fail
+ */
+extern
+bool log_init_ex(const log_config_t *config)
+{
+    assert(config != NULL);
+
+    if (log_ctx.initialized == false)
+    {
+        /* проверка невалиндых параметров */
+        if ((config->min_log_level <= LL_INVALID) || (config->min_log_level >= LL_CNT)) return false;
+        if ((config->flight_recorder_level < LL_INVALID) || (config->flight_recorder_level >= LL_CNT)) return false;
+        if ((config->backtrace_level < LL_INVALID) || (config->backtrace_level >= LL_CNT)) return false;
+
+        log_ctx.min_log_level = config->min_log_level;
+        log_ctx.use_mutex = config->is_thread_safe;
+        log_ctx.async_drain = !config->async_no_drain;
+        log_ctx.deferred = config->deferred || config->binary_path;
+        log_ctx.signal_fd = config->signal_safe_fd ? config->signal_safe_fd : STDERR_FILENO;
+        log_ctx.utc_offset = log_sig_utc_offset();
+        log_ctx.dedup_window_ns = (uint64_t)config->dedup_window_ms * 1000000u;
+        if (config->is_thread_safe)
+        {
+            if (pthread_mutex_init(&(log_ctx.mutex), NULL) != 0)
+            {
+                return false;
+            }
+        }
+        if (!create_manifest_handles())
+        {
+            destroy_src_handles();
+            if (config->is_thread_safe) pthread_mutex_destroy(&(log_ctx.mutex));
+            return false;
+        }
+        if (config->flight_recorder_size)
+        {
+            if (!log_flight_init(config->flight_recorder_size,
+                                 config->flight_recorder_path ? config->flight_recorder_path : LOG_FLIGHT_DEFAULT_PATH,
+                                 config->flight_recorder_crash_dump, config->flight_recorder_signal))
+            {
+                destroy_src_handles();
+                if (config->is_thread_safe) pthread_mutex_destroy(&(log_ctx.mutex));
+                return false;
+            }
+            log_ctx.flight = true;
+            log_ctx.flight_level = (config->flight_recorder_level != LL_INVALID) ? config->flight_recorder_level : LL_TRACE;
+        }
+        if (config->backtrace_records)
+        {
+            if (!log_backtrace_init(config->backtrace_records,
+                                    config->backtrace_record_size ? config->backtrace_record_size :
+                                                                    LOG_BACKTRACE_DEFAULT_RECORD_SIZE,
+                                    config->backtrace_window_ms))
+            {
+                log_ctx.flight = false;
+                log_flight_destroy();
+                destroy_src_handles();
+                if (config->is_thread_safe) pthread_mutex_destroy(&(log_ctx.mutex));
+                return false;
+            }
+            log_ctx.backtrace = true;
+            log_ctx.backtrace_level = (config->backtrace_level != LL_INVALID) ? config->backtrace_level : LL_TRACE;
+        }
+        log_ctx.retain_level = LL_CNT;
+        if (log_ctx.flight) log_ctx.retain_level = log_ctx.flight_level;
+        if (log_ctx.backtrace) log_ctx.retain_level = MIN(log_ctx.retain_level, log_ctx.backtrace_level);
+        if (config->binary_path)
+        {
+            char session[32];
+
+            log_ctx.binary_fd = open(config->binary_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (log_ctx.binary_fd < 0)
+            {
+                log_ctx.backtrace = false;
+                log_backtrace_destroy();
+                log_ctx.flight = false;
+                log_flight_destroy();
+                destroy_src_handles();
+                if (config->is_thread_safe) pthread_mutex_destroy(&(log_ctx.mutex));
+                return false;
+            }
+            log_ctx.binary = true;
+            log_ctx.binary_sites = 0;
+            ZEROIZE_STRUCT(log_ctx.binary_packer);
+            write_output(session, log_bin_put_session(session, sizeof(session), log_deferred_layout()), LL_NONE);
+        }
+        if (config->async || log_ctx.deferred)
+        {
+            log_async_cfg_t async_cfg;
+            char *batches[LOG_ASYNC_NUM_BATCHES];
+            size_t batch_size;
+
+            ZEROIZE_STRUCT(async_cfg);
+            async_cfg.ring_size = config->async_ring_size ? config->async_ring_size : LOG_ASYNC_DEFAULT_RING_SIZE;
+            /* округлить размер кольца вверх до степени 2 */
+            while (async_cfg.ring_size & (async_cfg.ring_size - 1))
+            {
+                async_cfg.ring_size = (async_cfg.ring_size | (async_cfg.ring_size - 1)) + 1;
+            }
+            async_cfg.record_size = config->async_record_size ? config->async_record_size : LOG_ASYNC_DEFAULT_RECORD_SIZE;
+            async_cfg.flush_interval_ms = config->async_flush_interval_ms ? config->async_flush_interval_ms :
+                                                                            LOG_ASYNC_DEFAULT_FLUSH_INTERVAL_MS;
+            async_cfg.write_fn = write_batch;
+            if (log_ctx.deferred)
+            {
+                async_cfg.render_fn = log_ctx.binary ? render_binary : render_deferred;
+                async_cfg.render_max_size = LOG_RECORD_MAX_SIZE;
+            }
+            if (log_ctx.binary) async_cfg.frame_fn = frame_text;
+            /* уровни записей важны только для фильтрации по приёмникам */
+            async_cfg.track_levels = !log_ctx.binary;
+            batch_size = log_async_get_batches(batches);
+            /* без io_uring (не собран, запрещён ядром) пачки выводятся write(2) */
+            log_ctx.uring = log_uring_init(batches, LOG_ASYNC_NUM_BATCHES, batch_size);
+            if (log_ctx.uring) async_cfg.wait_fn = log_uring_wait;
+            if (!log_async_start(&async_cfg))
+            {
+                if (log_ctx.uring)
+                {
+                    log_ctx.uring = false;
+                    log_uring_destroy();
+                }
+                if (log_ctx.binary)
+                {
+                    log_ctx.binary = false;
+                    close(log_ctx.binary_fd);
+                }
+                log_ctx.backtrace = false;
+                log_backtrace_destroy();
+                log_ctx.flight = false;
+                log_flight_destroy();
+                destroy_src_handles();
+                if (config->is_thread_safe) pthread_mutex_destroy(&(log_ctx.mutex));
+                return false;
+            }
+        }
+        log_ctx.initialized = true;
+        bump_cfg_generation();
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Устанавливает глобальный уровень логгирования.
+ *
+ * @param min_log_level [in] глобально (для всех источников) минимально выводимый уровень логов (LL_NONE - отключает вывод).
+ * @return true - OK, false - Fail
+ */
+extern
+bool log_set_log_level(log_level_t min_log_level)
+{
+    if ((min_log_level <= LL_INVALID) || (min_log_level >= LL_CNT)) return false;
+    if (log_ctx.initialized == false) return false;
+    lock_mutex_if_it_needs(&log_ctx);
+    __atomic_store_n(&log_ctx.min_log_level, min_log_level, __ATOMIC_RELEASE);
+    bump_cfg_generation();
+    unlock_mutex_if_it_needs(&log_ctx);
+    return true;
+}
+
+/**
+ * Регистрирует новый источник лога в системе логгирования.
+ * Если заданный источник уже зерегистрирован, он перезаписывается.
+ *
+ * @param source        [in] источник лога (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
+ * @param min_log_level [in] минимальный уровень выводимого лога (LL_NONE - отключает вывод).
+ * @return true - OK, false - fail.
+ */
+extern
+bool log_register(const char  *source,
+                  log_level_t  min_log_level)
+{
+    return (log_register_handle(source, min_log_level) != NULL);
+}
+
+/**
+ * Регистрирует новый источник лога в системе логгирования и возвращает его дескриптор.
+ * Если заданный источник уже зерегистрирован, он перезаписывается.
+ *
+ * @param source        [in] источник лога (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
+ * @param min_log_level [in] минимальный уровень выводимого лога (LL_NONE - отключает вывод).
+ * @return дескриптор источника (действителен до log_destroy()) или NULL в случае ошибки.
+ */
+extern
+log_source_t *log_register_handle(const char  *source,
+                                  log_level_t  min_log_level)
+{
+    return register_src_handle(source, min_log_level, LL_INVALID, 1.0);
+}
+
+/**
+ * Регистрирует новый источник лога с сэмплированием записей низких уровней:
+ * из записей уровней ниже sample_level выводится случайная доля sample_ratio.
+ * Решение принимается логгирующими макросами до вычисления аргументов и форматирования.
+ * Если заданный источник уже зерегистрирован, он перезаписывается.
+ *
+ * @param source        [in] источник лога (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
+ * @param min_log_level [in] минимальный уровень выводимого лога (LL_NONE - отключает вывод).
+ * @param sample_level  [in] записи уровней ниже sample_level сэмплируются (LL_INVALID - без сэмплирования).
+ * @param sample_ratio  [in] доля сохраняемых записей сэмплируемых уровней (0.0 ... 1.0).
+ * @return true - OK, false - fail.
+ */
+extern
+bool log_register_sampled(const char  *source,
+                          log_level_t  min_log_level,
+                          log_level_t  sample_level,
+                          double       sample_ratio)
+{
+    return (register_src_handle(source, min_log_level, sample_level, sample_ratio) != NULL);
+}
+
+/**
+ * Регистрирует источник (или перезаписывает зарегистрированный) с параметрами сэмплирования.
+ *
+ * @param source        [in] источник лога (!= NULL)
+ * @param min_log_level [in] минимальный уровень выводимого лога (LL_NONE - отключает вывод).
+ * @param sample_level  [in] записи уровней ниже sample_level сэмплируются (LL_INVALID - без сэмплирования).
+ * @param sample_ratio  [in] доля сохраняемых записей сэмплируемых уровней (0.0 ... 1.0).
+ * @return дескриптор источника или NULL в случае ошибки.
+ */
+static
+log_source_t *register_src_handle(const char  *source,
+                                  log_level_t  min_log_level,
+                                  log_level_t  sample_level,
+                                  double       sample_ratio)
+{
+    log_source_t *handle;
+
+    assert(source != NULL);
+
+    /* проверка невалиндых параметров */
+    if ((min_log_level <= LL_INVALID) || (min_log_level >= LL_CNT)) return NULL;
+    if ((sample_level < LL_INVALID) || (sample_level >= LL_CNT)) return NULL;
+    if (!(sample_ratio >= 0.0 && sample_ratio <= 1.0)) return NULL;
+    if (log_ctx.initialized == false) return NULL;
+    /* проверка на длину источника */
+    if (strlen(source) > LOG_SRC_STORED_MAX_SIZE)
+    {
+        return NULL;
+    }
+    /* доля 1.0 не требует розыгрыша */
+    if (sample_ratio >= 1.0) sample_level = LL_INVALID;
+    lock_mutex_if_it_needs(&log_ctx);
+    handle = get_or_create_src_handle(source);
+    if (handle)
+    {
+        /* параметры сэмплирования публикуются вместе с уровнем увеличением поколения конфигурации */
+        __atomic_store_n(&handle->sample_threshold, (sample_ratio < 1.0) ? (uint32_t)(sample_ratio * 4294967296.0) : UINT32_MAX,
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&handle->sample_level, sample_level, __ATOMIC_RELAXED);
+        handle->sample_ratio = sample_ratio;
+        if (handle->min_log_level == LL_CNT)
+        {
+            /* уровень выставляется до публикации, чтобы читатели сразу видели корректное значение */
+            __atomic_store_n(&handle->min_log_level, min_log_level, __ATOMIC_RELEASE);
+            if (!src_hm_update(handle, true))
+            {
+                __atomic_store_n(&handle->min_log_level, LL_CNT, __ATOMIC_RELEASE);
+                handle = NULL;
+            }
+        }
+        else
+        {
+            /* источник уже зарегистрирован - достаточно обновить уровень */
+            set_src_level(handle, min_log_level);
+        }
+    }
+    if (handle) bump_cfg_generation();
+    unlock_mutex_if_it_needs(&log_ctx);
+    return handle;
+}
+
+/**
+ * Возвращает дескриптор источника лога.
+ * Если источник ещё не зарегистрирован, создаётся незарегистрированный дескриптор:
+ * логи через него не выводятся до регистрации источника функцией log_register().
+ *
+ * @param source [in] источник лога (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
+ * @return дескриптор источника (действителен до log_destroy()) или NULL в случае ошибки.
+ */
+extern
+log_source_t *log_source_get(const char *source)
+{
+    log_source_t *handle;
+
+    assert(source != NULL);
+
+    if (log_ctx.initialized == false) return NULL;
+    if (strlen(source) > LOG_SRC_STORED_MAX_SIZE)
+    {
+        return NULL;
+    }
+    lock_mutex_if_it_needs(&log_ctx);
+    handle = get_or_create_src_handle(source);
+    unlock_mutex_if_it_needs(&log_ctx);
+    return handle;
+}
+
+/**
+ * Регистрирует новые источники лога в системе логгирования.
+ * Если один из источников уже зерегистрирован, он перезаписывается.
+ * @param descr      [in] Массив дескрипторов источника лога.
+ * @param num_descrs [in] Количество элементов в массиве num_descrs.
+ * @return true - OK, false - не удалось зарегистрировать хотябы 1 источник.
+ */
+extern
+bool log_register_ex(const log_src_descr_t *descr,
+                     size_t                 num_descrs)
+{
+    size_t i;
+
+    if (log_ctx.initialized == false) return false;
+    if (num_descrs && !descr) return false;
+    for (i = 0; i < num_descrs; i++)
+    {
+        if (!register_src_handle(descr[i].source, descr[i].min_log_level, descr[i].sample_level,
+                                 (descr[i].sample_level != LL_INVALID) ? descr[i].sample_ratio : 1.0))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Удаляет регистрацию источника (если зарегистрирован) в системе логгирования.
+ *
+ * @param source [in] источник лога (!= NULL)
+ */
+extern
+void log_unregister(const char *source)
+{
+    log_source_t *handle = NULL;
+    size_t len;
+    size_t idx;
+    uint32_t hash;
+
+    assert(source != NULL);
+
+    if (log_ctx.initialized == false) return;
+    hash = log_src_hash(source, &len);
+    lock_mutex_if_it_needs(&log_ctx);
+    idx = log_src_table_find(&log_ctx.handles_hm, source, len, hash);
+    if (idx != LOG_SRC_TABLE_NOT_FOUND) handle = log_ctx.handles_hm.entries[idx].handle;
+    if (handle && handle->min_log_level != LL_CNT)
+    {
+        /* дескриптор остаётся действительным, но перестаёт пропускать логи */
+        set_src_level(handle, LL_CNT);
+        (void)src_hm_update(handle, false);
+        bump_cfg_generation();
+    }
+    unlock_mutex_if_it_needs(&log_ctx);
+}
+
+/**
+ * Удаляет регистрацию всех источников в системе логгирования.
+ * Дескрипторы источников становятся недействительными, после вызова систему можно снова
+ * инициализировать log_init().
+ *
+ * @return true - OK, false -Fail
+ */
+extern
+bool log_destroy()
+{
+    size_t i;
+
+    if (log_ctx.initialized)
+    {
+        /* итоговые строки повторов выводятся до остановки фонового потока, чтобы попасть в вывод */
+        flush_dedup();
+        /* фоновый поток останавливается до захвата мьютекса: ему может потребоваться вывести остаток кольца */
+        log_async_stop(log_ctx.async_drain);
+        if (log_ctx.uring)
+        {
+            log_ctx.uring = false;
+            log_uring_destroy();
+        }
+        if (log_ctx.flight)
+        {
+            log_ctx.flight = false;
+            log_flight_destroy();
+        }
+        if (log_ctx.backtrace)
+        {
+            log_ctx.backtrace = false;
+            log_backtrace_destroy();
+        }
+        log_ctx.retain_level = LL_CNT;
+        if (log_ctx.binary)
+        {
+            /* словарь должен содержать все точки, на которые ссылаются записи файла */
+            flush_binary_sites();
+            log_ctx.binary = false;
+            close(log_ctx.binary_fd);
+        }
+        MUTEX_CHECK_LOCK(&log_sinks.mutex);
+        for (i = 0; i < log_sinks.num_sinks; i++)
+        {
+            destroy_sink(log_sinks.sinks[i]);
+        }
+        log_sinks.num_sinks = 0;
+        MUTEX_CHECK_UNLOCK(&log_sinks.mutex);
+        lock_mutex_if_it_needs(&log_ctx);
+        log_src_table_destroy(&log_ctx.source_hm[0]);
+        log_src_table_destroy(&log_ctx.source_hm[1]);
+        destroy_src_handles();
+        /* кеши точек логгирования устаревают вместе с поколением и не будут вычислены заново
+         * по освобождённому хранилищу: log_callsite_resolve() проверяет initialized */
+        log_ctx.initialized = false;
+        bump_cfg_generation();
+        if (log_ctx.use_mutex)
+        {
+            MUTEX_CHECK_UNLOCK(&log_ctx.mutex);
+            if (pthread_mutex_destroy(&(log_ctx.mutex)) != 0)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Логгирует в стиле printf.
+ * Печатает prefix и время перед логом.
+ *
+ * @param source    [in] источник (строка - источника лога) (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
+ * @param file      [in] имя файла (максимальная длина LOG_FUNCTION_NAME_MAX_SIZE).
+ * @param line      [in] номер строки в файле.
+ * @param function  [in] имя функции (максимальная длина LOG_FILE_NAME_MAX_SIZE).
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ * @param fmt       [in] (!= NULL).
+ */
+extern
+void log_log(const char  *source,
+             const char  *file,
+             const char  *line,
+             const char  *function,
+             log_level_t  log_level,
+             const char  *fmt, ...)
+{
+    assert(source != NULL);
+    assert(file != NULL);
+    assert(line != NULL);
+    assert(function != NULL);
+    assert(log_level > LL_INVALID);
+    assert(log_level < LL_CNT);
+    assert(fmt != NULL);
+
+    if (log_ctx.initialized == false) return;
+    /* проверка уровня выполняется без блокировки, мьютекс защищает только общий буфер и вывод */
+    if (is_log_allowed(source, log_level))
+    {
+        va_list args;
+
+        va_start(args, fmt);
+        write_log(source, file, line, function, log_level, LOG_DISPATCH_OUTPUT, fmt, args);
+        va_end(args);
+    }
+    else if (is_log_recorded(source, log_level))
+    {
+        va_list args;
+
+        va_start(args, fmt);
+        write_log(source, file, line, function, log_level, LOG_DISPATCH_HIDDEN, fmt, args);
+        va_end(args);
+    }
+}
+
+/**
+ * Логгирует в стиле printf от имени точки логгирования (используется макросами _LOG_*).
+ * В режиме отложенного форматирования сохраняет в кольцо строку формата по ссылке и аргументы
+ * в двоичном виде, форматирование выполняет фоновый поток. Строки file, line, function и fmt
+ * должны существовать всё время работы процесса.
+ *
+ * @param callsite  [in/out] кеш точки логгирования (!= NULL).
+ * @param source    [in] источник (строка - источника лога) (!= NULL)
+ * @param file      [in] имя файла.
+ * @param line      [in] номер строки в файле.
+ * @param function  [in] имя функции.
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ * @param fmt       [in] (!= NULL).
+ */
+extern
+void log_log_cs(log_callsite_t *callsite,
+                const char     *source,
+                const char     *file,
+                const char     *line,
+                const char     *function,
+                log_level_t     log_level,
+                const char     *fmt, ...)
+{
+    va_list args;
+    log_dispatch_t dispatch;
+    bool output;
+    bool recorded;
+
+    assert(callsite != NULL);
+    assert(source != NULL);
+    assert(file != NULL);
+    assert(line != NULL);
+    assert(function != NULL);
     assert(log_level > LL_INVALID);
     assert(log_level < LL_CNT);
+    assert(fmt != NULL);
+
+    if (log_ctx.initialized == false) return;
+    /* кеш точки обычно уже актуален; если нет - источник ищется в хэше */
+    if (!log_callsite_enabled(callsite, source, -1, log_level)) return;
+    output = log_callsite_printed(callsite, log_level);
+    recorded = (log_ctx.flight && check_log_level(log_level, log_ctx.flight_level));
+    dispatch = output ? LOG_DISPATCH_OUTPUT : LOG_DISPATCH_HIDDEN;
+    if (!output) recorded = recorded || (log_ctx.backtrace && check_log_level(log_level, log_ctx.backtrace_level));
+    va_start(args, fmt);
+    if (output && log_ctx.deferred)
+    {
+        /* предыстория выводится до ошибки, поэтому передаётся в кольцо раньше неё */
+        if (log_ctx.backtrace && log_level >= LL_ERROR) log_backtrace_flush(emit_record, log_level);
+        /* самописцу нужен текст: при отложенном выводе запись для него формируется сразу */
+        if (push_deferred(callsite, source, file, line, function, log_level, fmt, args))
+        {
+            dispatch = LOG_DISPATCH_RECORDER;
+            output = false;
+        }
+    }
+    if (output || recorded)
+    {
+        va_end(args);
+        va_start(args, fmt);
+        write_log(source, file, line, function, log_level, dispatch, fmt, args);
+    }
+    va_end(args);
+}
+
+/**
+ * Сохраняет лог в кольцо асинхронного вывода в двоичном виде для отложенного форматирования.
+ *
+ * @param callsite  [in/out] кеш точки логгирования (!= NULL).
+ * @param source    [in] источник (!= NULL)
+ * @param file      [in] имя файла.
+ * @param line      [in] номер строки в файле.
+ * @param function  [in] имя функции.
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ * @param fmt       [in] (!= NULL).
+ * @param args      [in] аргументы fmt.
+ * @return true - запись передана фоновому потоку, false - строка формата не поддерживается, лог нужно сформировать сразу.
+ */
+static
+bool push_deferred(log_callsite_t *callsite,
+                   const char     *source,
+                   const char     *file,
+                   const char     *line,
+                   const char     *function,
+                   log_level_t     log_level,
+                   const char     *fmt,
+                   va_list         args)
+{
+    uint32_t site_id = __atomic_load_n(&callsite->deferred_id, __ATOMIC_ACQUIRE);
+    struct timespec ts;
+    size_t len;
+
+    if (!log_async_is_running()) return false;
+    if (site_id == 0) site_id = log_deferred_site_register(callsite, file, line, function, fmt);
+    if (site_id == LOG_DEFERRED_UNSUPPORTED) return false;
+    get_current_time(&ts);
+    /* запись, упакованная в кадры двоичного файла, должна помещаться в LOG_RECORD_MAX_SIZE */
+    len = log_deferred_capture(tls_record_buf, sizeof(tls_record_buf) - LOG_BIN_PACK_MAX_OVERHEAD, site_id, log_level,
+                               source, &ts, args);
+    if (len == 0) return false;
+    (void)log_async_push(tls_record_buf, len, true, log_level);
+    return true;
+}
+
+/**
+ * Преобразует отложенную запись в текст (вызывается фоновым потоком асинхронного вывода).
+ *
+ * @param rec      [in]  двоичная запись (!= NULL)
+ * @param len      [in]  размер записи в байтах
+ * @param out      [out] буфер для текста (!= NULL)
+ * @param out_size [in]  размер буфера в байтах
+ * @return длина текста в байтах, 0 - запись повреждена.
+ */
+static
+size_t render_deferred(const char *rec,
+                       size_t      len,
+                       char       *out,
+                       size_t      out_size)
+{
+    log_deferred_hdr_t hdr;
+    const log_deferred_site_t *site;
+
+    assert(rec != NULL);
+    assert(out != NULL);
+
+    if (len < sizeof(hdr)) return 0;
+    memcpy(&hdr, rec, sizeof(hdr));
+    site = log_deferred_site_get(hdr.site_id);
+    if (site == NULL) return 0;
+    return log_deferred_render(rec, len, site, out, out_size);
+}
+
+/**
+ * Упаковывает отложенную запись в кадры двоичного файла журнала и дописывает
+ * кадры ещё не записанных точек логгирования, если они помещаются в буфер
+ * (вызывается фоновым потоком асинхронного вывода).
+ *
+ * @param rec      [in]  двоичная запись (!= NULL)
+ * @param len      [in]  размер записи в байтах
+ * @param out      [out] буфер для кадров (!= NULL)
+ * @param out_size [in]  размер буфера в байтах
+ * @return размер кадров в байтах.
+ */
+static
+size_t render_binary(const char *rec,
+                     size_t      len,
+                     char       *out,
+                     size_t      out_size)
+{
+    size_t out_len;
+    uint32_t num_sites = log_deferred_site_count();
+
+    assert(rec != NULL);
+    assert(out != NULL);
+
+    out_len = log_bin_pack_record(&log_ctx.binary_packer, rec, len, out, out_size);
+    if (out_len == 0) return 0;
+    /* словарь может следовать за записями: cos_log_decode читает его для всей сессии */
+    while (log_ctx.binary_sites < num_sites)
+    {
+        size_t site_len = log_bin_put_site(out + out_len, out_size - out_len, log_ctx.binary_sites + 1);
+
+        if (site_len > out_size - out_len) break;
+        out_len += site_len;
+        log_ctx.binary_sites++;
+    }
+    return out_len;
+}
 
-    /* проверить сперва глобальную настройку */
-    if (check_log_level(log_level, log_ctx.min_log_level))
+/**
+ * Формирует заголовок кадра текста двоичного файла журнала.
+ *
+ * @param hdr [out] буфер размером LOG_ASYNC_FRAME_MAX_SIZE (!= NULL)
+ * @param len [in]  размер текста в байтах
+ * @return размер заголовка в байтах.
+ */
+static
+size_t frame_text(char   *hdr,
+                  size_t  len)
+{
+    return log_bin_put_frame_hdr(hdr, LOG_BIN_FRAME_TEXT, (uint32_t)len);
+}
+
+/**
+ * Записывает в двоичный файл журнала кадры точек логгирования, ещё не попавшие в словарь.
+ */
+static
+void flush_binary_sites(void)
+{
+    uint32_t num_sites = log_deferred_site_count();
+
+    for (; log_ctx.binary_sites < num_sites; log_ctx.binary_sites++)
     {
-        log_source_hm_elt_t *elt = NULL;
-        /* найти в Хэше соответствующий источник */
-        HASH_FIND_STR(log_ctx.source_hm, source, elt);
-        if (elt)
+        size_t site_len = log_bin_put_site(tls_record_buf, sizeof(tls_record_buf), log_ctx.binary_sites + 1);
+
+        if (site_len > sizeof(tls_record_buf))
+        {
+            char *buf = malloc(site_len);
+
+            if (buf == NULL) continue;
+            write_output(buf, log_bin_put_site(buf, site_len, log_ctx.binary_sites + 1), LL_NONE);
+            free(buf);
+        }
+        else
         {
-            if (check_log_level(log_level, elt->min_log_level)) return true;
+            write_output(tls_record_buf, site_len, LL_NONE);
         }
     }
-    return false;
 }
 
 /**
- * Инициализирует систему логгирования.
- * Данный вызов не допускается 2 раза подряд.
+ * Формирует текст отложенной записи в раскладке compose_log_prefix().
  *
- * @param min_log_level  [in] глобально (для всех источников) минимально выводимый уровень логов (LL_NONE - отключает вывод).
- * @param is_thread_safe [in] флаг необходимости использовать примитивы синхронизации при каждом логгировании
- * @return true - OK, false - Fail
+ * @param rec      [in]  двоичная запись (!= NULL)
+ * @param len      [in]  размер записи в байтах
+ * @param site     [in]  описание точки логгирования записи (!= NULL)
+ * @param out      [out] буфер для текста (!= NULL)
+ * @param out_size [in]  размер буфера в байтах
+ * @return длина текста в байтах, 0 - запись повреждена.
  */
 extern
-bool log_init(log_level_t min_log_level,
-              bool        is_thread_safe)
+size_t log_deferred_render(const char                *rec,
+                           size_t                     len,
+                           const log_deferred_site_t *site,
+                           char                      *out,
+                           size_t                     out_size)
 {
-    if (log_ctx.initialized == false)
+    log_deferred_hdr_t hdr;
+    const char *source;
+    const char *args;
+    char source_buf[LOG_DEFERRED_SRC_MAX_SIZE + 1];
+    struct timespec ts;
+    size_t out_len;
+
+    assert(rec != NULL);
+    assert(site != NULL);
+    assert(out != NULL);
+
+    if (out_size < 2) return 0;
+    if (!log_deferred_parse(rec, len, &hdr, &source, &args)) return 0;
+    memcpy(source_buf, source, hdr.src_len);
+    source_buf[hdr.src_len] = '\0';
+    ts.tv_sec = (time_t)hdr.sec;
+    ts.tv_nsec = (long)hdr.nsec;
+    compose_log_prefix(out, out_size, source_buf, site->file, site->line, site->function, (log_level_t)hdr.level, &ts);
+    out_len = strlen(out);
+    out_len += (size_t)snprintf(out + out_len, out_size - out_len, " | ");
+    out_len = MIN(out_len, out_size - 1);
+    out_len += log_deferred_format(out + out_len, out_size - out_len, site->fmt, args, hdr.args_len);
+    /* запись обрезана - оставить место для завершающего перевода строки */
+    if (out_len > out_size - 2) out_len = out_size - 2;
+    out[out_len++] = '\n';
+    return out_len;
+}
+
+/**
+ * Возвращает раскладку префикса, с которой собрана библиотека.
+ *
+ * @return флаги LOG_BIN_LAYOUT_*.
+ */
+extern
+uint16_t log_deferred_layout(void)
+{
+    return (uint16_t)((DO_LOG_CURRENT_TIME ? LOG_BIN_LAYOUT_TIME : 0) |
+                      (DO_LOG_FUNCTION_NAME ? LOG_BIN_LAYOUT_FUNCTION : 0));
+}
+
+/**
+ * Логгирует в стиле printf от имени дескриптора источника (без поиска источника по строке).
+ * Печатает prefix и время перед логом.
+ *
+ * @param source    [in] дескриптор источника (!= NULL)
+ * @param file      [in] имя файла (максимальная длина LOG_FUNCTION_NAME_MAX_SIZE).
+ * @param line      [in] номер строки в файле.
+ * @param function  [in] имя функции (максимальная длина LOG_FILE_NAME_MAX_SIZE).
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ * @param fmt       [in] (!= NULL).
+ */
+extern
+void log_log_h(const log_source_t *source,
+               const char         *file,
+               const char         *line,
+               const char         *function,
+               log_level_t         log_level,
+               const char         *fmt, ...)
+{
+    assert(source != NULL);
+    assert(file != NULL);
+    assert(line != NULL);
+    assert(function != NULL);
+    assert(log_level > LL_INVALID);
+    assert(log_level < LL_CNT);
+    assert(fmt != NULL);
+
+    if (log_ctx.initialized == false) return;
+    if (check_log_level(log_level, get_handle_effective_level(source)))
     {
-        /* проверка невалиндых параметров */
-        if ((min_log_level <= LL_INVALID) || (min_log_level >= LL_CNT)) return false;
+        va_list args;
 
-        log_ctx.min_log_level = min_log_level;
-        log_ctx.use_mutex = is_thread_safe;
-        if (is_thread_safe)
-        {
-            if (pthread_mutex_init(&(log_ctx.mutex), NULL) != 0)
-            {
-                return false;
-            }
-        }
-        log_ctx.initialized = true;
-        return true;
+        va_start(args, fmt);
+        write_log(source->source, file, line, function, log_level, LOG_DISPATCH_OUTPUT, fmt, args);
+        va_end(args);
+    }
+    else if (is_handle_recorded(source, log_level))
+    {
+        va_list args;
+
+        va_start(args, fmt);
+        write_log(source->source, file, line, function, log_level, LOG_DISPATCH_HIDDEN, fmt, args);
+        va_end(args);
     }
-    return false;
 }
 
 /**
- * Устанавливает глобальный уровень логгирования.
+ * Формирует лог в стиле printf (уровень уже проверен), выводит его и сохраняет в бортовой самописец.
  *
- * @param min_log_level [in] глобально (для всех источников) минимально выводимый уровень логов (LL_NONE - отключает вывод).
- * @return true - OK, false - Fail
+ * @param source    [in] источник (строка - источника лога) (!= NULL)
+ * @param file      [in] имя файла.
+ * @param line      [in] номер строки в файле.
+ * @param function  [in] имя функции.
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ * @param dispatch  [in] назначение записи.
+ * @param fmt       [in] (!= NULL).
+ * @param args      [in] аргументы fmt.
  */
-extern
-bool log_set_log_level(log_level_t min_log_level)
+static
+void write_log(const char     *source,
+               const char     *file,
+               const char     *line,
+               const char     *function,
+               log_level_t     log_level,
+               log_dispatch_t  dispatch,
+               const char     *fmt,
+               va_list         args)
 {
-    if ((min_log_level <= LL_INVALID) || (min_log_level >= LL_CNT)) return false;
-    if (log_ctx.initialized == false) return false;
-    lock_mutex_if_it_needs(&log_ctx);
-    log_ctx.min_log_level = min_log_level;
-    unlock_mutex_if_it_needs(&log_ctx);
+    size_t len;
+    size_t body_offset;
+    int msg_len;
+
+    /* префикс и сообщение формируются в одном буфере, строка формата пользователя разбирается один раз */
+    compose_log_prefix(tls_record_buf, sizeof(tls_record_buf), source, file, line, function, log_level, NULL);
+    len = strlen(tls_record_buf);
+    len += (size_t)snprintf(tls_record_buf + len, sizeof(tls_record_buf) - len, " | ");
+    body_offset = len;
+    msg_len = vsnprintf(tls_record_buf + len, sizeof(tls_record_buf) - len, fmt, args);
+    if (msg_len < 0) return;
+    len += (size_t)msg_len;
+    /* запись обрезана - оставить место для завершающего перевода строки */
+    if (len > sizeof(tls_record_buf) - 2) len = sizeof(tls_record_buf) - 2;
+    tls_record_buf[len++] = '\n';
+    if (dispatch == LOG_DISPATCH_OUTPUT && log_ctx.dedup_window_ns)
+    {
+        /* самописец сохраняет все записи, повторы подавляются только при выводе */
+        dispatch_record(tls_record_buf, len, log_level, LOG_DISPATCH_RECORDER);
+        if (log_ctx.backtrace && log_level >= LL_ERROR) log_backtrace_flush(emit_record, log_level);
+        emit_deduped(source, file, line, function, log_level, tls_record_buf, len, body_offset);
+    }
+    else
+    {
+        dispatch_record(tls_record_buf, len, log_level, dispatch);
+    }
+}
+
+/**
+ * Передаёт сформированную запись на вывод: в кольцо асинхронного вывода, если он запущен, иначе напрямую.
+ *
+ * @param data  [in] запись (!= NULL)
+ * @param len   [in] размер записи в байтах
+ * @param level [in] уровень записи
+ */
+static
+void emit_record(const char  *data,
+                 size_t       len,
+                 log_level_t  level)
+{
+    assert(data != NULL);
+
+    if (log_async_is_running())
+    {
+        (void)log_async_push(data, len, false, level);
+    }
+    else
+    {
+        write_output(data, len, level);
+    }
+}
+
+/**
+ * Передаёт сформированную запись в бортовой самописец (если уровень записи достаточен), затем
+ * на вывод (предварив ошибку предысторией потока) или в буфер предыстории потока.
+ *
+ * @param data     [in] запись (!= NULL)
+ * @param len      [in] размер записи в байтах
+ * @param level    [in] уровень записи
+ * @param dispatch [in] назначение записи.
+ */
+static
+void dispatch_record(const char     *data,
+                     size_t          len,
+                     log_level_t     level,
+                     log_dispatch_t  dispatch)
+{
+    assert(data != NULL);
+
+    if (log_ctx.flight && check_log_level(level, log_ctx.flight_level)) log_flight_record(data, len);
+    switch (dispatch)
+    {
+        case LOG_DISPATCH_OUTPUT:
+            if (log_ctx.backtrace && level >= LL_ERROR) log_backtrace_flush(emit_record, level);
+            emit_record(data, len, level);
+            break;
+        case LOG_DISPATCH_HIDDEN:
+            if (log_ctx.backtrace && check_log_level(level, log_ctx.backtrace_level)) log_backtrace_push(data, len, level);
+            break;
+        case LOG_DISPATCH_RECORDER:
+            break;
+    }
+}
+
+/**
+ * Возвращает время монотонных часов LOG_MONOTONIC_CLOCK. Не изменяет errno.
+ *
+ * @param ns [out] время в наносекундах (!= NULL)
+ * @return true - OK, false - часы недоступны.
+ */
+static
+bool get_monotonic_ns(uint64_t *ns)
+{
+    int saved_errno = errno;
+    struct timespec ts;
+
+    assert(ns != NULL);
+
+    if (clock_gettime(LOG_MONOTONIC_CLOCK, &ts) != 0)
+    {
+        errno = saved_errno;
+        return false;
+    }
+    *ns = (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
     return true;
 }
 
 /**
- * Регистрирует новый источник лога в системе логгирования.
- * Если заданный источник уже зерегистрирован, он перезаписывается.
+ * Продолжает вычисление хэша FNV-1a (64 бита).
  *
- * @param source        [in] источник лога (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
- * @param min_log_level [in] минимальный уровень выводимого лога (LL_NONE - отключает вывод).
- * @return true - OK, false - fail.
+ * @param hash [in] текущее значение хэша (LOG_FNV_OFFSET_BASIS - начало)
+ * @param data [in] данные (!= NULL)
+ * @param len  [in] размер данных в байтах
+ * @return новое значение хэша.
  */
-extern
-bool log_register(const char  *source,
-                  log_level_t  min_log_level)
+static
+uint64_t hash_bytes(uint64_t    hash,
+                    const char *data,
+                    size_t      len)
+{
+    assert(data != NULL);
+
+    while (len-- > 0)
+    {
+        hash = (hash ^ (unsigned char)*data++) * LOG_FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * Выводит итоговую строку "last message repeated N times", если у источника есть подавленные повторы.
+ * Вызывается под мьютексом подавления повторов источника.
+ *
+ * @param handle [in/out] дескриптор источника (!= NULL)
+ */
+static
+void emit_dedup_summary(log_source_t *handle)
+{
+    log_dedup_t *dedup;
+    char summary[256];
+    size_t len;
+
+    assert(handle != NULL);
+    assert(handle->dedup != NULL);
+
+    dedup = handle->dedup;
+    if (dedup->repeats == 0) return;
+    compose_log_prefix(summary, sizeof(summary), handle->source, dedup->file, dedup->line, dedup->function, dedup->level, NULL);
+    len = strlen(summary);
+    len += (size_t)snprintf(summary + len, sizeof(summary) - len, " | last message repeated %u times\n", (unsigned)dedup->repeats);
+    emit_record(summary, MIN(len, sizeof(summary) - 1), dedup->level);
+    dedup->repeats = 0;
+}
+
+/**
+ * Выводит запись с подавлением повторов: запись, совпадающая с предыдущей записью источника по уровню,
+ * точке логгирования и сообщению, в пределах окна только подсчитывается. Итоговая строка выводится
+ * перед следующей записью источника, не попавшей в серию (другой или после окончания окна),
+ * в log_flush() и log_destroy(); само окончание окна её не выводит.
+ *
+ * @param source      [in] источник (!= NULL)
+ * @param file        [in] имя файла (!= NULL)
+ * @param line        [in] номер строки в файле (!= NULL)
+ * @param function    [in] имя функции (!= NULL)
+ * @param level       [in] уровень записи
+ * @param data        [in] запись (!= NULL)
+ * @param len         [in] размер записи в байтах
+ * @param body_offset [in] смещение сообщения (после префикса) в записи
+ */
+static
+void emit_deduped(const char  *source,
+                  const char  *file,
+                  const char  *line,
+                  const char  *function,
+                  log_level_t  level,
+                  const char  *data,
+                  size_t       len,
+                  size_t       body_offset)
 {
-    bool result = false;
-    log_source_hm_elt_t *source_hm_elt = NULL;
-    log_source_hm_elt_t *existing = NULL;
+    log_source_t *handle;
+    log_dedup_t *dedup;
+    uint64_t callsite_hash;
+    uint64_t body_hash;
+    uint64_t now;
 
     assert(source != NULL);
+    assert(file != NULL);
+    assert(line != NULL);
+    assert(function != NULL);
+    assert(data != NULL);
+    assert(body_offset <= len);
 
-    /* проверка невалиндых параметров */
-    if ((min_log_level <= LL_INVALID) || (min_log_level >= LL_CNT)) return false;
-    if (log_ctx.initialized == false) return false;
-    /* проверка на длину источника */
-    if (strlen(source) > LOG_SRC_STORED_MAX_SIZE)
+    handle = find_src_handle(source);
+    if (handle == NULL || handle->dedup == NULL || !get_monotonic_ns(&now))
     {
-        return false;
+        emit_record(data, len, level);
+        return;
     }
-    lock_mutex_if_it_needs(&log_ctx);
-    /* если в хэше уже имеется данный источник */
-    HASH_FIND_STR(log_ctx.source_hm, source, existing);
-    if (existing)
+    /* хэши считаются до захвата мьютекса, под ним только сравнение */
+    callsite_hash = hash_bytes(hash_bytes(LOG_FNV_OFFSET_BASIS, file, strlen(file)), line, strlen(line));
+    body_hash = hash_bytes(LOG_FNV_OFFSET_BASIS, data + body_offset, len - body_offset);
+    dedup = handle->dedup;
+    if (log_ctx.use_mutex) MUTEX_CHECK_LOCK(&dedup->mutex);
+    if (dedup->active && dedup->level == level && dedup->callsite_hash == callsite_hash &&
+        dedup->body_hash == body_hash && now - dedup->start_ns < log_ctx.dedup_window_ns)
     {
-        /* скопировать источник в новый элемент */
-        existing->min_log_level = min_log_level;
-        result = true;
+        dedup->repeats++;
     }
     else
     {
-        /* выделить новый элемент */
-        source_hm_elt = calloc(1, sizeof(log_source_hm_elt_t));
-        if (source_hm_elt)
+        emit_dedup_summary(handle);
+        emit_record(data, len, level);
+        dedup->active = true;
+        dedup->level = level;
+        dedup->body_hash = body_hash;
+        dedup->start_ns = now;
+        if (dedup->callsite_hash != callsite_hash)
         {
-            /* скопировать источник в новый элемент */
-            strncpy(source_hm_elt->source, source, LOG_SRC_STORED_MAX_SIZE-1);
-            source_hm_elt->source[LOG_SRC_STORED_MAX_SIZE-1] = '\0'; // гарантированное NULL-териминирование
-            source_hm_elt->min_log_level = min_log_level;
-            HASH_ADD_STR(log_ctx.source_hm, source, source_hm_elt);
-            result = true;
+            dedup->callsite_hash = callsite_hash;
+            snprintf(dedup->file, sizeof(dedup->file), "%s", extract_file_name(file));
+            snprintf(dedup->line, sizeof(dedup->line), "%s", line);
+            snprintf(dedup->function, sizeof(dedup->function), "%s", function);
         }
     }
+    if (log_ctx.use_mutex) MUTEX_CHECK_UNLOCK(&dedup->mutex);
+}
+
+/**
+ * Выводит итоговые строки подавленных повторов всех источников.
+ */
+static
+void flush_dedup(void)
+{
+    size_t i;
+
+    if (log_ctx.dedup_window_ns == 0) return;
+    lock_mutex_if_it_needs(&log_ctx);
+    for (i = 0; log_ctx.handles_hm.hashes && i <= log_ctx.handles_hm.mask; i++)
+    {
+        log_source_t *handle = log_ctx.handles_hm.entries[i].handle;
+
+        if (!log_ctx.handles_hm.hashes[i] || handle->dedup == NULL) continue;
+        if (log_ctx.use_mutex) MUTEX_CHECK_LOCK(&handle->dedup->mutex);
+        emit_dedup_summary(handle);
+        if (log_ctx.use_mutex) MUTEX_CHECK_UNLOCK(&handle->dedup->mutex);
+    }
     unlock_mutex_if_it_needs(&log_ctx);
-    return result;
 }
 
 /**
- * Регистрирует новые источники лога в системе логгирования.
- * Если один из источников уже зерегистрирован, он перезаписывается.
- * @param descr      [in] Массив дескрипторов источника лога.
- * @param num_descrs [in] Количество элементов в массиве num_descrs.
- * @return true - OK, false - не удалось зарегистрировать хотябы 1 источник.
+ * Возвращает текущее время часов LOG_TIME_CLOCK.
+ *
+ * @param ts [out] время (!= NULL)
  */
-extern
-bool log_register_ex(const log_src_descr_t *descr,
-                     size_t                 num_descrs)
+static
+void get_current_time(struct timespec *ts)
+{
+    assert(ts != NULL);
+
+    if (clock_gettime(LOG_TIME_CLOCK, ts) != 0)
+    {
+        ts->tv_sec = time(NULL);
+        ts->tv_nsec = 0;
+    }
+}
+
+/**
+ * Выводит сформированные записи: в двоичный файл журнала, в приёмники с подходящим уровнем
+ * или, если приёмников нет, в stderr.
+ *
+ * @param data  [in] данные (!= NULL)
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void write_output(const char  *data,
+                  size_t       len,
+                  log_level_t  level)
+{
+    log_async_run_t run;
+
+    assert(data != NULL);
+
+    run.end = len;
+    run.level = level;
+    write_batch(data, &run, 1);
+}
+
+/**
+ * Сообщает, нужен ли при выводе мьютекс списка приёмников: в многопоточном режиме или
+ * при асинхронном выводе (фоновый поток выводит в приёмники, пока другие потоки изменяют
+ * список, уровни приёмников или сбрасывают их) приёмник не должен удаляться во время вывода.
+ *
+ * @return true - нужен, false - вывод и изменение списка выполняются одним потоком.
+ */
+static inline
+bool sinks_need_mutex(void)
+{
+    return log_ctx.use_mutex || log_async_is_running();
+}
+
+/**
+ * Выводит пачку сформированных записей: в двоичный файл журнала, в приёмники с подходящим уровнем
+ * или, если приёмников нет, в stderr. Каждый приёмник получает подряд идущие участки подходящего
+ * уровня одним вызовом.
+ *
+ * @param data     [in] данные (!= NULL), размер - runs[num_runs - 1].end байт
+ * @param runs     [in] участки записей одного уровня (!= NULL)
+ * @param num_runs [in] количество участков (> 0)
+ */
+static
+void write_batch(const char            *data,
+                 const log_async_run_t *runs,
+                 size_t                 num_runs)
 {
+    size_t len = runs[num_runs - 1].end;
+    bool locked;
     size_t i;
 
-    if (log_ctx.initialized == false) return false;
-    if (num_descrs && !descr) return false;
-    for (i = 0; i < num_descrs; i++)
+    assert(data != NULL);
+    assert(runs != NULL);
+    assert(num_runs > 0);
+
+    if (log_ctx.binary)
+    {
+        write_fd(log_ctx.binary_fd, data, len);
+        if (log_ctx.uring) log_uring_submit();
+        return;
+    }
+    /* запись формируется один раз и передаётся всем приёмникам; признак блокировки запоминается,
+     * т.к. log_async_stop() сбрасывает running, пока фоновый поток ещё выводит */
+    locked = sinks_need_mutex();
+    if (locked) MUTEX_CHECK_LOCK(&log_sinks.mutex);
+    if (log_sinks.num_sinks == 0) write_fd(STDERR_FILENO, data, len);
+    for (i = 0; i < log_sinks.num_sinks; i++)
     {
-        if (!log_register(descr[i].source, descr[i].min_log_level))
+        log_sink_t *sink = log_sinks.sinks[i];
+        size_t start = 0;           /* начало непрерывного отрезка подходящих участков */
+        size_t end = 0;             /* конец отрезка */
+        log_level_t level = LL_CNT; /* наименьший уровень записей отрезка */
+        size_t r;
+
+        for (r = 0; r < num_runs; r++)
         {
-            return false;
+            if (check_log_level(runs[r].level, sink->min_log_level))
+            {
+                if (runs[r].level < level) level = runs[r].level;
+                end = runs[r].end;
+                continue;
+            }
+            if (end > start) sink->ops.write(sink->ctx, data + start, end - start, level);
+            start = end = runs[r].end;
+            level = LL_CNT;
         }
+        if (end > start) sink->ops.write(sink->ctx, data + start, end - start, level);
     }
-    return true;
+    /* записи всех приёмников пачки отправляются одним вызовом, до возможного закрытия их дескрипторов */
+    if (log_ctx.uring) log_uring_submit();
+    if (locked) MUTEX_CHECK_UNLOCK(&log_sinks.mutex);
 }
 
 /**
- * Удаляет регистрацию источника (если зарегистрирован) в системе логгирования.
+ * Выводит данные в файловый дескриптор одним вызовом write(2) (повторяя его только при частичной записи).
+ * Пачки фонового потока при доступном io_uring ставятся в очередь, их отправляет write_batch().
  *
- * @param source [in] источник лога (!= NULL)
+ * @param fd   [in] файловый дескриптор
+ * @param data [in] данные (!= NULL)
+ * @param len  [in] размер данных в байтах
  */
-extern
-void log_unregister(const char *source)
+static
+void write_fd(int         fd,
+              const char *data,
+              size_t      len)
 {
-    log_source_hm_elt_t *elt = NULL;
+    assert(data != NULL);
+
+    /* пока запущен асинхронный вывод, write_batch() вызывается только фоновым потоком */
+    if (log_ctx.uring && log_uring_write(fd, data, len)) return;
+
+    while (len > 0)
+    {
+        ssize_t res = write(fd, data, len);
 
+        if (res < 0)
+        {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += res;
+        len -= (size_t)res;
+    }
+}
+
+/**
+ * Логгирует RAW буфер.
+ * Печатает prefix и время перед логом.
+ *
+ * @param source   [in] источник (строка - источника лога) (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
+ * @param file     [in] имя файла  (максимальная длина LOG_FUNCTION_NAME_MAX_SIZE).
+ * @param line     [in] номер строки в файле
+ * @param function [in] имя функции (максимальная длина LOG_FILE_NAME_MAX_SIZE).
+ * @param buffer   [in] указатель на буфер (может быть NULL)
+ * @param length   [in] размер буфера в байтах
+ */
+extern
+void log_raw(const char *source,
+             const char *file,
+             const char *line,
+             const char *function,
+             const void *buffer,
+             size_t      length)
+{
     assert(source != NULL);
+    assert(file != NULL);
+    assert(line != NULL);
+    assert(function != NULL);
 
     if (log_ctx.initialized == false) return;
-    lock_mutex_if_it_needs(&log_ctx);
-    HASH_FIND_STR(log_ctx.source_hm, source, elt);
-    if (elt)
+    if (is_log_allowed(source, LL_RAW))
     {
-        HASH_DEL(log_ctx.source_hm, elt);
-        free(elt);
+        write_raw(source, file, line, function, buffer, length, LOG_DISPATCH_OUTPUT);
+    }
+    else if (is_log_recorded(source, LL_RAW))
+    {
+        write_raw(source, file, line, function, buffer, length, LOG_DISPATCH_HIDDEN);
     }
-    unlock_mutex_if_it_needs(&log_ctx);
 }
 
 /**
- * Удаляет регистрацию всех источников в системе логгирования.
+ * Логгирует RAW буфер от имени дескриптора источника (без поиска источника по строке).
+ * Печатает prefix и время перед логом.
  *
- * @return true - OK, false -Fail
+ * @param source   [in] дескриптор источника (!= NULL)
+ * @param file     [in] имя файла  (максимальная длина LOG_FUNCTION_NAME_MAX_SIZE).
+ * @param line     [in] номер строки в файле
+ * @param function [in] имя функции (максимальная длина LOG_FILE_NAME_MAX_SIZE).
+ * @param buffer   [in] указатель на буфер (может быть NULL)
+ * @param length   [in] размер буфера в байтах
  */
 extern
-bool log_destroy()
+void log_raw_h(const log_source_t *source,
+               const char         *file,
+               const char         *line,
+               const char         *function,
+               const void         *buffer,
+               size_t              length)
 {
-    log_source_hm_elt_t *elt = NULL, *tmp = NULL;
+    assert(source != NULL);
+    assert(file != NULL);
+    assert(line != NULL);
+    assert(function != NULL);
 
-    if (log_ctx.initialized)
+    if (log_ctx.initialized == false) return;
+    if (check_log_level(LL_RAW, get_handle_effective_level(source)))
     {
-        lock_mutex_if_it_needs(&log_ctx);
-        HASH_ITER(hh, log_ctx.source_hm, elt, tmp)
-        {
-            HASH_DEL(log_ctx.source_hm, elt);
-            free(elt);
-        }
-        log_ctx.source_hm = NULL;
-        if (log_ctx.use_mutex)
-        {
-            MUTEX_CHECK_UNLOCK(&log_ctx.mutex);
-            if (pthread_mutex_destroy(&(log_ctx.mutex)) != 0)
-            {
-                return false;
-            }
-        }
+        write_raw(source->source, file, line, function, buffer, length, LOG_DISPATCH_OUTPUT);
+    }
+    else if (is_handle_recorded(source, LL_RAW))
+    {
+        write_raw(source->source, file, line, function, buffer, length, LOG_DISPATCH_HIDDEN);
     }
-    return true;
 }
 
 /**
- * Логгирует в стиле printf.
- * Печатает prefix и время перед логом.
+ * Логгирует из обработчика сигнала (в том числе аварийного, когда другой поток держит мьютекс логгера).
+ * Не выделяет память и не берёт блокировок: запись формируется на стеке минимальным форматтером
+ * (целые, hex, указатели, строки, символы) и выводится одним вызовом write(2) в log_config_t.signal_safe_fd
+ * мимо асинхронного кольца и приёмников, а также сохраняется в бортовой самописец.
+ * Запись длиннее LOG_SIGNAL_RECORD_MAX_SIZE обрезается. Не изменяет errno.
  *
  * @param source    [in] источник (строка - источника лога) (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
  * @param file      [in] имя файла (максимальная длина LOG_FUNCTION_NAME_MAX_SIZE).
@@ -650,13 +2957,19 @@ bool log_destroy()
  * @param fmt       [in] (!= NULL).
  */
 extern
-void log_log(const char  *source,
-             const char  *file,
-             const char  *line,
-             const char  *function,
-             log_level_t  log_level,
-             const char  *fmt, ...)
+void log_log_signal_safe(const char  *source,
+                         const char  *file,
+                         const char  *line,
+                         const char  *function,
+                         log_level_t  log_level,
+                         const char  *fmt, ...)
 {
+    char record[LOG_SIGNAL_RECORD_MAX_SIZE];
+    int saved_errno = errno;
+    bool output;
+    size_t len = 0;
+    va_list args;
+
     assert(source != NULL);
     assert(file != NULL);
     assert(line != NULL);
@@ -666,155 +2979,113 @@ void log_log(const char  *source,
     assert(fmt != NULL);
 
     if (log_ctx.initialized == false) return;
-    lock_mutex_if_it_needs(&log_ctx);
-    if (is_log_allowed(source, log_level))
-    {
-        char prefix[128];
-        va_list args;
-
-        snprintf(log_ctx.log_buf,
-                 sizeof(log_ctx.log_buf),
-                 "%s | %s\n",
-                 compose_log_prefix(prefix, sizeof(prefix), source, file, line, function, log_level),
-                 fmt);
-        va_start(args, fmt);
-        vfprintf(stderr, log_ctx.log_buf, args);
-        va_end(args);
-    }
-    unlock_mutex_if_it_needs(&log_ctx);
-}
-
-/**
- * Производит hexdump буфера в строку (без символа перевода строки). Максимальная длина дампа - 16 байт
- *
- * @param buf_in      [in]  буфер, дамп котогого требуется сделать (!= NULL)
- * @param buf_in_size [in]  размер буфера в байтах
- * @param offset      [in]  смещение в буфере (байты / 16)
- * @param buf_out     [out] результирующий текстовый буфер с дампом строки. Минимальный размер - 100 байт (!= NULL)
- */
-static
-void compose_hexdump_line(const void *buf_in,
-                          size_t      buf_in_size,
-                          size_t      offset,
-                          char       *buf_out)
-{
-    size_t i, j;
-    size_t limit;
-
-    const unsigned char *ptr = (const unsigned char *)buf_in;
-    const char *cptr = (const char *)buf_in;
-
-    assert(buf_in != NULL);
-    assert(buf_out != NULL);
-
-    ptr += offset*16;
-    cptr += offset*16;
-
-    sprintf(buf_out,"%."STRX(LOG_RAW_ADDR_FIELD_WIDTH)"zX  ", offset*16);
-    buf_out += LOG_RAW_ADDR_FIELD_WIDTH + 2;
-
-    /* если до конца буфера еще > 16 байт */
-    if ((buf_in_size - (offset*16)) > 16)
-    {
-        limit = 16;
-    }
-    else
-    {
-        limit = buf_in_size - (offset*16);
-    }
-    /* HEX представления байт */
-    for (i = 0 ; i < limit; i++)
-    {
-        sprintf(buf_out," %.2hhX",*ptr);
-        ptr++;
-        buf_out+= 3;
-    }
-    /* добиваем оставшуюся часть (если есть) пробелами */
-    for (j = i ; j < 16; j++)
+    /* поиск источника выполняется без блокировок (см. src_hm_read_begin()) */
+    output = is_log_allowed(source, log_level);
+    if (!output && !is_log_recorded(source, log_level)) return;
+    #if DO_LOG_CURRENT_TIME
     {
-        buf_out[0] = ' ';
-        buf_out[1] = ' ';
-        buf_out[2] = ' ';
-        ptr++;
-        buf_out+= 3;
-    }
-    buf_out[0] = ' ';
-    buf_out[1] = '|';
-    buf_out[2] = ' ';
-    buf_out+= 3;
+        struct timespec now;
 
-    /* текстовое представление байт */
-    for (i = 0 ; i < limit; i++)
-    {
-        *buf_out = (char)(isprint(*cptr) ? (*cptr) : '.');
-        cptr++;
-        buf_out++;
+        get_current_time(&now);
+        len += log_sig_format_time(record, sizeof(record) - 1, &now, log_ctx.utc_offset);
+        record[len++] = ':';
     }
-    /* не добиваем пробелами текстовое представление, так как это последний элемент строки */
-    #if 0
-    for (j = i ; j < 16; j++)
+    #endif
+    UNUSED_PARAM(function);
+    len += log_sig_format(record + len,
+                          sizeof(record) - 1 - len,
+                          "[%-1.1s][%-"STRX(LOG_SRC_MAX_SIZE)"."STRX(LOG_SRC_MAX_SIZE)"s][%-"STRX(LOG_FILE_NAME_MAX_SIZE)"."STRX(LOG_FILE_NAME_MAX_SIZE)"s:%5s]"
+                          #if DO_LOG_FUNCTION_NAME
+                          " in %-"STRX(LOG_FUNCTION_NAME_MAX_SIZE)"."STRX(LOG_FUNCTION_NAME_MAX_SIZE)"s()"
+                          #endif
+                          " | ",
+                          log_level_map[log_level],
+                          source,
+                          extract_file_name(file),
+                          #if DO_LOG_FUNCTION_NAME
+                          line,
+                          function);
+                          #else
+                          line);
+                          #endif
+    va_start(args, fmt);
+    len += log_sig_vformat(record + len, sizeof(record) - 1 - len, fmt, args);
+    va_end(args);
+    record[len++] = '\n';
+    if (log_ctx.flight && check_log_level(log_level, log_ctx.flight_level)) log_flight_record(record, len);
+    if (output)
     {
-        *buf_out = ' ';
-        cptr++;
-        buf_out++;
+        while (write(log_ctx.signal_fd, record, len) < 0 && errno == EINTR);
     }
-    #endif
-    *buf_out = 0;
-    assert(strlen(buf_out) < 100);
+    errno = saved_errno;
 }
 
 /**
- * Логгирует RAW буфер.
- * Печатает prefix и время перед логом.
+ * Формирует hexdump RAW буфера (уровень уже проверен), выводит его и сохраняет в бортовой самописец.
  *
- * @param source   [in] источник (строка - источника лога) (максимальная длина LOG_SRC_MAX_SIZE остальное обрезается) (!= NULL)
- * @param file     [in] имя файла  (максимальная длина LOG_FUNCTION_NAME_MAX_SIZE).
+ * @param source   [in] источник (строка - источника лога) (!= NULL)
+ * @param file     [in] имя файла.
  * @param line     [in] номер строки в файле
- * @param function [in] имя функции (максимальная длина LOG_FILE_NAME_MAX_SIZE).
+ * @param function [in] имя функции.
  * @param buffer   [in] указатель на буфер (может быть NULL)
  * @param length   [in] размер буфера в байтах
+ * @param dispatch [in] назначение записи.
  */
-extern
-void log_raw(const char *source,
-             const char *file,
-             const char *line,
-             const char *function,
-             const void *buffer,
-             size_t      length)
+static
+void write_raw(const char     *source,
+               const char     *file,
+               const char     *line,
+               const char     *function,
+               const void     *buffer,
+               size_t          length,
+               log_dispatch_t  dispatch)
 {
-    size_t i = 0;
-    char hexdump_line[100];
-
-    assert(source != NULL);
-    assert(file != NULL);
-    assert(line != NULL);
-    assert(function != NULL);
+    size_t line_idx = 0;
+    size_t len;
+    char prefix[128];
+    char *buf = tls_record_buf;
+    size_t buf_size = sizeof(tls_record_buf);
+    size_t need_size;
+
+    compose_log_prefix(prefix, sizeof(prefix), source, file, line, function, LL_RAW, NULL);
+    /* весь дамп формируется одной записью; если он не помещается в буфер потока - в буфере из кучи */
+    need_size = strlen(prefix) + 1 + (buffer ? (length + 15) / 16 * LOG_HEXDUMP_LINE_MAX_SIZE : sizeof("NULL\n"));
+    if (need_size > buf_size)
+    {
+        char *heap_buf = malloc(need_size);
 
-    if (log_ctx.initialized == false) return;
-    lock_mutex_if_it_needs(&log_ctx);
-    if (is_log_allowed(source, LL_RAW))
+        if (heap_buf)
+        {
+            buf = heap_buf;
+            buf_size = need_size;
+        }
+    }
+    len = (size_t)snprintf(buf, buf_size, "%s\n", prefix);
+    if (buffer)
     {
-        char prefix[128];
+        size_t num_lines = (length + 15) / 16;
 
-        snprintf(log_ctx.log_buf,
-                 sizeof(log_ctx.log_buf),
-                 "%s\n",
-                 compose_log_prefix(prefix, sizeof(prefix), source, file, line, function, LL_RAW));
-        fprintf(stderr,"%s",log_ctx.log_buf);
-        if (buffer)
+        while (line_idx < num_lines)
         {
-            for (i = 0; i < length; i+=16)
+            size_t chunk_lines = MIN(num_lines - line_idx, (buf_size - len) / LOG_HEXDUMP_LINE_MAX_SIZE);
+
+            if (chunk_lines == 0)
             {
-                compose_hexdump_line(buffer, length, i/16, hexdump_line);
-                fprintf(stderr,"%s\n",hexdump_line);
+                /* не хватило памяти под весь дамп: он выводится частями, между которыми могут оказаться записи других потоков */
+                dispatch_record(buf, len, LL_RAW, dispatch);
+                len = 0;
+                continue;
             }
-        }
-        else
-        {
-            fprintf(stderr,"NULL\n");
+            len += log_hexdump(buf + len, buffer, length, line_idx, chunk_lines);
+            line_idx += chunk_lines;
         }
     }
-    unlock_mutex_if_it_needs(&log_ctx);
+    else
+    {
+        len += (size_t)snprintf(buf + len, buf_size - len, "NULL\n");
+    }
+    dispatch_record(buf, len, LL_RAW, dispatch);
+    if (buf != tls_record_buf) free(buf);
 }
 
 /**
@@ -871,11 +3142,47 @@ bool log_will_be_printed(const char  *source,
 {
     assert(source != NULL);
 
-    bool res = false;
-    lock_mutex_if_it_needs(&log_ctx);
-    res = is_log_allowed(source, log_level);
-    unlock_mutex_if_it_needs(&log_ctx);
-    return res;
+    return is_log_allowed(source, log_level);
+}
+
+/**
+ * Сообщает будет ли выведен лог от дескриптора источника с данным уровнем.
+ *
+ * @param source    [in] дескриптор источника (!= NULL)
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ *
+ * @return true - будет выведен, false - не будет.
+ */
+extern
+bool log_will_be_printed_h(const log_source_t *source,
+                           log_level_t         log_level)
+{
+    assert(source != NULL);
+
+    if (log_ctx.initialized == false) return false;
+    return check_log_level(log_level, get_handle_effective_level(source));
+}
+
+/**
+ * Сообщает, будет ли сформирован лог от дескриптора источника с данным уровнем:
+ * выведен или сохранён бортовым самописцем, с учётом сэмплирования источника (используется макросами _LOG_H_*).
+ *
+ * @param source    [in] дескриптор источника (!= NULL)
+ * @param log_level [in] уровень выводимого лога (LL_INVALID < log_level < LL_CNT).
+ *
+ * @return true - будет сформирован, false - не будет.
+ */
+extern
+bool log_will_be_formed_h(const log_source_t *source,
+                          log_level_t         log_level)
+{
+    assert(source != NULL);
+
+    if (log_ctx.initialized == false) return false;
+    if (!check_log_level(log_level, get_handle_effective_level(source)) && !is_handle_recorded(source, log_level)) return false;
+    /* сэмплирование - до вычисления аргументов макроса */
+    return (log_level >= __atomic_load_n(&source->sample_level, __ATOMIC_RELAXED) ||
+            log_sample_draw() < __atomic_load_n(&source->sample_threshold, __ATOMIC_RELAXED));
 }
 
 /**
@@ -889,16 +3196,9 @@ extern
 log_level_t log_get_src_level(const char *source)
 {
     assert(source != NULL);
-    log_source_hm_elt_t *elt = NULL;
-    lock_mutex_if_it_needs(&log_ctx);
-    /* найти в Хэше соответствующий источник */
-    HASH_FIND_STR(log_ctx.source_hm, source, elt);
-    log_level_t res = LL_INVALID;
-    if (elt)
-    {
-        res =  elt->min_log_level;
-    }
-    unlock_mutex_if_it_needs(&log_ctx);
+    log_level_t res = find_src_level(source);
+    /* источник не зарегистрирован или удалён между поиском и чтением уровня */
+    if (res == LL_CNT) res = LL_INVALID;
     return res;
 }
 
@@ -910,11 +3210,258 @@ log_level_t log_get_src_level(const char *source)
 extern
 log_level_t log_get_global_level(void)
 {
-    log_level_t res;
-    lock_mutex_if_it_needs(&log_ctx);
-    res = log_ctx.min_log_level;
-    unlock_mutex_if_it_needs(&log_ctx);
-    return res;
+    return __atomic_load_n(&log_ctx.min_log_level, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Добавляет приёмник записей лога. Каждая сформированная запись один раз передаётся всем приёмникам,
+ * минимальный уровень которых не выше уровня записи.
+ * Пока не добавлено ни одного приёмника, записи выводятся в stderr.
+ * Приёмники можно добавлять до log_init(), log_destroy() закрывает и удаляет все приёмники.
+ * В режиме binary_path записи выводятся в двоичный файл, а не в приёмники.
+ *
+ * @param ops           [in] операции приёмника (копируются) (!= NULL, ops->write != NULL).
+ * @param ctx           [in] контекст, передаваемый операциям.
+ * @param min_log_level [in] минимальный уровень записей для приёмника (LL_NONE - не выводить).
+ * @return приёмник или NULL в случае ошибки.
+ */
+extern
+log_sink_t *log_sink_add(const log_sink_ops_t *ops,
+                         void                 *ctx,
+                         log_level_t           min_log_level)
+{
+    log_sink_t *sink;
+
+    assert(ops != NULL);
+
+    if (ops->write == NULL) return NULL;
+    if ((min_log_level <= LL_INVALID) || (min_log_level >= LL_CNT)) return NULL;
+    sink = calloc(1, sizeof(*sink));
+    if (sink == NULL) return NULL;
+    sink->ops = *ops;
+    sink->ctx = ctx;
+    sink->min_log_level = min_log_level;
+    MUTEX_CHECK_LOCK(&log_sinks.mutex);
+    if (log_sinks.num_sinks == LOG_MAX_SINKS)
+    {
+        MUTEX_CHECK_UNLOCK(&log_sinks.mutex);
+        free(sink);
+        return NULL;
+    }
+    log_sinks.sinks[log_sinks.num_sinks++] = sink;
+    MUTEX_CHECK_UNLOCK(&log_sinks.mutex);
+    return sink;
+}
+
+/**
+ * Добавляет приёмник, выводящий записи в файловый дескриптор (дескриптор не закрывается).
+ *
+ * @param fd            [in] файловый дескриптор (>= 0).
+ * @param min_log_level [in] минимальный уровень записей для приёмника.
+ * @return приёмник или NULL в случае ошибки.
+ */
+extern
+log_sink_t *log_sink_add_fd(int         fd,
+                            log_level_t min_log_level)
+{
+    if (fd < 0) return NULL;
+    return add_fd_sink(fd, false, min_log_level);
+}
+
+/**
+ * Добавляет приёмник, дописывающий записи в файл (файл создаётся при необходимости и закрывается при удалении приёмника).
+ *
+ * @param path          [in] путь к файлу (!= NULL).
+ * @param min_log_level [in] минимальный уровень записей для приёмника.
+ * @return приёмник или NULL в случае ошибки.
+ */
+extern
+log_sink_t *log_sink_add_file(const char  *path,
+                              log_level_t  min_log_level)
+{
+    log_sink_t *sink;
+    int fd;
+
+    assert(path != NULL);
+
+    fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return NULL;
+    sink = add_fd_sink(fd, true, min_log_level);
+    if (sink == NULL) close(fd);
+    return sink;
+}
+
+/**
+ * Добавляет приёмник, передающий пачки записей функции пользователя.
+ *
+ * @param callback      [in] функция вывода пачки записей (!= NULL).
+ * @param arg           [in] аргумент функции.
+ * @param min_log_level [in] минимальный уровень записей для приёмника.
+ * @return приёмник или NULL в случае ошибки.
+ */
+extern
+log_sink_t *log_sink_add_callback(void        (*callback)(void *arg, const char *data, size_t len, log_level_t level),
+                                  void         *arg,
+                                  log_level_t   min_log_level)
+{
+    log_sink_ops_t ops;
+
+    assert(callback != NULL);
+
+    ZEROIZE_STRUCT(ops);
+    ops.write = callback;
+    return log_sink_add(&ops, arg, min_log_level);
+}
+
+/**
+ * Изменяет минимальный уровень записей для приёмника.
+ *
+ * @param sink          [in/out] приёмник (!= NULL).
+ * @param min_log_level [in] минимальный уровень записей для приёмника.
+ * @return true - OK, false - Fail
+ */
+extern
+bool log_sink_set_level(log_sink_t  *sink,
+                        log_level_t  min_log_level)
+{
+    assert(sink != NULL);
+
+    if ((min_log_level <= LL_INVALID) || (min_log_level >= LL_CNT)) return false;
+    MUTEX_CHECK_LOCK(&log_sinks.mutex);
+    sink->min_log_level = min_log_level;
+    MUTEX_CHECK_UNLOCK(&log_sinks.mutex);
+    return true;
+}
+
+/**
+ * Удаляет приёмник (вызывая его операции flush и close).
+ *
+ * @param sink [in] приёмник (!= NULL).
+ * @return true - OK, false - приёмник не найден.
+ */
+extern
+bool log_sink_remove(log_sink_t *sink)
+{
+    size_t i;
+    bool found = false;
+
+    assert(sink != NULL);
+
+    MUTEX_CHECK_LOCK(&log_sinks.mutex);
+    for (i = 0; i < log_sinks.num_sinks; i++)
+    {
+        if (log_sinks.sinks[i] == sink)
+        {
+            /* порядок вывода в оставшиеся приёмники сохраняется */
+            memmove(&log_sinks.sinks[i], &log_sinks.sinks[i + 1], (log_sinks.num_sinks - i - 1) * sizeof(sink));
+            log_sinks.num_sinks--;
+            destroy_sink(sink);
+            found = true;
+            break;
+        }
+    }
+    MUTEX_CHECK_UNLOCK(&log_sinks.mutex);
+    return found;
+}
+
+/**
+ * Сбрасывает буферы всех приёмников. В асинхронном режиме предварительно дожидается
+ * вывода записей, помещённых в кольцо до вызова.
+ */
+extern
+void log_flush(void)
+{
+    size_t i;
+
+    if (log_ctx.initialized) flush_dedup();
+    log_async_flush();
+    MUTEX_CHECK_LOCK(&log_sinks.mutex);
+    for (i = 0; i < log_sinks.num_sinks; i++)
+    {
+        log_sink_t *sink = log_sinks.sinks[i];
+
+        if (sink->ops.flush) sink->ops.flush(sink->ctx);
+    }
+    MUTEX_CHECK_UNLOCK(&log_sinks.mutex);
+}
+
+/**
+ * Операция write приёмника, выводящего в файловый дескриптор.
+ *
+ * @param ctx   [in] контекст (log_fd_sink_t *) (!= NULL)
+ * @param data  [in] данные (!= NULL)
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей (не используется)
+ */
+static
+void fd_sink_write(void        *ctx,
+                   const char  *data,
+                   size_t       len,
+                   log_level_t  level)
+{
+    assert(ctx != NULL);
+
+    UNUSED_PARAM(level);
+    write_fd(((log_fd_sink_t *)ctx)->fd, data, len);
+}
+
+/**
+ * Операция close приёмника, выводящего в файловый дескриптор.
+ *
+ * @param ctx [in] контекст (log_fd_sink_t *) (!= NULL)
+ */
+static
+void fd_sink_close(void *ctx)
+{
+    log_fd_sink_t *fd_sink = (log_fd_sink_t *)ctx;
+
+    assert(ctx != NULL);
+
+    if (fd_sink->owned) close(fd_sink->fd);
+    free(fd_sink);
+}
+
+/**
+ * Добавляет приёмник, выводящий в файловый дескриптор.
+ *
+ * @param fd            [in] файловый дескриптор
+ * @param owned         [in] закрывать дескриптор при удалении приёмника
+ * @param min_log_level [in] минимальный уровень записей для приёмника
+ * @return приёмник или NULL в случае ошибки.
+ */
+static
+log_sink_t *add_fd_sink(int         fd,
+                        bool        owned,
+                        log_level_t min_log_level)
+{
+    log_fd_sink_t *fd_sink = malloc(sizeof(*fd_sink));
+    log_sink_ops_t ops;
+    log_sink_t *sink;
+
+    if (fd_sink == NULL) return NULL;
+    fd_sink->fd = fd;
+    fd_sink->owned = owned;
+    ZEROIZE_STRUCT(ops);
+    ops.write = fd_sink_write;
+    ops.close = fd_sink_close;
+    sink = log_sink_add(&ops, fd_sink, min_log_level);
+    if (sink == NULL) free(fd_sink);
+    return sink;
+}
+
+/**
+ * Сбрасывает буферы, закрывает и освобождает приёмник (вызывается под мьютексом приёмников).
+ *
+ * @param sink [in] приёмник (!= NULL)
+ */
+static
+void destroy_sink(log_sink_t *sink)
+{
+    assert(sink != NULL);
+
+    if (sink->ops.flush) sink->ops.flush(sink->ctx);
+    if (sink->ops.close) sink->ops.close(sink->ctx);
+    free(sink);
 }
 
 /**
@@ -929,7 +3476,9 @@ log_src_dump_t *log_src_dump()
     log_src_dump_t *res = NULL;
     if (!log_ctx.initialized) return NULL;
     lock_mutex_if_it_needs(&log_ctx);
-    size_t sz = HASH_COUNT(log_ctx.source_hm);
+    /* под мьютексом писателей активная копия хранилища не изменяется */
+    const log_src_table_t *hm = &log_ctx.source_hm[log_ctx.active_hm];
+    size_t sz = hm->count;
     res = malloc(sizeof(log_src_dump_t) + sz*sizeof(log_src_descr_t));
     if (!res)
     {
@@ -938,12 +3487,16 @@ log_src_dump_t *log_src_dump()
     }
     res->global_level = log_ctx.min_log_level;
     res->num_log_src_descr = sz;
-    const log_source_hm_elt_t *elt = log_ctx.source_hm;
-    for (size_t i = 0 ; i < sz && elt ; i++)
+    for (size_t i = 0, n = 0 ; hm->hashes && i <= hm->mask ; i++)
     {
-        res->log_src_descrs[i].source        = elt->source;
-        res->log_src_descrs[i].min_log_level = elt->min_log_level;
-        elt = elt->hh.next;
+        const log_source_t *handle = hm->entries[i].handle;
+
+        if (!hm->hashes[i]) continue;
+        res->log_src_descrs[n].source        = handle->source;
+        res->log_src_descrs[n].min_log_level = handle->min_log_level;
+        res->log_src_descrs[n].sample_level  = handle->sample_level;
+        res->log_src_descrs[n].sample_ratio  = handle->sample_ratio;
+        n++;
     }
     unlock_mutex_if_it_needs(&log_ctx);
     return res;
@@ -0,0 +1,702 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define _LOG_SRC "UNKNOWN"
+#include "log.h"
+#include "log_async.h"
+
+/**
+ * Размер кеш-линии
+ */
+#define LOG_ASYNC_CACHE_LINE_SIZE 64
+
+/**
+ * Ячейка кольца.
+ * Кольцо - ограниченная очередь Д. Вьюкова: номер поколения ячейки сообщает,
+ * свободна ли она для производителя с данной позицией или заполнена для потребителя.
+ */
+typedef struct tag_log_async_cell
+{
+    uint64_t  seq;    /*!< номер поколения ячейки */
+    size_t    len;    /*!< размер записи в байтах */
+    bool      binary; /*!< двоичная запись (преобразуется в текст функцией render_fn) */
+    uint8_t   level;  /*!< уровень записи */
+    char     *heap;   /*!< запись в куче (если не поместилась в ячейку), иначе NULL */
+    char      data[]; /*!< запись (record_size байт) */
+}
+log_async_cell_t;
+
+/**
+ * Контекст асинхронного вывода
+ */
+typedef struct tag_log_async
+{
+    bool             running;     /*!< фоновый поток запущен */
+    bool             stop;        /*!< запрос остановки фонового потока */
+    bool             drain;       /*!< вывести оставшиеся записи при остановке */
+    log_async_cfg_t  cfg;         /*!< параметры */
+    size_t           cell_stride; /*!< размер ячейки вместе с данными и выравниванием */
+    char            *cells;       /*!< массив ячеек */
+    pthread_t        thread;      /*!< фоновый поток */
+    pthread_mutex_t  wait_mutex;  /*!< мьютекс ожидания фонового потока и log_async_flush() */
+    pthread_cond_t   wake_cond;   /*!< пробуждение фонового потока: в кольце появились записи или запрошена остановка */
+    pthread_cond_t   done_cond;   /*!< оповещение log_async_flush() о продвижении done_pos */
+    uint64_t         done_pos;    /*!< позиция, до которой записи выведены (под wait_mutex) */
+    unsigned         flush_waiters; /*!< количество потоков, ожидающих в log_async_flush() */
+    bool             sleeping    __attribute__((aligned(LOG_ASYNC_CACHE_LINE_SIZE))); /*!< фоновый поток ждёт записей на wake_cond */
+    uint64_t         enqueue_pos __attribute__((aligned(LOG_ASYNC_CACHE_LINE_SIZE))); /*!< позиция производителей */
+    unsigned         producers   __attribute__((aligned(LOG_ASYNC_CACHE_LINE_SIZE))); /*!< количество производителей внутри log_async_push */
+    uint64_t         dropped     __attribute__((aligned(LOG_ASYNC_CACHE_LINE_SIZE))); /*!< количество отброшенных записей */
+    uint64_t         dequeue_pos __attribute__((aligned(LOG_ASYNC_CACHE_LINE_SIZE))); /*!< позиция потребителя */
+    size_t           batch_len;   /*!< заполненный размер пачки */
+    size_t           num_runs;    /*!< количество участков записей одного уровня в пачке */
+    log_async_run_t  runs[LOG_ASYNC_MAX_RUNS]; /*!< участки записей одного уровня в пачке */
+    unsigned         batch_idx;   /*!< индекс заполняемого буфера пачки */
+    char             batch[LOG_ASYNC_NUM_BATCHES][LOG_ASYNC_BATCH_SIZE]; /*!< буферы пачек: пока выводится одна, заполняется другая */
+}
+log_async_t;
+
+static
+log_async_t log_async; ///< глобальный контекст асинхронного вывода.
+
+/**
+ * Возвращает ячейку кольца по позиции.
+ *
+ * @param pos [in] позиция
+ * @return ячейка
+ */
+static inline
+log_async_cell_t *get_cell(uint64_t pos) __attribute__((warn_unused_result));
+
+/**
+ * Извлекает из кольца все готовые записи и выводит их пачками.
+ *
+ * @param write [in] true - выводить записи, false - отбрасывать.
+ * @return количество извлечённых записей.
+ */
+static
+size_t drain_ring(bool write);
+
+/**
+ * Выводит накопленную пачку записей.
+ */
+static
+void flush_batch(void);
+
+/**
+ * Готовит пачку к добавлению записи: выводит её, если запись не помещается
+ * или (при track_levels) для участка нового уровня нет места.
+ *
+ * @param size  [in] размер добавляемых данных в байтах
+ * @param level [in] уровень записи
+ */
+static
+void reserve_batch(size_t      size,
+                   log_level_t level);
+
+/**
+ * Учитывает добавленную в пачку запись: продлевает последний участок или начинает новый.
+ *
+ * @param len   [in] размер добавленных данных в байтах
+ * @param level [in] уровень записи
+ */
+static
+void commit_batch(size_t      len,
+                  log_level_t level);
+
+/**
+ * Выводит данные одним участком мимо пачки.
+ *
+ * @param data  [in] данные (!= NULL)
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записи
+ */
+static
+void write_direct(const char  *data,
+                  size_t       len,
+                  log_level_t  level) __attribute__((nonnull(1)));
+
+/**
+ * Добавляет текстовую запись (с заголовком frame_fn, если он задан) в пачку,
+ * выводя пачку, если запись в неё не помещается.
+ *
+ * @param data  [in] запись (!= NULL)
+ * @param len   [in] размер записи в байтах
+ * @param level [in] уровень записи
+ */
+static
+void put_text(const char  *data,
+              size_t       len,
+              log_level_t  level) __attribute__((nonnull(1)));
+
+/**
+ * Выводит сообщение о количестве отброшенных записей, если таковые были.
+ */
+static
+void report_dropped(void);
+
+/**
+ * Дожидается завершения вывода извлечённых записей и сообщает потокам в log_async_flush(),
+ * что записи до позиции pos выведены.
+ *
+ * @param pos [in] позиция, до которой записи выведены
+ */
+static
+void publish_done(uint64_t pos);
+
+/**
+ * Усыпляет фоновый поток, пока в кольце нет готовых записей и не запрошена остановка
+ * (не дольше flush_interval_ms).
+ */
+static
+void wait_for_records(void);
+
+/**
+ * Будит фоновый поток, ожидающий записей.
+ */
+static
+void wake_writer(void);
+
+/**
+ * Освобождает мьютекс и условные переменные ожидания.
+ */
+static
+void destroy_wait_objects(void);
+
+/**
+ * Тело фонового потока вывода.
+ *
+ * @param arg [in] не используется.
+ * @return NULL
+ */
+static
+void *writer_thread(void *arg);
+
+/**
+ * Возвращает ячейку кольца по позиции.
+ *
+ * @param pos [in] позиция
+ * @return ячейка
+ */
+static inline
+log_async_cell_t *get_cell(uint64_t pos)
+{
+    return (log_async_cell_t *)(log_async.cells + (size_t)(pos & (log_async.cfg.ring_size - 1)) * log_async.cell_stride);
+}
+
+/**
+ * Извлекает из кольца все готовые записи и выводит их пачками.
+ *
+ * @param write [in] true - выводить записи, false - отбрасывать.
+ * @return количество извлечённых записей.
+ */
+static
+size_t drain_ring(bool write)
+{
+    size_t count = 0;
+
+    /* не больше одного оборота кольца за вызов, чтобы своевременно сообщать об отброшенных записях */
+    while (count < log_async.cfg.ring_size)
+    {
+        uint64_t pos = log_async.dequeue_pos;
+        log_async_cell_t *cell = get_cell(pos);
+        const char *data;
+
+        if (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) != pos + 1) break;
+        data = cell->heap ? cell->heap : cell->data;
+        if (write && cell->binary)
+        {
+            /* текст записи формируется прямо в пачке */
+            reserve_batch(log_async.cfg.render_max_size, (log_level_t)cell->level);
+            commit_batch(log_async.cfg.render_fn(data, cell->len,
+                                                 log_async.batch[log_async.batch_idx] + log_async.batch_len,
+                                                 LOG_ASYNC_BATCH_SIZE - log_async.batch_len),
+                         (log_level_t)cell->level);
+        }
+        else if (write)
+        {
+            put_text(data, cell->len, (log_level_t)cell->level);
+        }
+        free(cell->heap);
+        cell->heap = NULL;
+        /* освободить ячейку для производителя следующего оборота */
+        __atomic_store_n(&cell->seq, pos + log_async.cfg.ring_size, __ATOMIC_RELEASE);
+        log_async.dequeue_pos = pos + 1;
+        count++;
+    }
+    flush_batch();
+    return count;
+}
+
+/**
+ * Выводит накопленную пачку записей.
+ */
+static
+void flush_batch(void)
+{
+    if (log_async.batch_len)
+    {
+        /* не больше одной выводимой пачки: пачки выводятся по порядку, буфер следующей свободен */
+        if (log_async.cfg.wait_fn) log_async.cfg.wait_fn();
+        log_async.cfg.write_fn(log_async.batch[log_async.batch_idx], log_async.runs, log_async.num_runs);
+        log_async.batch_idx = (log_async.batch_idx + 1) % LOG_ASYNC_NUM_BATCHES;
+    }
+    log_async.batch_len = 0;
+    log_async.num_runs = 0;
+}
+
+/**
+ * Готовит пачку к добавлению записи: выводит её, если запись не помещается
+ * или (при track_levels) для участка нового уровня нет места.
+ *
+ * @param size  [in] размер добавляемых данных в байтах
+ * @param level [in] уровень записи
+ */
+static
+void reserve_batch(size_t      size,
+                   log_level_t level)
+{
+    if ((log_async.batch_len + size > LOG_ASYNC_BATCH_SIZE) ||
+        (log_async.cfg.track_levels && log_async.num_runs == LOG_ASYNC_MAX_RUNS &&
+         log_async.runs[log_async.num_runs - 1].level != level))
+    {
+        flush_batch();
+    }
+}
+
+/**
+ * Учитывает добавленную в пачку запись: продлевает последний участок или начинает новый.
+ *
+ * @param len   [in] размер добавленных данных в байтах
+ * @param level [in] уровень записи
+ */
+static
+void commit_batch(size_t      len,
+                  log_level_t level)
+{
+    log_async_run_t *run = log_async.num_runs ? &log_async.runs[log_async.num_runs - 1] : NULL;
+
+    if (len == 0) return;
+    log_async.batch_len += len;
+    if (run && (!log_async.cfg.track_levels || run->level == level))
+    {
+        /* без track_levels пачка - один участок наименьшего уровня её записей */
+        if (level < run->level) run->level = level;
+        run->end = log_async.batch_len;
+        return;
+    }
+    assert(log_async.num_runs < LOG_ASYNC_MAX_RUNS);
+    run = &log_async.runs[log_async.num_runs++];
+    run->end = log_async.batch_len;
+    run->level = level;
+}
+
+/**
+ * Выводит данные одним участком мимо пачки.
+ *
+ * @param data  [in] данные (!= NULL)
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записи
+ */
+static
+void write_direct(const char  *data,
+                  size_t       len,
+                  log_level_t  level)
+{
+    log_async_run_t run;
+
+    assert(data != NULL);
+
+    run.end = len;
+    run.level = level;
+    log_async.cfg.write_fn(data, &run, 1);
+}
+
+/**
+ * Добавляет текстовую запись (с заголовком frame_fn, если он задан) в пачку,
+ * выводя пачку, если запись в неё не помещается.
+ *
+ * @param data  [in] запись (!= NULL)
+ * @param len   [in] размер записи в байтах
+ * @param level [in] уровень записи
+ */
+static
+void put_text(const char  *data,
+              size_t       len,
+              log_level_t  level)
+{
+    char hdr[LOG_ASYNC_FRAME_MAX_SIZE];
+    size_t hdr_len = log_async.cfg.frame_fn ? log_async.cfg.frame_fn(hdr, len) : 0;
+
+    assert(data != NULL);
+    assert(hdr_len <= sizeof(hdr));
+
+    reserve_batch(hdr_len + len, level);
+    if (hdr_len + len > LOG_ASYNC_BATCH_SIZE)
+    {
+        if (log_async.cfg.wait_fn) log_async.cfg.wait_fn();
+        if (hdr_len) write_direct(hdr, hdr_len, level);
+        write_direct(data, len, level);
+    }
+    else
+    {
+        char *batch = log_async.batch[log_async.batch_idx];
+
+        memcpy(batch + log_async.batch_len, hdr, hdr_len);
+        memcpy(batch + log_async.batch_len + hdr_len, data, len);
+        commit_batch(hdr_len + len, level);
+    }
+}
+
+/**
+ * Выводит сообщение о количестве отброшенных записей, если таковые были.
+ */
+static
+void report_dropped(void)
+{
+    uint64_t dropped = __atomic_exchange_n(&log_async.dropped, 0, __ATOMIC_RELAXED);
+
+    if (dropped)
+    {
+        char msg[96];
+        int len = snprintf(msg, sizeof(msg), "cos_log: %" PRIu64 " records dropped (async ring is full)\n", dropped);
+
+        if (len > 0)
+        {
+            put_text(msg, (size_t)MIN((size_t)len, sizeof(msg) - 1), LL_WARNING);
+            flush_batch();
+        }
+    }
+}
+
+/**
+ * Дожидается завершения вывода извлечённых записей и сообщает потокам в log_async_flush(),
+ * что записи до позиции pos выведены.
+ *
+ * @param pos [in] позиция, до которой записи выведены
+ */
+static
+void publish_done(uint64_t pos)
+{
+    if (log_async.cfg.wait_fn) log_async.cfg.wait_fn();
+    pthread_mutex_lock(&log_async.wait_mutex);
+    log_async.done_pos = pos;
+    if (log_async.flush_waiters) pthread_cond_broadcast(&log_async.done_cond);
+    pthread_mutex_unlock(&log_async.wait_mutex);
+}
+
+/**
+ * Усыпляет фоновый поток, пока в кольце нет готовых записей и не запрошена остановка
+ * (не дольше flush_interval_ms).
+ */
+static
+void wait_for_records(void)
+{
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += (time_t)(log_async.cfg.flush_interval_ms / 1000);
+    deadline.tv_nsec += (long)(log_async.cfg.flush_interval_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&log_async.wait_mutex);
+    /* производитель публикует запись и затем проверяет sleeping, поток - наоборот: хотя бы один
+     * из них увидит изменение другого, поэтому сигнал о новой записи не теряется */
+    __atomic_store_n(&log_async.sleeping, true, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&get_cell(log_async.dequeue_pos)->seq, __ATOMIC_ACQUIRE) != log_async.dequeue_pos + 1 &&
+        !__atomic_load_n(&log_async.stop, __ATOMIC_ACQUIRE))
+    {
+        (void)pthread_cond_timedwait(&log_async.wake_cond, &log_async.wait_mutex, &deadline);
+    }
+    __atomic_store_n(&log_async.sleeping, false, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&log_async.wait_mutex);
+}
+
+/**
+ * Будит фоновый поток, ожидающий записей.
+ */
+static
+void wake_writer(void)
+{
+    pthread_mutex_lock(&log_async.wait_mutex);
+    pthread_cond_signal(&log_async.wake_cond);
+    pthread_mutex_unlock(&log_async.wait_mutex);
+}
+
+/**
+ * Освобождает мьютекс и условные переменные ожидания.
+ */
+static
+void destroy_wait_objects(void)
+{
+    pthread_cond_destroy(&log_async.done_cond);
+    pthread_cond_destroy(&log_async.wake_cond);
+    pthread_mutex_destroy(&log_async.wait_mutex);
+}
+
+/**
+ * Тело фонового потока вывода.
+ *
+ * @param arg [in] не используется.
+ * @return NULL
+ */
+static
+void *writer_thread(void *arg)
+{
+    UNUSED_PARAM(arg);
+
+    for (;;)
+    {
+        bool stop = __atomic_load_n(&log_async.stop, __ATOMIC_ACQUIRE);
+        size_t count;
+
+        if (stop && !log_async.drain) break;
+        count = drain_ring(true);
+        report_dropped();
+        if (count == 0 || __atomic_load_n(&log_async.flush_waiters, __ATOMIC_ACQUIRE))
+        {
+            publish_done(log_async.dequeue_pos);
+        }
+        if (count == 0)
+        {
+            if (stop) break;
+            wait_for_records();
+        }
+    }
+    /* после выхода потока записи больше не выводятся - отпустить все log_async_flush() */
+    publish_done(UINT64_MAX);
+    return NULL;
+}
+
+/**
+ * Запускает фоновый поток вывода.
+ *
+ * @param cfg [in] параметры (!= NULL)
+ * @return true - OK, false - Fail
+ */
+extern
+bool log_async_start(const log_async_cfg_t *cfg)
+{
+    pthread_condattr_t cond_attr;
+    size_t i;
+
+    assert(cfg != NULL);
+
+    if (log_async.running) return false;
+    /* размер кольца - степень 2 */
+    if ((cfg->ring_size == 0) || (cfg->ring_size & (cfg->ring_size - 1))) return false;
+    if (cfg->write_fn == NULL) return false;
+    if (cfg->render_fn && (cfg->render_max_size == 0 || cfg->render_max_size > LOG_ASYNC_BATCH_SIZE)) return false;
+
+    log_async.cfg = *cfg;
+    log_async.cell_stride = (sizeof(log_async_cell_t) + cfg->record_size + LOG_ASYNC_CACHE_LINE_SIZE - 1) &
+                            ~(size_t)(LOG_ASYNC_CACHE_LINE_SIZE - 1);
+    log_async.cells = calloc(cfg->ring_size, log_async.cell_stride);
+    if (log_async.cells == NULL) return false;
+    for (i = 0; i < cfg->ring_size; i++)
+    {
+        get_cell(i)->seq = i;
+    }
+    log_async.enqueue_pos = 0;
+    log_async.dequeue_pos = 0;
+    log_async.dropped = 0;
+    log_async.batch_len = 0;
+    log_async.num_runs = 0;
+    log_async.batch_idx = 0;
+    log_async.stop = false;
+    log_async.drain = true;
+    log_async.done_pos = 0;
+    log_async.flush_waiters = 0;
+    log_async.sleeping = false;
+    /* ожидание по монотонным часам не зависит от перевода системного времени */
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&log_async.wake_cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    pthread_cond_init(&log_async.done_cond, NULL);
+    pthread_mutex_init(&log_async.wait_mutex, NULL);
+    if (pthread_create(&log_async.thread, NULL, writer_thread, NULL) != 0)
+    {
+        destroy_wait_objects();
+        free(log_async.cells);
+        log_async.cells = NULL;
+        return false;
+    }
+    __atomic_store_n(&log_async.running, true, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Останавливает фоновый поток вывода и освобождает кольцо, дождавшись выхода
+ * производителей из log_async_push().
+ *
+ * @param drain [in] true - перед остановкой вывести все записи, находящиеся в кольце, false - отбросить их.
+ */
+extern
+void log_async_stop(bool drain)
+{
+    if (!log_async.running) return;
+    __atomic_store_n(&log_async.running, false, __ATOMIC_SEQ_CST);
+    /* производитель, успевший проверить running до сброса, может ещё писать в кольцо */
+    while (__atomic_load_n(&log_async.producers, __ATOMIC_SEQ_CST) != 0) sched_yield();
+    log_async.drain = drain;
+    __atomic_store_n(&log_async.stop, true, __ATOMIC_RELEASE);
+    wake_writer();
+    pthread_join(log_async.thread, NULL);
+    destroy_wait_objects();
+    /* освободить записи, оставшиеся в кольце */
+    while (drain_ring(false)) {}
+    free(log_async.cells);
+    log_async.cells = NULL;
+}
+
+/**
+ * Сообщает, запущен ли асинхронный вывод.
+ *
+ * @return true - запущен, false - нет.
+ */
+extern
+bool log_async_is_running(void)
+{
+    return __atomic_load_n(&log_async.running, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Помещает сформированную запись в кольцо без блокировок и системных вызовов
+ * (кроме выделения памяти для записей длиннее ячейки и пробуждения ожидающего фонового потока).
+ * Если кольцо заполнено, запись отбрасывается, количество отброшенных записей
+ * выводится фоновым потоком. Если вывод остановлен, запись не принимается.
+ *
+ * @param data   [in] запись (!= NULL)
+ * @param len    [in] размер записи в байтах
+ * @param binary [in] true - двоичная запись (выводится через render_fn), false - текст.
+ * @param level  [in] уровень записи
+ * @return true - запись помещена в кольцо, false - отброшена.
+ */
+extern
+bool log_async_push(const char  *data,
+                    size_t       len,
+                    bool         binary,
+                    log_level_t  level)
+{
+    uint64_t pos;
+    log_async_cell_t *cell;
+    char *heap = NULL;
+
+    assert(data != NULL);
+
+    /* пока счётчик не нулевой, log_async_stop() не освободит кольцо */
+    __atomic_add_fetch(&log_async.producers, 1, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&log_async.running, __ATOMIC_SEQ_CST))
+    {
+        __atomic_sub_fetch(&log_async.producers, 1, __ATOMIC_RELEASE);
+        return false;
+    }
+    assert(!binary || log_async.cfg.render_fn != NULL);
+
+    if (len > log_async.cfg.record_size)
+    {
+        heap = malloc(len);
+        if (heap == NULL)
+        {
+            __atomic_add_fetch(&log_async.dropped, 1, __ATOMIC_RELAXED);
+            __atomic_sub_fetch(&log_async.producers, 1, __ATOMIC_RELEASE);
+            return false;
+        }
+        memcpy(heap, data, len);
+    }
+    pos = __atomic_load_n(&log_async.enqueue_pos, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        int64_t diff;
+
+        cell = get_cell(pos);
+        diff = (int64_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0)
+        {
+            /* ячейка свободна - занять позицию */
+            if (__atomic_compare_exchange_n(&log_async.enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            /* кольцо заполнено */
+            free(heap);
+            __atomic_add_fetch(&log_async.dropped, 1, __ATOMIC_RELAXED);
+            __atomic_sub_fetch(&log_async.producers, 1, __ATOMIC_RELEASE);
+            return false;
+        }
+        else
+        {
+            pos = __atomic_load_n(&log_async.enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+    cell->len = len;
+    cell->binary = binary;
+    cell->level = (uint8_t)level;
+    cell->heap = heap;
+    if (heap == NULL) memcpy(cell->data, data, len);
+    /* опубликовать запись для потребителя */
+    __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+    /* разбудить фоновый поток, если он ждёт записей (см. wait_for_records) */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&log_async.sleeping, __ATOMIC_RELAXED)) wake_writer();
+    __atomic_sub_fetch(&log_async.producers, 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Дожидается вывода фоновым потоком всех записей, помещённых в кольцо до вызова.
+ * Если вывод не запущен, возвращается сразу.
+ */
+extern
+void log_async_flush(void)
+{
+    uint64_t target;
+
+    if (!log_async_is_running()) return;
+    target = __atomic_load_n(&log_async.enqueue_pos, __ATOMIC_ACQUIRE);
+    pthread_mutex_lock(&log_async.wait_mutex);
+    __atomic_add_fetch(&log_async.flush_waiters, 1, __ATOMIC_RELEASE);
+    while (log_async.done_pos < target)
+    {
+        pthread_cond_wait(&log_async.done_cond, &log_async.wait_mutex);
+    }
+    __atomic_sub_fetch(&log_async.flush_waiters, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&log_async.wait_mutex);
+}
+
+/**
+ * Возвращает буферы пачек фонового потока (например, для регистрации в io_uring).
+ * Адреса буферов постоянны.
+ *
+ * @param bufs [out] буферы (LOG_ASYNC_NUM_BATCHES элементов) (!= NULL)
+ * @return размер каждого буфера в байтах.
+ */
+extern
+size_t log_async_get_batches(char *bufs[])
+{
+    unsigned i;
+
+    assert(bufs != NULL);
+
+    for (i = 0; i < LOG_ASYNC_NUM_BATCHES; i++)
+    {
+        bufs[i] = log_async.batch[i];
+    }
+    return LOG_ASYNC_BATCH_SIZE;
+}
@@ -0,0 +1,153 @@
+#ifndef LOG_ASYNC_H_
+#define LOG_ASYNC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "log.h"
+
+/**
+ * Размер пачки, которой фоновый поток выводит записи
+ */
+#define LOG_ASYNC_BATCH_SIZE 65536
+
+/**
+ * Количество буферов пачек
+ */
+#define LOG_ASYNC_NUM_BATCHES 2
+
+/**
+ * Максимальное количество участков записей одного уровня в пачке
+ */
+#define LOG_ASYNC_MAX_RUNS 256
+
+/**
+ * Участок пачки из подряд идущих записей одного уровня.
+ */
+typedef struct tag_log_async_run
+{
+    size_t      end;   ///< смещение конца участка от начала пачки.
+    log_level_t level; ///< уровень записей участка.
+}
+log_async_run_t;
+
+/**
+ * Функция вывода пачки сформированных записей (вызывается из фонового потока).
+ *
+ * @param data     [in] данные (!= NULL), размер - runs[num_runs - 1].end байт
+ * @param runs     [in] участки записей одного уровня (без track_levels - один участок наименьшего уровня записей) (!= NULL)
+ * @param num_runs [in] количество участков (> 0)
+ */
+typedef void (*log_async_write_fn_t)(const char *data, const log_async_run_t *runs, size_t num_runs);
+
+/**
+ * Функция ожидания завершения вывода, начатого log_async_write_fn_t (вызывается из фонового потока).
+ */
+typedef void (*log_async_wait_fn_t)(void);
+
+/**
+ * Функция преобразования двоичной записи в текст (вызывается из фонового потока).
+ *
+ * @param rec      [in]  двоичная запись (!= NULL)
+ * @param len      [in]  размер записи в байтах
+ * @param out      [out] буфер для текста (!= NULL)
+ * @param out_size [in]  размер буфера в байтах
+ * @return длина текста в байтах (не больше out_size), 0 - запись не выводится.
+ */
+typedef size_t (*log_async_render_fn_t)(const char *rec, size_t len, char *out, size_t out_size);
+
+/**
+ * Максимальный размер заголовка, который функция log_async_frame_fn_t добавляет к тексту
+ */
+#define LOG_ASYNC_FRAME_MAX_SIZE 16
+
+/**
+ * Функция формирования заголовка перед текстовыми данными (вызывается из фонового потока).
+ *
+ * @param hdr [out] буфер размером LOG_ASYNC_FRAME_MAX_SIZE (!= NULL)
+ * @param len [in]  размер текста в байтах
+ * @return размер заголовка в байтах.
+ */
+typedef size_t (*log_async_frame_fn_t)(char *hdr, size_t len);
+
+/**
+ * Параметры асинхронного вывода.
+ */
+typedef struct tag_log_async_cfg
+{
+    size_t               ring_size;         ///< количество ячеек кольца (степень 2).
+    size_t               record_size;       ///< размер данных ячейки в байтах (более длинные записи копируются в кучу).
+    unsigned             flush_interval_ms; ///< страховочный период пробуждения фонового потока при отсутствии записей
+                                            ///< (новые записи будят его сразу).
+    log_async_write_fn_t write_fn;          ///< функция вывода (!= NULL).
+    log_async_render_fn_t render_fn;        ///< функция преобразования двоичных записей (NULL - двоичные записи не используются).
+    size_t               render_max_size;   ///< максимальная длина текста одной двоичной записи.
+    log_async_frame_fn_t frame_fn;          ///< функция формирования заголовка текстовых записей (NULL - без заголовка).
+    bool                 track_levels;      ///< пачка хранит границы записей разных уровней (для фильтрации по уровню при выводе).
+    log_async_wait_fn_t  wait_fn;           ///< ожидание завершения вывода (NULL - write_fn выводит синхронно); вызывается перед каждым
+                                            ///< вызовом write_fn и при остановке, буфер пачки не изменяется до следующего вызова.
+}
+log_async_cfg_t;
+
+/**
+ * Запускает фоновый поток вывода.
+ *
+ * @param cfg [in] параметры (!= NULL)
+ * @return true - OK, false - Fail
+ */
+extern
+bool log_async_start(const log_async_cfg_t *cfg) __attribute__((nonnull(1)));
+
+/**
+ * Останавливает фоновый поток вывода и освобождает кольцо, дождавшись выхода
+ * производителей из log_async_push().
+ *
+ * @param drain [in] true - перед остановкой вывести все записи, находящиеся в кольце, false - отбросить их.
+ */
+extern
+void log_async_stop(bool drain);
+
+/**
+ * Сообщает, запущен ли асинхронный вывод.
+ *
+ * @return true - запущен, false - нет.
+ */
+extern
+bool log_async_is_running(void) __attribute__((warn_unused_result));
+
+/**
+ * Помещает сформированную запись в кольцо без блокировок и системных вызовов
+ * (кроме выделения памяти для записей длиннее ячейки и пробуждения ожидающего фонового потока).
+ * Если кольцо заполнено, запись отбрасывается, количество отброшенных записей
+ * выводится фоновым потоком. Если вывод остановлен, запись не принимается.
+ *
+ * @param data   [in] запись (!= NULL)
+ * @param len    [in] размер записи в байтах
+ * @param binary [in] true - двоичная запись (выводится через render_fn), false - текст.
+ * @param level  [in] уровень записи
+ * @return true - запись помещена в кольцо, false - отброшена.
+ */
+extern
+bool log_async_push(const char  *data,
+                    size_t       len,
+                    bool         binary,
+                    log_level_t  level) __attribute__((nonnull(1)));
+
+/**
+ * Дожидается вывода фоновым потоком всех записей, помещённых в кольцо до вызова.
+ * Если вывод не запущен, возвращается сразу.
+ */
+extern
+void log_async_flush(void);
+
+/**
+ * Возвращает буферы пачек фонового потока (например, для регистрации в io_uring).
+ * Адреса буферов постоянны.
+ *
+ * @param bufs [out] буферы (LOG_ASYNC_NUM_BATCHES элементов) (!= NULL)
+ * @return размер каждого буфера в байтах.
+ */
+extern
+size_t log_async_get_batches(char *bufs[]) __attribute__((nonnull(1)));
+
+#endif /* LOG_ASYNC_H_ */
@@ -0,0 +1,295 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define _LOG_SRC "UNKNOWN"
+#include "log.h"
+#include "log_backtrace.h"
+
+/**
+ * Часы возраста записей (точности тика ядра достаточно для окна в миллисекундах)
+ */
+#ifdef CLOCK_MONOTONIC_COARSE
+#define LOG_BACKTRACE_CLOCK CLOCK_MONOTONIC_COARSE
+#else
+#define LOG_BACKTRACE_CLOCK CLOCK_MONOTONIC
+#endif
+
+/**
+ * Заголовок записи кольца
+ */
+typedef struct tag_log_bt_slot
+{
+    uint64_t    time_ns; /*!< время сохранения записи, нс */
+    size_t      len;     /*!< размер записи в байтах */
+    log_level_t level;   /*!< уровень записи */
+}
+log_bt_slot_t;
+
+/**
+ * Кольцо предыстории потока (заголовки и данные записей выделяются одним блоком следом за ним).
+ * Параметры копируются в кольцо при выделении: повторный log_backtrace_init() не меняет размеры
+ * кольца, которым поток уже пользуется.
+ */
+typedef struct tag_log_bt_ring
+{
+    uint32_t       generation;  /*!< поколение параметров, для которых выделено кольцо */
+    size_t         num_records; /*!< количество записей */
+    size_t         record_size; /*!< максимальный размер записи в байтах */
+    uint64_t       window_ns;   /*!< максимальный возраст выводимых записей, нс (0 - без ограничения) */
+    size_t         next;        /*!< индекс следующей записи */
+    size_t         count;       /*!< количество записей в кольце */
+    log_bt_slot_t *slots;       /*!< заголовки записей */
+    char          *data;        /*!< данные записей (по record_size байт на запись) */
+}
+log_bt_ring_t;
+
+/**
+ * Параметры буферов предыстории.
+ * Параметры записываются до увеличения generation (release) и читаются после его чтения (acquire).
+ */
+typedef struct tag_log_backtrace
+{
+    bool     enabled;     /*!< буферы включены */
+    uint32_t generation;  /*!< поколение параметров (увеличивается при каждом log_backtrace_init()) */
+    size_t   num_records; /*!< количество записей на поток */
+    size_t   record_size; /*!< максимальный размер записи в байтах */
+    uint64_t window_ns;   /*!< максимальный возраст выводимых записей, нс (0 - без ограничения) */
+}
+log_backtrace_t;
+
+static
+log_backtrace_t log_backtrace; ///< параметры буферов предыстории.
+
+/**
+ * Кольцо предыстории текущего потока
+ */
+static __thread
+log_bt_ring_t *tls_bt_ring;
+
+/**
+ * Ключ для освобождения кольца при завершении потока (создаётся один раз и не удаляется)
+ */
+static
+pthread_key_t bt_ring_key;
+
+static
+pthread_once_t bt_ring_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Результат создания ключа bt_ring_key
+ */
+static
+bool bt_ring_key_created;
+
+/**
+ * Создаёт ключ bt_ring_key (вызывается через pthread_once()).
+ */
+static
+void create_ring_key(void);
+
+/**
+ * Освобождает кольцо потока при его завершении.
+ *
+ * @param ring [in] кольцо (log_bt_ring_t *)
+ */
+static
+void free_ring(void *ring);
+
+/**
+ * Возвращает кольцо текущего потока, выделяя его при необходимости.
+ *
+ * @return кольцо или NULL при нехватке памяти.
+ */
+static
+log_bt_ring_t *get_ring(void) __attribute__((warn_unused_result));
+
+/**
+ * Возвращает время часов LOG_BACKTRACE_CLOCK в наносекундах (0 - часы недоступны).
+ *
+ * @return время в наносекундах.
+ */
+static
+uint64_t get_time_ns(void);
+
+/**
+ * Создаёт ключ bt_ring_key (вызывается через pthread_once()).
+ */
+static
+void create_ring_key(void)
+{
+    bt_ring_key_created = (pthread_key_create(&bt_ring_key, free_ring) == 0);
+}
+
+/**
+ * Освобождает кольцо потока при его завершении.
+ *
+ * @param ring [in] кольцо (log_bt_ring_t *)
+ */
+static
+void free_ring(void *ring)
+{
+    free(ring);
+}
+
+/**
+ * Возвращает кольцо текущего потока, выделяя его при необходимости.
+ *
+ * @return кольцо или NULL при нехватке памяти.
+ */
+static
+log_bt_ring_t *get_ring(void)
+{
+    log_bt_ring_t *ring = tls_bt_ring;
+    uint32_t generation = __atomic_load_n(&log_backtrace.generation, __ATOMIC_ACQUIRE);
+    size_t num_records;
+    size_t record_size;
+
+    if (ring && ring->generation == generation) return ring;
+    free(ring);
+    tls_bt_ring = NULL;
+    /* размер проверен на переполнение в log_backtrace_init() */
+    num_records = __atomic_load_n(&log_backtrace.num_records, __ATOMIC_RELAXED);
+    record_size = __atomic_load_n(&log_backtrace.record_size, __ATOMIC_RELAXED);
+    ring = malloc(sizeof(log_bt_ring_t) + num_records * (sizeof(log_bt_slot_t) + record_size));
+    if (ring)
+    {
+        ring->generation = generation;
+        ring->num_records = num_records;
+        ring->record_size = record_size;
+        ring->window_ns = __atomic_load_n(&log_backtrace.window_ns, __ATOMIC_RELAXED);
+        ring->next = 0;
+        ring->count = 0;
+        ring->slots = (log_bt_slot_t *)(ring + 1);
+        ring->data = (char *)(ring->slots + num_records);
+        tls_bt_ring = ring;
+    }
+    /* кольцо освобождается деструктором ключа при завершении потока */
+    (void)pthread_setspecific(bt_ring_key, ring);
+    return ring;
+}
+
+/**
+ * Возвращает время часов LOG_BACKTRACE_CLOCK в наносекундах (0 - часы недоступны).
+ *
+ * @return время в наносекундах.
+ */
+static
+uint64_t get_time_ns(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(LOG_BACKTRACE_CLOCK, &ts) != 0) return 0;
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Включает буферы предыстории потоков.
+ * Кольца, выделенные потоками при прежних параметрах, пересоздаются при следующей записи.
+ *
+ * @param num_records [in] количество хранимых записей на поток (> 0)
+ * @param record_size [in] максимальный размер записи в байтах, более длинные обрезаются (> 0)
+ * @param window_ms   [in] максимальный возраст выводимых записей (0 - без ограничения)
+ * @return true - OK, false - Fail
+ */
+extern
+bool log_backtrace_init(size_t   num_records,
+                        size_t   record_size,
+                        unsigned window_ms)
+{
+    if (__atomic_load_n(&log_backtrace.enabled, __ATOMIC_RELAXED) || num_records == 0 || record_size == 0) return false;
+    /* размер кольца потока не должен переполнять size_t */
+    if (record_size > SIZE_MAX - sizeof(log_bt_slot_t) ||
+        num_records > (SIZE_MAX - sizeof(log_bt_ring_t)) / (sizeof(log_bt_slot_t) + record_size))
+    {
+        return false;
+    }
+    if (pthread_once(&bt_ring_key_once, create_ring_key) != 0 || !bt_ring_key_created) return false;
+    __atomic_store_n(&log_backtrace.num_records, num_records, __ATOMIC_RELAXED);
+    __atomic_store_n(&log_backtrace.record_size, record_size, __ATOMIC_RELAXED);
+    __atomic_store_n(&log_backtrace.window_ns, (uint64_t)window_ms * 1000000u, __ATOMIC_RELAXED);
+    /* опубликовать параметры: потоки читают их после чтения generation */
+    __atomic_add_fetch(&log_backtrace.generation, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&log_backtrace.enabled, true, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Выключает буферы предыстории и освобождает кольцо текущего потока
+ * (кольца остальных потоков освобождаются при их завершении).
+ */
+extern
+void log_backtrace_destroy(void)
+{
+    if (!__atomic_load_n(&log_backtrace.enabled, __ATOMIC_RELAXED)) return;
+    __atomic_store_n(&log_backtrace.enabled, false, __ATOMIC_RELAXED);
+    free(tls_bt_ring);
+    tls_bt_ring = NULL;
+    (void)pthread_setspecific(bt_ring_key, NULL);
+}
+
+/**
+ * Сохраняет запись в кольцо текущего потока (самая старая запись перезаписывается).
+ *
+ * @param data  [in] запись (!= NULL)
+ * @param len   [in] размер записи в байтах
+ * @param level [in] уровень записи
+ */
+extern
+void log_backtrace_push(const char  *data,
+                        size_t       len,
+                        log_level_t  level)
+{
+    log_bt_ring_t *ring;
+    log_bt_slot_t *slot;
+    char *slot_data;
+
+    assert(data != NULL);
+
+    if (!__atomic_load_n(&log_backtrace.enabled, __ATOMIC_ACQUIRE) || len == 0) return;
+    ring = get_ring();
+    if (ring == NULL) return;
+    slot = &ring->slots[ring->next];
+    slot_data = ring->data + ring->next * ring->record_size;
+    slot->len = MIN(len, ring->record_size);
+    slot->level = level;
+    slot->time_ns = ring->window_ns ? get_time_ns() : 0;
+    memcpy(slot_data, data, slot->len);
+    /* обрезанная запись всё равно заканчивается переводом строки */
+    if (slot->len < len) slot_data[slot->len - 1] = '\n';
+    ring->next = (ring->next + 1) % ring->num_records;
+    if (ring->count < ring->num_records) ring->count++;
+}
+
+/**
+ * Выводит записи кольца текущего потока не старше окна (от старых к новым) и очищает кольцо.
+ *
+ * @param emit  [in] функция вывода (!= NULL)
+ * @param level [in] уровень, с которым выводятся записи (уровень ошибки)
+ */
+extern
+void log_backtrace_flush(log_backtrace_emit_fn emit,
+                         log_level_t           level)
+{
+    log_bt_ring_t *ring = tls_bt_ring;
+    uint64_t now;
+    size_t idx;
+
+    assert(emit != NULL);
+
+    if (!__atomic_load_n(&log_backtrace.enabled, __ATOMIC_ACQUIRE) || ring == NULL || ring->count == 0) return;
+    if (ring->generation != __atomic_load_n(&log_backtrace.generation, __ATOMIC_ACQUIRE)) return;
+    now = ring->window_ns ? get_time_ns() : 0;
+    idx = (ring->next + ring->num_records - ring->count) % ring->num_records;
+    for (; ring->count > 0; ring->count--, idx = (idx + 1) % ring->num_records)
+    {
+        const log_bt_slot_t *slot = &ring->slots[idx];
+
+        if (ring->window_ns && now - slot->time_ns > ring->window_ns) continue;
+        /* записи выводятся с уровнем ошибки: приёмник, принимающий ошибку, получает и её предысторию */
+        emit(ring->data + idx * ring->record_size, slot->len, level);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef LOG_BACKTRACE_H_
+#define LOG_BACKTRACE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "log.h"
+
+/**
+ * Буфер предыстории потока: записи ниже уровня вывода сохраняются сформированными в кольцо
+ * текущего потока и выводятся только вместе с ошибкой этого потока.
+ * Кольцо выделяется при первой записи потока и освобождается при его завершении.
+ */
+
+/**
+ * Функция вывода записи предыстории.
+ *
+ * @param data  [in] запись (!= NULL)
+ * @param len   [in] размер записи в байтах
+ * @param level [in] уровень записи
+ */
+typedef void (*log_backtrace_emit_fn)(const char *data, size_t len, log_level_t level);
+
+/**
+ * Включает буферы предыстории потоков.
+ * Кольца, выделенные потоками при прежних параметрах, пересоздаются при следующей записи.
+ *
+ * @param num_records [in] количество хранимых записей на поток (> 0)
+ * @param record_size [in] максимальный размер записи в байтах, более длинные обрезаются (> 0)
+ * @param window_ms   [in] максимальный возраст выводимых записей (0 - без ограничения)
+ * @return true - OK, false - Fail
+ */
+extern
+bool log_backtrace_init(size_t   num_records,
+                        size_t   record_size,
+                        unsigned window_ms) __attribute__((warn_unused_result));
+
+/**
+ * Выключает буферы предыстории и освобождает кольцо текущего потока
+ * (кольца остальных потоков освобождаются при их завершении).
+ */
+extern
+void log_backtrace_destroy(void);
+
+/**
+ * Сохраняет запись в кольцо текущего потока (самая старая запись перезаписывается).
+ *
+ * @param data  [in] запись (!= NULL)
+ * @param len   [in] размер записи в байтах
+ * @param level [in] уровень записи
+ */
+extern
+void log_backtrace_push(const char  *data,
+                        size_t       len,
+                        log_level_t  level) __attribute__((nonnull(1)));
+
+/**
+ * Выводит записи кольца текущего потока не старше окна (от старых к новым) и очищает кольцо.
+ *
+ * @param emit  [in] функция вывода (!= NULL)
+ * @param level [in] уровень, с которым выводятся записи (уровень ошибки)
+ */
+extern
+void log_backtrace_flush(log_backtrace_emit_fn emit,
+                         log_level_t           level) __attribute__((nonnull(1)));
+
+#endif /* LOG_BACKTRACE_H_ */
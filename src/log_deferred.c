@@ -0,0 +1,1226 @@
+#include <assert.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _LOG_SRC "UNKNOWN"
+#include "log_deferred.h"
+
+/**
+ * Количество точек логгирования в одном блоке хранилища
+ */
+#define LOG_DEFERRED_CHUNK_SIZE 256
+
+/**
+ * Максимальное количество блоков хранилища точек логгирования
+ */
+#define LOG_DEFERRED_MAX_CHUNKS 1024
+
+/**
+ * Максимальная длина одной спецификации преобразования (вместе с '%')
+ */
+#define LOG_DEFERRED_SPEC_MAX_SIZE 32
+
+/**
+ * Признак спецификации без аргумента ("%%")
+ */
+#define LOG_ARG_NONE LOG_ARG_CNT
+
+/**
+ * Разобранная спецификация преобразования строки формата
+ */
+typedef struct tag_log_fmt_spec
+{
+    size_t len;       /*!< длина спецификации вместе с '%' */
+    int    num_stars; /*!< количество ширин/точностей, передаваемых аргументами ('*') */
+    int    type;      /*!< тип аргумента (log_arg_type_t) или LOG_ARG_NONE */
+}
+log_fmt_spec_t;
+
+/**
+ * Хранилище зарегистрированных точек логгирования.
+ * Блоки не перемещаются, поэтому описание точки можно читать без блокировки
+ * после того, как её идентификатор получен из записи.
+ */
+typedef struct tag_log_deferred_sites
+{
+    pthread_mutex_t      mutex;                          /*!< мьютекс регистрации */
+    uint32_t             count;                          /*!< количество зарегистрированных точек */
+    log_deferred_site_t *chunks[LOG_DEFERRED_MAX_CHUNKS]; /*!< блоки точек */
+}
+log_deferred_sites_t;
+
+static
+log_deferred_sites_t sites = { PTHREAD_MUTEX_INITIALIZER, 0, { NULL } }; ///< хранилище точек логгирования.
+
+/**
+ * Разбирает спецификацию преобразования.
+ *
+ * @param p    [in]  указатель на '%' (!= NULL)
+ * @param spec [out] спецификация (!= NULL)
+ * @return true - OK, false - спецификация не поддерживается отложенным форматированием.
+ */
+static
+bool parse_spec(const char     *p,
+                log_fmt_spec_t *spec) __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+
+/**
+ * Возвращает размер сохранённого аргумента заданного типа (для строк - размер поля длины).
+ *
+ * @param type [in] тип аргумента
+ * @return размер в байтах.
+ */
+static
+size_t get_arg_size(log_arg_type_t type) __attribute__((warn_unused_result));
+
+/**
+ * Разбирает спецификацию преобразования.
+ *
+ * @param p    [in]  указатель на '%' (!= NULL)
+ * @param spec [out] спецификация (!= NULL)
+ * @return true - OK, false - спецификация не поддерживается отложенным форматированием.
+ */
+static
+bool parse_spec(const char     *p,
+                log_fmt_spec_t *spec)
+{
+    const char *start = p;
+    char length[3] = {0, 0, 0};
+    size_t length_len = 0;
+
+    assert(p != NULL);
+    assert(*p == '%');
+    assert(spec != NULL);
+
+    spec->num_stars = 0;
+    spec->type = LOG_ARG_NONE;
+    p++;
+    if (*p == '%')
+    {
+        spec->len = 2;
+        return true;
+    }
+    /* флаги */
+    while (*p && strchr("-+ #0'I", *p)) p++;
+    /* ширина */
+    if (*p == '*')
+    {
+        spec->num_stars++;
+        p++;
+    }
+    while (isdigit((unsigned char)*p)) p++;
+    /* позиционные аргументы не поддерживаются */
+    if (*p == '$') return false;
+    /* точность */
+    if (*p == '.')
+    {
+        p++;
+        if (*p == '*')
+        {
+            spec->num_stars++;
+            p++;
+        }
+        while (isdigit((unsigned char)*p)) p++;
+        if (*p == '$') return false;
+    }
+    /* модификатор длины */
+    while (*p && strchr("hlLqjzt", *p) && length_len < 2)
+    {
+        length[length_len++] = *p++;
+    }
+    switch (*p)
+    {
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+        if      (!strcmp(length, "l"))                               spec->type = LOG_ARG_LONG;
+        else if (!strcmp(length, "ll") || !strcmp(length, "q"))      spec->type = LOG_ARG_LLONG;
+        else if (!strcmp(length, "j"))                               spec->type = LOG_ARG_INTMAX;
+        else if (!strcmp(length, "z"))                               spec->type = LOG_ARG_SIZE;
+        else if (!strcmp(length, "t"))                               spec->type = LOG_ARG_PTRDIFF;
+        else if (!length_len || !strcmp(length, "h") || !strcmp(length, "hh")) spec->type = LOG_ARG_INT;
+        else return false;
+        break;
+    case 'c':
+        if (length_len) return false;
+        spec->type = LOG_ARG_INT;
+        break;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        if      (!strcmp(length, "L"))                       spec->type = LOG_ARG_LDOUBLE;
+        else if (!length_len || !strcmp(length, "l"))        spec->type = LOG_ARG_DOUBLE;
+        else return false;
+        break;
+    case 's':
+        if (length_len) return false;
+        spec->type = LOG_ARG_STR;
+        break;
+    case 'p':
+        if (length_len) return false;
+        spec->type = LOG_ARG_PTR;
+        break;
+    default:
+        /* %n, %m, широкие символы и неизвестные преобразования */
+        return false;
+    }
+    spec->len = (size_t)(p + 1 - start);
+    return (spec->len < LOG_DEFERRED_SPEC_MAX_SIZE);
+}
+
+/**
+ * Возвращает размер сохранённого аргумента заданного типа (для строк - размер поля длины).
+ *
+ * @param type [in] тип аргумента
+ * @return размер в байтах.
+ */
+static
+size_t get_arg_size(log_arg_type_t type)
+{
+    switch (type)
+    {
+    case LOG_ARG_LDOUBLE: return sizeof(long double);
+    case LOG_ARG_STR:     return sizeof(uint16_t);
+    default:              return sizeof(uint64_t);
+    }
+}
+
+/**
+ * Записывает строку кадра двоичного файла журнала: длина (2 байта) и символы.
+ *
+ * @param out [out] буфер (!= NULL)
+ * @param str [in]  строка (!= NULL)
+ * @return размер записанных данных в байтах.
+ */
+static
+size_t put_bin_str(char       *out,
+                   const char *str) __attribute__((nonnull(1, 2)));
+
+/**
+ * Записывает строку кадра двоичного файла журнала: длина (2 байта) и символы.
+ *
+ * @param out [out] буфер (!= NULL)
+ * @param str [in]  строка (!= NULL)
+ * @return размер записанных данных в байтах.
+ */
+static
+size_t put_bin_str(char       *out,
+                   const char *str)
+{
+    uint16_t len = (uint16_t)strnlen(str, UINT16_MAX);
+
+    memcpy(out, &len, sizeof(len));
+    memcpy(out + sizeof(len), str, len);
+    return sizeof(len) + len;
+}
+
+/**
+ * Записывает число в формате varint.
+ *
+ * @param out [out] буфер размером не менее 10 байт (!= NULL)
+ * @param val [in]  число
+ * @return размер записанных данных в байтах.
+ */
+static
+size_t put_varint(char     *out,
+                  uint64_t  val) __attribute__((nonnull(1)));
+
+/**
+ * Читает число в формате varint.
+ *
+ * @param data [in]     данные (!= NULL)
+ * @param len  [in]     размер данных в байтах
+ * @param pos  [in/out] позиция чтения (!= NULL)
+ * @param val  [out]    число (!= NULL)
+ * @return true - OK, false - данные повреждены.
+ */
+static
+bool get_varint(const char *data,
+                size_t      len,
+                size_t     *pos,
+                uint64_t   *val) __attribute__((nonnull(1, 3, 4))) __attribute__((warn_unused_result));
+
+/**
+ * Дописывает данные в буфер с проверкой его размера.
+ *
+ * @param out      [out]    буфер (!= NULL)
+ * @param out_size [in]     размер буфера в байтах
+ * @param pos      [in/out] позиция записи (!= NULL)
+ * @param data     [in]     данные (!= NULL)
+ * @param size     [in]     размер данных в байтах
+ * @return true - OK, false - данные не помещаются в буфер.
+ */
+static
+bool append(char       *out,
+            size_t      out_size,
+            size_t     *pos,
+            const void *data,
+            size_t      size) __attribute__((nonnull(1, 3, 4))) __attribute__((warn_unused_result));
+
+/**
+ * Ищет источник в словаре сессии.
+ *
+ * @param packer [in] состояние упаковки сессии (!= NULL)
+ * @param name   [in] имя источника (!= NULL)
+ * @param len    [in] длина имени
+ * @return элемент хэш-таблицы с источником или свободный элемент, куда его можно добавить.
+ */
+static
+log_bin_source_t *find_source(log_bin_packer_t *packer,
+                              const char       *name,
+                              uint8_t           len) __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+
+/**
+ * Записывает число в формате varint.
+ *
+ * @param out [out] буфер размером не менее 10 байт (!= NULL)
+ * @param val [in]  число
+ * @return размер записанных данных в байтах.
+ */
+static
+size_t put_varint(char     *out,
+                  uint64_t  val)
+{
+    size_t len = 0;
+
+    assert(out != NULL);
+
+    while (val >= 0x80)
+    {
+        out[len++] = (char)(val | 0x80);
+        val >>= 7;
+    }
+    out[len++] = (char)val;
+    return len;
+}
+
+/**
+ * Читает число в формате varint.
+ *
+ * @param data [in]     данные (!= NULL)
+ * @param len  [in]     размер данных в байтах
+ * @param pos  [in/out] позиция чтения (!= NULL)
+ * @param val  [out]    число (!= NULL)
+ * @return true - OK, false - данные повреждены.
+ */
+static
+bool get_varint(const char *data,
+                size_t      len,
+                size_t     *pos,
+                uint64_t   *val)
+{
+    unsigned shift;
+
+    assert(data != NULL);
+    assert(pos != NULL);
+    assert(val != NULL);
+
+    *val = 0;
+    for (shift = 0; shift < 64 && *pos < len; shift += 7)
+    {
+        unsigned char byte = (unsigned char)data[(*pos)++];
+
+        *val |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+/**
+ * Дописывает данные в буфер с проверкой его размера.
+ *
+ * @param out      [out]    буфер (!= NULL)
+ * @param out_size [in]     размер буфера в байтах
+ * @param pos      [in/out] позиция записи (!= NULL)
+ * @param data     [in]     данные (!= NULL)
+ * @param size     [in]     размер данных в байтах
+ * @return true - OK, false - данные не помещаются в буфер.
+ */
+static
+bool append(char       *out,
+            size_t      out_size,
+            size_t     *pos,
+            const void *data,
+            size_t      size)
+{
+    assert(out != NULL);
+    assert(pos != NULL);
+    assert(data != NULL);
+
+    if (out_size - *pos < size) return false;
+    memcpy(out + *pos, data, size);
+    *pos += size;
+    return true;
+}
+
+/**
+ * Ищет источник в словаре сессии.
+ *
+ * @param packer [in] состояние упаковки сессии (!= NULL)
+ * @param name   [in] имя источника (!= NULL)
+ * @param len    [in] длина имени
+ * @return элемент хэш-таблицы с источником или свободный элемент, куда его можно добавить.
+ */
+static
+log_bin_source_t *find_source(log_bin_packer_t *packer,
+                              const char       *name,
+                              uint8_t           len)
+{
+    uint32_t hash = 2166136261u;
+    uint8_t i;
+
+    assert(packer != NULL);
+    assert(name != NULL);
+
+    /* FNV-1a */
+    for (i = 0; i < len; i++)
+    {
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    }
+    /* таблица заполнена не более чем наполовину, свободный элемент всегда найдётся */
+    for (;; hash++)
+    {
+        log_bin_source_t *source = &packer->sources[hash % TBL_SZ(packer->sources)];
+
+        if (source->id == 0 || (source->len == len && memcmp(source->name, name, len) == 0)) return source;
+    }
+}
+
+/**
+ * Заполняет описание точки логгирования и определяет типы аргументов строки формата.
+ *
+ * @param site     [out] описание точки (!= NULL)
+ * @param file     [in]  имя файла (!= NULL)
+ * @param line     [in]  номер строки в файле (!= NULL)
+ * @param function [in]  имя функции (!= NULL)
+ * @param fmt      [in]  строка формата (!= NULL)
+ * @return true - OK, false - строка формата не поддерживается отложенным форматированием.
+ */
+extern
+bool log_deferred_site_init(log_deferred_site_t *site,
+                            const char          *file,
+                            const char          *line,
+                            const char          *function,
+                            const char          *fmt)
+{
+    const char *p;
+
+    assert(site != NULL);
+    assert(file != NULL);
+    assert(line != NULL);
+    assert(function != NULL);
+    assert(fmt != NULL);
+
+    memset(site, 0, sizeof(*site));
+    site->file = file;
+    site->line = line;
+    site->function = function;
+    site->fmt = fmt;
+    /* определить типы аргументов */
+    for (p = strchr(fmt, '%'); p; p = strchr(p, '%'))
+    {
+        log_fmt_spec_t spec;
+        int i;
+
+        if (!parse_spec(p, &spec)) return false;
+        p += spec.len;
+        if (spec.type == LOG_ARG_NONE) continue;
+        if (site->num_args + spec.num_stars + 1 > LOG_DEFERRED_MAX_ARGS) return false;
+        for (i = 0; i < spec.num_stars; i++)
+        {
+            site->arg_types[site->num_args++] = LOG_ARG_INT;
+        }
+        site->arg_types[site->num_args++] = (uint8_t)spec.type;
+    }
+    return (strlen(fmt) < LOG_DEFERRED_FMT_MAX_SIZE);
+}
+
+/**
+ * Регистрирует точку логгирования (однократно для каждого log_callsite_t).
+ * Строки должны существовать всё время работы процесса (как строковые литералы макросов),
+ * точки не удаляются до завершения процесса.
+ *
+ * @param callsite [in/out] кеш точки логгирования, куда сохраняется идентификатор (!= NULL)
+ * @param file     [in] имя файла (!= NULL)
+ * @param line     [in] номер строки в файле (!= NULL)
+ * @param function [in] имя функции (!= NULL)
+ * @param fmt      [in] строка формата (!= NULL)
+ * @return идентификатор точки, LOG_DEFERRED_UNSUPPORTED - строка формата не поддерживается.
+ */
+extern
+uint32_t log_deferred_site_register(log_callsite_t *callsite,
+                                    const char     *file,
+                                    const char     *line,
+                                    const char     *function,
+                                    const char     *fmt)
+{
+    log_deferred_site_t site;
+    uint32_t id = LOG_DEFERRED_UNSUPPORTED;
+    bool supported;
+
+    assert(callsite != NULL);
+    assert(file != NULL);
+    assert(line != NULL);
+    assert(function != NULL);
+    assert(fmt != NULL);
+
+    supported = log_deferred_site_init(&site, file, line, function, fmt);
+    pthread_mutex_lock(&sites.mutex);
+    /* точку могли зарегистрировать из другого потока */
+    if (callsite->deferred_id == 0)
+    {
+        if (supported && sites.count < LOG_DEFERRED_CHUNK_SIZE * LOG_DEFERRED_MAX_CHUNKS)
+        {
+            uint32_t idx = sites.count;
+            log_deferred_site_t *chunk = sites.chunks[idx / LOG_DEFERRED_CHUNK_SIZE];
+
+            if (chunk == NULL)
+            {
+                chunk = calloc(LOG_DEFERRED_CHUNK_SIZE, sizeof(log_deferred_site_t));
+                sites.chunks[idx / LOG_DEFERRED_CHUNK_SIZE] = chunk;
+            }
+            if (chunk)
+            {
+                chunk[idx % LOG_DEFERRED_CHUNK_SIZE] = site;
+                id = idx + 1;
+                __atomic_store_n(&sites.count, id, __ATOMIC_RELEASE);
+            }
+        }
+        __atomic_store_n(&callsite->deferred_id, id, __ATOMIC_RELEASE);
+    }
+    id = callsite->deferred_id;
+    pthread_mutex_unlock(&sites.mutex);
+    return id;
+}
+
+/**
+ * Возвращает описание зарегистрированной точки логгирования.
+ *
+ * @param site_id [in] идентификатор точки
+ * @return описание или NULL, если точка не зарегистрирована.
+ */
+extern
+const log_deferred_site_t *log_deferred_site_get(uint32_t site_id)
+{
+    if (site_id == 0 || site_id > __atomic_load_n(&sites.count, __ATOMIC_ACQUIRE)) return NULL;
+    site_id--;
+    return &sites.chunks[site_id / LOG_DEFERRED_CHUNK_SIZE][site_id % LOG_DEFERRED_CHUNK_SIZE];
+}
+
+/**
+ * Возвращает количество зарегистрированных точек логгирования (идентификаторы 1..N).
+ *
+ * @return количество точек.
+ */
+extern
+uint32_t log_deferred_site_count(void)
+{
+    return __atomic_load_n(&sites.count, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Формирует отложенную запись: заголовок, источник и аргументы в двоичном виде.
+ * Строковые аргументы обрезаются, если запись не помещается в буфер.
+ *
+ * @param out      [out] буфер для записи (!= NULL)
+ * @param out_size [in]  размер буфера в байтах
+ * @param site_id  [in]  идентификатор точки логгирования
+ * @param level    [in]  уровень лога
+ * @param source   [in]  источник (!= NULL)
+ * @param ts       [in]  время записи (!= NULL)
+ * @param args     [in]  аргументы строки формата точки
+ * @return размер записи в байтах или 0 в случае ошибки.
+ */
+extern
+size_t log_deferred_capture(char                  *out,
+                            size_t                 out_size,
+                            uint32_t               site_id,
+                            log_level_t            level,
+                            const char            *source,
+                            const struct timespec *ts,
+                            va_list                args)
+{
+    const log_deferred_site_t *site = log_deferred_site_get(site_id);
+    log_deferred_hdr_t hdr;
+    size_t fixed_size = 0;
+    size_t str_budget;
+    size_t pos;
+    uint8_t i;
+
+    assert(out != NULL);
+    assert(source != NULL);
+    assert(ts != NULL);
+
+    if (site == NULL) return 0;
+    /* заголовок записывается целиком, включая выравнивание */
+    ZEROIZE_STRUCT(hdr);
+    hdr.sec = (uint64_t)ts->tv_sec;
+    hdr.nsec = (uint32_t)ts->tv_nsec;
+    hdr.site_id = site_id;
+    hdr.level = (uint8_t)level;
+    hdr.src_len = (uint8_t)strnlen(source, LOG_DEFERRED_SRC_MAX_SIZE);
+    for (i = 0; i < site->num_args; i++)
+    {
+        fixed_size += get_arg_size((log_arg_type_t)site->arg_types[i]);
+    }
+    pos = sizeof(hdr) + hdr.src_len;
+    if (pos + fixed_size > out_size) return 0;
+    str_budget = MIN(out_size - pos - fixed_size, UINT16_MAX - fixed_size);
+    memcpy(out + sizeof(hdr), source, hdr.src_len);
+    for (i = 0; i < site->num_args; i++)
+    {
+        uint64_t val;
+
+        switch ((log_arg_type_t)site->arg_types[i])
+        {
+        case LOG_ARG_INT:     val = (uint64_t)(int64_t)va_arg(args, int);       break;
+        case LOG_ARG_LONG:    val = (uint64_t)(int64_t)va_arg(args, long);      break;
+        case LOG_ARG_LLONG:   val = (uint64_t)va_arg(args, long long);          break;
+        case LOG_ARG_INTMAX:  val = (uint64_t)va_arg(args, intmax_t);           break;
+        case LOG_ARG_SIZE:    val = (uint64_t)va_arg(args, size_t);             break;
+        case LOG_ARG_PTRDIFF: val = (uint64_t)(int64_t)va_arg(args, ptrdiff_t); break;
+        case LOG_ARG_PTR:     val = (uint64_t)(uintptr_t)va_arg(args, void *); break;
+        case LOG_ARG_DOUBLE:
+        {
+            double d = va_arg(args, double);
+            memcpy(&val, &d, sizeof(val));
+            break;
+        }
+        case LOG_ARG_LDOUBLE:
+        {
+            long double ld = va_arg(args, long double);
+            memcpy(out + pos, &ld, sizeof(ld));
+            pos += sizeof(ld);
+            continue;
+        }
+        case LOG_ARG_STR:
+        {
+            const char *str = va_arg(args, const char *);
+            uint16_t str_len;
+
+            if (str == NULL) str = "(null)";
+            str_len = (uint16_t)strnlen(str, str_budget);
+            str_budget -= str_len;
+            memcpy(out + pos, &str_len, sizeof(str_len));
+            memcpy(out + pos + sizeof(str_len), str, str_len);
+            pos += sizeof(str_len) + str_len;
+            continue;
+        }
+        default:
+            return 0;
+        }
+        memcpy(out + pos, &val, sizeof(val));
+        pos += sizeof(val);
+    }
+    hdr.args_len = (uint16_t)(pos - sizeof(hdr) - hdr.src_len);
+    memcpy(out, &hdr, sizeof(hdr));
+    return pos;
+}
+
+/**
+ * Разбирает отложенную запись.
+ *
+ * @param rec    [in]  запись (!= NULL)
+ * @param len    [in]  размер записи в байтах
+ * @param hdr    [out] заголовок (!= NULL)
+ * @param source [out] источник (не NULL-терминирован, длина hdr->src_len) (!= NULL)
+ * @param args   [out] аргументы (длина hdr->args_len) (!= NULL)
+ * @return true - OK, false - запись повреждена.
+ */
+extern
+bool log_deferred_parse(const char          *rec,
+                        size_t               len,
+                        log_deferred_hdr_t  *hdr,
+                        const char         **source,
+                        const char         **args)
+{
+    assert(rec != NULL);
+    assert(hdr != NULL);
+    assert(source != NULL);
+    assert(args != NULL);
+
+    if (len < sizeof(*hdr)) return false;
+    memcpy(hdr, rec, sizeof(*hdr));
+    if (len != sizeof(*hdr) + hdr->src_len + hdr->args_len) return false;
+    if (hdr->level <= LL_INVALID || hdr->level >= LL_CNT) return false;
+    *source = rec + sizeof(*hdr);
+    *args = *source + hdr->src_len;
+    return true;
+}
+
+/**
+ * Форматирует сообщение отложенной записи по строке формата и сохранённым аргументам.
+ *
+ * @param out      [out] буфер для сообщения (!= NULL)
+ * @param out_size [in]  размер буфера в байтах (> 0)
+ * @param fmt      [in]  строка формата (!= NULL)
+ * @param args     [in]  сохранённые аргументы (!= NULL)
+ * @param args_len [in]  размер аргументов в байтах
+ * @return длина сообщения (без учёта обрезания по размеру буфера).
+ */
+extern
+size_t log_deferred_format(char       *out,
+                           size_t      out_size,
+                           const char *fmt,
+                           const char *args,
+                           size_t      args_len)
+{
+    size_t len = 0;
+    size_t args_pos = 0;
+    const char *p = fmt;
+
+    assert(out != NULL);
+    assert(out_size > 0);
+    assert(fmt != NULL);
+    assert(args != NULL);
+
+    /* текущая позиция вывода с учётом обрезания */
+    #define OUT_POS  (out + MIN(len, out_size - 1))
+    #define OUT_LEFT (out_size - MIN(len, out_size - 1))
+    /* прочитать из аргументов значение размера sizeof(var) */
+    #define READ_ARG(var)                                                         \
+        do                                                                        \
+        {                                                                         \
+            if (args_pos + sizeof(var) > args_len) goto out;                      \
+            memcpy(&(var), args + args_pos, sizeof(var));                         \
+            args_pos += sizeof(var);                                              \
+        } while (0)
+    /* вывести одно преобразование с учётом ширины/точности из аргументов */
+    #define PRINT_SPEC(val)                                                                        \
+        ((spec.num_stars == 0) ? snprintf(OUT_POS, OUT_LEFT, spec_buf, val) :                      \
+         (spec.num_stars == 1) ? snprintf(OUT_POS, OUT_LEFT, spec_buf, stars[0], val) :            \
+                                 snprintf(OUT_POS, OUT_LEFT, spec_buf, stars[0], stars[1], val))
+
+    *out = '\0';
+    while (*p)
+    {
+        const char *pct = strchr(p, '%');
+        size_t literal_len = pct ? (size_t)(pct - p) : strlen(p);
+        char spec_buf[LOG_DEFERRED_SPEC_MAX_SIZE];
+        log_fmt_spec_t spec;
+        int stars[2] = {0, 0};
+        int printed = 0;
+        int i;
+
+        /* текст до преобразования */
+        if (literal_len)
+        {
+            size_t copy_len = MIN(literal_len, OUT_LEFT - 1);
+
+            memcpy(OUT_POS, p, copy_len);
+            OUT_POS[copy_len] = '\0';
+            len += literal_len;
+            p += literal_len;
+        }
+        if (pct == NULL) break;
+        if (!parse_spec(pct, &spec)) break;
+        p = pct + spec.len;
+        if (spec.type == LOG_ARG_NONE)
+        {
+            if (OUT_LEFT > 1)
+            {
+                OUT_POS[0] = '%';
+                OUT_POS[1] = '\0';
+            }
+            len++;
+            continue;
+        }
+        memcpy(spec_buf, pct, spec.len);
+        spec_buf[spec.len] = '\0';
+        for (i = 0; i < spec.num_stars; i++)
+        {
+            int64_t star;
+
+            READ_ARG(star);
+            stars[i] = (int)star;
+        }
+        switch (spec.type)
+        {
+        case LOG_ARG_INT:     { int64_t v; READ_ARG(v); printed = PRINT_SPEC((int)v);       break; }
+        case LOG_ARG_LONG:    { int64_t v; READ_ARG(v); printed = PRINT_SPEC((long)v);      break; }
+        case LOG_ARG_LLONG:   { int64_t v; READ_ARG(v); printed = PRINT_SPEC((long long)v); break; }
+        case LOG_ARG_INTMAX:  { int64_t v; READ_ARG(v); printed = PRINT_SPEC((intmax_t)v);  break; }
+        case LOG_ARG_SIZE:    { int64_t v; READ_ARG(v); printed = PRINT_SPEC((size_t)v);    break; }
+        case LOG_ARG_PTRDIFF: { int64_t v; READ_ARG(v); printed = PRINT_SPEC((ptrdiff_t)v); break; }
+        case LOG_ARG_PTR:     { uint64_t v; READ_ARG(v); printed = PRINT_SPEC((void *)(uintptr_t)v); break; }
+        case LOG_ARG_DOUBLE:  { double v; READ_ARG(v); printed = PRINT_SPEC(v); break; }
+        case LOG_ARG_LDOUBLE: { long double v; READ_ARG(v); printed = PRINT_SPEC(v); break; }
+        case LOG_ARG_STR:
+        {
+            uint16_t str_len;
+            char str[UINT16_MAX + 1];
+
+            READ_ARG(str_len);
+            if (args_pos + str_len > args_len) goto out;
+            memcpy(str, args + args_pos, str_len);
+            str[str_len] = '\0';
+            args_pos += str_len;
+            printed = PRINT_SPEC(str);
+            break;
+        }
+        default:
+            goto out;
+        }
+        if (printed > 0) len += (size_t)printed;
+    }
+out:
+    #undef PRINT_SPEC
+    #undef READ_ARG
+    #undef OUT_LEFT
+    #undef OUT_POS
+    return len;
+}
+
+/**
+ * Записывает заголовок кадра двоичного файла журнала.
+ *
+ * @param out  [out] буфер размером не менее LOG_BIN_FRAME_HDR_SIZE (!= NULL)
+ * @param type [in]  тип кадра (LOG_BIN_FRAME_*)
+ * @param len  [in]  длина данных кадра в байтах
+ * @return LOG_BIN_FRAME_HDR_SIZE
+ */
+extern
+size_t log_bin_put_frame_hdr(char     *out,
+                             char      type,
+                             uint32_t  len)
+{
+    assert(out != NULL);
+
+    out[0] = type;
+    memcpy(out + 1, &len, sizeof(len));
+    return LOG_BIN_FRAME_HDR_SIZE;
+}
+
+/**
+ * Записывает кадр сессии двоичного файла журнала.
+ *
+ * @param out      [out] буфер (!= NULL)
+ * @param out_size [in]  размер буфера в байтах
+ * @param layout   [in]  раскладка префикса (LOG_BIN_LAYOUT_*)
+ * @return размер кадра в байтах (кадр записан, только если он не больше out_size).
+ */
+extern
+size_t log_bin_put_session(char     *out,
+                           size_t    out_size,
+                           uint16_t  layout)
+{
+    const uint16_t version = LOG_BIN_VERSION;
+    const size_t len = sizeof(LOG_BIN_MAGIC) - 1 + sizeof(version) + sizeof(layout);
+    char *p = out;
+
+    assert(out != NULL);
+
+    if (LOG_BIN_FRAME_HDR_SIZE + len > out_size) return LOG_BIN_FRAME_HDR_SIZE + len;
+    p += log_bin_put_frame_hdr(p, LOG_BIN_FRAME_SESSION, (uint32_t)len);
+    memcpy(p, LOG_BIN_MAGIC, sizeof(LOG_BIN_MAGIC) - 1);
+    p += sizeof(LOG_BIN_MAGIC) - 1;
+    memcpy(p, &version, sizeof(version));
+    p += sizeof(version);
+    memcpy(p, &layout, sizeof(layout));
+    return LOG_BIN_FRAME_HDR_SIZE + len;
+}
+
+/**
+ * Записывает кадр точки логгирования двоичного файла журнала.
+ *
+ * @param out      [out] буфер (может быть NULL, если out_size == 0)
+ * @param out_size [in]  размер буфера в байтах
+ * @param site_id  [in]  идентификатор зарегистрированной точки
+ * @return размер кадра в байтах (кадр записан, только если он не больше out_size), 0 - точка не зарегистрирована.
+ */
+extern
+size_t log_bin_put_site(char     *out,
+                        size_t    out_size,
+                        uint32_t  site_id)
+{
+    const log_deferred_site_t *site = log_deferred_site_get(site_id);
+    const char *strs[4];
+    size_t len = sizeof(site_id);
+    size_t i;
+    char *p = out;
+
+    if (site == NULL) return 0;
+    strs[0] = site->file;
+    strs[1] = site->line;
+    strs[2] = site->function;
+    strs[3] = site->fmt;
+    for (i = 0; i < TBL_SZ(strs); i++)
+    {
+        len += sizeof(uint16_t) + strnlen(strs[i], UINT16_MAX);
+    }
+    if (LOG_BIN_FRAME_HDR_SIZE + len > out_size) return LOG_BIN_FRAME_HDR_SIZE + len;
+    p += log_bin_put_frame_hdr(p, LOG_BIN_FRAME_SITE, (uint32_t)len);
+    memcpy(p, &site_id, sizeof(site_id));
+    p += sizeof(site_id);
+    for (i = 0; i < TBL_SZ(strs); i++)
+    {
+        p += put_bin_str(p, strs[i]);
+    }
+    return LOG_BIN_FRAME_HDR_SIZE + len;
+}
+
+/**
+ * Упаковывает отложенную запись в кадр двоичного файла журнала. Перед кадром записи
+ * выводится кадр источника, если источника ещё нет в словаре сессии.
+ * Состояние упаковки изменяется, только если кадры записаны.
+ *
+ * @param packer   [in/out] состояние упаковки сессии (!= NULL)
+ * @param rec      [in]     запись (log_deferred_capture()) (!= NULL)
+ * @param len      [in]     размер записи в байтах
+ * @param out      [out]    буфер для кадров (!= NULL)
+ * @param out_size [in]     размер буфера в байтах (достаточно len + LOG_BIN_PACK_MAX_OVERHEAD)
+ * @return размер кадров в байтах, 0 - запись повреждена или не помещается в буфер.
+ */
+extern
+size_t log_bin_pack_record(log_bin_packer_t *packer,
+                           const char       *rec,
+                           size_t            len,
+                           char             *out,
+                           size_t            out_size)
+{
+    const log_deferred_site_t *site;
+    log_deferred_hdr_t hdr;
+    log_bin_source_t *source_slot;
+    const char *source;
+    const char *args;
+    uint32_t source_id;
+    uint64_t ns;
+    size_t rec_pos = 0;
+    size_t pos;
+    size_t args_pos = 0;
+    uint8_t i;
+
+    assert(packer != NULL);
+    assert(rec != NULL);
+    assert(out != NULL);
+
+    if (!log_deferred_parse(rec, len, &hdr, &source, &args)) return 0;
+    site = log_deferred_site_get(hdr.site_id);
+    if (site == NULL) return 0;
+    /* кадры не длиннее записи с запасом LOG_BIN_PACK_MAX_OVERHEAD, дальше размер буфера не проверяется */
+    if (out_size < len + LOG_BIN_PACK_MAX_OVERHEAD) return 0;
+    source_slot = find_source(packer, source, hdr.src_len);
+    source_id = source_slot->id;
+    if (source_id == 0 && packer->num_sources < LOG_BIN_MAX_SOURCES)
+    {
+        /* новый источник словаря */
+        source_id = packer->num_sources + 1;
+        pos = LOG_BIN_FRAME_HDR_SIZE + put_varint(out + LOG_BIN_FRAME_HDR_SIZE, source_id);
+        memcpy(out + pos, source, hdr.src_len);
+        pos += hdr.src_len;
+        (void)log_bin_put_frame_hdr(out, LOG_BIN_FRAME_SOURCE, (uint32_t)(pos - LOG_BIN_FRAME_HDR_SIZE));
+        rec_pos = pos;
+    }
+    pos = rec_pos + LOG_BIN_FRAME_HDR_SIZE;
+    pos += put_varint(out + pos, hdr.site_id);
+    out[pos++] = (char)hdr.level;
+    pos += put_varint(out + pos, source_id);
+    if (source_id == 0)
+    {
+        out[pos++] = (char)hdr.src_len;
+        memcpy(out + pos, source, hdr.src_len);
+        pos += hdr.src_len;
+    }
+    /* записи разных потоков попадают в кольцо не в порядке времени - приращение может быть отрицательным */
+    ns = hdr.sec * 1000000000u + hdr.nsec;
+    pos += put_varint(out + pos, ((ns - packer->last_ns) << 1) ^ (0 - ((ns - packer->last_ns) >> 63)));
+    for (i = 0; i < site->num_args; i++)
+    {
+        log_arg_type_t type = (log_arg_type_t)site->arg_types[i];
+        uint64_t val;
+        uint16_t str_len;
+
+        if (args_pos + get_arg_size(type) > hdr.args_len) return 0;
+        switch (type)
+        {
+        case LOG_ARG_INT: case LOG_ARG_LONG: case LOG_ARG_LLONG:
+        case LOG_ARG_INTMAX: case LOG_ARG_SIZE: case LOG_ARG_PTRDIFF:
+            memcpy(&val, args + args_pos, sizeof(val));
+            pos += put_varint(out + pos, (val << 1) ^ (0 - (val >> 63)));
+            break;
+        case LOG_ARG_PTR:
+            memcpy(&val, args + args_pos, sizeof(val));
+            pos += put_varint(out + pos, val);
+            break;
+        case LOG_ARG_DOUBLE:
+        case LOG_ARG_LDOUBLE:
+            memcpy(out + pos, args + args_pos, get_arg_size(type));
+            pos += get_arg_size(type);
+            break;
+        case LOG_ARG_STR:
+            memcpy(&str_len, args + args_pos, sizeof(str_len));
+            if (args_pos + sizeof(str_len) + str_len > hdr.args_len) return 0;
+            pos += put_varint(out + pos, str_len);
+            memcpy(out + pos, args + args_pos + sizeof(str_len), str_len);
+            pos += str_len;
+            args_pos += str_len;
+            break;
+        default:
+            return 0;
+        }
+        args_pos += get_arg_size(type);
+    }
+    if (args_pos != hdr.args_len) return 0;
+    (void)log_bin_put_frame_hdr(out + rec_pos, LOG_BIN_FRAME_RECORD, (uint32_t)(pos - rec_pos - LOG_BIN_FRAME_HDR_SIZE));
+    if (source_slot->id == 0 && source_id != 0)
+    {
+        memcpy(source_slot->name, source, hdr.src_len);
+        source_slot->len = hdr.src_len;
+        source_slot->id = (uint16_t)source_id;
+        packer->num_sources++;
+    }
+    packer->last_ns = ns;
+    return pos;
+}
+
+/**
+ * Возвращает идентификатор точки логгирования кадра записи.
+ *
+ * @param payload [in]  данные кадра (!= NULL)
+ * @param len     [in]  длина данных кадра в байтах
+ * @param site_id [out] идентификатор точки (!= NULL)
+ * @return true - OK, false - кадр повреждён.
+ */
+extern
+bool log_bin_get_record_site(const char *payload,
+                             size_t      len,
+                             uint32_t   *site_id)
+{
+    size_t pos = 0;
+    uint64_t val;
+
+    assert(payload != NULL);
+    assert(site_id != NULL);
+
+    if (!get_varint(payload, len, &pos, &val) || val == 0 || val >= LOG_DEFERRED_UNSUPPORTED) return false;
+    *site_id = (uint32_t)val;
+    return true;
+}
+
+/**
+ * Распаковывает кадр записи в отложенную запись (как log_deferred_capture()).
+ * Время предыдущей записи обновляется, даже если аргументы разобрать не удалось,
+ * чтобы повреждённая запись не искажала время следующих.
+ *
+ * @param payload  [in]     данные кадра (!= NULL)
+ * @param len      [in]     длина данных кадра в байтах
+ * @param site     [in]     описание точки логгирования записи (NULL - точка неизвестна)
+ * @param sources  [in]     словарь источников сессии по номеру - 1 (ptr == NULL - источник отсутствует) (!= NULL)
+ * @param last_ns  [in/out] время предыдущей записи сессии, нс (!= NULL)
+ * @param out      [out]    буфер для записи (!= NULL)
+ * @param out_size [in]     размер буфера в байтах
+ * @return размер записи в байтах, 0 - кадр повреждён.
+ */
+extern
+size_t log_bin_unpack_record(const char                *payload,
+                             size_t                     len,
+                             const log_deferred_site_t *site,
+                             const log_bin_str_t        sources[LOG_BIN_MAX_SOURCES],
+                             uint64_t                  *last_ns,
+                             char                      *out,
+                             size_t                     out_size)
+{
+    log_deferred_hdr_t hdr;
+    const char *source;
+    size_t pos = 0;
+    size_t out_pos;
+    uint64_t val;
+    uint8_t i;
+
+    assert(payload != NULL);
+    assert(sources != NULL);
+    assert(last_ns != NULL);
+    assert(out != NULL);
+
+    ZEROIZE_STRUCT(hdr);
+    if (!get_varint(payload, len, &pos, &val) || val == 0 || val >= LOG_DEFERRED_UNSUPPORTED) return 0;
+    hdr.site_id = (uint32_t)val;
+    if (pos >= len) return 0;
+    hdr.level = (uint8_t)payload[pos++];
+    if (!get_varint(payload, len, &pos, &val)) return 0;
+    if (val == 0)
+    {
+        if (pos >= len) return 0;
+        hdr.src_len = (uint8_t)payload[pos++];
+        if (hdr.src_len > LOG_DEFERRED_SRC_MAX_SIZE || len - pos < hdr.src_len) return 0;
+        source = payload + pos;
+        pos += hdr.src_len;
+    }
+    else
+    {
+        if (val > LOG_BIN_MAX_SOURCES || sources[val - 1].ptr == NULL) return 0;
+        source = sources[val - 1].ptr;
+        hdr.src_len = (uint8_t)MIN(sources[val - 1].len, LOG_DEFERRED_SRC_MAX_SIZE);
+    }
+    if (!get_varint(payload, len, &pos, &val)) return 0;
+    *last_ns += (val >> 1) ^ (0 - (val & 1));
+    hdr.sec = *last_ns / 1000000000u;
+    hdr.nsec = (uint32_t)(*last_ns % 1000000000u);
+    if (site == NULL) return 0;
+    out_pos = sizeof(hdr);
+    if (!append(out, out_size, &out_pos, source, hdr.src_len)) return 0;
+    for (i = 0; i < site->num_args; i++)
+    {
+        log_arg_type_t type = (log_arg_type_t)site->arg_types[i];
+        uint16_t str_len;
+
+        switch (type)
+        {
+        case LOG_ARG_INT: case LOG_ARG_LONG: case LOG_ARG_LLONG:
+        case LOG_ARG_INTMAX: case LOG_ARG_SIZE: case LOG_ARG_PTRDIFF:
+            if (!get_varint(payload, len, &pos, &val)) return 0;
+            val = (val >> 1) ^ (0 - (val & 1));
+            if (!append(out, out_size, &out_pos, &val, sizeof(val))) return 0;
+            break;
+        case LOG_ARG_PTR:
+            if (!get_varint(payload, len, &pos, &val)) return 0;
+            if (!append(out, out_size, &out_pos, &val, sizeof(val))) return 0;
+            break;
+        case LOG_ARG_DOUBLE:
+        case LOG_ARG_LDOUBLE:
+            if (len - pos < get_arg_size(type)) return 0;
+            if (!append(out, out_size, &out_pos, payload + pos, get_arg_size(type))) return 0;
+            pos += get_arg_size(type);
+            break;
+        case LOG_ARG_STR:
+            if (!get_varint(payload, len, &pos, &val) || val > UINT16_MAX || len - pos < val) return 0;
+            str_len = (uint16_t)val;
+            if (!append(out, out_size, &out_pos, &str_len, sizeof(str_len))) return 0;
+            if (!append(out, out_size, &out_pos, payload + pos, str_len)) return 0;
+            pos += str_len;
+            break;
+        default:
+            return 0;
+        }
+    }
+    if (pos != len || out_pos - sizeof(hdr) - hdr.src_len > UINT16_MAX) return 0;
+    hdr.args_len = (uint16_t)(out_pos - sizeof(hdr) - hdr.src_len);
+    memcpy(out, &hdr, sizeof(hdr));
+    return out_pos;
+}
+
+/**
+ * Разбирает очередной кадр двоичного файла журнала.
+ *
+ * @param data    [in]  данные (!= NULL)
+ * @param size    [in]  размер данных в байтах
+ * @param type    [out] тип кадра (!= NULL)
+ * @param payload [out] данные кадра (!= NULL)
+ * @param len     [out] длина данных кадра в байтах (!= NULL)
+ * @return полный размер кадра в байтах, 0 - кадр неполон.
+ */
+extern
+size_t log_bin_get_frame(const char  *data,
+                         size_t       size,
+                         char        *type,
+                         const char **payload,
+                         size_t      *len)
+{
+    uint32_t frame_len;
+
+    assert(data != NULL);
+    assert(type != NULL);
+    assert(payload != NULL);
+    assert(len != NULL);
+
+    if (size < LOG_BIN_FRAME_HDR_SIZE) return 0;
+    memcpy(&frame_len, data + 1, sizeof(frame_len));
+    if (size - LOG_BIN_FRAME_HDR_SIZE < frame_len) return 0;
+    *type = data[0];
+    *payload = data + LOG_BIN_FRAME_HDR_SIZE;
+    *len = frame_len;
+    return LOG_BIN_FRAME_HDR_SIZE + (size_t)frame_len;
+}
+
+/**
+ * Разбирает данные кадра сессии.
+ *
+ * @param payload [in]  данные кадра (!= NULL)
+ * @param len     [in]  длина данных кадра в байтах
+ * @param version [out] версия формата (!= NULL)
+ * @param layout  [out] раскладка префикса (!= NULL)
+ * @return true - OK, false - кадр повреждён.
+ */
+extern
+bool log_bin_get_session(const char *payload,
+                         size_t      len,
+                         uint16_t   *version,
+                         uint16_t   *layout)
+{
+    const size_t magic_len = sizeof(LOG_BIN_MAGIC) - 1;
+
+    assert(payload != NULL);
+    assert(version != NULL);
+    assert(layout != NULL);
+
+    if (len != magic_len + sizeof(*version) + sizeof(*layout)) return false;
+    if (memcmp(payload, LOG_BIN_MAGIC, magic_len) != 0) return false;
+    memcpy(version, payload + magic_len, sizeof(*version));
+    memcpy(layout, payload + magic_len + sizeof(*version), sizeof(*layout));
+    return true;
+}
+
+/**
+ * Разбирает данные кадра точки логгирования.
+ *
+ * @param payload [in]  данные кадра (!= NULL)
+ * @param len     [in]  длина данных кадра в байтах
+ * @param site_id [out] идентификатор точки (!= NULL)
+ * @param strs    [out] файл, строка, функция, формат (!= NULL)
+ * @return true - OK, false - кадр повреждён.
+ */
+extern
+bool log_bin_get_site(const char    *payload,
+                      size_t         len,
+                      uint32_t      *site_id,
+                      log_bin_str_t  strs[4])
+{
+    size_t pos = sizeof(*site_id);
+    size_t i;
+
+    assert(payload != NULL);
+    assert(site_id != NULL);
+    assert(strs != NULL);
+
+    if (len < pos) return false;
+    memcpy(site_id, payload, sizeof(*site_id));
+    for (i = 0; i < 4; i++)
+    {
+        if (len - pos < sizeof(strs[i].len)) return false;
+        memcpy(&strs[i].len, payload + pos, sizeof(strs[i].len));
+        pos += sizeof(strs[i].len);
+        if (len - pos < strs[i].len) return false;
+        strs[i].ptr = payload + pos;
+        pos += strs[i].len;
+    }
+    return (pos == len);
+}
+
+/**
+ * Разбирает данные кадра источника.
+ *
+ * @param payload   [in]  данные кадра (!= NULL)
+ * @param len       [in]  длина данных кадра в байтах
+ * @param source_id [out] номер источника (1..LOG_BIN_MAX_SOURCES) (!= NULL)
+ * @param name      [out] имя источника (!= NULL)
+ * @return true - OK, false - кадр повреждён.
+ */
+extern
+bool log_bin_get_source(const char    *payload,
+                        size_t         len,
+                        uint32_t      *source_id,
+                        log_bin_str_t *name)
+{
+    size_t pos = 0;
+    uint64_t val;
+
+    assert(payload != NULL);
+    assert(source_id != NULL);
+    assert(name != NULL);
+
+    if (!get_varint(payload, len, &pos, &val) || val == 0 || val > LOG_BIN_MAX_SOURCES) return false;
+    if (len - pos > LOG_DEFERRED_SRC_MAX_SIZE) return false;
+    *source_id = (uint32_t)val;
+    name->ptr = payload + pos;
+    name->len = (uint16_t)(len - pos);
+    return true;
+}
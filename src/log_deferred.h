@@ -0,0 +1,450 @@
+#ifndef LOG_DEFERRED_H_
+#define LOG_DEFERRED_H_
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "log.h"
+
+/**
+ * Максимальное количество аргументов у строки формата отложенной записи
+ */
+#define LOG_DEFERRED_MAX_ARGS 32
+
+/**
+ * Максимальная сохраняемая длина источника (отображается только LOG_SRC_MAX_SIZE символов)
+ */
+#define LOG_DEFERRED_SRC_MAX_SIZE 16
+
+/**
+ * Максимальная длина строки формата отложенной записи (более длинные форматируются сразу)
+ */
+#define LOG_DEFERRED_FMT_MAX_SIZE 4096
+
+/**
+ * Идентификатор точки логгирования, строка формата которой не поддерживает отложенное форматирование
+ */
+#define LOG_DEFERRED_UNSUPPORTED UINT32_MAX
+
+/**
+ * Двоичный файл журнала - последовательность кадров: тип (1 байт), длина данных (4 байта), данные.
+ * Каждый запуск начинается кадром сессии, словарь (кадры точек логгирования и источников) действует
+ * до следующего кадра сессии и может располагаться в любом месте сессии.
+ * Числа фиксированной длины записываются в порядке байт записывающей машины, varint - по 7 бит
+ * начиная с младших, zigzag - знаковое число как varint (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...).
+ * Время записи хранится как zigzag-приращение в наносекундах к времени предыдущей записи сессии.
+ */
+#define LOG_BIN_FRAME_SESSION 'H' ///< сессия: LOG_BIN_MAGIC, версия (2 байта), раскладка префикса (2 байта)
+#define LOG_BIN_FRAME_SITE    'S' ///< точка логгирования: идентификатор (4 байта), файл, строка, функция, формат (2 байта длины + символы)
+#define LOG_BIN_FRAME_SOURCE  'N' ///< источник: номер (varint, 1..LOG_BIN_MAX_SOURCES), имя
+#define LOG_BIN_FRAME_RECORD  'R' ///< отложенная запись: точка (varint), уровень (1 байт), источник (varint номер, 0 - далее длина (1 байт) и имя), приращение времени (zigzag), аргументы
+#define LOG_BIN_FRAME_TEXT    'T' ///< сформированный текст (сырые дампы, записи с неподдерживаемым форматом)
+
+/**
+ * Размер заголовка кадра двоичного файла журнала
+ */
+#define LOG_BIN_FRAME_HDR_SIZE 5
+
+/**
+ * Сигнатура кадра сессии
+ */
+#define LOG_BIN_MAGIC "COSLOG"
+
+/**
+ * Версия формата двоичного файла журнала
+ */
+#define LOG_BIN_VERSION 2
+
+/**
+ * Максимальное количество источников в словаре сессии (имена остальных хранятся в каждой записи)
+ */
+#define LOG_BIN_MAX_SOURCES 256
+
+/**
+ * Максимальное увеличение отложенной записи при упаковке в кадры двоичного файла журнала:
+ * заголовки кадров записи и источника, кадр источника, до 2 байт на каждый аргумент
+ * (varint 64-битного числа занимает до 10 байт вместо 8)
+ */
+#define LOG_BIN_PACK_MAX_OVERHEAD (2 * LOG_BIN_FRAME_HDR_SIZE + 2 + LOG_DEFERRED_SRC_MAX_SIZE + 2 * LOG_DEFERRED_MAX_ARGS)
+
+/**
+ * Флаги раскладки префикса записи (опции сборки, с которыми записан файл)
+ */
+#define LOG_BIN_LAYOUT_TIME     0x0001u ///< DO_LOG_CURRENT_TIME
+#define LOG_BIN_LAYOUT_FUNCTION 0x0002u ///< DO_LOG_FUNCTION_NAME
+
+/**
+ * Строка кадра двоичного файла журнала (не NULL-терминирована)
+ */
+typedef struct tag_log_bin_str
+{
+    const char *ptr; ///< символы
+    uint16_t    len; ///< длина
+}
+log_bin_str_t;
+
+/**
+ * Типы аргументов отложенной записи (определяют размер и приведение при форматировании).
+ * В скобках - размер в записи кольца / в кадре двоичного файла журнала.
+ */
+typedef enum tag_log_arg_type
+{
+    LOG_ARG_INT,     ///< int, char, short (8 байт / zigzag)
+    LOG_ARG_LONG,    ///< long (8 байт / zigzag)
+    LOG_ARG_LLONG,   ///< long long (8 байт / zigzag)
+    LOG_ARG_INTMAX,  ///< intmax_t (8 байт / zigzag)
+    LOG_ARG_SIZE,    ///< size_t (8 байт / zigzag)
+    LOG_ARG_PTRDIFF, ///< ptrdiff_t (8 байт / zigzag)
+    LOG_ARG_DOUBLE,  ///< double, float (8 байт)
+    LOG_ARG_LDOUBLE, ///< long double (sizeof(long double) байт)
+    LOG_ARG_STR,     ///< строка (2 байта длины / varint длины + символы без 0)
+    LOG_ARG_PTR,     ///< указатель (8 байт / varint)
+
+    LOG_ARG_CNT
+}
+log_arg_type_t;
+
+/**
+ * Описание точки логгирования с отложенным форматированием
+ */
+typedef struct tag_log_deferred_site
+{
+    const char *file;                             ///< имя файла
+    const char *line;                             ///< номер строки в файле
+    const char *function;                         ///< имя функции
+    const char *fmt;                              ///< строка формата
+    uint8_t     num_args;                         ///< количество аргументов
+    uint8_t     arg_types[LOG_DEFERRED_MAX_ARGS]; ///< типы аргументов (log_arg_type_t)
+}
+log_deferred_site_t;
+
+/**
+ * Заголовок отложенной записи. За ним следуют src_len байт источника и args_len байт аргументов.
+ */
+typedef struct tag_log_deferred_hdr
+{
+    uint64_t sec;      ///< время записи: секунды
+    uint32_t nsec;     ///< время записи: наносекунды
+    uint32_t site_id;  ///< идентификатор точки логгирования
+    uint16_t args_len; ///< размер аргументов в байтах
+    uint8_t  level;    ///< уровень лога
+    uint8_t  src_len;  ///< длина источника
+}
+log_deferred_hdr_t;
+
+/**
+ * Источник словаря сессии двоичного файла журнала (элемент хэш-таблицы log_bin_packer_t)
+ */
+typedef struct tag_log_bin_source
+{
+    char     name[LOG_DEFERRED_SRC_MAX_SIZE]; ///< имя
+    uint8_t  len;                             ///< длина имени
+    uint16_t id;                              ///< номер в словаре (0 - элемент свободен)
+}
+log_bin_source_t;
+
+/**
+ * Состояние упаковки записей сессии двоичного файла журнала (обнуляется в начале сессии)
+ */
+typedef struct tag_log_bin_packer
+{
+    uint64_t         last_ns;                          ///< время предыдущей записи сессии, нс
+    uint32_t         num_sources;                      ///< количество источников в словаре
+    log_bin_source_t sources[2 * LOG_BIN_MAX_SOURCES]; ///< хэш-таблица источников словаря (открытая адресация)
+}
+log_bin_packer_t;
+
+/**
+ * Заполняет описание точки логгирования и определяет типы аргументов строки формата.
+ *
+ * @param site     [out] описание точки (!= NULL)
+ * @param file     [in]  имя файла (!= NULL)
+ * @param line     [in]  номер строки в файле (!= NULL)
+ * @param function [in]  имя функции (!= NULL)
+ * @param fmt      [in]  строка формата (!= NULL)
+ * @return true - OK, false - строка формата не поддерживается отложенным форматированием.
+ */
+extern
+bool log_deferred_site_init(log_deferred_site_t *site,
+                            const char          *file,
+                            const char          *line,
+                            const char          *function,
+                            const char          *fmt) __attribute__((nonnull(1, 2, 3, 4, 5)));
+
+/**
+ * Регистрирует точку логгирования (однократно для каждого log_callsite_t).
+ * Строки должны существовать всё время работы процесса (как строковые литералы макросов),
+ * точки не удаляются до завершения процесса.
+ *
+ * @param callsite [in/out] кеш точки логгирования, куда сохраняется идентификатор (!= NULL)
+ * @param file     [in] имя файла (!= NULL)
+ * @param line     [in] номер строки в файле (!= NULL)
+ * @param function [in] имя функции (!= NULL)
+ * @param fmt      [in] строка формата (!= NULL)
+ * @return идентификатор точки, LOG_DEFERRED_UNSUPPORTED - строка формата не поддерживается.
+ */
+extern
+uint32_t log_deferred_site_register(log_callsite_t *callsite,
+                                    const char     *file,
+                                    const char     *line,
+                                    const char     *function,
+                                    const char     *fmt) __attribute__((nonnull(1, 2, 3, 4, 5)));
+
+/**
+ * Возвращает описание зарегистрированной точки логгирования.
+ *
+ * @param site_id [in] идентификатор точки
+ * @return описание или NULL, если точка не зарегистрирована.
+ */
+extern
+const log_deferred_site_t *log_deferred_site_get(uint32_t site_id) __attribute__((warn_unused_result));
+
+/**
+ * Возвращает количество зарегистрированных точек логгирования (идентификаторы 1..N).
+ *
+ * @return количество точек.
+ */
+extern
+uint32_t log_deferred_site_count(void) __attribute__((warn_unused_result));
+
+/**
+ * Формирует отложенную запись: заголовок, источник и аргументы в двоичном виде.
+ * Строковые аргументы обрезаются, если запись не помещается в буфер.
+ *
+ * @param out      [out] буфер для записи (!= NULL)
+ * @param out_size [in]  размер буфера в байтах
+ * @param site_id  [in]  идентификатор точки логгирования
+ * @param level    [in]  уровень лога
+ * @param source   [in]  источник (!= NULL)
+ * @param ts       [in]  время записи (!= NULL)
+ * @param args     [in]  аргументы строки формата точки
+ * @return размер записи в байтах или 0 в случае ошибки.
+ */
+extern
+size_t log_deferred_capture(char                  *out,
+                            size_t                 out_size,
+                            uint32_t               site_id,
+                            log_level_t            level,
+                            const char            *source,
+                            const struct timespec *ts,
+                            va_list                args) __attribute__((nonnull(1, 5, 6)));
+
+/**
+ * Разбирает отложенную запись.
+ *
+ * @param rec    [in]  запись (!= NULL)
+ * @param len    [in]  размер записи в байтах
+ * @param hdr    [out] заголовок (!= NULL)
+ * @param source [out] источник (не NULL-терминирован, длина hdr->src_len) (!= NULL)
+ * @param args   [out] аргументы (длина hdr->args_len) (!= NULL)
+ * @return true - OK, false - запись повреждена.
+ */
+extern
+bool log_deferred_parse(const char          *rec,
+                        size_t               len,
+                        log_deferred_hdr_t  *hdr,
+                        const char         **source,
+                        const char         **args) __attribute__((nonnull(1, 3, 4, 5)));
+
+/**
+ * Форматирует сообщение отложенной записи по строке формата и сохранённым аргументам.
+ *
+ * @param out      [out] буфер для сообщения (!= NULL)
+ * @param out_size [in]  размер буфера в байтах (> 0)
+ * @param fmt      [in]  строка формата (!= NULL)
+ * @param args     [in]  сохранённые аргументы (!= NULL)
+ * @param args_len [in]  размер аргументов в байтах
+ * @return длина сообщения (без учёта обрезания по размеру буфера).
+ */
+extern
+size_t log_deferred_format(char       *out,
+                           size_t      out_size,
+                           const char *fmt,
+                           const char *args,
+                           size_t      args_len) __attribute__((nonnull(1, 3, 4)));
+
+/**
+ * Записывает заголовок кадра двоичного файла журнала.
+ *
+ * @param out  [out] буфер размером не менее LOG_BIN_FRAME_HDR_SIZE (!= NULL)
+ * @param type [in]  тип кадра (LOG_BIN_FRAME_*)
+ * @param len  [in]  длина данных кадра в байтах
+ * @return LOG_BIN_FRAME_HDR_SIZE
+ */
+extern
+size_t log_bin_put_frame_hdr(char     *out,
+                             char      type,
+                             uint32_t  len) __attribute__((nonnull(1)));
+
+/**
+ * Записывает кадр сессии двоичного файла журнала.
+ *
+ * @param out      [out] буфер (!= NULL)
+ * @param out_size [in]  размер буфера в байтах
+ * @param layout   [in]  раскладка префикса (LOG_BIN_LAYOUT_*)
+ * @return размер кадра в байтах (кадр записан, только если он не больше out_size).
+ */
+extern
+size_t log_bin_put_session(char     *out,
+                           size_t    out_size,
+                           uint16_t  layout) __attribute__((nonnull(1)));
+
+/**
+ * Записывает кадр точки логгирования двоичного файла журнала.
+ *
+ * @param out      [out] буфер (может быть NULL, если out_size == 0)
+ * @param out_size [in]  размер буфера в байтах
+ * @param site_id  [in]  идентификатор зарегистрированной точки
+ * @return размер кадра в байтах (кадр записан, только если он не больше out_size), 0 - точка не зарегистрирована.
+ */
+extern
+size_t log_bin_put_site(char     *out,
+                        size_t    out_size,
+                        uint32_t  site_id);
+
+/**
+ * Упаковывает отложенную запись в кадр двоичного файла журнала. Перед кадром записи
+ * выводится кадр источника, если источника ещё нет в словаре сессии.
+ * Состояние упаковки изменяется, только если кадры записаны.
+ *
+ * @param packer   [in/out] состояние упаковки сессии (!= NULL)
+ * @param rec      [in]     запись (log_deferred_capture()) (!= NULL)
+ * @param len      [in]     размер записи в байтах
+ * @param out      [out]    буфер для кадров (!= NULL)
+ * @param out_size [in]     размер буфера в байтах (достаточно len + LOG_BIN_PACK_MAX_OVERHEAD)
+ * @return размер кадров в байтах, 0 - запись повреждена или не помещается в буфер.
+ */
+extern
+size_t log_bin_pack_record(log_bin_packer_t *packer,
+                           const char       *rec,
+                           size_t            len,
+                           char             *out,
+                           size_t            out_size) __attribute__((nonnull(1, 2, 4)));
+
+/**
+ * Возвращает идентификатор точки логгирования кадра записи.
+ *
+ * @param payload [in]  данные кадра (!= NULL)
+ * @param len     [in]  длина данных кадра в байтах
+ * @param site_id [out] идентификатор точки (!= NULL)
+ * @return true - OK, false - кадр повреждён.
+ */
+extern
+bool log_bin_get_record_site(const char *payload,
+                             size_t      len,
+                             uint32_t   *site_id) __attribute__((nonnull(1, 3)));
+
+/**
+ * Распаковывает кадр записи в отложенную запись (как log_deferred_capture()).
+ * Время предыдущей записи обновляется, даже если аргументы разобрать не удалось,
+ * чтобы повреждённая запись не искажала время следующих.
+ *
+ * @param payload  [in]     данные кадра (!= NULL)
+ * @param len      [in]     длина данных кадра в байтах
+ * @param site     [in]     описание точки логгирования записи (NULL - точка неизвестна)
+ * @param sources  [in]     словарь источников сессии по номеру - 1 (ptr == NULL - источник отсутствует) (!= NULL)
+ * @param last_ns  [in/out] время предыдущей записи сессии, нс (!= NULL)
+ * @param out      [out]    буфер для записи (!= NULL)
+ * @param out_size [in]     размер буфера в байтах
+ * @return размер записи в байтах, 0 - кадр повреждён.
+ */
+extern
+size_t log_bin_unpack_record(const char                *payload,
+                             size_t                     len,
+                             const log_deferred_site_t *site,
+                             const log_bin_str_t        sources[LOG_BIN_MAX_SOURCES],
+                             uint64_t                  *last_ns,
+                             char                      *out,
+                             size_t                     out_size) __attribute__((nonnull(1, 4, 5, 6)));
+
+/**
+ * Разбирает очередной кадр двоичного файла журнала.
+ *
+ * @param data    [in]  данные (!= NULL)
+ * @param size    [in]  размер данных в байтах
+ * @param type    [out] тип кадра (!= NULL)
+ * @param payload [out] данные кадра (!= NULL)
+ * @param len     [out] длина данных кадра в байтах (!= NULL)
+ * @return полный размер кадра в байтах, 0 - кадр неполон.
+ */
+extern
+size_t log_bin_get_frame(const char  *data,
+                         size_t       size,
+                         char        *type,
+                         const char **payload,
+                         size_t      *len) __attribute__((nonnull(1, 3, 4, 5)));
+
+/**
+ * Разбирает данные кадра сессии.
+ *
+ * @param payload [in]  данные кадра (!= NULL)
+ * @param len     [in]  длина данных кадра в байтах
+ * @param version [out] версия формата (!= NULL)
+ * @param layout  [out] раскладка префикса (!= NULL)
+ * @return true - OK, false - кадр повреждён.
+ */
+extern
+bool log_bin_get_session(const char *payload,
+                         size_t      len,
+                         uint16_t   *version,
+                         uint16_t   *layout) __attribute__((nonnull(1, 3, 4)));
+
+/**
+ * Разбирает данные кадра точки логгирования.
+ *
+ * @param payload [in]  данные кадра (!= NULL)
+ * @param len     [in]  длина данных кадра в байтах
+ * @param site_id [out] идентификатор точки (!= NULL)
+ * @param strs    [out] файл, строка, функция, формат (!= NULL)
+ * @return true - OK, false - кадр повреждён.
+ */
+extern
+bool log_bin_get_site(const char    *payload,
+                      size_t         len,
+                      uint32_t      *site_id,
+                      log_bin_str_t  strs[4]) __attribute__((nonnull(1, 3, 4)));
+
+/**
+ * Разбирает данные кадра источника.
+ *
+ * @param payload   [in]  данные кадра (!= NULL)
+ * @param len       [in]  длина данных кадра в байтах
+ * @param source_id [out] номер источника (1..LOG_BIN_MAX_SOURCES) (!= NULL)
+ * @param name      [out] имя источника (!= NULL)
+ * @return true - OK, false - кадр повреждён.
+ */
+extern
+bool log_bin_get_source(const char    *payload,
+                        size_t         len,
+                        uint32_t      *source_id,
+                        log_bin_str_t *name) __attribute__((nonnull(1, 3, 4)));
+
+/**
+ * Формирует текст отложенной записи в раскладке compose_log_prefix() (реализована в log.c).
+ *
+ * @param rec      [in]  двоичная запись (!= NULL)
+ * @param len      [in]  размер записи в байтах
+ * @param site     [in]  описание точки логгирования записи (!= NULL)
+ * @param out      [out] буфер для текста (!= NULL)
+ * @param out_size [in]  размер буфера в байтах
+ * @return длина текста в байтах, 0 - запись повреждена.
+ */
+extern
+size_t log_deferred_render(const char                *rec,
+                           size_t                     len,
+                           const log_deferred_site_t *site,
+                           char                      *out,
+                           size_t                     out_size) __attribute__((nonnull(1, 3, 4)));
+
+/**
+ * Возвращает раскладку префикса, с которой собрана библиотека (реализована в log.c).
+ *
+ * @return флаги LOG_BIN_LAYOUT_*.
+ */
+extern
+uint16_t log_deferred_layout(void) __attribute__((warn_unused_result));
+
+#endif /* LOG_DEFERRED_H_ */
@@ -0,0 +1,714 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define _LOG_SRC "UNKNOWN"
+#include "log.h"
+
+/**
+ * Размер буфера по-умолчанию
+ */
+#define LOG_FILE_SINK_DEFAULT_BUFFER_SIZE 65536
+
+/**
+ * Максимальное время нахождения записей в буфере по-умолчанию
+ */
+#define LOG_FILE_SINK_DEFAULT_IDLE_FLUSH_MS 1000
+
+/**
+ * Количество хранимых старых файлов ротации по-умолчанию
+ */
+#define LOG_ROTATE_DEFAULT_MAX_FILES 5
+
+/**
+ * Запас размера буфера пути под суффикс ".<номер>"
+ */
+#define LOG_ROTATE_SUFFIX_SIZE 16
+
+/**
+ * Контекст буферизованного файлового приёмника
+ */
+typedef struct tag_log_file_sink
+{
+    int              fd;            /*!< файловый дескриптор */
+    pthread_mutex_t  mutex;         /*!< мьютекс буфера (запись лога и фоновый поток сброса) */
+    pthread_cond_t   cond;          /*!< оповещение фонового потока о появлении данных и остановке */
+    pthread_t        thread;        /*!< фоновый поток сброса */
+    bool             stop;          /*!< запрос остановки фонового потока */
+    log_level_t      flush_level;   /*!< уровень немедленного сброса */
+    unsigned         idle_flush_ms; /*!< максимальное время нахождения записей в буфере */
+    struct timespec  first_write;   /*!< время попадания в пустой буфер первых данных (CLOCK_MONOTONIC) */
+    size_t           len;           /*!< заполненный размер буфера */
+    size_t           size;          /*!< размер буфера */
+    char            *buf;           /*!< буфер */
+}
+log_file_sink_t;
+
+/**
+ * Контекст файлового приёмника с ротацией
+ */
+typedef struct tag_log_rotating_sink
+{
+    pthread_rwlock_t  fd_lock;           /*!< защита дескриптора: запись - под чтением, подмена - под записью */
+    int               fd;                /*!< файловый дескриптор текущего файла */
+    uint64_t          written;           /*!< размер текущего файла в байтах */
+    bool              rotate_requested;  /*!< запрошена ротация */
+    pthread_mutex_t   mutex;             /*!< мьютекс состояния фонового потока */
+    pthread_cond_t    cond;              /*!< оповещение фонового потока о запросе ротации и остановке */
+    pthread_t         thread;            /*!< фоновый поток ротации */
+    bool              stop;              /*!< запрос остановки фонового потока */
+    size_t            max_size;          /*!< размер файла для ротации (0 - без ротации по размеру) */
+    unsigned          interval_sec;      /*!< период ротации (0 - без ротации по времени) */
+    unsigned          max_files;         /*!< количество хранимых старых файлов */
+    struct timespec   opened;            /*!< время создания текущего файла (CLOCK_MONOTONIC) */
+    char             *path;              /*!< путь к файлу */
+    char             *from_path;         /*!< буфер пути переименовываемого файла */
+    char             *to_path;           /*!< буфер нового пути переименовываемого файла */
+    size_t            path_size;         /*!< размер буферов путей */
+}
+log_rotating_sink_t;
+
+/**
+ * Выводит векторы одним вызовом writev(2) (повторяя его только при частичной записи).
+ *
+ * @param fd     [in]     файловый дескриптор
+ * @param iov    [in/out] векторы (изменяются) (!= NULL)
+ * @param iovcnt [in]     количество векторов
+ */
+static
+void writev_all(int           fd,
+                struct iovec *iov,
+                int           iovcnt) __attribute__((nonnull(2)));
+
+/**
+ * Выводит буфер и, если задано, данные за ним одним вызовом writev(2) (вызывается под мьютексом приёмника).
+ *
+ * @param fs   [in/out] приёмник (!= NULL)
+ * @param data [in]     данные после буфера (может быть NULL)
+ * @param len  [in]     размер данных в байтах
+ */
+static
+void flush_locked(log_file_sink_t *fs,
+                  const char      *data,
+                  size_t           len) __attribute__((nonnull(1)));
+
+/**
+ * Операция write приёмника.
+ *
+ * @param ctx   [in] контекст (log_file_sink_t *) (!= NULL)
+ * @param data  [in] данные (!= NULL)
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void file_sink_write(void        *ctx,
+                     const char  *data,
+                     size_t       len,
+                     log_level_t  level) __attribute__((nonnull(1, 2)));
+
+/**
+ * Операция flush приёмника.
+ *
+ * @param ctx [in] контекст (log_file_sink_t *) (!= NULL)
+ */
+static
+void file_sink_flush(void *ctx) __attribute__((nonnull(1)));
+
+/**
+ * Операция close приёмника: останавливает фоновый поток, сбрасывает буфер и закрывает файл.
+ *
+ * @param ctx [in] контекст (log_file_sink_t *) (!= NULL)
+ */
+static
+void file_sink_close(void *ctx) __attribute__((nonnull(1)));
+
+/**
+ * Тело фонового потока сброса буфера по времени.
+ *
+ * @param arg [in] приёмник (log_file_sink_t *) (!= NULL)
+ * @return NULL
+ */
+static
+void *flush_thread(void *arg);
+
+/**
+ * Освобождает приёмник (файл не закрывается).
+ *
+ * @param fs [in] приёмник (!= NULL)
+ */
+static
+void free_file_sink(log_file_sink_t *fs) __attribute__((nonnull(1)));
+
+/**
+ * Операция write приёмника с ротацией.
+ *
+ * @param ctx   [in] контекст (log_rotating_sink_t *) (!= NULL)
+ * @param data  [in] данные (!= NULL)
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void rotating_sink_write(void        *ctx,
+                         const char  *data,
+                         size_t       len,
+                         log_level_t  level) __attribute__((nonnull(1, 2)));
+
+/**
+ * Операция close приёмника с ротацией: останавливает фоновый поток и закрывает файл.
+ *
+ * @param ctx [in] контекст (log_rotating_sink_t *) (!= NULL)
+ */
+static
+void rotating_sink_close(void *ctx) __attribute__((nonnull(1)));
+
+/**
+ * Выполняет ротацию: сдвигает старые файлы, переименовывает текущий, создаёт новый и подменяет дескриптор.
+ * Вызывается фоновым потоком без мьютекса состояния.
+ *
+ * @param rs [in/out] приёмник (!= NULL)
+ */
+static
+void rotate_files(log_rotating_sink_t *rs) __attribute__((nonnull(1)));
+
+/**
+ * Тело фонового потока ротации.
+ *
+ * @param arg [in] приёмник (log_rotating_sink_t *) (!= NULL)
+ * @return NULL
+ */
+static
+void *rotate_thread(void *arg);
+
+/**
+ * Освобождает приёмник с ротацией (файл не закрывается).
+ *
+ * @param rs [in] приёмник (!= NULL)
+ */
+static
+void free_rotating_sink(log_rotating_sink_t *rs) __attribute__((nonnull(1)));
+
+/**
+ * Выводит векторы одним вызовом writev(2) (повторяя его только при частичной записи).
+ *
+ * @param fd     [in]     файловый дескриптор
+ * @param iov    [in/out] векторы (изменяются) (!= NULL)
+ * @param iovcnt [in]     количество векторов
+ */
+static
+void writev_all(int           fd,
+                struct iovec *iov,
+                int           iovcnt)
+{
+    assert(iov != NULL);
+
+    while (iovcnt > 0)
+    {
+        ssize_t res = writev(fd, iov, iovcnt);
+        size_t written;
+
+        if (res < 0)
+        {
+            if (errno == EINTR) continue;
+            return;
+        }
+        written = (size_t)res;
+        /* пропустить полностью выведенные векторы */
+        while (iovcnt > 0 && written >= iov->iov_len)
+        {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+/**
+ * Выводит буфер и, если задано, данные за ним одним вызовом writev(2) (вызывается под мьютексом приёмника).
+ *
+ * @param fs   [in/out] приёмник (!= NULL)
+ * @param data [in]     данные после буфера (может быть NULL)
+ * @param len  [in]     размер данных в байтах
+ */
+static
+void flush_locked(log_file_sink_t *fs,
+                  const char      *data,
+                  size_t           len)
+{
+    struct iovec iov[2];
+    int iovcnt = 0;
+
+    assert(fs != NULL);
+
+    if (fs->len)
+    {
+        iov[iovcnt].iov_base = fs->buf;
+        iov[iovcnt].iov_len = fs->len;
+        iovcnt++;
+    }
+    if (data && len)
+    {
+        iov[iovcnt].iov_base = (void *)data;
+        iov[iovcnt].iov_len = len;
+        iovcnt++;
+    }
+    if (iovcnt) writev_all(fs->fd, iov, iovcnt);
+    fs->len = 0;
+}
+
+/**
+ * Операция write приёмника.
+ *
+ * @param ctx   [in] контекст (log_file_sink_t *) (!= NULL)
+ * @param data  [in] данные (!= NULL)
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void file_sink_write(void        *ctx,
+                     const char  *data,
+                     size_t       len,
+                     log_level_t  level)
+{
+    log_file_sink_t *fs = (log_file_sink_t *)ctx;
+
+    assert(ctx != NULL);
+    assert(data != NULL);
+
+    pthread_mutex_lock(&fs->mutex);
+    if ((fs->len + len > fs->size) || (level >= fs->flush_level))
+    {
+        /* буфер и новые записи выводятся одним системным вызовом, без копирования */
+        flush_locked(fs, data, len);
+    }
+    else
+    {
+        if (fs->len == 0)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &fs->first_write);
+            /* запустить отсчёт времени сброса */
+            pthread_cond_signal(&fs->cond);
+        }
+        memcpy(fs->buf + fs->len, data, len);
+        fs->len += len;
+    }
+    pthread_mutex_unlock(&fs->mutex);
+}
+
+/**
+ * Операция flush приёмника.
+ *
+ * @param ctx [in] контекст (log_file_sink_t *) (!= NULL)
+ */
+static
+void file_sink_flush(void *ctx)
+{
+    log_file_sink_t *fs = (log_file_sink_t *)ctx;
+
+    assert(ctx != NULL);
+
+    pthread_mutex_lock(&fs->mutex);
+    flush_locked(fs, NULL, 0);
+    pthread_mutex_unlock(&fs->mutex);
+}
+
+/**
+ * Операция close приёмника: останавливает фоновый поток, сбрасывает буфер и закрывает файл.
+ *
+ * @param ctx [in] контекст (log_file_sink_t *) (!= NULL)
+ */
+static
+void file_sink_close(void *ctx)
+{
+    log_file_sink_t *fs = (log_file_sink_t *)ctx;
+
+    assert(ctx != NULL);
+
+    pthread_mutex_lock(&fs->mutex);
+    fs->stop = true;
+    pthread_cond_signal(&fs->cond);
+    pthread_mutex_unlock(&fs->mutex);
+    pthread_join(fs->thread, NULL);
+    flush_locked(fs, NULL, 0);
+    close(fs->fd);
+    free_file_sink(fs);
+}
+
+/**
+ * Тело фонового потока сброса буфера по времени.
+ *
+ * @param arg [in] приёмник (log_file_sink_t *) (!= NULL)
+ * @return NULL
+ */
+static
+void *flush_thread(void *arg)
+{
+    log_file_sink_t *fs = (log_file_sink_t *)arg;
+
+    assert(arg != NULL);
+
+    pthread_mutex_lock(&fs->mutex);
+    while (!fs->stop)
+    {
+        if (fs->len == 0)
+        {
+            pthread_cond_wait(&fs->cond, &fs->mutex);
+        }
+        else
+        {
+            struct timespec deadline = fs->first_write;
+            struct timespec now;
+
+            deadline.tv_sec += (time_t)(fs->idle_flush_ms / 1000);
+            deadline.tv_nsec += (long)(fs->idle_flush_ms % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L)
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if ((now.tv_sec > deadline.tv_sec) || ((now.tv_sec == deadline.tv_sec) && (now.tv_nsec >= deadline.tv_nsec)))
+            {
+                flush_locked(fs, NULL, 0);
+            }
+            else
+            {
+                /* буфер могли сбросить и заполнить снова - время проверяется заново после пробуждения */
+                pthread_cond_timedwait(&fs->cond, &fs->mutex, &deadline);
+            }
+        }
+    }
+    pthread_mutex_unlock(&fs->mutex);
+    return NULL;
+}
+
+/**
+ * Освобождает приёмник (файл не закрывается).
+ *
+ * @param fs [in] приёмник (!= NULL)
+ */
+static
+void free_file_sink(log_file_sink_t *fs)
+{
+    assert(fs != NULL);
+
+    pthread_cond_destroy(&fs->cond);
+    pthread_mutex_destroy(&fs->mutex);
+    free(fs->buf);
+    free(fs);
+}
+
+/**
+ * Операция write приёмника с ротацией.
+ *
+ * @param ctx   [in] контекст (log_rotating_sink_t *) (!= NULL)
+ * @param data  [in] данные (!= NULL)
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void rotating_sink_write(void        *ctx,
+                         const char  *data,
+                         size_t       len,
+                         log_level_t  level)
+{
+    log_rotating_sink_t *rs = (log_rotating_sink_t *)ctx;
+    struct iovec iov;
+    uint64_t written;
+
+    assert(ctx != NULL);
+    assert(data != NULL);
+    UNUSED_PARAM(level);
+
+    iov.iov_base = (void *)data;
+    iov.iov_len = len;
+    /* фоновый поток удерживает блокировку на запись только на время подмены дескриптора */
+    pthread_rwlock_rdlock(&rs->fd_lock);
+    writev_all(rs->fd, &iov, 1);
+    written = __atomic_add_fetch(&rs->written, len, __ATOMIC_RELAXED);
+    pthread_rwlock_unlock(&rs->fd_lock);
+    if (rs->max_size && written >= rs->max_size && !__atomic_exchange_n(&rs->rotate_requested, true, __ATOMIC_RELAXED))
+    {
+        pthread_mutex_lock(&rs->mutex);
+        pthread_cond_signal(&rs->cond);
+        pthread_mutex_unlock(&rs->mutex);
+    }
+}
+
+/**
+ * Операция close приёмника с ротацией: останавливает фоновый поток и закрывает файл.
+ *
+ * @param ctx [in] контекст (log_rotating_sink_t *) (!= NULL)
+ */
+static
+void rotating_sink_close(void *ctx)
+{
+    log_rotating_sink_t *rs = (log_rotating_sink_t *)ctx;
+
+    assert(ctx != NULL);
+
+    pthread_mutex_lock(&rs->mutex);
+    rs->stop = true;
+    pthread_cond_signal(&rs->cond);
+    pthread_mutex_unlock(&rs->mutex);
+    pthread_join(rs->thread, NULL);
+    close(rs->fd);
+    free_rotating_sink(rs);
+}
+
+/**
+ * Выполняет ротацию: сдвигает старые файлы, переименовывает текущий, создаёт новый и подменяет дескриптор.
+ * Вызывается фоновым потоком без мьютекса состояния.
+ *
+ * @param rs [in/out] приёмник (!= NULL)
+ */
+static
+void rotate_files(log_rotating_sink_t *rs)
+{
+    unsigned i;
+    int fd;
+    int old_fd;
+    bool rotated = false;
+
+    assert(rs != NULL);
+
+    /* самый старый файл замещается при переименовании */
+    for (i = rs->max_files - 1; i > 0; i--)
+    {
+        snprintf(rs->from_path, rs->path_size, "%s.%u", rs->path, i);
+        snprintf(rs->to_path, rs->path_size, "%s.%u", rs->path, i + 1);
+        (void)rename(rs->from_path, rs->to_path);
+    }
+    snprintf(rs->to_path, rs->path_size, "%s.1", rs->path);
+    /* до подмены дескриптора записи продолжают дописываться в переименованный файл */
+    if (rename(rs->path, rs->to_path) == 0)
+    {
+        fd = open(rs->path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd >= 0)
+        {
+            pthread_rwlock_wrlock(&rs->fd_lock);
+            old_fd = rs->fd;
+            rs->fd = fd;
+            __atomic_store_n(&rs->written, 0, __ATOMIC_RELAXED);
+            pthread_rwlock_unlock(&rs->fd_lock);
+            close(old_fd);
+            rotated = true;
+        }
+    }
+    /* при ошибке вывод продолжается в прежний файл, ротация повторится после max_size новых байт или следующего периода */
+    if (!rotated) __atomic_store_n(&rs->written, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&rs->rotate_requested, false, __ATOMIC_RELAXED);
+    clock_gettime(CLOCK_MONOTONIC, &rs->opened);
+}
+
+/**
+ * Тело фонового потока ротации.
+ *
+ * @param arg [in] приёмник (log_rotating_sink_t *) (!= NULL)
+ * @return NULL
+ */
+static
+void *rotate_thread(void *arg)
+{
+    log_rotating_sink_t *rs = (log_rotating_sink_t *)arg;
+
+    assert(arg != NULL);
+
+    pthread_mutex_lock(&rs->mutex);
+    while (!rs->stop)
+    {
+        if (__atomic_load_n(&rs->rotate_requested, __ATOMIC_RELAXED))
+        {
+            pthread_mutex_unlock(&rs->mutex);
+            rotate_files(rs);
+            pthread_mutex_lock(&rs->mutex);
+        }
+        else if (rs->interval_sec)
+        {
+            struct timespec deadline = rs->opened;
+            struct timespec now;
+
+            deadline.tv_sec += (time_t)rs->interval_sec;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if ((now.tv_sec > deadline.tv_sec) || ((now.tv_sec == deadline.tv_sec) && (now.tv_nsec >= deadline.tv_nsec)))
+            {
+                /* пустой файл не ротируется */
+                if (__atomic_load_n(&rs->written, __ATOMIC_RELAXED)) __atomic_store_n(&rs->rotate_requested, true, __ATOMIC_RELAXED);
+                else rs->opened = now;
+            }
+            else
+            {
+                pthread_cond_timedwait(&rs->cond, &rs->mutex, &deadline);
+            }
+        }
+        else
+        {
+            pthread_cond_wait(&rs->cond, &rs->mutex);
+        }
+    }
+    pthread_mutex_unlock(&rs->mutex);
+    return NULL;
+}
+
+/**
+ * Освобождает приёмник с ротацией (файл не закрывается).
+ *
+ * @param rs [in] приёмник (!= NULL)
+ */
+static
+void free_rotating_sink(log_rotating_sink_t *rs)
+{
+    assert(rs != NULL);
+
+    pthread_cond_destroy(&rs->cond);
+    pthread_mutex_destroy(&rs->mutex);
+    pthread_rwlock_destroy(&rs->fd_lock);
+    free(rs->to_path);
+    free(rs->from_path);
+    free(rs->path);
+    free(rs);
+}
+
+/**
+ * Добавляет приёмник, дописывающий записи в файл через буфер: записи накапливаются в буфере и выводятся
+ * одним вызовом writev(2) вместе с записью, не поместившейся в буфер. Буфер также сбрасывается
+ * через idle_flush_ms после попадания в него данных (фоновым потоком приёмника) и сразу после
+ * записи уровня flush_level и выше.
+ *
+ * @param path          [in] путь к файлу (!= NULL).
+ * @param min_log_level [in] минимальный уровень записей для приёмника.
+ * @param config        [in] параметры (NULL - по-умолчанию).
+ * @return приёмник или NULL в случае ошибки.
+ */
+extern
+log_sink_t *log_sink_add_buffered_file(const char                   *path,
+                                       log_level_t                   min_log_level,
+                                       const log_file_sink_config_t *config)
+{
+    log_file_sink_t *fs;
+    log_sink_ops_t ops;
+    log_sink_t *sink;
+    pthread_condattr_t cond_attr;
+
+    assert(path != NULL);
+
+    if (config && (config->flush_level < LL_INVALID || config->flush_level >= LL_CNT)) return NULL;
+    fs = calloc(1, sizeof(*fs));
+    if (fs == NULL) return NULL;
+    fs->size = (config && config->buffer_size) ? config->buffer_size : LOG_FILE_SINK_DEFAULT_BUFFER_SIZE;
+    fs->idle_flush_ms = (config && config->idle_flush_ms) ? config->idle_flush_ms : LOG_FILE_SINK_DEFAULT_IDLE_FLUSH_MS;
+    fs->flush_level = (config && config->flush_level != LL_INVALID) ? config->flush_level : LL_ERROR;
+    fs->buf = malloc(fs->size);
+    if (fs->buf == NULL)
+    {
+        free(fs);
+        return NULL;
+    }
+    /* ожидание по монотонным часам не зависит от перевода системного времени */
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&fs->cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    pthread_mutex_init(&fs->mutex, NULL);
+    fs->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fs->fd < 0)
+    {
+        free_file_sink(fs);
+        return NULL;
+    }
+    if (pthread_create(&fs->thread, NULL, flush_thread, fs) != 0)
+    {
+        close(fs->fd);
+        free_file_sink(fs);
+        return NULL;
+    }
+    ZEROIZE_STRUCT(ops);
+    ops.write = file_sink_write;
+    ops.flush = file_sink_flush;
+    ops.close = file_sink_close;
+    sink = log_sink_add(&ops, fs, min_log_level);
+    if (sink == NULL) file_sink_close(fs);
+    return sink;
+}
+
+/**
+ * Добавляет приёмник, дописывающий записи в файл с ротацией по размеру и/или по времени:
+ * файл переименовывается в "<path>.1" (старые файлы сдвигаются, самый старый удаляется) и создаётся заново.
+ * Переименование и создание файла выполняет фоновый поток приёмника, после чего атомарно
+ * подменяет дескриптор: до подмены записи дописываются в прежний файл и не теряются,
+ * логгирующие потоки не ожидают ввода-вывода ротации.
+ *
+ * @param path          [in] путь к файлу (!= NULL).
+ * @param min_log_level [in] минимальный уровень записей для приёмника.
+ * @param config        [in] параметры ротации (!= NULL).
+ * @return приёмник или NULL в случае ошибки.
+ */
+extern
+log_sink_t *log_sink_add_rotating_file(const char                *path,
+                                       log_level_t                min_log_level,
+                                       const log_rotate_config_t *config)
+{
+    log_rotating_sink_t *rs;
+    log_sink_ops_t ops;
+    log_sink_t *sink;
+    pthread_condattr_t cond_attr;
+    struct stat st;
+
+    assert(path != NULL);
+    assert(config != NULL);
+
+    rs = calloc(1, sizeof(*rs));
+    if (rs == NULL) return NULL;
+    rs->max_size = config->max_size;
+    rs->interval_sec = config->interval_sec;
+    rs->max_files = config->max_files ? config->max_files : LOG_ROTATE_DEFAULT_MAX_FILES;
+    rs->path_size = strlen(path) + LOG_ROTATE_SUFFIX_SIZE;
+    rs->path = strdup(path);
+    rs->from_path = malloc(rs->path_size);
+    rs->to_path = malloc(rs->path_size);
+    pthread_rwlock_init(&rs->fd_lock, NULL);
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&rs->cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    pthread_mutex_init(&rs->mutex, NULL);
+    if (rs->path == NULL || rs->from_path == NULL || rs->to_path == NULL)
+    {
+        free_rotating_sink(rs);
+        return NULL;
+    }
+    rs->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (rs->fd < 0)
+    {
+        free_rotating_sink(rs);
+        return NULL;
+    }
+    /* файл дописывается: размер для ротации отсчитывается от существующего содержимого */
+    if (fstat(rs->fd, &st) == 0) rs->written = (uint64_t)st.st_size;
+    if (rs->max_size && rs->written >= rs->max_size) rs->rotate_requested = true;
+    clock_gettime(CLOCK_MONOTONIC, &rs->opened);
+    if (pthread_create(&rs->thread, NULL, rotate_thread, rs) != 0)
+    {
+        close(rs->fd);
+        free_rotating_sink(rs);
+        return NULL;
+    }
+    ZEROIZE_STRUCT(ops);
+    ops.write = rotating_sink_write;
+    ops.close = rotating_sink_close;
+    sink = log_sink_add(&ops, rs, min_log_level);
+    if (sink == NULL) rotating_sink_close(rs);
+    return sink;
+}
@@ -0,0 +1,301 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define _LOG_SRC "UNKNOWN"
+#include "log.h"
+#include "log_flight.h"
+
+/**
+ * Количество сигналов аварийного завершения
+ */
+#define LOG_FLIGHT_NUM_CRASH_SIGNALS 5
+
+/**
+ * Сигналы аварийного завершения, при которых сохраняется дамп
+ */
+static
+const int log_flight_crash_signals[LOG_FLIGHT_NUM_CRASH_SIGNALS] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+
+/**
+ * Контекст бортового самописца
+ */
+typedef struct tag_log_flight
+{
+    char             *ring;                                          /*!< кольцо записей (NULL - самописец выключен) */
+    size_t            size;                                          /*!< размер кольца в байтах (степень 2) */
+    uint64_t          head;                                          /*!< позиция следующей записи (всего записано байт) */
+    char             *path;                                          /*!< файл дампа по-умолчанию */
+    bool              crash_dump;                                    /*!< установлены обработчики аварийных сигналов */
+    int               dump_signal;                                   /*!< сигнал дампа (0 - нет) */
+    struct sigaction  old_crash[LOG_FLIGHT_NUM_CRASH_SIGNALS];       /*!< прежние обработчики аварийных сигналов */
+    struct sigaction  old_dump;                                      /*!< прежний обработчик сигнала дампа */
+}
+log_flight_t;
+
+static
+log_flight_t log_flight; ///< глобальный контекст бортового самописца.
+
+/**
+ * Выводит данные в файловый дескриптор вызовами write(2) (допускается в обработчике сигнала).
+ *
+ * @param fd   [in] файловый дескриптор
+ * @param data [in] данные (!= NULL)
+ * @param len  [in] размер данных в байтах
+ */
+static
+void write_all(int         fd,
+               const char *data,
+               size_t      len) __attribute__((nonnull(2)));
+
+/**
+ * Выводит содержимое кольца, начиная с самой старой целой записи (допускается в обработчике сигнала).
+ *
+ * @param fd [in] файловый дескриптор
+ */
+static
+void dump_ring(int fd);
+
+/**
+ * Сохраняет дамп кольца в файл (допускается в обработчике сигнала).
+ *
+ * @param path [in] путь к файлу (!= NULL)
+ * @return true - OK, false - Fail
+ */
+static
+bool dump_to_file(const char *path) __attribute__((nonnull(1)));
+
+/**
+ * Обработчик сигналов самописца: сохраняет дамп, для аварийных сигналов затем
+ * восстанавливает прежний обработчик и повторяет сигнал.
+ *
+ * @param sig [in] номер сигнала
+ */
+static
+void flight_signal_handler(int sig);
+
+/**
+ * Выводит данные в файловый дескриптор вызовами write(2) (допускается в обработчике сигнала).
+ *
+ * @param fd   [in] файловый дескриптор
+ * @param data [in] данные (!= NULL)
+ * @param len  [in] размер данных в байтах
+ */
+static
+void write_all(int         fd,
+               const char *data,
+               size_t      len)
+{
+    assert(data != NULL);
+
+    while (len > 0)
+    {
+        ssize_t res = write(fd, data, len);
+
+        if (res < 0)
+        {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += res;
+        len -= (size_t)res;
+    }
+}
+
+/**
+ * Выводит содержимое кольца, начиная с самой старой целой записи (допускается в обработчике сигнала).
+ *
+ * @param fd [in] файловый дескриптор
+ */
+static
+void dump_ring(int fd)
+{
+    uint64_t head = __atomic_load_n(&log_flight.head, __ATOMIC_ACQUIRE);
+    uint64_t pos = 0;
+
+    if (head > log_flight.size)
+    {
+        /* начало кольца перезаписано посередине записи: пропустить её остаток */
+        pos = head - log_flight.size;
+        while (pos < head && log_flight.ring[pos & (log_flight.size - 1)] != '\n') pos++;
+        pos++;
+    }
+    while (pos < head)
+    {
+        size_t offset = (size_t)(pos & (log_flight.size - 1));
+        size_t len = (size_t)MIN(head - pos, (uint64_t)(log_flight.size - offset));
+
+        write_all(fd, log_flight.ring + offset, len);
+        pos += len;
+    }
+}
+
+/**
+ * Сохраняет дамп кольца в файл (допускается в обработчике сигнала).
+ *
+ * @param path [in] путь к файлу (!= NULL)
+ * @return true - OK, false - Fail
+ */
+static
+bool dump_to_file(const char *path)
+{
+    int fd;
+
+    assert(path != NULL);
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    dump_ring(fd);
+    close(fd);
+    return true;
+}
+
+/**
+ * Обработчик сигналов самописца: сохраняет дамп, для аварийных сигналов затем
+ * восстанавливает прежний обработчик и повторяет сигнал.
+ *
+ * @param sig [in] номер сигнала
+ */
+static
+void flight_signal_handler(int sig)
+{
+    int saved_errno = errno;
+    size_t i;
+
+    if (log_flight.ring) (void)dump_to_file(log_flight.path);
+    for (i = 0; i < LOG_FLIGHT_NUM_CRASH_SIGNALS; i++)
+    {
+        if (log_flight_crash_signals[i] == sig && sig != log_flight.dump_signal)
+        {
+            /* сигнал заблокирован до выхода из обработчика и будет доставлен прежнему обработчику */
+            sigaction(sig, &log_flight.old_crash[i], NULL);
+            raise(sig);
+            break;
+        }
+    }
+    errno = saved_errno;
+}
+
+/**
+ * Создаёт кольцо самописца и, если задано, устанавливает обработчики сигналов.
+ *
+ * @param size         [in] размер кольца в байтах (округляется вверх до степени 2)
+ * @param path         [in] файл дампа по-умолчанию (копируется) (!= NULL)
+ * @param crash_dump   [in] сохранять дамп при SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT
+ * @param dump_signal  [in] сигнал, по которому сохраняется дамп (0 - нет)
+ * @return true - OK, false - Fail
+ */
+extern
+bool log_flight_init(size_t      size,
+                     const char *path,
+                     bool        crash_dump,
+                     int         dump_signal)
+{
+    struct sigaction action;
+    size_t i;
+
+    assert(path != NULL);
+
+    if (log_flight.ring || size == 0 || dump_signal < 0) return false;
+    /* округлить размер кольца вверх до степени 2 */
+    while (size & (size - 1))
+    {
+        size = (size | (size - 1)) + 1;
+    }
+    log_flight.path = strdup(path);
+    if (log_flight.path == NULL) return false;
+    /* страницы кольца выделяются сразу: запись не должна вызывать ошибок страниц при первом обороте */
+    log_flight.ring = malloc(size);
+    if (log_flight.ring == NULL)
+    {
+        free(log_flight.path);
+        log_flight.path = NULL;
+        return false;
+    }
+    memset(log_flight.ring, '\n', size);
+    log_flight.size = size;
+    log_flight.head = 0;
+    log_flight.crash_dump = crash_dump;
+    log_flight.dump_signal = dump_signal;
+    ZEROIZE_STRUCT(action);
+    action.sa_handler = flight_signal_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (crash_dump)
+    {
+        for (i = 0; i < LOG_FLIGHT_NUM_CRASH_SIGNALS; i++)
+        {
+            sigaction(log_flight_crash_signals[i], &action, &log_flight.old_crash[i]);
+        }
+    }
+    if (dump_signal) sigaction(dump_signal, &action, &log_flight.old_dump);
+    return true;
+}
+
+/**
+ * Восстанавливает обработчики сигналов и освобождает кольцо самописца.
+ */
+extern
+void log_flight_destroy(void)
+{
+    char *ring = log_flight.ring;
+    size_t i;
+
+    if (ring == NULL) return;
+    if (log_flight.crash_dump)
+    {
+        for (i = 0; i < LOG_FLIGHT_NUM_CRASH_SIGNALS; i++)
+        {
+            sigaction(log_flight_crash_signals[i], &log_flight.old_crash[i], NULL);
+        }
+    }
+    if (log_flight.dump_signal) sigaction(log_flight.dump_signal, &log_flight.old_dump, NULL);
+    __atomic_store_n(&log_flight.ring, NULL, __ATOMIC_RELEASE);
+    free(ring);
+    free(log_flight.path);
+    log_flight.path = NULL;
+}
+
+/**
+ * Добавляет запись в кольцо самописца (самые старые записи перезаписываются).
+ *
+ * @param data [in] запись (!= NULL)
+ * @param len  [in] размер записи в байтах
+ */
+extern
+void log_flight_record(const char *data,
+                       size_t      len)
+{
+    uint64_t pos;
+    size_t offset;
+    size_t first;
+
+    assert(data != NULL);
+
+    if (log_flight.ring == NULL || len > log_flight.size) return;
+    /* место резервируется без блокировок, записи разных потоков копируются параллельно */
+    pos = __atomic_fetch_add(&log_flight.head, (uint64_t)len, __ATOMIC_RELAXED);
+    offset = (size_t)(pos & (log_flight.size - 1));
+    first = MIN(len, log_flight.size - offset);
+    memcpy(log_flight.ring + offset, data, first);
+    memcpy(log_flight.ring, data + first, len - first);
+}
+
+/**
+ * Сохраняет дамп бортового самописца в файл (см. log_config_t.flight_recorder_size).
+ * Записи, добавляемые во время дампа, могут оказаться в нём частично.
+ *
+ * @param path [in] путь к файлу (NULL - log_config_t.flight_recorder_path).
+ * @return true - OK, false - самописец выключен или файл не создан.
+ */
+extern
+bool log_flight_recorder_dump(const char *path)
+{
+    if (log_flight.ring == NULL) return false;
+    return dump_to_file(path ? path : log_flight.path);
+}
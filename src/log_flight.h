@@ -0,0 +1,43 @@
+#ifndef LOG_FLIGHT_H_
+#define LOG_FLIGHT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Бортовой самописец: кольцо в памяти с последними сформированными записями.
+ * Записи добавляются без блокировок, дамп кольца допускается из обработчика сигнала.
+ */
+
+/**
+ * Создаёт кольцо самописца и, если задано, устанавливает обработчики сигналов.
+ *
+ * @param size         [in] размер кольца в байтах (округляется вверх до степени 2)
+ * @param path         [in] файл дампа по-умолчанию (копируется) (!= NULL)
+ * @param crash_dump   [in] сохранять дамп при SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT
+ * @param dump_signal  [in] сигнал, по которому сохраняется дамп (0 - нет)
+ * @return true - OK, false - Fail
+ */
+extern
+bool log_flight_init(size_t      size,
+                     const char *path,
+                     bool        crash_dump,
+                     int         dump_signal) __attribute__((nonnull(2))) __attribute__((warn_unused_result));
+
+/**
+ * Восстанавливает обработчики сигналов и освобождает кольцо самописца.
+ */
+extern
+void log_flight_destroy(void);
+
+/**
+ * Добавляет запись в кольцо самописца (самые старые записи перезаписываются).
+ *
+ * @param data [in] запись (!= NULL)
+ * @param len  [in] размер записи в байтах
+ */
+extern
+void log_flight_record(const char *data,
+                       size_t      len) __attribute__((nonnull(1)));
+
+#endif /* LOG_FLIGHT_H_ */
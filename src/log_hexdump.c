@@ -0,0 +1,340 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "macros.h"
+#include "log_hexdump.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define LOG_HEXDUMP_X86 1
+#include <immintrin.h>
+#else
+#define LOG_HEXDUMP_X86 0
+#endif
+
+/**
+ * Минимальная ширина поля адреса строки дампа
+ */
+#define LOG_HEXDUMP_ADDR_FIELD_WIDTH 8
+
+/**
+ * Количество байт в строке дампа
+ */
+#define LOG_HEXDUMP_LINE_BYTES 16
+
+static
+const char hex_digits[] = "0123456789ABCDEF"; ///< HEX цифры.
+
+#if LOG_HEXDUMP_X86
+/**
+ * Таблицы pshufb для раскладки 32 HEX цифр строки в 48 символов " XX" * 16:
+ * для каждой из трёх 16-байтных частей результата - индексы в первой (байты 0..7)
+ * и второй (байты 8..15) половинах пар цифр (0x80 - ноль), и пробелы-разделители.
+ */
+static
+const unsigned char hex_shuf_lo[3][16] __attribute__((aligned(16))) =
+{
+    { 0x80,    0,    1, 0x80,    2,    3, 0x80,    4,    5, 0x80,    6,    7, 0x80,    8,    9, 0x80 },
+    {   10,   11, 0x80,   12,   13, 0x80,   14,   15, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 }
+};
+static
+const unsigned char hex_shuf_hi[3][16] __attribute__((aligned(16))) =
+{
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,    0,    1, 0x80,    2,    3, 0x80,    4 },
+    {    5, 0x80,    6,    7, 0x80,    8,    9, 0x80,   10,   11, 0x80,   12,   13, 0x80,   14,   15 }
+};
+static
+const char hex_spaces[3][16] __attribute__((aligned(16))) =
+{
+    { ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ' },
+    { 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0 },
+    { 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0 }
+};
+#endif
+
+/**
+ * Записывает адрес строки дампа ("%.8zX  ").
+ *
+ * @param out  [out] буфер (!= NULL)
+ * @param addr [in]  адрес
+ * @return указатель за записанными символами.
+ */
+static inline
+char *put_addr(char   *out,
+               size_t  addr) __attribute__((nonnull(1)));
+
+/**
+ * Формирует неполную строку дампа (скалярно).
+ *
+ * @param out  [out] буфер (!= NULL)
+ * @param in   [in]  байты строки (!= NULL)
+ * @param n    [in]  количество байт (<= 16)
+ * @param addr [in]  адрес строки
+ * @return указатель за сформированной строкой.
+ */
+static
+char *put_line_scalar(char                *out,
+                      const unsigned char *in,
+                      size_t               n,
+                      size_t               addr) __attribute__((nonnull(1, 2)));
+
+#if LOG_HEXDUMP_X86
+/**
+ * Формирует полную строку дампа (SSE2).
+ *
+ * @param out  [out] буфер (!= NULL)
+ * @param in   [in]  16 байт строки (!= NULL)
+ * @param addr [in]  адрес строки
+ * @return указатель за сформированной строкой.
+ */
+static
+char *put_line_sse2(char                *out,
+                    const unsigned char *in,
+                    size_t               addr) __attribute__((nonnull(1, 2)));
+
+/**
+ * Формирует две полные строки дампа (AVX2, по строке в каждой 128-битной половине регистра).
+ *
+ * @param out  [out] буфер (!= NULL)
+ * @param in   [in]  32 байта строк (!= NULL)
+ * @param addr [in]  адрес первой строки
+ * @return указатель за сформированными строками.
+ */
+static
+char *put_2lines_avx2(char                *out,
+                      const unsigned char *in,
+                      size_t               addr) __attribute__((nonnull(1, 2))) __attribute__((target("avx2")));
+#endif
+
+/**
+ * Записывает адрес строки дампа ("%.8zX  ").
+ *
+ * @param out  [out] буфер (!= NULL)
+ * @param addr [in]  адрес
+ * @return указатель за записанными символами.
+ */
+static inline
+char *put_addr(char   *out,
+               size_t  addr)
+{
+    int width = LOG_HEXDUMP_ADDR_FIELD_WIDTH;
+    int i;
+
+    assert(out != NULL);
+
+    while (width < (int)(sizeof(addr) * 2) && (addr >> (width * 4)) != 0) width++;
+    for (i = width - 1; i >= 0; i--)
+    {
+        out[i] = hex_digits[addr & 0xF];
+        addr >>= 4;
+    }
+    out[width] = ' ';
+    out[width + 1] = ' ';
+    return out + width + 2;
+}
+
+/**
+ * Формирует неполную строку дампа (скалярно).
+ *
+ * @param out  [out] буфер (!= NULL)
+ * @param in   [in]  байты строки (!= NULL)
+ * @param n    [in]  количество байт (<= 16)
+ * @param addr [in]  адрес строки
+ * @return указатель за сформированной строкой.
+ */
+static
+char *put_line_scalar(char                *out,
+                      const unsigned char *in,
+                      size_t               n,
+                      size_t               addr)
+{
+    size_t i;
+
+    assert(out != NULL);
+    assert(in != NULL);
+    assert(n <= LOG_HEXDUMP_LINE_BYTES);
+
+    out = put_addr(out, addr);
+    /* HEX представления байт */
+    for (i = 0; i < n; i++)
+    {
+        out[0] = ' ';
+        out[1] = hex_digits[in[i] >> 4];
+        out[2] = hex_digits[in[i] & 0xF];
+        out += 3;
+    }
+    /* добиваем оставшуюся часть (если есть) пробелами */
+    memset(out, ' ', (LOG_HEXDUMP_LINE_BYTES - n) * 3);
+    out += (LOG_HEXDUMP_LINE_BYTES - n) * 3;
+    memcpy(out, " | ", 3);
+    out += 3;
+    /* текстовое представление байт (как isprint() в локали "C") */
+    for (i = 0; i < n; i++)
+    {
+        *out++ = (char)((in[i] >= 0x20 && in[i] < 0x7F) ? in[i] : '.');
+    }
+    /* не добиваем пробелами текстовое представление, так как это последний элемент строки */
+    *out++ = '\n';
+    return out;
+}
+
+#if LOG_HEXDUMP_X86
+/**
+ * Формирует полную строку дампа (SSE2).
+ *
+ * @param out  [out] буфер (!= NULL)
+ * @param in   [in]  16 байт строки (!= NULL)
+ * @param addr [in]  адрес строки
+ * @return указатель за сформированной строкой.
+ */
+static
+char *put_line_sse2(char                *out,
+                    const unsigned char *in,
+                    size_t               addr)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i v = _mm_loadu_si128((const __m128i *)in);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+    __m128i lo = _mm_and_si128(v, nibble);
+    __m128i printable;
+    char pairs[32];
+    int i;
+
+    /* цифра: n + '0', для n > 9 ещё + ('A' - '9' - 1) */
+    hi = _mm_add_epi8(_mm_add_epi8(hi, _mm_set1_epi8('0')),
+                      _mm_and_si128(_mm_cmpgt_epi8(hi, _mm_set1_epi8(9)), _mm_set1_epi8('A' - '9' - 1)));
+    lo = _mm_add_epi8(_mm_add_epi8(lo, _mm_set1_epi8('0')),
+                      _mm_and_si128(_mm_cmpgt_epi8(lo, _mm_set1_epi8(9)), _mm_set1_epi8('A' - '9' - 1)));
+    _mm_storeu_si128((__m128i *)pairs, _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i *)(pairs + 16), _mm_unpackhi_epi8(hi, lo));
+    /* печатаемые 0x20..0x7E: знаковое сравнение отсекает байты >= 0x80 */
+    printable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1F)), _mm_cmplt_epi8(v, _mm_set1_epi8(0x7F)));
+
+    out = put_addr(out, addr);
+    for (i = 0; i < LOG_HEXDUMP_LINE_BYTES; i++)
+    {
+        out[0] = ' ';
+        out[1] = pairs[2 * i];
+        out[2] = pairs[2 * i + 1];
+        out += 3;
+    }
+    memcpy(out, " | ", 3);
+    out += 3;
+    _mm_storeu_si128((__m128i *)out, _mm_or_si128(_mm_and_si128(printable, v),
+                                                  _mm_andnot_si128(printable, _mm_set1_epi8('.'))));
+    out += LOG_HEXDUMP_LINE_BYTES;
+    *out++ = '\n';
+    return out;
+}
+
+/**
+ * Формирует две полные строки дампа (AVX2, по строке в каждой 128-битной половине регистра).
+ *
+ * @param out  [out] буфер (!= NULL)
+ * @param in   [in]  32 байта строк (!= NULL)
+ * @param addr [in]  адрес первой строки
+ * @return указатель за сформированными строками.
+ */
+static
+char *put_2lines_avx2(char                *out,
+                      const unsigned char *in,
+                      size_t               addr)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i v = _mm256_loadu_si256((const __m256i *)in);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+    __m256i lo = _mm256_and_si256(v, nibble);
+    __m256i pairs_lo, pairs_hi, printable, text;
+    __m256i parts[3];
+    int i, line;
+
+    hi = _mm256_add_epi8(_mm256_add_epi8(hi, _mm256_set1_epi8('0')),
+                         _mm256_and_si256(_mm256_cmpgt_epi8(hi, _mm256_set1_epi8(9)), _mm256_set1_epi8('A' - '9' - 1)));
+    lo = _mm256_add_epi8(_mm256_add_epi8(lo, _mm256_set1_epi8('0')),
+                         _mm256_and_si256(_mm256_cmpgt_epi8(lo, _mm256_set1_epi8(9)), _mm256_set1_epi8('A' - '9' - 1)));
+    /* распаковка и pshufb работают внутри 128-битных половин, т.е. для каждой строки отдельно */
+    pairs_lo = _mm256_unpacklo_epi8(hi, lo);
+    pairs_hi = _mm256_unpackhi_epi8(hi, lo);
+    for (i = 0; i < 3; i++)
+    {
+        const __m256i shuf_lo = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)hex_shuf_lo[i]));
+        const __m256i shuf_hi = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)hex_shuf_hi[i]));
+        const __m256i spaces = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)hex_spaces[i]));
+
+        parts[i] = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(pairs_lo, shuf_lo),
+                                                   _mm256_shuffle_epi8(pairs_hi, shuf_hi)),
+                                   spaces);
+    }
+    printable = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(0x1F)),
+                                 _mm256_cmpgt_epi8(_mm256_set1_epi8(0x7F), v));
+    text = _mm256_blendv_epi8(_mm256_set1_epi8('.'), v, printable);
+
+    for (line = 0; line < 2; line++)
+    {
+        out = put_addr(out, addr + (size_t)line * LOG_HEXDUMP_LINE_BYTES);
+        for (i = 0; i < 3; i++)
+        {
+            _mm_storeu_si128((__m128i *)out, line ? _mm256_extracti128_si256(parts[i], 1) :
+                                                    _mm256_castsi256_si128(parts[i]));
+            out += 16;
+        }
+        memcpy(out, " | ", 3);
+        out += 3;
+        _mm_storeu_si128((__m128i *)out, line ? _mm256_extracti128_si256(text, 1) : _mm256_castsi256_si128(text));
+        out += LOG_HEXDUMP_LINE_BYTES;
+        *out++ = '\n';
+    }
+    return out;
+}
+#endif
+
+/**
+ * Формирует строки hexdump буфера (по 16 байт, каждая завершается переводом строки):
+ * "АДРЕС   XX XX ... XX | текст". Непечатаемые символы (вне 0x20..0x7E) заменяются точкой.
+ * На x86-64 используется SSE2, при поддержке процессором - AVX2.
+ *
+ * @param out        [out] буфер размером не менее num_lines * LOG_HEXDUMP_LINE_MAX_SIZE (!= NULL)
+ * @param buf        [in]  буфер, дамп которого требуется сделать (!= NULL)
+ * @param size       [in]  размер буфера в байтах
+ * @param first_line [in]  номер первой строки (смещение в буфере / 16)
+ * @param num_lines  [in]  количество строк (first_line + num_lines <= (size + 15) / 16)
+ * @return длина сформированного текста в байтах.
+ */
+extern
+size_t log_hexdump(char       *out,
+                   const void *buf,
+                   size_t      size,
+                   size_t      first_line,
+                   size_t      num_lines)
+{
+    const unsigned char *in = (const unsigned char *)buf;
+    size_t addr = first_line * LOG_HEXDUMP_LINE_BYTES;
+    /* конец полных строк */
+    size_t full_end = MIN(size & ~(size_t)(LOG_HEXDUMP_LINE_BYTES - 1), (first_line + num_lines) * LOG_HEXDUMP_LINE_BYTES);
+    char *p = out;
+
+    assert(out != NULL);
+    assert(buf != NULL);
+    assert(first_line + num_lines <= (size + LOG_HEXDUMP_LINE_BYTES - 1) / LOG_HEXDUMP_LINE_BYTES);
+
+    #if LOG_HEXDUMP_X86
+    if (__builtin_cpu_supports("avx2"))
+    {
+        for (; addr + 2 * LOG_HEXDUMP_LINE_BYTES <= full_end; addr += 2 * LOG_HEXDUMP_LINE_BYTES)
+        {
+            p = put_2lines_avx2(p, in + addr, addr);
+        }
+    }
+    for (; addr < full_end; addr += LOG_HEXDUMP_LINE_BYTES)
+    {
+        p = put_line_sse2(p, in + addr, addr);
+    }
+    #endif
+    for (; addr < (first_line + num_lines) * LOG_HEXDUMP_LINE_BYTES; addr += LOG_HEXDUMP_LINE_BYTES)
+    {
+        p = put_line_scalar(p, in + addr, MIN(size - addr, (size_t)LOG_HEXDUMP_LINE_BYTES), addr);
+    }
+    return (size_t)(p - out);
+}
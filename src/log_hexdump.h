@@ -0,0 +1,31 @@
+#ifndef LOG_HEXDUMP_H_
+#define LOG_HEXDUMP_H_
+
+#include <stddef.h>
+
+/**
+ * Максимальная длина строки hexdump вместе с переводом строки
+ * (адрес до 16 цифр, 16 байт в HEX и текстовом виде)
+ */
+#define LOG_HEXDUMP_LINE_MAX_SIZE 86
+
+/**
+ * Формирует строки hexdump буфера (по 16 байт, каждая завершается переводом строки):
+ * "АДРЕС   XX XX ... XX | текст". Непечатаемые символы (вне 0x20..0x7E) заменяются точкой.
+ * На x86-64 используется SSE2, при поддержке процессором - AVX2.
+ *
+ * @param out        [out] буфер размером не менее num_lines * LOG_HEXDUMP_LINE_MAX_SIZE (!= NULL)
+ * @param buf        [in]  буфер, дамп которого требуется сделать (!= NULL)
+ * @param size       [in]  размер буфера в байтах
+ * @param first_line [in]  номер первой строки (смещение в буфере / 16)
+ * @param num_lines  [in]  количество строк (first_line + num_lines <= (size + 15) / 16)
+ * @return длина сформированного текста в байтах.
+ */
+extern
+size_t log_hexdump(char       *out,
+                   const void *buf,
+                   size_t      size,
+                   size_t      first_line,
+                   size_t      num_lines) __attribute__((nonnull(1, 2)));
+
+#endif /* LOG_HEXDUMP_H_ */
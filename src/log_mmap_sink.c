@@ -0,0 +1,514 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define _LOG_SRC "UNKNOWN"
+#include "log.h"
+
+/**
+ * Размер сегмента по-умолчанию
+ */
+#define LOG_MMAP_SINK_DEFAULT_SEGMENT_SIZE (16 * 1024 * 1024)
+
+/**
+ * Запас размера буфера пути сегмента под суффикс ".<номер>"
+ */
+#define LOG_MMAP_SINK_SUFFIX_SIZE 24
+
+/**
+ * Отображённый в память файл сегмента
+ */
+typedef struct tag_log_mmap_segment
+{
+    int            fd;    /*!< файловый дескриптор */
+    char          *map;   /*!< отображение (NULL - сегмента нет) */
+    unsigned long  index; /*!< номер сегмента */
+}
+log_mmap_segment_t;
+
+/**
+ * Контекст приёмника в отображаемые в память сегменты
+ */
+typedef struct tag_log_mmap_sink
+{
+    pthread_mutex_t     mutex;        /*!< мьютекс приёмника */
+    pthread_cond_t      cond;         /*!< оповещение фонового потока (сегмент занят или заполнен, остановка) */
+    pthread_cond_t      ready_cond;   /*!< оповещение пишущего потока (следующий сегмент готов, заполненный освобождён) */
+    pthread_t           thread;       /*!< фоновый поток подготовки и освобождения сегментов */
+    bool                stop;         /*!< запрос остановки фонового потока */
+    bool                next_failed;  /*!< не удалось создать следующий сегмент, вывод прекращён */
+    size_t              segment_size; /*!< размер сегмента в байтах */
+    log_mmap_segment_t  cur;          /*!< текущий сегмент */
+    size_t              used;         /*!< заполненный размер текущего сегмента */
+    log_mmap_segment_t  next;         /*!< подготовленный следующий сегмент */
+    log_mmap_segment_t  retired;      /*!< заполненный сегмент, ожидающий освобождения */
+    unsigned long       next_index;   /*!< номер следующего создаваемого сегмента */
+    char               *path_prefix;  /*!< префикс путей сегментов */
+    char               *path;         /*!< буфер пути сегмента (используется только фоновым потоком) */
+    size_t              path_size;    /*!< размер буфера пути */
+}
+log_mmap_sink_t;
+
+/**
+ * Формирует в буфере приёмника путь сегмента.
+ *
+ * @param ms    [in/out] приёмник (!= NULL)
+ * @param index [in]     номер сегмента
+ * @return путь сегмента
+ */
+static
+const char *segment_path(log_mmap_sink_t *ms,
+                         unsigned long    index) __attribute__((nonnull(1)));
+
+/**
+ * Создаёт файл сегмента, выделяет под него место на диске и отображает его в память.
+ *
+ * @param ms    [in/out] приёмник (!= NULL)
+ * @param index [in]     номер сегмента
+ * @param seg   [out]    сегмент (!= NULL)
+ * @return true - OK, false - Fail
+ */
+static
+bool open_segment(log_mmap_sink_t    *ms,
+                  unsigned long       index,
+                  log_mmap_segment_t *seg) __attribute__((nonnull(1, 3))) __attribute__((warn_unused_result));
+
+/**
+ * Синхронизирует записанную часть сегмента с файлом, снимает отображение и закрывает файл.
+ * Файл не полностью записанного сегмента усекается до размера данных, пустой - удаляется.
+ *
+ * @param ms  [in/out] приёмник (!= NULL)
+ * @param seg [in]     сегмент (!= NULL)
+ * @param len [in]     размер записанных в сегмент данных
+ */
+static
+void release_segment(log_mmap_sink_t          *ms,
+                     const log_mmap_segment_t *seg,
+                     size_t                    len) __attribute__((nonnull(1, 2)));
+
+/**
+ * Делает текущим подготовленный следующий сегмент, при необходимости дожидаясь его создания
+ * (вызывается под мьютексом приёмника).
+ *
+ * @param ms [in/out] приёмник (!= NULL)
+ * @return true - OK, false - сегмент создать не удалось
+ */
+static
+bool take_next_locked(log_mmap_sink_t *ms) __attribute__((nonnull(1)));
+
+/**
+ * Передаёт заполненный текущий сегмент фоновому потоку для освобождения
+ * (вызывается под мьютексом приёмника).
+ *
+ * @param ms [in/out] приёмник (!= NULL)
+ */
+static
+void retire_locked(log_mmap_sink_t *ms) __attribute__((nonnull(1)));
+
+/**
+ * Операция write приёмника. Может блокироваться в retire_locked()/take_next_locked(),
+ * если фоновый поток отстаёт от вывода.
+ *
+ * @param ctx   [in] контекст (log_mmap_sink_t *) (!= NULL)
+ * @param data  [in] данные (!= NULL)
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void mmap_sink_write(void        *ctx,
+                     const char  *data,
+                     size_t       len,
+                     log_level_t  level) __attribute__((nonnull(1, 2)));
+
+/**
+ * Операция flush приёмника: запускает запись на диск заполненной части текущего сегмента.
+ *
+ * @param ctx [in] контекст (log_mmap_sink_t *) (!= NULL)
+ */
+static
+void mmap_sink_flush(void *ctx) __attribute__((nonnull(1)));
+
+/**
+ * Операция close приёмника: останавливает фоновый поток и освобождает сегменты.
+ *
+ * @param ctx [in] контекст (log_mmap_sink_t *) (!= NULL)
+ */
+static
+void mmap_sink_close(void *ctx) __attribute__((nonnull(1)));
+
+/**
+ * Тело фонового потока подготовки и освобождения сегментов.
+ *
+ * @param arg [in] приёмник (log_mmap_sink_t *) (!= NULL)
+ * @return NULL
+ */
+static
+void *segment_thread(void *arg);
+
+/**
+ * Освобождает приёмник (сегменты не освобождаются).
+ *
+ * @param ms [in] приёмник (!= NULL)
+ */
+static
+void free_mmap_sink(log_mmap_sink_t *ms) __attribute__((nonnull(1)));
+
+/**
+ * Формирует в буфере приёмника путь сегмента.
+ *
+ * @param ms    [in/out] приёмник (!= NULL)
+ * @param index [in]     номер сегмента
+ * @return путь сегмента
+ */
+static
+const char *segment_path(log_mmap_sink_t *ms,
+                         unsigned long    index)
+{
+    assert(ms != NULL);
+
+    snprintf(ms->path, ms->path_size, "%s.%06lu", ms->path_prefix, index);
+    return ms->path;
+}
+
+/**
+ * Создаёт файл сегмента, выделяет под него место на диске и отображает его в память.
+ *
+ * @param ms    [in/out] приёмник (!= NULL)
+ * @param index [in]     номер сегмента
+ * @param seg   [out]    сегмент (!= NULL)
+ * @return true - OK, false - Fail
+ */
+static
+bool open_segment(log_mmap_sink_t    *ms,
+                  unsigned long       index,
+                  log_mmap_segment_t *seg)
+{
+    const char *path = segment_path(ms, index);
+    void *map;
+    int fd;
+
+    assert(ms != NULL);
+    assert(seg != NULL);
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    /* место выделяется заранее: запись в отображение не должна завершаться SIGBUS при нехватке места */
+    if (posix_fallocate(fd, 0, (off_t)ms->segment_size) != 0)
+    {
+        close(fd);
+        unlink(path);
+        return false;
+    }
+    map = mmap(NULL, ms->segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        close(fd);
+        unlink(path);
+        return false;
+    }
+    posix_madvise(map, ms->segment_size, POSIX_MADV_SEQUENTIAL);
+    seg->fd = fd;
+    seg->map = map;
+    seg->index = index;
+    return true;
+}
+
+/**
+ * Синхронизирует записанную часть сегмента с файлом, снимает отображение и закрывает файл.
+ * Файл не полностью записанного сегмента усекается до размера данных, пустой - удаляется.
+ *
+ * @param ms  [in/out] приёмник (!= NULL)
+ * @param seg [in]     сегмент (!= NULL)
+ * @param len [in]     размер записанных в сегмент данных
+ */
+static
+void release_segment(log_mmap_sink_t          *ms,
+                     const log_mmap_segment_t *seg,
+                     size_t                    len)
+{
+    assert(ms != NULL);
+    assert(seg != NULL);
+
+    if (len) msync(seg->map, len, MS_SYNC);
+    munmap(seg->map, ms->segment_size);
+    if (len == 0)
+    {
+        unlink(segment_path(ms, seg->index));
+    }
+    else if (len < ms->segment_size)
+    {
+        (void)!ftruncate(seg->fd, (off_t)len);
+    }
+    /* записанный сегмент больше не читается - не занимать им страничный кеш */
+    posix_fadvise(seg->fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(seg->fd);
+}
+
+/**
+ * Делает текущим подготовленный следующий сегмент, при необходимости дожидаясь его создания
+ * (вызывается под мьютексом приёмника).
+ *
+ * @param ms [in/out] приёмник (!= NULL)
+ * @return true - OK, false - сегмент создать не удалось
+ */
+static
+bool take_next_locked(log_mmap_sink_t *ms)
+{
+    assert(ms != NULL);
+
+    /* ожидание возможно, только если фоновый поток не успевает за выводом */
+    while (ms->next.map == NULL && !ms->next_failed && !ms->stop)
+    {
+        pthread_cond_wait(&ms->ready_cond, &ms->mutex);
+    }
+    if (ms->next.map == NULL) return false;
+    ms->cur = ms->next;
+    ms->next.map = NULL;
+    ms->used = 0;
+    pthread_cond_signal(&ms->cond);
+    return true;
+}
+
+/**
+ * Передаёт заполненный текущий сегмент фоновому потоку для освобождения
+ * (вызывается под мьютексом приёмника).
+ *
+ * @param ms [in/out] приёмник (!= NULL)
+ */
+static
+void retire_locked(log_mmap_sink_t *ms)
+{
+    assert(ms != NULL);
+
+    while (ms->retired.map != NULL)
+    {
+        pthread_cond_wait(&ms->ready_cond, &ms->mutex);
+    }
+    ms->retired = ms->cur;
+    ms->cur.map = NULL;
+    pthread_cond_signal(&ms->cond);
+}
+
+/**
+ * Операция write приёмника. Может блокироваться в retire_locked()/take_next_locked(),
+ * если фоновый поток отстаёт от вывода.
+ *
+ * @param ctx   [in] контекст (log_mmap_sink_t *) (!= NULL)
+ * @param data  [in] данные (!= NULL)
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void mmap_sink_write(void        *ctx,
+                     const char  *data,
+                     size_t       len,
+                     log_level_t  level)
+{
+    log_mmap_sink_t *ms = (log_mmap_sink_t *)ctx;
+
+    assert(ctx != NULL);
+    assert(data != NULL);
+    UNUSED_PARAM(level);
+
+    pthread_mutex_lock(&ms->mutex);
+    while (len)
+    {
+        size_t n;
+
+        /* текущего сегмента нет, только если не удалось создать следующий */
+        if (ms->cur.map == NULL && !take_next_locked(ms)) break;
+        /* записи могут переходить из сегмента в сегмент: все сегменты, кроме последнего, заполнены полностью */
+        n = MIN(len, ms->segment_size - ms->used);
+        memcpy(ms->cur.map + ms->used, data, n);
+        ms->used += n;
+        data += n;
+        len -= n;
+        if (ms->used == ms->segment_size)
+        {
+            retire_locked(ms);
+            (void)take_next_locked(ms);
+        }
+    }
+    pthread_mutex_unlock(&ms->mutex);
+}
+
+/**
+ * Операция flush приёмника: запускает запись на диск заполненной части текущего сегмента.
+ *
+ * @param ctx [in] контекст (log_mmap_sink_t *) (!= NULL)
+ */
+static
+void mmap_sink_flush(void *ctx)
+{
+    log_mmap_sink_t *ms = (log_mmap_sink_t *)ctx;
+
+    assert(ctx != NULL);
+
+    pthread_mutex_lock(&ms->mutex);
+    if (ms->cur.map && ms->used) msync(ms->cur.map, ms->used, MS_ASYNC);
+    pthread_mutex_unlock(&ms->mutex);
+}
+
+/**
+ * Операция close приёмника: останавливает фоновый поток и освобождает сегменты.
+ *
+ * @param ctx [in] контекст (log_mmap_sink_t *) (!= NULL)
+ */
+static
+void mmap_sink_close(void *ctx)
+{
+    log_mmap_sink_t *ms = (log_mmap_sink_t *)ctx;
+
+    assert(ctx != NULL);
+
+    pthread_mutex_lock(&ms->mutex);
+    ms->stop = true;
+    pthread_cond_signal(&ms->cond);
+    pthread_cond_broadcast(&ms->ready_cond);
+    pthread_mutex_unlock(&ms->mutex);
+    pthread_join(ms->thread, NULL);
+    /* заполненный сегмент фоновый поток освобождает до остановки */
+    if (ms->cur.map) release_segment(ms, &ms->cur, ms->used);
+    if (ms->next.map) release_segment(ms, &ms->next, 0);
+    free_mmap_sink(ms);
+}
+
+/**
+ * Тело фонового потока подготовки и освобождения сегментов.
+ *
+ * @param arg [in] приёмник (log_mmap_sink_t *) (!= NULL)
+ * @return NULL
+ */
+static
+void *segment_thread(void *arg)
+{
+    log_mmap_sink_t *ms = (log_mmap_sink_t *)arg;
+
+    assert(arg != NULL);
+
+    pthread_mutex_lock(&ms->mutex);
+    for (;;)
+    {
+        log_mmap_segment_t seg;
+
+        if (ms->retired.map)
+        {
+            seg = ms->retired;
+            pthread_mutex_unlock(&ms->mutex);
+            release_segment(ms, &seg, ms->segment_size);
+            pthread_mutex_lock(&ms->mutex);
+            ms->retired.map = NULL;
+            pthread_cond_broadcast(&ms->ready_cond);
+        }
+        else if (ms->stop)
+        {
+            break;
+        }
+        else if (ms->next.map == NULL && !ms->next_failed)
+        {
+            unsigned long index = ms->next_index++;
+            bool res;
+
+            pthread_mutex_unlock(&ms->mutex);
+            res = open_segment(ms, index, &seg);
+            pthread_mutex_lock(&ms->mutex);
+            if (res) ms->next = seg;
+            else ms->next_failed = true;
+            pthread_cond_broadcast(&ms->ready_cond);
+        }
+        else
+        {
+            pthread_cond_wait(&ms->cond, &ms->mutex);
+        }
+    }
+    pthread_mutex_unlock(&ms->mutex);
+    return NULL;
+}
+
+/**
+ * Освобождает приёмник (сегменты не освобождаются).
+ *
+ * @param ms [in] приёмник (!= NULL)
+ */
+static
+void free_mmap_sink(log_mmap_sink_t *ms)
+{
+    assert(ms != NULL);
+
+    pthread_cond_destroy(&ms->ready_cond);
+    pthread_cond_destroy(&ms->cond);
+    pthread_mutex_destroy(&ms->mutex);
+    free(ms->path);
+    free(ms->path_prefix);
+    free(ms);
+}
+
+/**
+ * Добавляет приёмник, копирующий записи в отображённые в память (mmap) файлы сегментов
+ * "<path_prefix>.<номер>" фиксированного размера: вывод записи не требует системных вызовов.
+ * Следующий сегмент заранее создаётся и отображается фоновым потоком приёмника, он же
+ * синхронизирует (msync) и освобождает заполненные сегменты. Скопированные в отображение
+ * записи не теряются при аварийном завершении процесса. Последний сегмент при удалении
+ * приёмника усекается до размера записанных данных (после аварии остаток сегмента заполнен нулями).
+ * Нумерация начинается с первого свободного номера.
+ * Записи не отбрасываются: если фоновый поток не успевает (следующий сегмент ещё не создан или
+ * предыдущий заполненный ещё не освобождён), вывод, заполнивший сегмент, блокируется до его готовности.
+ *
+ * @param path_prefix   [in] префикс путей файлов сегментов (!= NULL).
+ * @param min_log_level [in] минимальный уровень записей для приёмника.
+ * @param config        [in] параметры (NULL - по-умолчанию).
+ * @return приёмник или NULL в случае ошибки.
+ */
+extern
+log_sink_t *log_sink_add_mmap(const char                   *path_prefix,
+                              log_level_t                   min_log_level,
+                              const log_mmap_sink_config_t *config)
+{
+    log_mmap_sink_t *ms;
+    log_sink_ops_t ops;
+    log_sink_t *sink;
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+    assert(path_prefix != NULL);
+
+    ms = calloc(1, sizeof(*ms));
+    if (ms == NULL) return NULL;
+    ms->segment_size = (config && config->segment_size) ? config->segment_size : LOG_MMAP_SINK_DEFAULT_SEGMENT_SIZE;
+    ms->segment_size = (ms->segment_size + page_size - 1) / page_size * page_size;
+    ms->path_prefix = strdup(path_prefix);
+    ms->path_size = strlen(path_prefix) + LOG_MMAP_SINK_SUFFIX_SIZE;
+    ms->path = malloc(ms->path_size);
+    pthread_mutex_init(&ms->mutex, NULL);
+    pthread_cond_init(&ms->cond, NULL);
+    pthread_cond_init(&ms->ready_cond, NULL);
+    if (ms->path_prefix == NULL || ms->path == NULL)
+    {
+        free_mmap_sink(ms);
+        return NULL;
+    }
+    /* не перезаписывать сегменты предыдущих запусков */
+    while (access(segment_path(ms, ms->next_index), F_OK) == 0) ms->next_index++;
+    if (!open_segment(ms, ms->next_index++, &ms->cur))
+    {
+        free_mmap_sink(ms);
+        return NULL;
+    }
+    if (pthread_create(&ms->thread, NULL, segment_thread, ms) != 0)
+    {
+        release_segment(ms, &ms->cur, 0);
+        free_mmap_sink(ms);
+        return NULL;
+    }
+    ZEROIZE_STRUCT(ops);
+    ops.write = mmap_sink_write;
+    ops.flush = mmap_sink_flush;
+    ops.close = mmap_sink_close;
+    sink = log_sink_add(&ops, ms, min_log_level);
+    if (sink == NULL) mmap_sink_close(ms);
+    return sink;
+}
@@ -0,0 +1,583 @@
+#include <assert.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define _LOG_SRC "UNKNOWN"
+#include "log.h"
+#include "log_signal.h"
+
+/**
+ * Модификатор размера аргумента
+ */
+typedef enum tag_log_sig_length
+{
+    LOG_SIG_LEN_NONE, /*!< int */
+    LOG_SIG_LEN_HH,   /*!< char */
+    LOG_SIG_LEN_H,    /*!< short */
+    LOG_SIG_LEN_L,    /*!< long */
+    LOG_SIG_LEN_LL,   /*!< long long */
+    LOG_SIG_LEN_Z,    /*!< size_t */
+    LOG_SIG_LEN_J,    /*!< intmax_t */
+    LOG_SIG_LEN_T     /*!< ptrdiff_t */
+}
+log_sig_length_t;
+
+/**
+ * Буфер вывода форматтера
+ */
+typedef struct tag_log_sig_out
+{
+    char   *buf;  /*!< буфер */
+    size_t  size; /*!< размер буфера в байтах */
+    size_t  len;  /*!< количество записанных байт */
+}
+log_sig_out_t;
+
+/**
+ * Спецификация преобразования
+ */
+typedef struct tag_log_sig_spec
+{
+    bool   left;      /*!< выравнивание по левому краю ('-') */
+    bool   zero_pad;  /*!< дополнение нулями ('0') */
+    bool   alt;       /*!< альтернативная форма ('#'): префикс "0x" или "0" */
+    size_t width;     /*!< минимальная ширина поля */
+    bool   has_prec;  /*!< точность задана */
+    size_t precision; /*!< точность: минимум цифр для чисел, максимум символов для строк */
+}
+log_sig_spec_t;
+
+/**
+ * Дописывает символы в буфер вывода (лишнее отбрасывается).
+ *
+ * @param out  [in/out] буфер вывода (!= NULL)
+ * @param c    [in]     символ
+ * @param num  [in]     количество повторений
+ */
+static
+void out_repeat(log_sig_out_t *out,
+                char           c,
+                size_t         num) __attribute__((nonnull(1)));
+
+/**
+ * Дописывает строку в буфер вывода (лишнее отбрасывается).
+ *
+ * @param out  [in/out] буфер вывода (!= NULL)
+ * @param str  [in]     строка (!= NULL)
+ * @param len  [in]     длина строки
+ */
+static
+void out_str(log_sig_out_t *out,
+             const char    *str,
+             size_t         len) __attribute__((nonnull(1, 2)));
+
+/**
+ * Выводит поле: префикс (знак, "0x"), ведущие нули и тело с выравниванием по ширине.
+ *
+ * @param out        [in/out] буфер вывода (!= NULL)
+ * @param spec       [in]     спецификация преобразования (!= NULL)
+ * @param prefix     [in]     префикс (!= NULL)
+ * @param body       [in]     тело (!= NULL)
+ * @param body_len   [in]     длина тела
+ * @param zeros      [in]     количество ведущих нулей перед телом
+ */
+static
+void out_field(log_sig_out_t        *out,
+               const log_sig_spec_t *spec,
+               const char           *prefix,
+               const char           *body,
+               size_t                body_len,
+               size_t                zeros) __attribute__((nonnull(1, 2, 3, 4)));
+
+/**
+ * Выводит целое число без знака.
+ *
+ * @param out    [in/out] буфер вывода (!= NULL)
+ * @param spec   [in]     спецификация преобразования (!= NULL)
+ * @param prefix [in]     префикс (знак, "0x") (!= NULL)
+ * @param value  [in]     модуль числа
+ * @param base   [in]     основание (8, 10, 16)
+ * @param upper  [in]     шестнадцатеричные цифры в верхнем регистре
+ */
+static
+void out_number(log_sig_out_t        *out,
+                const log_sig_spec_t *spec,
+                const char           *prefix,
+                unsigned long long    value,
+                unsigned              base,
+                bool                  upper) __attribute__((nonnull(1, 2, 3)));
+
+/**
+ * Читает знаковый целый аргумент.
+ *
+ * @param args   [in/out] аргументы (!= NULL)
+ * @param length [in]     модификатор размера
+ * @return значение аргумента.
+ */
+static
+long long get_signed(va_list          *args,
+                     log_sig_length_t  length) __attribute__((nonnull(1)));
+
+/**
+ * Читает беззнаковый целый аргумент.
+ *
+ * @param args   [in/out] аргументы (!= NULL)
+ * @param length [in]     модификатор размера
+ * @return значение аргумента.
+ */
+static
+unsigned long long get_unsigned(va_list          *args,
+                                log_sig_length_t  length) __attribute__((nonnull(1)));
+
+/**
+ * Количество дней от 1970-01-01 до заданной даты григорианского календаря.
+ *
+ * @param year  [in] год
+ * @param month [in] месяц (1..12)
+ * @param day   [in] день (1..31)
+ * @return количество дней.
+ */
+static
+long days_from_civil(long     year,
+                     unsigned month,
+                     unsigned day);
+
+/**
+ * Дописывает символы в буфер вывода (лишнее отбрасывается).
+ *
+ * @param out  [in/out] буфер вывода (!= NULL)
+ * @param c    [in]     символ
+ * @param num  [in]     количество повторений
+ */
+static
+void out_repeat(log_sig_out_t *out,
+                char           c,
+                size_t         num)
+{
+    assert(out != NULL);
+
+    while (num-- > 0 && out->len < out->size)
+    {
+        out->buf[out->len++] = c;
+    }
+}
+
+/**
+ * Дописывает строку в буфер вывода (лишнее отбрасывается).
+ *
+ * @param out  [in/out] буфер вывода (!= NULL)
+ * @param str  [in]     строка (!= NULL)
+ * @param len  [in]     длина строки
+ */
+static
+void out_str(log_sig_out_t *out,
+             const char    *str,
+             size_t         len)
+{
+    assert(out != NULL);
+    assert(str != NULL);
+
+    while (len-- > 0 && out->len < out->size)
+    {
+        out->buf[out->len++] = *str++;
+    }
+}
+
+/**
+ * Выводит поле: префикс (знак, "0x"), ведущие нули и тело с выравниванием по ширине.
+ *
+ * @param out        [in/out] буфер вывода (!= NULL)
+ * @param spec       [in]     спецификация преобразования (!= NULL)
+ * @param prefix     [in]     префикс (!= NULL)
+ * @param body       [in]     тело (!= NULL)
+ * @param body_len   [in]     длина тела
+ * @param zeros      [in]     количество ведущих нулей перед телом
+ */
+static
+void out_field(log_sig_out_t        *out,
+               const log_sig_spec_t *spec,
+               const char           *prefix,
+               const char           *body,
+               size_t                body_len,
+               size_t                zeros)
+{
+    size_t prefix_len = 0;
+    size_t total;
+    size_t pad;
+
+    assert(out != NULL);
+    assert(spec != NULL);
+    assert(prefix != NULL);
+    assert(body != NULL);
+
+    while (prefix[prefix_len]) prefix_len++;
+    total = prefix_len + zeros + body_len;
+    pad = (spec->width > total) ? spec->width - total : 0;
+    if (!spec->left && !spec->zero_pad) out_repeat(out, ' ', pad);
+    out_str(out, prefix, prefix_len);
+    if (!spec->left && spec->zero_pad) out_repeat(out, '0', pad);
+    out_repeat(out, '0', zeros);
+    out_str(out, body, body_len);
+    if (spec->left) out_repeat(out, ' ', pad);
+}
+
+/**
+ * Выводит целое число без знака.
+ *
+ * @param out    [in/out] буфер вывода (!= NULL)
+ * @param spec   [in]     спецификация преобразования (!= NULL)
+ * @param prefix [in]     префикс (знак, "0x") (!= NULL)
+ * @param value  [in]     модуль числа
+ * @param base   [in]     основание (8, 10, 16)
+ * @param upper  [in]     шестнадцатеричные цифры в верхнем регистре
+ */
+static
+void out_number(log_sig_out_t        *out,
+                const log_sig_spec_t *spec,
+                const char           *prefix,
+                unsigned long long    value,
+                unsigned              base,
+                bool                  upper)
+{
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char num[24];
+    size_t pos = sizeof(num);
+    size_t len;
+
+    assert(out != NULL);
+    assert(spec != NULL);
+    assert(prefix != NULL);
+
+    /* точность 0 и значение 0 дают пустое тело, как у printf */
+    if (value != 0 || !spec->has_prec || spec->precision != 0)
+    {
+        do
+        {
+            num[--pos] = digits[value % base];
+            value /= base;
+        } while (value != 0);
+    }
+    len = sizeof(num) - pos;
+    out_field(out, spec, prefix, num + pos, len, (spec->has_prec && spec->precision > len) ? spec->precision - len : 0);
+}
+
+/**
+ * Читает знаковый целый аргумент.
+ *
+ * @param args   [in/out] аргументы (!= NULL)
+ * @param length [in]     модификатор размера
+ * @return значение аргумента.
+ */
+static
+long long get_signed(va_list          *args,
+                     log_sig_length_t  length)
+{
+    assert(args != NULL);
+
+    switch (length)
+    {
+        case LOG_SIG_LEN_HH: return (signed char)va_arg(*args, int);
+        case LOG_SIG_LEN_H:  return (short)va_arg(*args, int);
+        case LOG_SIG_LEN_L:  return va_arg(*args, long);
+        case LOG_SIG_LEN_LL: return va_arg(*args, long long);
+        case LOG_SIG_LEN_Z:  return va_arg(*args, ssize_t);
+        case LOG_SIG_LEN_J:  return va_arg(*args, intmax_t);
+        case LOG_SIG_LEN_T:  return va_arg(*args, ptrdiff_t);
+        default:             return va_arg(*args, int);
+    }
+}
+
+/**
+ * Читает беззнаковый целый аргумент.
+ *
+ * @param args   [in/out] аргументы (!= NULL)
+ * @param length [in]     модификатор размера
+ * @return значение аргумента.
+ */
+static
+unsigned long long get_unsigned(va_list          *args,
+                                log_sig_length_t  length)
+{
+    assert(args != NULL);
+
+    switch (length)
+    {
+        case LOG_SIG_LEN_HH: return (unsigned char)va_arg(*args, unsigned);
+        case LOG_SIG_LEN_H:  return (unsigned short)va_arg(*args, unsigned);
+        case LOG_SIG_LEN_L:  return va_arg(*args, unsigned long);
+        case LOG_SIG_LEN_LL: return va_arg(*args, unsigned long long);
+        case LOG_SIG_LEN_Z:  return va_arg(*args, size_t);
+        case LOG_SIG_LEN_J:  return va_arg(*args, uintmax_t);
+        case LOG_SIG_LEN_T:  return (unsigned long long)va_arg(*args, ptrdiff_t);
+        default:             return va_arg(*args, unsigned);
+    }
+}
+
+/**
+ * Количество дней от 1970-01-01 до заданной даты григорианского календаря.
+ *
+ * @param year  [in] год
+ * @param month [in] месяц (1..12)
+ * @param day   [in] день (1..31)
+ * @return количество дней.
+ */
+static
+long days_from_civil(long     year,
+                     unsigned month,
+                     unsigned day)
+{
+    long era;
+    unsigned yoe;
+    unsigned doy;
+    unsigned doe;
+
+    /* год считается с марта, чтобы 29 февраля было последним днём года */
+    year -= (month <= 2);
+    era = (year >= 0 ? year : year - 399) / 400;
+    yoe = (unsigned)(year - era * 400);
+    doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (long)doe - 719468;
+}
+
+/**
+ * Форматирует строку (аналог vsnprintf(), без завершающего 0).
+ *
+ * @param buf  [out] буфер (!= NULL)
+ * @param size [in]  размер буфера в байтах
+ * @param fmt  [in]  строка формата (!= NULL)
+ * @param args [in]  аргументы
+ * @return количество записанных в буфер байт (не больше size, лишнее обрезается).
+ */
+extern
+size_t log_sig_vformat(char       *buf,
+                       size_t      size,
+                       const char *fmt,
+                       va_list     args)
+{
+    log_sig_out_t out = { buf, size, 0 };
+    va_list ap;
+
+    assert(buf != NULL);
+    assert(fmt != NULL);
+
+    va_copy(ap, args);
+    while (*fmt && out.len < out.size)
+    {
+        const char *spec_start = fmt;
+        log_sig_spec_t spec;
+        log_sig_length_t length = LOG_SIG_LEN_NONE;
+
+        if (*fmt != '%')
+        {
+            out.buf[out.len++] = *fmt++;
+            continue;
+        }
+        fmt++;
+        ZEROIZE_STRUCT(spec);
+        for (;; fmt++)
+        {
+            if (*fmt == '-') spec.left = true;
+            else if (*fmt == '0') spec.zero_pad = true;
+            else if (*fmt == '#') spec.alt = true;
+            else if (*fmt != '+' && *fmt != ' ') break;
+        }
+        if (*fmt == '*')
+        {
+            int width = va_arg(ap, int);
+
+            if (width < 0)
+            {
+                spec.left = true;
+                width = -width;
+            }
+            spec.width = (size_t)width;
+            fmt++;
+        }
+        while (*fmt >= '0' && *fmt <= '9') spec.width = spec.width * 10 + (size_t)(*fmt++ - '0');
+        if (*fmt == '.')
+        {
+            fmt++;
+            spec.has_prec = true;
+            if (*fmt == '*')
+            {
+                int precision = va_arg(ap, int);
+
+                spec.has_prec = (precision >= 0);
+                spec.precision = (size_t)MAX(precision, 0);
+                fmt++;
+            }
+            while (*fmt >= '0' && *fmt <= '9') spec.precision = spec.precision * 10 + (size_t)(*fmt++ - '0');
+        }
+        switch (*fmt)
+        {
+            case 'h': length = (fmt[1] == 'h') ? LOG_SIG_LEN_HH : LOG_SIG_LEN_H; break;
+            case 'l': length = (fmt[1] == 'l') ? LOG_SIG_LEN_LL : LOG_SIG_LEN_L; break;
+            case 'z': length = LOG_SIG_LEN_Z; break;
+            case 'j': length = LOG_SIG_LEN_J; break;
+            case 't': length = LOG_SIG_LEN_T; break;
+            default: break;
+        }
+        if (length != LOG_SIG_LEN_NONE) fmt += (length == LOG_SIG_LEN_HH || length == LOG_SIG_LEN_LL) ? 2 : 1;
+        /* у чисел с точностью дополнение нулями не применяется */
+        if (spec.has_prec || spec.left) spec.zero_pad = false;
+        switch (*fmt)
+        {
+            case 'd':
+            case 'i':
+            {
+                long long value = get_signed(&ap, length);
+                unsigned long long magnitude = (value < 0) ? (unsigned long long)(-(value + 1)) + 1 : (unsigned long long)value;
+
+                out_number(&out, &spec, (value < 0) ? "-" : "", magnitude, 10, false);
+                break;
+            }
+            case 'u': out_number(&out, &spec, "", get_unsigned(&ap, length), 10, false); break;
+            case 'o':
+            {
+                unsigned long long value = get_unsigned(&ap, length);
+
+                out_number(&out, &spec, (spec.alt && value) ? "0" : "", value, 8, false);
+                break;
+            }
+            case 'x':
+            case 'X':
+            {
+                unsigned long long value = get_unsigned(&ap, length);
+
+                out_number(&out, &spec, (spec.alt && value) ? ((*fmt == 'X') ? "0X" : "0x") : "", value, 16, (*fmt == 'X'));
+                break;
+            }
+            case 'p':
+            {
+                const void *ptr = va_arg(ap, const void *);
+
+                if (ptr) out_number(&out, &spec, "0x", (uintptr_t)ptr, 16, false);
+                else out_field(&out, &spec, "", "(nil)", 5, 0);
+                break;
+            }
+            case 's':
+            {
+                const char *str = va_arg(ap, const char *);
+                size_t len = 0;
+
+                if (str == NULL) str = "(null)";
+                while ((!spec.has_prec || len < spec.precision) && str[len]) len++;
+                spec.zero_pad = false;
+                out_field(&out, &spec, "", str, len, 0);
+                break;
+            }
+            case 'c':
+            {
+                char c = (char)va_arg(ap, int);
+
+                spec.zero_pad = false;
+                out_field(&out, &spec, "", &c, 1, 0);
+                break;
+            }
+            case '%': out_repeat(&out, '%', 1); break;
+            default:
+                /* неподдерживаемое преобразование выводится как есть, аргумент не читается */
+                out_str(&out, spec_start, (size_t)(fmt - spec_start) + (*fmt ? 1 : 0));
+                break;
+        }
+        if (*fmt) fmt++;
+    }
+    va_end(ap);
+    return out.len;
+}
+
+/**
+ * Форматирует строку (аналог snprintf(), без завершающего 0).
+ *
+ * @param buf  [out] буфер (!= NULL)
+ * @param size [in]  размер буфера в байтах
+ * @param fmt  [in]  строка формата (!= NULL)
+ * @return количество записанных в буфер байт (не больше size, лишнее обрезается).
+ */
+extern
+size_t log_sig_format(char       *buf,
+                      size_t      size,
+                      const char *fmt, ...)
+{
+    va_list args;
+    size_t len;
+
+    assert(buf != NULL);
+    assert(fmt != NULL);
+
+    va_start(args, fmt);
+    len = log_sig_vformat(buf, size, fmt, args);
+    va_end(args);
+    return len;
+}
+
+/**
+ * Форматирует время как "ГГГГ.ММ.ДД-ЧЧ:ММ:СС:ХХХ " без localtime(): смещение местного времени
+ * от UTC задаётся заранее (см. log_sig_utc_offset()).
+ *
+ * @param buf        [out] буфер (!= NULL)
+ * @param size       [in]  размер буфера в байтах
+ * @param ts         [in]  время UTC (!= NULL)
+ * @param utc_offset [in]  смещение местного времени от UTC в секундах
+ * @return количество записанных в буфер байт.
+ */
+extern
+size_t log_sig_format_time(char                  *buf,
+                           size_t                 size,
+                           const struct timespec *ts,
+                           long                   utc_offset)
+{
+    long secs;
+    long days;
+    long sec_of_day;
+    long era;
+    unsigned doe;
+    unsigned yoe;
+    unsigned doy;
+    unsigned mp;
+    unsigned day;
+    unsigned month;
+    long year;
+
+    assert(buf != NULL);
+    assert(ts != NULL);
+
+    secs = (long)ts->tv_sec + utc_offset;
+    days = secs / 86400;
+    sec_of_day = secs % 86400;
+    if (sec_of_day < 0)
+    {
+        sec_of_day += 86400;
+        days--;
+    }
+    /* обратное к days_from_civil() преобразование */
+    days += 719468;
+    era = (days >= 0 ? days : days - 146096) / 146097;
+    doe = (unsigned)(days - era * 146097);
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp = (5 * doy + 2) / 153;
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = (mp < 10) ? mp + 3 : mp - 9;
+    year = (long)yoe + era * 400 + (month <= 2);
+    return log_sig_format(buf, size, "%.4ld.%.2u.%.2u-%.2ld:%.2ld:%.2ld:%.3ld ",
+                          year, month, day, sec_of_day / 3600, sec_of_day / 60 % 60, sec_of_day % 60,
+                          (long)(ts->tv_nsec / 1000000));
+}
+
+/**
+ * Вычисляет текущее смещение местного времени от UTC (не допускается в обработчике сигнала).
+ *
+ * @return смещение в секундах (0 - если определить не удалось).
+ */
+extern
+long log_sig_utc_offset(void)
+{
+    time_t now = time(NULL);
+    struct tm local_time;
+
+    if (localtime_r(&now, &local_time) == NULL) return 0;
+    return days_from_civil(1900L + local_time.tm_year, (unsigned)local_time.tm_mon + 1, (unsigned)local_time.tm_mday) * 86400 +
+           local_time.tm_hour * 3600L + local_time.tm_min * 60L + local_time.tm_sec - (long)now;
+}
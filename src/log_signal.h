@@ -0,0 +1,69 @@
+#ifndef LOG_SIGNAL_H_
+#define LOG_SIGNAL_H_
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <time.h>
+
+/**
+ * Минимальный форматтер для log_log_signal_safe(): не выделяет память, не берёт блокировок,
+ * не обращается к stdio и локали, поэтому допускается в обработчике сигнала.
+ *
+ * Поддерживаются флаги '-', '0' и '#', ширина и точность (в том числе '*'), модификаторы
+ * hh, h, l, ll, z, j, t и преобразования %d, %i, %u, %x, %X, %o, %p, %s, %c, %%.
+ * Прочие преобразования выводятся как есть, без чтения аргумента.
+ */
+
+/**
+ * Форматирует строку (аналог vsnprintf(), без завершающего 0).
+ *
+ * @param buf  [out] буфер (!= NULL)
+ * @param size [in]  размер буфера в байтах
+ * @param fmt  [in]  строка формата (!= NULL)
+ * @param args [in]  аргументы
+ * @return количество записанных в буфер байт (не больше size, лишнее обрезается).
+ */
+extern
+size_t log_sig_vformat(char       *buf,
+                       size_t      size,
+                       const char *fmt,
+                       va_list     args) __attribute__((nonnull(1, 3)));
+
+/**
+ * Форматирует строку (аналог snprintf(), без завершающего 0).
+ *
+ * @param buf  [out] буфер (!= NULL)
+ * @param size [in]  размер буфера в байтах
+ * @param fmt  [in]  строка формата (!= NULL)
+ * @return количество записанных в буфер байт (не больше size, лишнее обрезается).
+ */
+extern
+size_t log_sig_format(char       *buf,
+                      size_t      size,
+                      const char *fmt, ...) __attribute__((nonnull(1, 3)));
+
+/**
+ * Форматирует время как "ГГГГ.ММ.ДД-ЧЧ:ММ:СС:ХХХ " без localtime(): смещение местного времени
+ * от UTC задаётся заранее (см. log_sig_utc_offset()).
+ *
+ * @param buf        [out] буфер (!= NULL)
+ * @param size       [in]  размер буфера в байтах
+ * @param ts         [in]  время UTC (!= NULL)
+ * @param utc_offset [in]  смещение местного времени от UTC в секундах
+ * @return количество записанных в буфер байт.
+ */
+extern
+size_t log_sig_format_time(char                  *buf,
+                           size_t                 size,
+                           const struct timespec *ts,
+                           long                   utc_offset) __attribute__((nonnull(1, 3)));
+
+/**
+ * Вычисляет текущее смещение местного времени от UTC (не допускается в обработчике сигнала).
+ *
+ * @return смещение в секундах (0 - если определить не удалось).
+ */
+extern
+long log_sig_utc_offset(void);
+
+#endif /* LOG_SIGNAL_H_ */
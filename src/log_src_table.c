@@ -0,0 +1,340 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _LOG_SRC "UNKNOWN"
+#include "log.h"
+#include "log_src_table.h"
+
+/**
+ * Размер данных блока арены по-умолчанию (запросы больше выделяются отдельным блоком)
+ */
+#define LOG_ARENA_BLOCK_SIZE 4096
+
+/**
+ * Выравнивание памяти арены
+ */
+#define LOG_ARENA_ALIGN 16
+
+/**
+ * Начальная ёмкость таблицы источников (степень 2)
+ */
+#define LOG_SRC_TABLE_MIN_CAPACITY 16
+
+/**
+ * Параметры хэша FNV-1a (32 бита)
+ */
+#define LOG_SRC_FNV_OFFSET_BASIS 2166136261u
+#define LOG_SRC_FNV_PRIME        16777619u
+
+/**
+ * Блок арены (данные следуют за заголовком)
+ */
+struct tag_log_arena_block
+{
+    log_arena_block_t *next; /*!< предыдущий блок */
+}
+__attribute__((aligned(LOG_ARENA_ALIGN)));
+
+/**
+ * Увеличивает таблицу вдвое (выделяет начальную, если таблица не выделена).
+ *
+ * @param table [in/out] таблица (!= NULL)
+ * @return true - OK, false - нехватка памяти (таблица не изменена).
+ */
+static
+bool grow_table(log_src_table_t *table) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
+
+/**
+ * Помещает источник в первый свободный слот его цепочки (место гарантированно есть).
+ *
+ * @param table [in/out] таблица (!= NULL)
+ * @param entry [in]     имя и дескриптор источника (!= NULL)
+ * @param hash  [in]     хэш имени
+ * @param level [in]     уровень источника
+ */
+static
+void place_entry(log_src_table_t       *table,
+                 const log_src_entry_t *entry,
+                 uint32_t               hash,
+                 uint8_t                level) __attribute__((nonnull(1, 2)));
+
+/**
+ * Увеличивает таблицу вдвое (выделяет начальную, если таблица не выделена).
+ *
+ * @param table [in/out] таблица (!= NULL)
+ * @return true - OK, false - нехватка памяти (таблица не изменена).
+ */
+static
+bool grow_table(log_src_table_t *table)
+{
+    log_src_table_t grown;
+    size_t capacity = table->mask ? (table->mask + 1) * 2 : LOG_SRC_TABLE_MIN_CAPACITY;
+    size_t i;
+
+    /* массивы выделяются одним блоком: сначала имена и дескрипторы (выровнены по указателю), затем хэши и уровни */
+    grown.entries = calloc(capacity, sizeof(log_src_entry_t) + sizeof(uint32_t) + sizeof(uint8_t));
+    if (grown.entries == NULL) return false;
+    grown.hashes = (uint32_t *)(grown.entries + capacity);
+    grown.levels = (uint8_t *)(grown.hashes + capacity);
+    grown.mask = capacity - 1;
+    grown.count = 0;
+    for (i = 0; table->mask && i <= table->mask; i++)
+    {
+        if (table->hashes[i]) place_entry(&grown, &table->entries[i], table->hashes[i], table->levels[i]);
+    }
+    free(table->entries);
+    *table = grown;
+    return true;
+}
+
+/**
+ * Помещает источник в первый свободный слот его цепочки (место гарантированно есть).
+ *
+ * @param table [in/out] таблица (!= NULL)
+ * @param entry [in]     имя и дескриптор источника (!= NULL)
+ * @param hash  [in]     хэш имени
+ * @param level [in]     уровень источника
+ */
+static
+void place_entry(log_src_table_t       *table,
+                 const log_src_entry_t *entry,
+                 uint32_t               hash,
+                 uint8_t                level)
+{
+    size_t i = hash & table->mask;
+
+    while (table->hashes[i]) i = (i + 1) & table->mask;
+    table->hashes[i] = hash;
+    table->levels[i] = level;
+    table->entries[i] = *entry;
+    table->count++;
+}
+
+/**
+ * Выделяет память из арены (выровненную и обнулённую).
+ *
+ * @param arena [in/out] арена (!= NULL)
+ * @param size  [in]     размер в байтах
+ * @return память (действительна до log_arena_destroy()) или NULL при нехватке памяти.
+ */
+extern
+void *log_arena_alloc(log_arena_t *arena,
+                      size_t       size)
+{
+    char *res;
+
+    assert(arena != NULL);
+
+    size = (size + LOG_ARENA_ALIGN - 1) & ~(size_t)(LOG_ARENA_ALIGN - 1);
+    if (arena->blocks == NULL || arena->size - arena->used < size)
+    {
+        size_t block_size = MAX(size, (size_t)LOG_ARENA_BLOCK_SIZE);
+        log_arena_block_t *block = calloc(1, sizeof(log_arena_block_t) + block_size);
+
+        if (block == NULL) return NULL;
+        /* остаток прежнего блока не используется: имена источников короткие, потери невелики */
+        block->next = arena->blocks;
+        arena->blocks = block;
+        arena->used = 0;
+        arena->size = block_size;
+    }
+    res = (char *)(arena->blocks + 1) + arena->used;
+    arena->used += size;
+    return res;
+}
+
+/**
+ * Копирует строку в арену.
+ *
+ * @param arena [in/out] арена (!= NULL)
+ * @param str   [in]     строка (!= NULL)
+ * @param len   [in]     количество копируемых символов
+ * @return NULL-терминированная копия или NULL при нехватке памяти.
+ */
+extern
+const char *log_arena_strndup(log_arena_t *arena,
+                              const char  *str,
+                              size_t       len)
+{
+    char *res;
+
+    assert(arena != NULL);
+    assert(str != NULL);
+
+    res = log_arena_alloc(arena, len + 1);
+    if (res)
+    {
+        /* память арены обнулена - завершающий 0 уже на месте */
+        memcpy(res, str, len);
+    }
+    return res;
+}
+
+/**
+ * Освобождает всю память арены.
+ *
+ * @param arena [in/out] арена (!= NULL)
+ */
+extern
+void log_arena_destroy(log_arena_t *arena)
+{
+    assert(arena != NULL);
+
+    while (arena->blocks)
+    {
+        log_arena_block_t *next = arena->blocks->next;
+
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+    arena->used = 0;
+    arena->size = 0;
+}
+
+/**
+ * Вычисляет хэш имени источника и его длину за один проход.
+ *
+ * @param name [in]  имя источника (!= NULL)
+ * @param len  [out] длина имени (!= NULL)
+ * @return хэш (!= 0).
+ */
+extern
+uint32_t log_src_hash(const char *name,
+                      size_t     *len)
+{
+    uint32_t hash = LOG_SRC_FNV_OFFSET_BASIS;
+    const char *p;
+
+    assert(name != NULL);
+    assert(len != NULL);
+
+    for (p = name; *p; p++)
+    {
+        hash ^= (unsigned char)*p;
+        hash *= LOG_SRC_FNV_PRIME;
+    }
+    *len = (size_t)(p - name);
+    /* 0 обозначает свободный слот */
+    return hash ? hash : 1;
+}
+
+/**
+ * Находит источник в таблице.
+ *
+ * @param table [in] таблица (!= NULL)
+ * @param name  [in] имя источника (!= NULL)
+ * @param len   [in] длина имени
+ * @param hash  [in] хэш имени (см. log_src_hash())
+ * @return индекс слота или LOG_SRC_TABLE_NOT_FOUND.
+ */
+extern
+size_t log_src_table_find(const log_src_table_t *table,
+                          const char            *name,
+                          size_t                 len,
+                          uint32_t               hash)
+{
+    size_t i;
+
+    assert(table != NULL);
+    assert(name != NULL);
+
+    if (table->mask == 0) return LOG_SRC_TABLE_NOT_FOUND;
+    /* таблица заполнена не больше чем наполовину, поэтому свободный слот всегда встретится */
+    for (i = hash & table->mask; table->hashes[i]; i = (i + 1) & table->mask)
+    {
+        if (table->hashes[i] == hash && table->entries[i].len == len && memcmp(table->entries[i].name, name, len) == 0)
+        {
+            return i;
+        }
+    }
+    return LOG_SRC_TABLE_NOT_FOUND;
+}
+
+/**
+ * Добавляет в таблицу отсутствующий в ней источник, при необходимости увеличивая таблицу.
+ *
+ * @param table  [in/out] таблица (!= NULL)
+ * @param name   [in]     имя источника (должно существовать, пока источник в таблице) (!= NULL)
+ * @param len    [in]     длина имени
+ * @param hash   [in]     хэш имени (см. log_src_hash())
+ * @param handle [in]     дескриптор источника
+ * @param level  [in]     уровень источника
+ * @return true - OK, false - нехватка памяти (таблица не изменена).
+ */
+extern
+bool log_src_table_insert(log_src_table_t *table,
+                          const char      *name,
+                          size_t           len,
+                          uint32_t         hash,
+                          void            *handle,
+                          uint8_t          level)
+{
+    log_src_entry_t entry;
+
+    assert(table != NULL);
+    assert(name != NULL);
+    assert(hash != 0);
+    assert(log_src_table_find(table, name, len, hash) == LOG_SRC_TABLE_NOT_FOUND);
+
+    if ((table->count + 1) * 2 > table->mask + 1)
+    {
+        if (!grow_table(table)) return false;
+    }
+    entry.name = name;
+    entry.len = len;
+    entry.handle = handle;
+    place_entry(table, &entry, hash, level);
+    return true;
+}
+
+/**
+ * Удаляет источник из таблицы (без надгробий: последующие элементы цепочки сдвигаются назад).
+ *
+ * @param table [in/out] таблица (!= NULL)
+ * @param idx   [in]     индекс слота, полученный от log_src_table_find()
+ */
+extern
+void log_src_table_remove(log_src_table_t *table,
+                          size_t           idx)
+{
+    size_t hole = idx;
+    size_t i;
+
+    assert(table != NULL);
+    assert(idx <= table->mask);
+    assert(table->hashes[idx] != 0);
+
+    for (i = (idx + 1) & table->mask; table->hashes[i]; i = (i + 1) & table->mask)
+    {
+        size_t home = table->hashes[i] & table->mask;
+
+        /* элемент переносится в освободившийся слот, если тот лежит на пути от его начального слота */
+        if (((i - home) & table->mask) >= ((i - hole) & table->mask))
+        {
+            table->hashes[hole] = table->hashes[i];
+            table->levels[hole] = table->levels[i];
+            table->entries[hole] = table->entries[i];
+            hole = i;
+        }
+    }
+    table->hashes[hole] = 0;
+    table->levels[hole] = 0;
+    ZEROIZE_STRUCT(table->entries[hole]);
+    table->count--;
+}
+
+/**
+ * Освобождает таблицу.
+ *
+ * @param table [in/out] таблица (!= NULL)
+ */
+extern
+void log_src_table_destroy(log_src_table_t *table)
+{
+    assert(table != NULL);
+
+    free(table->entries);
+    ZEROIZE_STRUCT(*table);
+}
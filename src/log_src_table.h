@@ -0,0 +1,157 @@
+#ifndef LOG_SRC_TABLE_H_
+#define LOG_SRC_TABLE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Таблица источников: открытая адресация с линейным пробированием в непрерывных массивах.
+ * Поиск просматривает только компактный массив хэшей, уровни хранятся в отдельном массиве,
+ * имя и дескриптор источника читаются только при совпадении хэша.
+ *
+ * Таблица не синхронизирована: изменяется писателем, когда читателей нет (см. схему left-right
+ * в log.c), конкурентно с читателями допускается только атомарное изменение уровней.
+ */
+
+/**
+ * Результат поиска, если источник не найден
+ */
+#define LOG_SRC_TABLE_NOT_FOUND SIZE_MAX
+
+/**
+ * Блок арены
+ */
+typedef struct tag_log_arena_block log_arena_block_t;
+
+/**
+ * Арена: память выделяется последовательно из крупных блоков и освобождается только целиком
+ */
+typedef struct tag_log_arena
+{
+    log_arena_block_t *blocks; /*!< блоки (текущий - первый) */
+    size_t             used;   /*!< занято байт в текущем блоке */
+    size_t             size;   /*!< размер данных текущего блока */
+}
+log_arena_t;
+
+/**
+ * Имя и дескриптор источника в таблице
+ */
+typedef struct tag_log_src_entry
+{
+    const char *name;   /*!< имя источника (не копируется таблицей) */
+    size_t      len;    /*!< длина имени */
+    void       *handle; /*!< дескриптор источника */
+}
+log_src_entry_t;
+
+/**
+ * Таблица источников (ёмкость - степень 2, заполнение не больше половины)
+ */
+typedef struct tag_log_src_table
+{
+    size_t           mask;    /*!< ёмкость - 1 (0 - таблица не выделена) */
+    size_t           count;   /*!< количество источников */
+    uint32_t        *hashes;  /*!< хэши имён (0 - слот свободен) */
+    uint8_t         *levels;  /*!< уровни источников */
+    log_src_entry_t *entries; /*!< имена и дескрипторы источников */
+}
+log_src_table_t;
+
+/**
+ * Выделяет память из арены (выровненную и обнулённую).
+ *
+ * @param arena [in/out] арена (!= NULL)
+ * @param size  [in]     размер в байтах
+ * @return память (действительна до log_arena_destroy()) или NULL при нехватке памяти.
+ */
+extern
+void *log_arena_alloc(log_arena_t *arena,
+                      size_t       size) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
+
+/**
+ * Копирует строку в арену.
+ *
+ * @param arena [in/out] арена (!= NULL)
+ * @param str   [in]     строка (!= NULL)
+ * @param len   [in]     количество копируемых символов
+ * @return NULL-терминированная копия или NULL при нехватке памяти.
+ */
+extern
+const char *log_arena_strndup(log_arena_t *arena,
+                              const char  *str,
+                              size_t       len) __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+
+/**
+ * Освобождает всю память арены.
+ *
+ * @param arena [in/out] арена (!= NULL)
+ */
+extern
+void log_arena_destroy(log_arena_t *arena) __attribute__((nonnull(1)));
+
+/**
+ * Вычисляет хэш имени источника и его длину за один проход.
+ *
+ * @param name [in]  имя источника (!= NULL)
+ * @param len  [out] длина имени (!= NULL)
+ * @return хэш (!= 0).
+ */
+extern
+uint32_t log_src_hash(const char *name,
+                      size_t     *len) __attribute__((nonnull(1, 2)));
+
+/**
+ * Находит источник в таблице.
+ *
+ * @param table [in] таблица (!= NULL)
+ * @param name  [in] имя источника (!= NULL)
+ * @param len   [in] длина имени
+ * @param hash  [in] хэш имени (см. log_src_hash())
+ * @return индекс слота или LOG_SRC_TABLE_NOT_FOUND.
+ */
+extern
+size_t log_src_table_find(const log_src_table_t *table,
+                          const char            *name,
+                          size_t                 len,
+                          uint32_t               hash) __attribute__((nonnull(1, 2)));
+
+/**
+ * Добавляет в таблицу отсутствующий в ней источник, при необходимости увеличивая таблицу.
+ *
+ * @param table  [in/out] таблица (!= NULL)
+ * @param name   [in]     имя источника (должно существовать, пока источник в таблице) (!= NULL)
+ * @param len    [in]     длина имени
+ * @param hash   [in]     хэш имени (см. log_src_hash())
+ * @param handle [in]     дескриптор источника
+ * @param level  [in]     уровень источника
+ * @return true - OK, false - нехватка памяти (таблица не изменена).
+ */
+extern
+bool log_src_table_insert(log_src_table_t *table,
+                          const char      *name,
+                          size_t           len,
+                          uint32_t         hash,
+                          void            *handle,
+                          uint8_t          level) __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+
+/**
+ * Удаляет источник из таблицы (без надгробий: последующие элементы цепочки сдвигаются назад).
+ *
+ * @param table [in/out] таблица (!= NULL)
+ * @param idx   [in]     индекс слота, полученный от log_src_table_find()
+ */
+extern
+void log_src_table_remove(log_src_table_t *table,
+                          size_t           idx) __attribute__((nonnull(1)));
+
+/**
+ * Освобождает таблицу.
+ *
+ * @param table [in/out] таблица (!= NULL)
+ */
+extern
+void log_src_table_destroy(log_src_table_t *table) __attribute__((nonnull(1)));
+
+#endif /* LOG_SRC_TABLE_H_ */
@@ -0,0 +1,516 @@
+/* syscall(2) */
+#define _DEFAULT_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "log_uring.h"
+#include "macros.h"
+
+#if DO_LOG_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+/**
+ * Количество элементов очереди отправки
+ */
+#define LOG_URING_ENTRIES 64
+
+/**
+ * Максимальное количество регистрируемых буферов
+ */
+#define LOG_URING_MAX_BUFS 4
+
+/**
+ * Поставленная в очередь запись
+ */
+typedef struct tag_log_uring_op
+{
+    int         fd;        /*!< файловый дескриптор */
+    const char *data;      /*!< данные */
+    size_t      len;       /*!< размер данных в байтах */
+    unsigned    buf_index; /*!< индекс зарегистрированного буфера */
+    int         res;       /*!< результат записи из очереди завершения */
+}
+log_uring_op_t;
+
+/**
+ * Контекст вывода через io_uring
+ */
+typedef struct tag_log_uring
+{
+    int                  ring_fd;                    /*!< дескриптор кольца (< 0 - не создано) */
+    void                *sq_ptr;                     /*!< отображение очереди отправки */
+    size_t               sq_size;                    /*!< размер отображения очереди отправки */
+    void                *cq_ptr;                     /*!< отображение очереди завершения (может совпадать с sq_ptr) */
+    size_t               cq_size;                    /*!< размер отображения очереди завершения */
+    struct io_uring_sqe *sqes;                       /*!< элементы очереди отправки */
+    size_t               sqes_size;                  /*!< размер отображения элементов очереди отправки */
+    unsigned            *sq_tail;                    /*!< хвост очереди отправки */
+    unsigned            *sq_mask;                    /*!< маска индекса очереди отправки */
+    unsigned            *cq_head;                    /*!< голова очереди завершения */
+    unsigned            *cq_tail;                    /*!< хвост очереди завершения */
+    unsigned            *cq_mask;                    /*!< маска индекса очереди завершения */
+    struct io_uring_cqe *cqes;                       /*!< элементы очереди завершения */
+    unsigned             entries;                    /*!< количество элементов очереди отправки */
+    unsigned             num_pending;                /*!< записи, ещё не помещённые в очередь отправки */
+    unsigned             queued;                     /*!< помещено в очередь отправки и не отправлено */
+    unsigned             inflight;                   /*!< отправлено и не завершено */
+    unsigned             done_tail;                  /*!< хвост очереди отправки, до которого записи завершены и дописаны */
+    struct iovec         bufs[LOG_URING_MAX_BUFS];   /*!< зарегистрированные буферы */
+    unsigned             num_bufs;                   /*!< количество зарегистрированных буферов */
+    log_uring_op_t       pending[LOG_URING_ENTRIES]; /*!< записи, ещё не помещённые в очередь отправки (по порядку вызовов) */
+    log_uring_op_t       ops[LOG_URING_ENTRIES];     /*!< записи по индексу элемента очереди отправки */
+}
+log_uring_t;
+
+static
+log_uring_t log_uring = { .ring_fd = -1 }; ///< глобальный контекст вывода через io_uring.
+
+/**
+ * Выводит данные в файловый дескриптор вызовами write(2).
+ *
+ * @param fd   [in] файловый дескриптор
+ * @param data [in] данные (!= NULL)
+ * @param len  [in] размер данных в байтах
+ */
+static
+void write_all(int         fd,
+               const char *data,
+               size_t      len) __attribute__((nonnull(2)));
+
+/**
+ * Обрабатывает элементы очереди завершения: запоминает результаты записей.
+ *
+ * @return количество обработанных элементов.
+ */
+static
+unsigned reap_completions(void);
+
+/**
+ * Помещает накопленные записи в очередь отправки: записи одного дескриптора идут подряд
+ * и связываются IOSQE_IO_LINK, чтобы ядро выполняло их по порядку.
+ */
+static
+void fill_sq(void);
+
+/**
+ * Синхронно дописывает недописанные (частичные, прерванные, отменённые) записи
+ * в порядке их постановки в очередь. Вызывается, когда все отправленные записи завершены.
+ */
+static
+void finish_writes(void);
+
+/**
+ * Освобождает отображения и дескриптор кольца.
+ */
+static
+void release_ring(void);
+
+/**
+ * Выводит данные в файловый дескриптор вызовами write(2).
+ *
+ * @param fd   [in] файловый дескриптор
+ * @param data [in] данные (!= NULL)
+ * @param len  [in] размер данных в байтах
+ */
+static
+void write_all(int         fd,
+               const char *data,
+               size_t      len)
+{
+    assert(data != NULL);
+
+    while (len > 0)
+    {
+        ssize_t res = write(fd, data, len);
+
+        if (res < 0)
+        {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += res;
+        len -= (size_t)res;
+    }
+}
+
+/**
+ * Обрабатывает элементы очереди завершения: запоминает результаты записей.
+ *
+ * @return количество обработанных элементов.
+ */
+static
+unsigned reap_completions(void)
+{
+    unsigned head = *log_uring.cq_head;
+    unsigned tail = __atomic_load_n(log_uring.cq_tail, __ATOMIC_ACQUIRE);
+    unsigned count = 0;
+
+    for (; head != tail; head++, count++)
+    {
+        const struct io_uring_cqe *cqe = &log_uring.cqes[head & *log_uring.cq_mask];
+
+        log_uring.ops[cqe->user_data].res = cqe->res;
+    }
+    __atomic_store_n(log_uring.cq_head, head, __ATOMIC_RELEASE);
+    log_uring.inflight -= count;
+    return count;
+}
+
+/**
+ * Помещает накопленные записи в очередь отправки: записи одного дескриптора идут подряд
+ * и связываются IOSQE_IO_LINK, чтобы ядро выполняло их по порядку.
+ */
+static
+void fill_sq(void)
+{
+    unsigned tail = *log_uring.sq_tail;
+    bool placed[LOG_URING_ENTRIES] = { false };
+    unsigned i, j;
+
+    for (i = 0; i < log_uring.num_pending; i++)
+    {
+        struct io_uring_sqe *prev = NULL;
+
+        if (placed[i]) continue;
+        for (j = i; j < log_uring.num_pending; j++)
+        {
+            const log_uring_op_t *op = &log_uring.pending[j];
+            unsigned index = tail & *log_uring.sq_mask;
+            struct io_uring_sqe *sqe = &log_uring.sqes[index];
+
+            if (placed[j] || op->fd != log_uring.pending[i].fd) continue;
+            placed[j] = true;
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_WRITE_FIXED;
+            sqe->fd = op->fd;
+            sqe->off = (uint64_t)-1;
+            sqe->addr = (uint64_t)(uintptr_t)op->data;
+            sqe->len = (uint32_t)op->len;
+            sqe->buf_index = (uint16_t)op->buf_index;
+            sqe->user_data = index;
+            /* частичная или неудачная запись отменяет следующие записи цепочки (-ECANCELED) */
+            if (prev) prev->flags |= IOSQE_IO_LINK;
+            prev = sqe;
+            log_uring.ops[index] = *op;
+            tail++;
+        }
+    }
+    __atomic_store_n(log_uring.sq_tail, tail, __ATOMIC_RELEASE);
+    log_uring.queued += log_uring.num_pending;
+    log_uring.num_pending = 0;
+}
+
+/**
+ * Синхронно дописывает недописанные (частичные, прерванные, отменённые) записи
+ * в порядке их постановки в очередь. Вызывается, когда все отправленные записи завершены.
+ */
+static
+void finish_writes(void)
+{
+    unsigned tail = *log_uring.sq_tail;
+
+    for (; log_uring.done_tail != tail; log_uring.done_tail++)
+    {
+        const log_uring_op_t *op = &log_uring.ops[log_uring.done_tail & *log_uring.sq_mask];
+
+        /* прочие ошибки игнорируются, как и у write(2) */
+        if (op->res >= 0 && (size_t)op->res < op->len)
+        {
+            write_all(op->fd, op->data + op->res, op->len - (size_t)op->res);
+        }
+        else if (op->res == -EINTR || op->res == -EAGAIN || op->res == -ECANCELED)
+        {
+            write_all(op->fd, op->data, op->len);
+        }
+    }
+}
+
+/**
+ * Освобождает отображения и дескриптор кольца.
+ */
+static
+void release_ring(void)
+{
+    if (log_uring.sqes) munmap(log_uring.sqes, log_uring.sqes_size);
+    if (log_uring.cq_ptr && log_uring.cq_ptr != log_uring.sq_ptr) munmap(log_uring.cq_ptr, log_uring.cq_size);
+    if (log_uring.sq_ptr) munmap(log_uring.sq_ptr, log_uring.sq_size);
+    if (log_uring.ring_fd >= 0) close(log_uring.ring_fd);
+    memset(&log_uring, 0, sizeof(log_uring));
+    log_uring.ring_fd = -1;
+}
+
+/**
+ * Создаёт кольцо io_uring и регистрирует буферы пачек.
+ *
+ * @param bufs     [in] буферы (!= NULL)
+ * @param num_bufs [in] количество буферов
+ * @param buf_size [in] размер каждого буфера в байтах
+ * @return true - OK, false - io_uring недоступен (не собран или запрещён ядром), вывод синхронный.
+ */
+extern
+bool log_uring_init(char * const bufs[],
+                    unsigned     num_bufs,
+                    size_t       buf_size)
+{
+    struct io_uring_params params;
+    unsigned *sq_array;
+    unsigned i;
+    long fd;
+
+    assert(bufs != NULL);
+
+    if (log_uring.ring_fd >= 0 || num_bufs > LOG_URING_MAX_BUFS) return false;
+    memset(&params, 0, sizeof(params));
+    fd = syscall(__NR_io_uring_setup, LOG_URING_ENTRIES, &params);
+    if (fd < 0) return false;
+    log_uring.ring_fd = (int)fd;
+    /* запись по текущей позиции файла (смещение -1) нужна для каналов и терминалов */
+    if (!(params.features & IORING_FEAT_RW_CUR_POS) || params.sq_entries > LOG_URING_ENTRIES)
+    {
+        release_ring();
+        return false;
+    }
+    log_uring.entries = params.sq_entries;
+    log_uring.sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    log_uring.cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        log_uring.sq_size = MAX(log_uring.sq_size, log_uring.cq_size);
+        log_uring.cq_size = log_uring.sq_size;
+    }
+    log_uring.sq_ptr = mmap(NULL, log_uring.sq_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                            log_uring.ring_fd, IORING_OFF_SQ_RING);
+    if (log_uring.sq_ptr == MAP_FAILED)
+    {
+        log_uring.sq_ptr = NULL;
+        release_ring();
+        return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        log_uring.cq_ptr = log_uring.sq_ptr;
+    }
+    else
+    {
+        log_uring.cq_ptr = mmap(NULL, log_uring.cq_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                log_uring.ring_fd, IORING_OFF_CQ_RING);
+        if (log_uring.cq_ptr == MAP_FAILED)
+        {
+            log_uring.cq_ptr = NULL;
+            release_ring();
+            return false;
+        }
+    }
+    log_uring.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    log_uring.sqes = mmap(NULL, log_uring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                          log_uring.ring_fd, IORING_OFF_SQES);
+    if (log_uring.sqes == MAP_FAILED)
+    {
+        log_uring.sqes = NULL;
+        release_ring();
+        return false;
+    }
+    log_uring.sq_tail = (unsigned *)((char *)log_uring.sq_ptr + params.sq_off.tail);
+    log_uring.sq_mask = (unsigned *)((char *)log_uring.sq_ptr + params.sq_off.ring_mask);
+    log_uring.cq_head = (unsigned *)((char *)log_uring.cq_ptr + params.cq_off.head);
+    log_uring.cq_tail = (unsigned *)((char *)log_uring.cq_ptr + params.cq_off.tail);
+    log_uring.cq_mask = (unsigned *)((char *)log_uring.cq_ptr + params.cq_off.ring_mask);
+    log_uring.cqes = (struct io_uring_cqe *)((char *)log_uring.cq_ptr + params.cq_off.cqes);
+    /* элемент очереди отправки с индексом i всегда описывается i-м элементом массива */
+    sq_array = (unsigned *)((char *)log_uring.sq_ptr + params.sq_off.array);
+    for (i = 0; i < params.sq_entries; i++) sq_array[i] = i;
+    /* буферы пачек закрепляются в памяти ядра один раз: запись из них не требует отображения страниц */
+    for (i = 0; i < num_bufs; i++)
+    {
+        log_uring.bufs[i].iov_base = bufs[i];
+        log_uring.bufs[i].iov_len = buf_size;
+    }
+    if (num_bufs &&
+        syscall(__NR_io_uring_register, log_uring.ring_fd, IORING_REGISTER_BUFFERS, log_uring.bufs, num_bufs) < 0)
+    {
+        release_ring();
+        return false;
+    }
+    log_uring.num_bufs = num_bufs;
+    return true;
+}
+
+/**
+ * Дожидается завершения всех записей и освобождает кольцо.
+ */
+extern
+void log_uring_destroy(void)
+{
+    if (log_uring.ring_fd < 0) return;
+    log_uring_wait();
+    release_ring();
+}
+
+/**
+ * Ставит в очередь запись данных из зарегистрированного буфера.
+ *
+ * @param fd   [in] файловый дескриптор
+ * @param data [in] данные (!= NULL)
+ * @param len  [in] размер данных в байтах
+ * @return true - запись поставлена в очередь, false - данные не из зарегистрированного буфера:
+ *         все ранее поставленные записи к этому моменту завершены, вызывающий выводит данные сам.
+ */
+extern
+bool log_uring_write(int         fd,
+                     const char *data,
+                     size_t      len)
+{
+    log_uring_op_t *op;
+    unsigned i;
+
+    assert(data != NULL);
+
+    for (i = 0; i < log_uring.num_bufs; i++)
+    {
+        const char *base = log_uring.bufs[i].iov_base;
+
+        if (data >= base && data + len <= base + log_uring.bufs[i].iov_len) break;
+    }
+    if (i == log_uring.num_bufs || len > UINT32_MAX)
+    {
+        /* синхронный вывод не должен обгонять поставленные в очередь записи */
+        log_uring_wait();
+        return false;
+    }
+    if (log_uring.num_pending + log_uring.queued + log_uring.inflight == log_uring.entries) log_uring_wait();
+    /* в очередь отправки записи помещаются при отправке, сгруппированными по дескрипторам */
+    op = &log_uring.pending[log_uring.num_pending++];
+    op->fd = fd;
+    op->data = data;
+    op->len = len;
+    op->buf_index = i;
+    op->res = 0;
+    return true;
+}
+
+/**
+ * Отправляет ядру поставленные в очередь записи, не дожидаясь их завершения.
+ * Записи в один дескриптор выполняются ядром в порядке постановки в очередь.
+ */
+extern
+void log_uring_submit(void)
+{
+    if (log_uring.num_pending) fill_sq();
+    while (log_uring.queued)
+    {
+        long res = syscall(__NR_io_uring_enter, log_uring.ring_fd, log_uring.queued, 0, 0, NULL, 0);
+
+        if (res < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+            {
+                /* нехватка ресурсов ядра: освободить очередь завершения и повторить */
+                (void)reap_completions();
+                continue;
+            }
+            return;
+        }
+        log_uring.queued -= (unsigned)res;
+        log_uring.inflight += (unsigned)res;
+    }
+}
+
+/**
+ * Отправляет поставленные в очередь записи и дожидается завершения всех записей
+ * (недописанный остаток выводится синхронно).
+ */
+extern
+void log_uring_wait(void)
+{
+    if (log_uring.ring_fd < 0) return;
+    log_uring_submit();
+    while (log_uring.inflight)
+    {
+        if (reap_completions()) continue;
+        if (syscall(__NR_io_uring_enter, log_uring.ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 &&
+            errno != EINTR)
+        {
+            return;
+        }
+    }
+    if (log_uring.queued == 0) finish_writes();
+}
+
+#else /* DO_LOG_IO_URING */
+
+/**
+ * Создаёт кольцо io_uring и регистрирует буферы пачек.
+ *
+ * @param bufs     [in] буферы (!= NULL)
+ * @param num_bufs [in] количество буферов
+ * @param buf_size [in] размер каждого буфера в байтах
+ * @return true - OK, false - io_uring недоступен (не собран или запрещён ядром), вывод синхронный.
+ */
+extern
+bool log_uring_init(char * const bufs[],
+                    unsigned     num_bufs,
+                    size_t       buf_size)
+{
+    assert(bufs != NULL);
+    UNUSED_PARAM(num_bufs);
+    UNUSED_PARAM(buf_size);
+
+    return false;
+}
+
+/**
+ * Дожидается завершения всех записей и освобождает кольцо.
+ */
+extern
+void log_uring_destroy(void)
+{
+}
+
+/**
+ * Ставит в очередь запись данных из зарегистрированного буфера.
+ *
+ * @param fd   [in] файловый дескриптор
+ * @param data [in] данные (!= NULL)
+ * @param len  [in] размер данных в байтах
+ * @return true - запись поставлена в очередь, false - данные не из зарегистрированного буфера:
+ *         все ранее поставленные записи к этому моменту завершены, вызывающий выводит данные сам.
+ */
+extern
+bool log_uring_write(int         fd,
+                     const char *data,
+                     size_t      len)
+{
+    assert(data != NULL);
+    UNUSED_PARAM(fd);
+    UNUSED_PARAM(len);
+
+    return false;
+}
+
+/**
+ * Отправляет ядру поставленные в очередь записи, не дожидаясь их завершения.
+ * Записи в один дескриптор выполняются ядром в порядке постановки в очередь.
+ */
+extern
+void log_uring_submit(void)
+{
+}
+
+/**
+ * Отправляет поставленные в очередь записи и дожидается завершения всех записей
+ * (недописанный остаток выводится синхронно).
+ */
+extern
+void log_uring_wait(void)
+{
+}
+
+#endif /* DO_LOG_IO_URING */
@@ -0,0 +1,61 @@
+#ifndef LOG_URING_H_
+#define LOG_URING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Вывод фонового потока через io_uring (Linux, при сборке с DO_LOG_IO_URING).
+ * Все функции, кроме log_uring_init() и log_uring_destroy(), вызываются только фоновым потоком вывода.
+ * Записи из зарегистрированных буферов ставятся в очередь и отправляются ядру одним вызовом
+ * на пачку, остальные данные вызывающий выводит синхронно.
+ */
+
+/**
+ * Создаёт кольцо io_uring и регистрирует буферы пачек.
+ *
+ * @param bufs     [in] буферы (!= NULL)
+ * @param num_bufs [in] количество буферов
+ * @param buf_size [in] размер каждого буфера в байтах
+ * @return true - OK, false - io_uring недоступен (не собран или запрещён ядром), вывод синхронный.
+ */
+extern
+bool log_uring_init(char * const bufs[],
+                    unsigned     num_bufs,
+                    size_t       buf_size) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
+
+/**
+ * Дожидается завершения всех записей и освобождает кольцо.
+ */
+extern
+void log_uring_destroy(void);
+
+/**
+ * Ставит в очередь запись данных из зарегистрированного буфера.
+ *
+ * @param fd   [in] файловый дескриптор
+ * @param data [in] данные (!= NULL)
+ * @param len  [in] размер данных в байтах
+ * @return true - запись поставлена в очередь, false - данные не из зарегистрированного буфера:
+ *         все ранее поставленные записи к этому моменту завершены, вызывающий выводит данные сам.
+ */
+extern
+bool log_uring_write(int         fd,
+                     const char *data,
+                     size_t      len) __attribute__((nonnull(2)));
+
+/**
+ * Отправляет ядру поставленные в очередь записи, не дожидаясь их завершения.
+ * Записи в один дескриптор выполняются ядром в порядке постановки в очередь.
+ */
+extern
+void log_uring_submit(void);
+
+/**
+ * Отправляет поставленные в очередь записи и дожидается завершения всех записей
+ * (недописанный остаток выводится синхронно).
+ */
+extern
+void log_uring_wait(void);
+
+#endif /* LOG_URING_H_ */
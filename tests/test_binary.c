@@ -0,0 +1,240 @@
+/*
+ * Проверка двоичного файла журнала: текст, восстановленный cos_log_decode, побайтно совпадает
+ * с выводом тех же записей в текстовом режиме. Время записей задаёт тест (подменой clock_gettime()
+ * для часов реального времени). Записи содержат аргументы всех типов, отрицательные приращения времени,
+ * источники сверх словаря сессии (LOG_BIN_MAX_SOURCES) и неподдерживаемые строки формата (кадры текста).
+ *
+ * Использование: test_binary <cos_log_decode> <двоичный файл>
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define _LOG_SRC "TEST"
+#include "log.h"
+#include "log_deferred.h"
+
+/**
+ * Количество итераций записи
+ */
+#define TEST_NUM_RECORDS 400
+
+/**
+ * Количество источников: часть из них не помещается в словарь сессии
+ */
+#define TEST_NUM_SOURCES (LOG_BIN_MAX_SOURCES + 44)
+
+/**
+ * Время первой записи, нс
+ */
+#define TEST_START_NS 1700000000123456789ull
+
+/**
+ * Проверяет условие, при невыполнении выводит его и завершает тест с ошибкой
+ */
+#define CHECK(cond)                                                                 \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE);                                                     \
+        }                                                                           \
+    }                                                                               \
+    while (0)
+
+/**
+ * Накопленный вывод
+ */
+typedef struct tag_test_output
+{
+    char   *data; /*!< данные */
+    size_t  len;  /*!< размер данных в байтах */
+    size_t  size; /*!< размер буфера в байтах */
+}
+test_output_t;
+
+static
+uint64_t fake_ns; ///< время часов реального времени, возвращаемое clock_gettime(), нс.
+
+static
+char sources[TEST_NUM_SOURCES][16]; ///< имена источников.
+
+/**
+ * Дописывает данные в накопленный вывод.
+ *
+ * @param out  [in/out] вывод (!= NULL)
+ * @param data [in]     данные (!= NULL)
+ * @param len  [in]     размер данных в байтах
+ */
+static
+void output_append(test_output_t *out,
+                   const char    *data,
+                   size_t         len)
+{
+    if (out->len + len > out->size)
+    {
+        out->size = (out->len + len) * 2;
+        out->data = realloc(out->data, out->size);
+        CHECK(out->data != NULL);
+    }
+    memcpy(out->data + out->len, data, len);
+    out->len += len;
+}
+
+/**
+ * Подменяет часы реального времени временем, заданным тестом, остальные часы - системные.
+ *
+ * @param clk_id [in]  часы
+ * @param tp     [out] время (!= NULL)
+ * @return 0 - OK, -1 - Fail
+ */
+int clock_gettime(clockid_t        clk_id,
+                  struct timespec *tp)
+{
+    if (clk_id == CLOCK_REALTIME || clk_id == CLOCK_REALTIME_COARSE)
+    {
+        tp->tv_sec = (time_t)(fake_ns / 1000000000u);
+        tp->tv_nsec = (long)(fake_ns % 1000000000u);
+        return 0;
+    }
+    return (int)syscall(SYS_clock_gettime, clk_id, tp);
+}
+
+/**
+ * Приёмник, накапливающий текстовый вывод.
+ *
+ * @param arg   [in] накопленный вывод (test_output_t *)
+ * @param data  [in] данные
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void save_sink(void        *arg,
+               const char  *data,
+               size_t       len,
+               log_level_t  level)
+{
+    UNUSED_PARAM(level);
+
+    output_append(arg, data, len);
+}
+
+/**
+ * Логгирует проверочные записи (одинаково в текстовом и двоичном режимах).
+ */
+static
+void log_records(void)
+{
+    static log_callsite_t callsite;
+    unsigned i;
+
+    fake_ns = TEST_START_NS;
+    for (i = 0; i < TEST_NUM_RECORDS; i++)
+    {
+        /* приращения разной длины, иногда отрицательные (как у записей разных потоков) */
+        fake_ns += (uint64_t)i * i * 7919u % 100000000u;
+        if (i % 5 == 4) fake_ns -= 12345678;
+
+        _LOG_INFO("record %u: int %d, negative %d, char %c, short %hd", i, (int)i * 1000, -(int)i, 'a' + (int)(i % 26),
+                  (short)-(int)i);
+        _LOG_WARNING("long %ld, llong %lld, hex %llx, intmax %jd, size %zu, ptrdiff %td", -(long)i * 100000,
+                     (long long)i << 40, 0xFFFFFFFFFFFFFFFFull - i, (intmax_t)-1 - (intmax_t)i, (size_t)i * 3,
+                     (ptrdiff_t)i - 200);
+        _LOG_ERROR("double %.3f %g, long double %.5Lf, star [%*d] [%-*.*s]", i / 7.0, -1e300 / (i + 1),
+                   (long double)i / 3, (int)(i % 9), (int)i, 12, (int)(i % 5), "truncated string");
+        _LOG_INFO("str \"%s\", ptr %p, percent 100%%", sources[i % TEST_NUM_SOURCES], (void *)(uintptr_t)(0x1000 + i));
+        _LOG_DEBUG("hidden %u", i);
+        if (i % 50 == 0) _LOG_INFO("positional %1$u", i);
+        log_log_cs(&callsite, sources[i % TEST_NUM_SOURCES], __FILE__, STRX(__LINE__), __FUNCTION__, LL_WARNING,
+                   "source %u", i % TEST_NUM_SOURCES);
+    }
+}
+
+/**
+ * Регистрирует источники записей.
+ */
+static
+void register_sources(void)
+{
+    unsigned i;
+
+    CHECK(log_register(_LOG_SRC, LL_DEBUG));
+    for (i = 0; i < TEST_NUM_SOURCES; i++)
+    {
+        CHECK(log_register(sources[i], LL_INFO));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    test_output_t text = { NULL, 0, 0 };
+    test_output_t decoded = { NULL, 0, 0 };
+    log_config_t config;
+    char cmd[4096];
+    char buf[4096];
+    FILE *pipe;
+    FILE *bin;
+    long bin_size;
+    size_t len;
+    unsigned i;
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s <cos_log_decode> <binary file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < TEST_NUM_SOURCES; i++)
+    {
+        snprintf(sources[i], sizeof(sources[i]), "SRC%u", i);
+    }
+
+    /* текстовый режим */
+    CHECK(log_init(LL_INFO, true));
+    register_sources();
+    CHECK(log_sink_add_callback(save_sink, &text, LL_RAW) != NULL);
+    log_records();
+    CHECK(log_destroy());
+
+    /* двоичный файл журнала */
+    unlink(argv[2]);
+    ZEROIZE_STRUCT(config);
+    config.min_log_level = LL_INFO;
+    config.is_thread_safe = true;
+    config.async_ring_size = 8 * TEST_NUM_RECORDS;
+    config.binary_path = argv[2];
+    CHECK(log_init_ex(&config));
+    register_sources();
+    log_records();
+    CHECK(log_destroy());
+
+    snprintf(cmd, sizeof(cmd), "'%s' '%s'", argv[1], argv[2]);
+    pipe = popen(cmd, "r");
+    CHECK(pipe != NULL);
+    while ((len = fread(buf, 1, sizeof(buf), pipe)) > 0)
+    {
+        output_append(&decoded, buf, len);
+    }
+    CHECK(pclose(pipe) == 0);
+
+    bin = fopen(argv[2], "rb");
+    CHECK(bin != NULL);
+    CHECK(fseek(bin, 0, SEEK_END) == 0);
+    bin_size = ftell(bin);
+    fclose(bin);
+    printf("text %zu bytes, binary %ld bytes\n", text.len, bin_size);
+
+    CHECK(text.len > 0);
+    CHECK(decoded.len == text.len);
+    CHECK(memcmp(decoded.data, text.data, text.len) == 0);
+    /* точки логгирования и источники хранятся в словаре, числа - в varint */
+    CHECK((size_t)bin_size < text.len / 2);
+    free(decoded.data);
+    free(text.data);
+    return EXIT_SUCCESS;
+}
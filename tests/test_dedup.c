@@ -0,0 +1,201 @@
+/*
+ * Проверка подавления повторов (log_config_t.dedup_window_ms): совпадающие записи источника в пределах окна
+ * подсчитываются, итоговая строка "last message repeated N times" выводится перед следующей записью вне серии,
+ * в log_flush() и в log_destroy(); источники, уровни и точки логгирования считаются раздельно.
+ * Монотонное время задаёт тест (подменой clock_gettime()).
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define _LOG_SRC "TEST"
+#include "log.h"
+
+/**
+ * Окно подавления повторов, мс
+ */
+#define TEST_WINDOW_MS 1000
+
+/**
+ * Максимальное количество сохраняемых записей
+ */
+#define TEST_MAX_RECORDS 32
+
+/**
+ * Проверяет условие, при невыполнении выводит его и завершает тест с ошибкой
+ */
+#define CHECK(cond)                                                                 \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE);                                                     \
+        }                                                                           \
+    }                                                                               \
+    while (0)
+
+static
+uint64_t fake_ns = 1000000000000ull; ///< время монотонных часов, возвращаемое clock_gettime(), нс.
+
+static
+char records[TEST_MAX_RECORDS][256]; ///< записи, полученные приёмником.
+
+static
+unsigned num_records; ///< количество записей, полученных приёмником.
+
+/**
+ * Подменяет монотонные часы временем, заданным тестом, остальные часы - системные.
+ *
+ * @param clk_id [in]  часы
+ * @param tp     [out] время (!= NULL)
+ * @return 0 - OK, -1 - Fail
+ */
+int clock_gettime(clockid_t        clk_id,
+                  struct timespec *tp)
+{
+    if (clk_id == CLOCK_MONOTONIC || clk_id == CLOCK_MONOTONIC_COARSE)
+    {
+        tp->tv_sec = (time_t)(fake_ns / 1000000000u);
+        tp->tv_nsec = (long)(fake_ns % 1000000000u);
+        return 0;
+    }
+    return (int)syscall(SYS_clock_gettime, clk_id, tp);
+}
+
+/**
+ * Приёмник, сохраняющий записи.
+ *
+ * @param arg   [in] не используется.
+ * @param data  [in] данные
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void save_sink(void        *arg,
+               const char  *data,
+               size_t       len,
+               log_level_t  level)
+{
+    UNUSED_PARAM(arg);
+    UNUSED_PARAM(level);
+
+    CHECK(num_records < TEST_MAX_RECORDS);
+    len = MIN(len, sizeof(records[0]) - 1);
+    memcpy(records[num_records], data, len);
+    records[num_records][len] = '\0';
+    num_records++;
+}
+
+/**
+ * Логгирует одно и то же сообщение через одну точку логгирования.
+ *
+ * @param handle [in] дескриптор источника (!= NULL)
+ * @param level  [in] уровень записей
+ * @param msg    [in] сообщение (!= NULL)
+ * @param count  [in] количество записей
+ */
+static
+void log_repeated(const log_source_t *handle,
+                  log_level_t         level,
+                  const char         *msg,
+                  unsigned            count)
+{
+    unsigned i;
+
+    for (i = 0; i < count; i++)
+    {
+        _LOG_H_LEVEL(handle, level, "%s", msg);
+    }
+}
+
+/**
+ * Проверяет окончание записи.
+ *
+ * @param idx    [in] номер записи
+ * @param suffix [in] ожидаемое окончание (без перевода строки) (!= NULL)
+ * @return true - совпадает, false - нет.
+ */
+static
+bool record_ends(unsigned    idx,
+                 const char *suffix)
+{
+    size_t len = strlen(suffix);
+    size_t rec_len;
+
+    if (idx >= num_records) return false;
+    rec_len = strlen(records[idx]);
+    return (rec_len >= len + 1) && (memcmp(records[idx] + rec_len - len - 1, suffix, len) == 0) &&
+           (records[idx][rec_len - 1] == '\n');
+}
+
+int main(void)
+{
+    log_config_t config;
+    log_source_t *test;
+    log_source_t *other;
+
+    ZEROIZE_STRUCT(config);
+    config.min_log_level = LL_INFO;
+    config.is_thread_safe = true;
+    config.dedup_window_ms = TEST_WINDOW_MS;
+    CHECK(log_init_ex(&config));
+    test = log_register_handle(_LOG_SRC, LL_INFO);
+    other = log_register_handle("OTHER", LL_INFO);
+    CHECK(test != NULL && other != NULL);
+    CHECK(log_sink_add_callback(save_sink, NULL, LL_INFO) != NULL);
+
+    /* серия повторов выводится одной записью, итог - перед следующей записью источника */
+    log_repeated(test, LL_INFO, "same", 5);
+    CHECK(num_records == 1);
+    CHECK(record_ends(0, "same"));
+    log_repeated(test, LL_INFO, "different", 1);
+    CHECK(num_records == 3);
+    CHECK(record_ends(1, "last message repeated 4 times"));
+    CHECK(record_ends(2, "different"));
+
+    /* другой уровень и другой источник не продолжают серию, источники считаются раздельно */
+    log_repeated(test, LL_WARNING, "different", 1);
+    CHECK(num_records == 4);
+    log_repeated(other, LL_WARNING, "different", 4);
+    log_repeated(test, LL_WARNING, "different", 2);
+    CHECK(num_records == 5);
+    CHECK(record_ends(4, "different"));
+
+    /* log_flush() выводит итоги всех источников */
+    log_flush();
+    CHECK(num_records == 7);
+    CHECK((record_ends(5, "last message repeated 2 times") && record_ends(6, "last message repeated 3 times")) ||
+          (record_ends(5, "last message repeated 3 times") && record_ends(6, "last message repeated 2 times")));
+    log_flush();
+    CHECK(num_records == 7);
+
+    /* после окончания окна та же запись выводится снова, начиная новую серию */
+    log_repeated(test, LL_WARNING, "different", 1);
+    CHECK(num_records == 7);
+    fake_ns += (uint64_t)TEST_WINDOW_MS * 1000000u;
+    log_repeated(test, LL_WARNING, "different", 3);
+    CHECK(num_records == 9);
+    CHECK(record_ends(7, "last message repeated 1 times"));
+    CHECK(record_ends(8, "different"));
+
+    /* то же сообщение из другой точки логгирования не продолжает серию */
+    _LOG_H_WARNING(test, "%s", "different");
+    CHECK(num_records == 11);
+    CHECK(record_ends(9, "last message repeated 2 times"));
+    CHECK(record_ends(10, "different"));
+
+    /* log_destroy() выводит оставшиеся итоги (окно серии другого источника тоже истекло) */
+    log_repeated(other, LL_WARNING, "different", 2);
+    CHECK(num_records == 12);
+    CHECK(record_ends(11, "different"));
+    CHECK(log_destroy());
+    CHECK(num_records == 13);
+    CHECK(record_ends(12, "last message repeated 1 times"));
+    return EXIT_SUCCESS;
+}
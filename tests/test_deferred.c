@@ -0,0 +1,195 @@
+/*
+ * Проверка отложенного форматирования (log_config_t.deferred): текст, сформированный фоновым потоком
+ * из сохранённых аргументов, побайтно совпадает с выводом тех же записей в синхронном режиме.
+ * Записи содержат аргументы всех типов, строки, изменяемые сразу после вызова (сохраняются копии),
+ * строки длиннее ячейки кольца и неподдерживаемые строки формата (форматируются сразу).
+ * Время записей задаёт тест (подменой clock_gettime() для часов реального времени).
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define _LOG_SRC "TEST"
+#include "log.h"
+
+/**
+ * Количество итераций записи
+ */
+#define TEST_NUM_RECORDS 300
+
+/**
+ * Размер ячейки кольца: длинные строки не помещаются в ячейку
+ */
+#define TEST_RECORD_SIZE 128
+
+/**
+ * Время первой записи, нс
+ */
+#define TEST_START_NS 1700000000987654321ull
+
+/**
+ * Проверяет условие, при невыполнении выводит его и завершает тест с ошибкой
+ */
+#define CHECK(cond)                                                                 \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE);                                                     \
+        }                                                                           \
+    }                                                                               \
+    while (0)
+
+/**
+ * Накопленный вывод
+ */
+typedef struct tag_test_output
+{
+    char   *data; /*!< данные */
+    size_t  len;  /*!< размер данных в байтах */
+    size_t  size; /*!< размер буфера в байтах */
+}
+test_output_t;
+
+static
+uint64_t fake_ns; ///< время часов реального времени, возвращаемое clock_gettime(), нс.
+
+/**
+ * Дописывает данные в накопленный вывод.
+ *
+ * @param out  [in/out] вывод (!= NULL)
+ * @param data [in]     данные (!= NULL)
+ * @param len  [in]     размер данных в байтах
+ */
+static
+void output_append(test_output_t *out,
+                   const char    *data,
+                   size_t         len)
+{
+    if (out->len + len > out->size)
+    {
+        out->size = (out->len + len) * 2;
+        out->data = realloc(out->data, out->size);
+        CHECK(out->data != NULL);
+    }
+    memcpy(out->data + out->len, data, len);
+    out->len += len;
+}
+
+/**
+ * Подменяет часы реального времени временем, заданным тестом, остальные часы - системные.
+ *
+ * @param clk_id [in]  часы
+ * @param tp     [out] время (!= NULL)
+ * @return 0 - OK, -1 - Fail
+ */
+int clock_gettime(clockid_t        clk_id,
+                  struct timespec *tp)
+{
+    if (clk_id == CLOCK_REALTIME || clk_id == CLOCK_REALTIME_COARSE)
+    {
+        tp->tv_sec = (time_t)(fake_ns / 1000000000u);
+        tp->tv_nsec = (long)(fake_ns % 1000000000u);
+        return 0;
+    }
+    return (int)syscall(SYS_clock_gettime, clk_id, tp);
+}
+
+/**
+ * Приёмник, накапливающий текстовый вывод.
+ *
+ * @param arg   [in] накопленный вывод (test_output_t *)
+ * @param data  [in] данные
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void save_sink(void        *arg,
+               const char  *data,
+               size_t       len,
+               log_level_t  level)
+{
+    UNUSED_PARAM(level);
+
+    output_append(arg, data, len);
+}
+
+/**
+ * Логгирует проверочные записи (одинаково в синхронном и отложенном режимах).
+ */
+static
+void log_records(void)
+{
+    char changing[32];
+    char long_str[3 * TEST_RECORD_SIZE];
+    unsigned i;
+
+    fake_ns = TEST_START_NS;
+    for (i = 0; i < TEST_NUM_RECORDS; i++)
+    {
+        fake_ns += (uint64_t)i * 104729u % 50000000u;
+
+        _LOG_INFO("record %u: int %d, char %c, short %hd, uchar %hhu", i, -(int)i * 1000, 'A' + (int)(i % 26),
+                  (short)(i * 300), (unsigned char)i);
+        _LOG_WARNING("long %ld, ullong %llu, hex %#llx, size %zu, ptrdiff %td, intmax %jd", (long)i * -70000,
+                     (unsigned long long)i << 50, 0xFEDCBA9876543210ull + i, (size_t)i * 5, (ptrdiff_t)i - 1000,
+                     (intmax_t)INT64_MIN + i);
+        _LOG_ERROR("double %.4f %e, long double %.3Lf, star [%*u] [%-*.*s]", i / 3.0, 1e-300 * (i + 1),
+                   (long double)i / 7, (int)(i % 7), i, 10, (int)(i % 6), "precision");
+
+        /* строка копируется при вызове: изменение после вызова не попадает в запись */
+        snprintf(changing, sizeof(changing), "before %u", i);
+        _LOG_INFO("str \"%s\", ptr %p, null %s, percent 5%%", changing, (void *)(uintptr_t)(0xABC0 + i), (char *)NULL);
+        snprintf(changing, sizeof(changing), "after %u", i);
+
+        /* запись длиннее ячейки кольца */
+        memset(long_str, 'a' + (int)(i % 26), sizeof(long_str) - 1);
+        long_str[sizeof(long_str) - 1] = '\0';
+        if (i % 10 == 0) _LOG_INFO("long %u %s", i, long_str);
+
+        /* неподдерживаемая строка формата форматируется сразу */
+        if (i % 25 == 0) _LOG_INFO("positional %1$u %1$u", i);
+        _LOG_DEBUG("hidden %u", i);
+    }
+}
+
+int main(void)
+{
+    test_output_t text = { NULL, 0, 0 };
+    test_output_t deferred = { NULL, 0, 0 };
+    log_config_t config;
+
+    /* синхронный режим */
+    CHECK(log_init(LL_INFO, true));
+    CHECK(log_register(_LOG_SRC, LL_INFO));
+    CHECK(log_sink_add_callback(save_sink, &text, LL_INFO) != NULL);
+    log_records();
+    CHECK(log_destroy());
+
+    /* отложенное форматирование: log_flush() дожидается вывода фоновым потоком */
+    ZEROIZE_STRUCT(config);
+    config.min_log_level = LL_INFO;
+    config.is_thread_safe = true;
+    config.deferred = true;
+    config.async_ring_size = 8 * TEST_NUM_RECORDS;
+    config.async_record_size = TEST_RECORD_SIZE;
+    CHECK(log_init_ex(&config));
+    CHECK(log_register(_LOG_SRC, LL_INFO));
+    CHECK(log_sink_add_callback(save_sink, &deferred, LL_INFO) != NULL);
+    log_records();
+    log_flush();
+
+    CHECK(text.len > 0);
+    CHECK(deferred.len == text.len);
+    CHECK(memcmp(deferred.data, text.data, text.len) == 0);
+    CHECK(log_destroy());
+    free(deferred.data);
+    free(text.data);
+    return EXIT_SUCCESS;
+}
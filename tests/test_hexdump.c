@@ -0,0 +1,147 @@
+/*
+ * Проверка log_hexdump(): вывод совпадает со скалярной реализацией на snprintf для длин 0..257
+ * (включая неполные последние строки) при формировании дампа целиком и по одной строке,
+ * дамп NULL-буфера через _LOG_RAW выводится как "NULL".
+ */
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _LOG_SRC "TEST"
+#include "log.h"
+#include "log_hexdump.h"
+
+/**
+ * Максимальная проверяемая длина буфера
+ */
+#define TEST_MAX_SIZE 257
+
+/**
+ * Количество строк дампа буфера максимальной длины
+ */
+#define TEST_MAX_LINES ((TEST_MAX_SIZE + 15) / 16)
+
+/**
+ * Проверяет условие, при невыполнении выводит его и завершает тест с ошибкой
+ */
+#define CHECK(cond)                                                                 \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE);                                                     \
+        }                                                                           \
+    }                                                                               \
+    while (0)
+
+static
+char last_record[256]; ///< последняя запись, полученная приёмником.
+
+/**
+ * Формирует дамп буфера скалярно через snprintf: "АДРЕС   XX XX ... XX | текст\n" на каждые 16 байт.
+ *
+ * @param out  [out] буфер размером не менее TEST_MAX_LINES * LOG_HEXDUMP_LINE_MAX_SIZE + 1 (!= NULL)
+ * @param buf  [in]  буфер (!= NULL)
+ * @param size [in]  размер буфера в байтах (<= TEST_MAX_SIZE)
+ * @return длина дампа в байтах.
+ */
+static
+size_t reference_hexdump(char                *out,
+                         const unsigned char *buf,
+                         size_t               size)
+{
+    size_t out_size = TEST_MAX_LINES * LOG_HEXDUMP_LINE_MAX_SIZE + 1;
+    size_t len = 0;
+    size_t offset;
+
+    for (offset = 0; offset < size; offset += 16)
+    {
+        size_t limit = (size - offset > 16) ? 16 : size - offset;
+        size_t i;
+
+        len += (size_t)snprintf(out + len, out_size - len, "%.8zX  ", offset);
+        for (i = 0; i < 16; i++)
+        {
+            if (i < limit) len += (size_t)snprintf(out + len, out_size - len, " %.2hhX", buf[offset + i]);
+            else len += (size_t)snprintf(out + len, out_size - len, "   ");
+        }
+        len += (size_t)snprintf(out + len, out_size - len, " | ");
+        for (i = 0; i < limit; i++)
+        {
+            len += (size_t)snprintf(out + len, out_size - len, "%c", isprint(buf[offset + i]) ? buf[offset + i] : '.');
+        }
+        len += (size_t)snprintf(out + len, out_size - len, "\n");
+    }
+    out[len] = '\0';
+    return len;
+}
+
+/**
+ * Приёмник, сохраняющий последнюю запись.
+ *
+ * @param arg   [in] не используется.
+ * @param data  [in] данные
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void save_sink(void        *arg,
+               const char  *data,
+               size_t       len,
+               log_level_t  level)
+{
+    UNUSED_PARAM(arg);
+    UNUSED_PARAM(level);
+
+    len = MIN(len, sizeof(last_record) - 1);
+    memcpy(last_record, data, len);
+    last_record[len] = '\0';
+}
+
+int main(void)
+{
+    static unsigned char buf[TEST_MAX_SIZE];
+    static char expected[TEST_MAX_LINES * LOG_HEXDUMP_LINE_MAX_SIZE + 1];
+    static char actual[TEST_MAX_LINES * LOG_HEXDUMP_LINE_MAX_SIZE + 1];
+    size_t size;
+    size_t i;
+
+    /* все значения байт, включая непечатаемые */
+    for (i = 0; i < sizeof(buf); i++)
+    {
+        buf[i] = (unsigned char)(i * 37 + 11);
+    }
+    for (size = 0; size <= TEST_MAX_SIZE; size++)
+    {
+        size_t num_lines = (size + 15) / 16;
+        size_t expected_len = reference_hexdump(expected, buf, size);
+        size_t len;
+
+        /* весь дамп одним вызовом */
+        len = log_hexdump(actual, buf, size, 0, num_lines);
+        CHECK(len == expected_len);
+        CHECK(memcmp(actual, expected, len) == 0);
+
+        /* по одной строке, как при выводе дампа частями */
+        len = 0;
+        for (i = 0; i < num_lines; i++)
+        {
+            len += log_hexdump(actual + len, buf, size, i, 1);
+        }
+        CHECK(len == expected_len);
+        CHECK(memcmp(actual, expected, len) == 0);
+    }
+
+    CHECK(log_init(LL_RAW, true));
+    CHECK(log_register(_LOG_SRC, LL_RAW));
+    CHECK(log_sink_add_callback(save_sink, NULL, LL_RAW) != NULL);
+    _LOG_RAW(NULL, 5);
+    size = strlen(last_record);
+    CHECK(size >= sizeof("\nNULL\n") - 1);
+    CHECK(strcmp(last_record + size - (sizeof("\nNULL\n") - 1), "\nNULL\n") == 0);
+    CHECK(log_destroy());
+    return EXIT_SUCCESS;
+}
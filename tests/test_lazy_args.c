@@ -0,0 +1,121 @@
+/*
+ * Проверка ленивого вычисления аргументов логгирующих макросов: аргументы вычисляются только
+ * для выводимых уровней. Собирается дважды: с TEST_COMPILE_MIN_LEVEL == LOG_LVL_RAW (все макросы
+ * присутствуют) и с TEST_COMPILE_MIN_LEVEL == LOG_LVL_NONE (все макросы вырезаны при компиляции).
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef TEST_COMPILE_MIN_LEVEL
+#undef LOG_COMPILE_MIN_LEVEL
+#define LOG_COMPILE_MIN_LEVEL TEST_COMPILE_MIN_LEVEL
+#endif
+
+#define _LOG_SRC "TEST"
+#include "log.h"
+
+/**
+ * Проверяет условие, при невыполнении выводит его и завершает тест с ошибкой
+ */
+#define CHECK(cond)                                                                 \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE);                                                     \
+        }                                                                           \
+    }                                                                               \
+    while (0)
+
+static
+unsigned evaluated; ///< количество вычислений аргументов.
+
+static
+unsigned written;   ///< количество записей, полученных приёмником.
+
+static
+const char dump[4] = { 1, 2, 3, 4 }; ///< буфер для _LOG_RAW.
+
+/**
+ * Аргумент логгирующего макроса с побочным эффектом: считает свои вычисления.
+ *
+ * @param value [in] значение
+ * @return value
+ */
+static
+int side_effect(int value)
+{
+    evaluated++;
+    return value;
+}
+
+/**
+ * Приёмник, считающий записи.
+ *
+ * @param arg   [in] не используется.
+ * @param data  [in] данные
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void count_sink(void        *arg,
+                const char  *data,
+                size_t       len,
+                log_level_t  level)
+{
+    UNUSED_PARAM(arg);
+    UNUSED_PARAM(data);
+    UNUSED_PARAM(len);
+    UNUSED_PARAM(level);
+
+    written++;
+}
+
+/**
+ * Логгирует через _LOG_LEVEL, _LOG_RAW и _LOG_ERROR_EX, каждый раз вычисляя ровно один аргумент side_effect().
+ */
+static
+void log_all(void)
+{
+    _LOG_INFO("info %d", side_effect(1));
+    _LOG_RAW(dump, (size_t)side_effect((int)sizeof(dump)));
+    _LOG_ERROR_EX(side_effect(2), "error text", "error %d", 3);
+}
+
+/**
+ * Логгирует при уровне источника min_log_level и проверяет количество вычисленных аргументов и записей.
+ *
+ * @param min_log_level [in] уровень источника
+ * @param expected      [in] ожидаемое количество вычислений аргументов (и записей)
+ */
+static
+void check_level(log_level_t min_log_level,
+                 unsigned    expected)
+{
+    CHECK(log_register(_LOG_SRC, min_log_level));
+    evaluated = 0;
+    written = 0;
+    log_all();
+    CHECK(evaluated == expected);
+    CHECK(written == expected);
+}
+
+int main(void)
+{
+    bool stripped = (LOG_COMPILE_MIN_LEVEL > LOG_LVL_ERROR);
+
+    CHECK(log_init(LL_RAW, true));
+    CHECK(log_sink_add_callback(count_sink, NULL, LL_RAW) != NULL);
+
+    /* все уровни выводятся */
+    check_level(LL_RAW, stripped ? 0 : 3);
+    /* выводится только ошибка */
+    check_level(LL_ERROR, stripped ? 0 : 1);
+    /* вывод выключен */
+    check_level(LL_NONE, 0);
+
+    CHECK(log_destroy());
+    return EXIT_SUCCESS;
+}
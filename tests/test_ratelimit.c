@@ -0,0 +1,196 @@
+/*
+ * Проверка логгирующих макросов с ограничением частоты (_LOG_*_RL): пачка из burst записей
+ * выводится сразу, остальные подавляются без вычисления аргументов, следующая выведенная запись
+ * сообщает количество подавленных. Монотонное время задаёт тест (подменой clock_gettime()).
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define _LOG_SRC "TEST"
+#include "log.h"
+
+/**
+ * Разрешённое количество записей в секунду
+ */
+#define TEST_RATE 10
+
+/**
+ * Максимальная пачка записей
+ */
+#define TEST_BURST 3
+
+/**
+ * Интервал между записями при TEST_RATE, нс
+ */
+#define TEST_INTERVAL_NS (1000000000ull / TEST_RATE)
+
+/**
+ * Максимальное количество сохраняемых записей
+ */
+#define TEST_MAX_RECORDS 16
+
+/**
+ * Проверяет условие, при невыполнении выводит его и завершает тест с ошибкой
+ */
+#define CHECK(cond)                                                                 \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE);                                                     \
+        }                                                                           \
+    }                                                                               \
+    while (0)
+
+static
+uint64_t fake_ns = 1000000000000ull; ///< время монотонных часов, возвращаемое clock_gettime(), нс.
+
+static
+char records[TEST_MAX_RECORDS][256]; ///< записи, полученные приёмником.
+
+static
+unsigned num_records; ///< количество записей, полученных приёмником.
+
+static
+unsigned num_evaluated; ///< количество вычислений аргумента записи.
+
+/**
+ * Подменяет монотонные часы временем, заданным тестом, остальные часы - системные.
+ *
+ * @param clk_id [in]  часы
+ * @param tp     [out] время (!= NULL)
+ * @return 0 - OK, -1 - Fail
+ */
+int clock_gettime(clockid_t        clk_id,
+                  struct timespec *tp)
+{
+    if (clk_id == CLOCK_MONOTONIC || clk_id == CLOCK_MONOTONIC_COARSE)
+    {
+        tp->tv_sec = (time_t)(fake_ns / 1000000000u);
+        tp->tv_nsec = (long)(fake_ns % 1000000000u);
+        return 0;
+    }
+    return (int)syscall(SYS_clock_gettime, clk_id, tp);
+}
+
+/**
+ * Приёмник, сохраняющий записи.
+ *
+ * @param arg   [in] не используется.
+ * @param data  [in] данные
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void save_sink(void        *arg,
+               const char  *data,
+               size_t       len,
+               log_level_t  level)
+{
+    UNUSED_PARAM(arg);
+    UNUSED_PARAM(level);
+
+    CHECK(num_records < TEST_MAX_RECORDS);
+    len = MIN(len, sizeof(records[0]) - 1);
+    memcpy(records[num_records], data, len);
+    records[num_records][len] = '\0';
+    num_records++;
+}
+
+/**
+ * Аргумент записи, подсчитывающий свои вычисления.
+ *
+ * @param value [in] значение
+ * @return value
+ */
+static
+unsigned evaluated(unsigned value)
+{
+    num_evaluated++;
+    return value;
+}
+
+/**
+ * Логгирует через одну точку с ограничением частоты.
+ *
+ * @param count [in] количество вызовов
+ */
+static
+void log_burst(unsigned count)
+{
+    unsigned i;
+
+    for (i = 0; i < count; i++)
+    {
+        _LOG_WARNING_RL(TEST_RATE, TEST_BURST, "limited %u", evaluated(i));
+    }
+}
+
+/**
+ * Проверяет, что запись содержит сообщение и заканчивается количеством подавленных записей.
+ *
+ * @param idx        [in] номер записи
+ * @param msg        [in] сообщение (!= NULL)
+ * @param suppressed [in] количество подавленных записей (0 - без количества)
+ * @return true - совпадает, false - нет.
+ */
+static
+bool record_is(unsigned    idx,
+               const char *msg,
+               unsigned    suppressed)
+{
+    char expected[128];
+    size_t len;
+    size_t rec_len = strlen(records[idx]);
+
+    if (suppressed) snprintf(expected, sizeof(expected), "%s (%u messages suppressed)\n", msg, suppressed);
+    else snprintf(expected, sizeof(expected), "%s\n", msg);
+    len = strlen(expected);
+    return (rec_len >= len) && (strcmp(records[idx] + rec_len - len, expected) == 0);
+}
+
+int main(void)
+{
+    CHECK(log_init(LL_INFO, true));
+    CHECK(log_register(_LOG_SRC, LL_INFO));
+    CHECK(log_sink_add_callback(save_sink, NULL, LL_INFO) != NULL);
+
+    /* пачка из TEST_BURST записей, остальные подавлены без вычисления аргументов */
+    log_burst(10);
+    CHECK(num_records == TEST_BURST);
+    CHECK(num_evaluated == TEST_BURST);
+    CHECK(record_is(0, "limited 0", 0));
+    CHECK(record_is(1, "limited 1", 0));
+    CHECK(record_is(2, "limited 2", 0));
+
+    /* через интервал разрешена одна запись, она сообщает о подавленных */
+    fake_ns += TEST_INTERVAL_NS;
+    log_burst(3);
+    CHECK(num_records == TEST_BURST + 1);
+    CHECK(num_evaluated == TEST_BURST + 1);
+    CHECK(record_is(3, "limited 0", 7));
+
+    /* после долгой паузы снова доступна целая пачка, первая запись сообщает о подавленных */
+    fake_ns += 10 * 1000000000ull;
+    log_burst(TEST_BURST + 1);
+    CHECK(num_records == 2 * TEST_BURST + 1);
+    CHECK(record_is(4, "limited 0", 2));
+    CHECK(record_is(5, "limited 1", 0));
+    CHECK(record_is(6, "limited 2", 0));
+
+    /* запись ниже уровня вывода не проходит ограничитель и не вычисляет аргументы */
+    num_evaluated = 0;
+    _LOG_DEBUG_RL(TEST_RATE, TEST_BURST, "hidden %u", evaluated(0));
+    CHECK(num_evaluated == 0);
+    CHECK(num_records == 2 * TEST_BURST + 1);
+
+    CHECK(log_destroy());
+    return EXIT_SUCCESS;
+}
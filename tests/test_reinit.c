@@ -0,0 +1,93 @@
+/*
+ * Проверка повторной инициализации: после log_destroy() вызовы логгирования и регистрации
+ * не обращаются к освобождённым источникам и ничего не выводят, кеши точек логгирования
+ * устаревают, log_init() снова инициализирует систему.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define _LOG_SRC "TEST"
+#include "log.h"
+
+/**
+ * Проверяет условие, при невыполнении выводит его и завершает тест с ошибкой
+ */
+#define CHECK(cond)                                                                 \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE);                                                     \
+        }                                                                           \
+    }                                                                               \
+    while (0)
+
+static
+unsigned num_records; ///< количество записей, полученных приёмником.
+
+/**
+ * Приёмник, подсчитывающий записи.
+ *
+ * @param arg   [in] не используется.
+ * @param data  [in] данные
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void count_sink(void        *arg,
+                const char  *data,
+                size_t       len,
+                log_level_t  level)
+{
+    UNUSED_PARAM(arg);
+    UNUSED_PARAM(data);
+    UNUSED_PARAM(len);
+    UNUSED_PARAM(level);
+
+    num_records++;
+}
+
+/**
+ * Логгирует по одной записи через макрос (с кешем точки логгирования) и через дескриптор источника.
+ *
+ * @param handle [in] дескриптор источника (может быть недействительным после log_destroy()) (!= NULL)
+ */
+static
+void log_records(const log_source_t *handle)
+{
+    _LOG_INFO("macro record");
+    _LOG_H_INFO(handle, "handle record");
+}
+
+int main(void)
+{
+    log_source_t *handle;
+    unsigned round;
+
+    for (round = 0; round < 3; round++)
+    {
+        CHECK(log_init(LL_INFO, true));
+        CHECK(log_sink_add_callback(count_sink, NULL, LL_INFO) != NULL);
+        handle = log_register_handle(_LOG_SRC, LL_INFO);
+        CHECK(handle != NULL);
+        num_records = 0;
+        log_records(handle);
+        CHECK(num_records == 2);
+        /* повторная инициализация без log_destroy() не допускается */
+        CHECK(!log_init(LL_INFO, true));
+        CHECK(log_destroy());
+
+        /* после log_destroy() система не инициализирована */
+        num_records = 0;
+        log_records(handle);
+        CHECK(num_records == 0);
+        CHECK(!log_will_be_printed_h(handle, LL_ERROR));
+        CHECK(!log_register(_LOG_SRC, LL_INFO));
+        CHECK(log_register_handle(_LOG_SRC, LL_INFO) == NULL);
+        CHECK(!log_will_be_printed(_LOG_SRC, LL_ERROR));
+        CHECK(log_destroy());
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,291 @@
+/*
+ * Проверка приёмника с ротацией (log_sink_add_rotating_file()):
+ * - по размеру: файл, достигший max_size, переименовывается в "<path>.1", старые файлы сдвигаются,
+ *   хранится не больше max_files старых файлов; в сохранившихся файлах записи идут подряд, без потерь;
+ * - по времени: непустой файл ротируется через interval_sec, пустой не ротируется.
+ *
+ * Использование: test_rotate <префикс путей файлов>
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define _LOG_SRC "TEST"
+#include "log.h"
+
+/**
+ * Размер файла, после которого выполняется ротация по размеру, байт
+ */
+#define TEST_MAX_SIZE 1000
+
+/**
+ * Количество хранимых старых файлов
+ */
+#define TEST_MAX_FILES 3
+
+/**
+ * Количество ротаций по размеру (больше TEST_MAX_FILES - самые старые файлы удаляются)
+ */
+#define TEST_NUM_ROUNDS 5
+
+/**
+ * Количество записей между ротациями (в сумме больше TEST_MAX_SIZE)
+ */
+#define TEST_RECORDS_PER_ROUND 20
+
+/**
+ * Период ротации по времени, с
+ */
+#define TEST_INTERVAL_SEC 1
+
+/**
+ * Максимальное время ожидания ротации фоновым потоком, мс
+ */
+#define TEST_WAIT_MS 5000
+
+/**
+ * Проверяет условие, при невыполнении выводит его и завершает тест с ошибкой
+ */
+#define CHECK(cond)                                                                 \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE);                                                     \
+        }                                                                           \
+    }                                                                               \
+    while (0)
+
+/**
+ * Засыпает на заданное время.
+ *
+ * @param ms [in] время, мс
+ */
+static
+void sleep_ms(unsigned ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(ms / 1000);
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+}
+
+/**
+ * Формирует путь старого файла "<path>.<idx>" (idx == 0 - сам path).
+ *
+ * @param out      [out] буфер (!= NULL)
+ * @param out_size [in]  размер буфера в байтах
+ * @param path     [in]  путь файла (!= NULL)
+ * @param idx      [in]  номер старого файла
+ */
+static
+void rotated_path(char       *out,
+                  size_t      out_size,
+                  const char *path,
+                  unsigned    idx)
+{
+    if (idx) snprintf(out, out_size, "%s.%u", path, idx);
+    else snprintf(out, out_size, "%s", path);
+}
+
+/**
+ * Удаляет файл и все его старые копии.
+ *
+ * @param path [in] путь файла (!= NULL)
+ */
+static
+void remove_files(const char *path)
+{
+    char name[512];
+    unsigned i;
+
+    for (i = 0; i <= TEST_MAX_FILES + 1; i++)
+    {
+        rotated_path(name, sizeof(name), path, i);
+        unlink(name);
+    }
+}
+
+/**
+ * Возвращает номер inode файла.
+ *
+ * @param path [in] путь файла (!= NULL)
+ * @return inode, 0 - файла нет.
+ */
+static
+ino_t file_inode(const char *path)
+{
+    struct stat st;
+
+    return (stat(path, &st) == 0) ? st.st_ino : 0;
+}
+
+/**
+ * Дожидается, пока фоновый поток приёмника создаст новый файл вместо прежнего.
+ *
+ * @param path [in] путь файла (!= NULL)
+ * @param ino  [in] inode прежнего файла
+ * @return true - файл создан заново, false - не дождались.
+ */
+static
+bool wait_rotation(const char *path,
+                   ino_t       ino)
+{
+    unsigned waited;
+
+    for (waited = 0; waited < TEST_WAIT_MS; waited += 10)
+    {
+        ino_t cur = file_inode(path);
+
+        if (cur != 0 && cur != ino) return true;
+        sleep_ms(10);
+    }
+    return false;
+}
+
+/**
+ * Проверяет записи файла: номера записей "rec N" идут подряд начиная с *next
+ * (если *next < 0 - с любого номера) и продолжает отсчёт.
+ *
+ * @param path [in]     путь файла (!= NULL)
+ * @param next [in/out] номер следующей ожидаемой записи
+ * @return размер файла в байтах.
+ */
+static
+size_t check_records(const char *path,
+                     long       *next)
+{
+    FILE *f = fopen(path, "r");
+    char line[512];
+    size_t size = 0;
+
+    CHECK(f != NULL);
+    while (fgets(line, sizeof(line), f))
+    {
+        const char *rec = strstr(line, "rec ");
+        long num;
+
+        size += strlen(line);
+        CHECK(rec != NULL);
+        num = strtol(rec + 4, NULL, 10);
+        if (*next >= 0) CHECK(num == *next);
+        *next = num + 1;
+    }
+    fclose(f);
+    return size;
+}
+
+/**
+ * Ротация по размеру.
+ *
+ * @param path [in] путь файла (!= NULL)
+ */
+static
+void test_size_rotation(const char *path)
+{
+    log_rotate_config_t config;
+    char name[512];
+    unsigned round;
+    unsigned i;
+    long next = -1;
+    long first;
+
+    remove_files(path);
+    ZEROIZE_STRUCT(config);
+    config.max_size = TEST_MAX_SIZE;
+    config.max_files = TEST_MAX_FILES;
+    CHECK(log_init(LL_INFO, true));
+    CHECK(log_register(_LOG_SRC, LL_INFO));
+    CHECK(log_sink_add_rotating_file(path, LL_INFO, &config) != NULL);
+
+    for (round = 0; round < TEST_NUM_ROUNDS; round++)
+    {
+        ino_t ino = file_inode(path);
+
+        for (i = 0; i < TEST_RECORDS_PER_ROUND; i++)
+        {
+            _LOG_INFO("rec %u padding to make the record longer", round * TEST_RECORDS_PER_ROUND + i);
+        }
+        CHECK(wait_rotation(path, ino));
+    }
+    CHECK(log_destroy());
+
+    /* хранятся только max_files старых файлов */
+    rotated_path(name, sizeof(name), path, TEST_MAX_FILES + 1);
+    CHECK(file_inode(name) == 0);
+    /* от самого старого файла к текущему записи идут подряд, самые старые удалены */
+    for (i = TEST_MAX_FILES; i > 0; i--)
+    {
+        rotated_path(name, sizeof(name), path, i);
+        first = next;
+        CHECK(check_records(name, &next) >= TEST_MAX_SIZE);
+        if (i == TEST_MAX_FILES) CHECK(next > TEST_RECORDS_PER_ROUND);
+        CHECK(next > first);
+    }
+    (void)check_records(path, &next);
+    CHECK(next == TEST_NUM_ROUNDS * TEST_RECORDS_PER_ROUND);
+    remove_files(path);
+}
+
+/**
+ * Ротация по времени.
+ *
+ * @param path [in] путь файла (!= NULL)
+ */
+static
+void test_time_rotation(const char *path)
+{
+    log_rotate_config_t config;
+    char name[512];
+    long next = 0;
+    ino_t ino;
+
+    remove_files(path);
+    ZEROIZE_STRUCT(config);
+    config.interval_sec = TEST_INTERVAL_SEC;
+    config.max_files = TEST_MAX_FILES;
+    CHECK(log_init(LL_INFO, true));
+    CHECK(log_register(_LOG_SRC, LL_INFO));
+    CHECK(log_sink_add_rotating_file(path, LL_INFO, &config) != NULL);
+
+    ino = file_inode(path);
+    _LOG_INFO("rec 0");
+    CHECK(wait_rotation(path, ino));
+    /* пустой файл по истечении периода не ротируется */
+    ino = file_inode(path);
+    sleep_ms(TEST_INTERVAL_SEC * 2000 + 500);
+    CHECK(file_inode(path) == ino);
+    _LOG_INFO("rec 1");
+    CHECK(log_destroy());
+
+    rotated_path(name, sizeof(name), path, 1);
+    (void)check_records(name, &next);
+    CHECK(next == 1);
+    rotated_path(name, sizeof(name), path, 2);
+    CHECK(file_inode(name) == 0);
+    (void)check_records(path, &next);
+    CHECK(next == 2);
+    remove_files(path);
+}
+
+int main(int argc, char *argv[])
+{
+    char path[256];
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s <path prefix>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    snprintf(path, sizeof(path), "%s_size.log", argv[1]);
+    test_size_rotation(path);
+    snprintf(path, sizeof(path), "%s_time.log", argv[1]);
+    test_time_rotation(path);
+    return EXIT_SUCCESS;
+}
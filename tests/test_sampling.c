@@ -0,0 +1,142 @@
+/*
+ * Проверка сэмплирования (log_register_sampled()): из записей уровней ниже sample_level выводится
+ * доля sample_ratio (в пределах допуска), аргументы отброшенных записей не вычисляются,
+ * записи от sample_level и выше выводятся все. Генератор сэмплирования запускается с фиксированного
+ * начального значения, поэтому результат воспроизводим.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define _LOG_SRC "TEST"
+#include "log.h"
+
+/**
+ * Количество записей на проверку доли
+ */
+#define TEST_NUM_RECORDS 100000
+
+/**
+ * Допустимое отклонение доли выведенных записей от заданной
+ */
+#define TEST_TOLERANCE 0.01
+
+/**
+ * Начальное значение генератора сэмплирования
+ */
+#define TEST_SEED 0x2545F4914F6CDD1Dull
+
+/**
+ * Проверяет условие, при невыполнении выводит его и завершает тест с ошибкой
+ */
+#define CHECK(cond)                                                                 \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE);                                                     \
+        }                                                                           \
+    }                                                                               \
+    while (0)
+
+static
+unsigned num_records; ///< количество записей, полученных приёмником.
+
+static
+unsigned num_evaluated; ///< количество вычислений аргумента записи.
+
+/**
+ * Приёмник, подсчитывающий записи.
+ *
+ * @param arg   [in] не используется.
+ * @param data  [in] данные
+ * @param len   [in] размер данных в байтах
+ * @param level [in] уровень записей
+ */
+static
+void count_sink(void        *arg,
+                const char  *data,
+                size_t       len,
+                log_level_t  level)
+{
+    UNUSED_PARAM(arg);
+    UNUSED_PARAM(data);
+    UNUSED_PARAM(len);
+    UNUSED_PARAM(level);
+
+    num_records++;
+}
+
+/**
+ * Аргумент записи, подсчитывающий свои вычисления.
+ *
+ * @param value [in] значение
+ * @return value
+ */
+static
+unsigned evaluated(unsigned value)
+{
+    num_evaluated++;
+    return value;
+}
+
+/**
+ * Логгирует записи уровня DEBUG (сэмплируемого) и INFO (не сэмплируемого) и возвращает
+ * долю выведенных записей DEBUG.
+ *
+ * @param ratio [in] доля сохраняемых записей
+ * @return доля выведенных записей DEBUG.
+ */
+static
+double sampled_share(double ratio)
+{
+    unsigned i;
+    unsigned debug_records;
+
+    CHECK(log_register_sampled(_LOG_SRC, LL_DEBUG, LL_INFO, ratio));
+    log_sample_rng = TEST_SEED;
+    num_records = 0;
+    num_evaluated = 0;
+    for (i = 0; i < TEST_NUM_RECORDS; i++)
+    {
+        _LOG_DEBUG("sampled %u", evaluated(i));
+    }
+    debug_records = num_records;
+    /* отброшенные записи не вычисляют аргументы */
+    CHECK(num_evaluated == debug_records);
+
+    /* уровни от sample_level не сэмплируются */
+    num_records = 0;
+    for (i = 0; i < TEST_NUM_RECORDS / 100; i++)
+    {
+        _LOG_INFO("kept %u", i);
+    }
+    CHECK(num_records == TEST_NUM_RECORDS / 100);
+    return (double)debug_records / TEST_NUM_RECORDS;
+}
+
+int main(void)
+{
+    static const double ratios[] = { 0.01, 0.1, 0.5, 0.9 };
+    double share;
+    size_t i;
+
+    CHECK(log_init(LL_DEBUG, true));
+    CHECK(log_sink_add_callback(count_sink, NULL, LL_DEBUG) != NULL);
+
+    for (i = 0; i < sizeof(ratios) / sizeof(ratios[0]); i++)
+    {
+        share = sampled_share(ratios[i]);
+        CHECK(share > ratios[i] - TEST_TOLERANCE && share < ratios[i] + TEST_TOLERANCE);
+    }
+    /* с тем же начальным значением генератора результат воспроизводится */
+    CHECK(sampled_share(0.1) == sampled_share(0.1));
+    /* крайние доли: ничего и всё */
+    CHECK(sampled_share(0.0) == 0.0);
+    CHECK(sampled_share(1.0) == 1.0);
+
+    CHECK(log_destroy());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,212 @@
+/*
+ * Проверка cos_log_srcgen на манифесте srcgen_test.manifest:
+ * - идентификаторы всех имён манифеста (LOG_SRC_MANIFEST_ID() сгенерированного при сборке заголовка)
+ *   различны, лежат в таблице и указывают на своё имя, для имён вне манифеста - -1;
+ * - повторный запуск генератора, в том числе на манифесте с обратным порядком строк,
+ *   даёт побайтно тот же заголовок.
+ *
+ * Использование: test_srcgen <cos_log_srcgen> <манифест> <заголовок> <рабочий префикс путей>
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "srcgen_test_manifest.h"
+
+/**
+ * Максимальный размер сгенерированного заголовка
+ */
+#define TEST_MAX_HEADER_SIZE 65536
+
+/**
+ * Максимальное количество строк манифеста
+ */
+#define TEST_MAX_LINES 256
+
+/**
+ * Проверяет условие, при невыполнении выводит его и завершает тест с ошибкой
+ */
+#define CHECK(cond)                                                                 \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE);                                                     \
+        }                                                                           \
+    }                                                                               \
+    while (0)
+
+/**
+ * Имя источника и его идентификатор, вычисленный при компиляции
+ */
+#define TEST_ENTRY(s) { s, LOG_SRC_MANIFEST_ID(s) }
+
+/**
+ * Имя источника и его идентификатор
+ */
+typedef struct tag_test_entry
+{
+    const char *name; /*!< имя */
+    int         id;   /*!< идентификатор (-1 - нет в манифесте) */
+}
+test_entry_t;
+
+/**
+ * Читает файл целиком.
+ *
+ * @param path [in]  путь файла (!= NULL)
+ * @param buf  [out] буфер размером TEST_MAX_HEADER_SIZE (!= NULL)
+ * @return размер файла в байтах.
+ */
+static
+size_t read_file(const char *path,
+                 char       *buf)
+{
+    FILE *f = fopen(path, "rb");
+    size_t len;
+
+    CHECK(f != NULL);
+    len = fread(buf, 1, TEST_MAX_HEADER_SIZE, f);
+    CHECK(len < TEST_MAX_HEADER_SIZE);
+    fclose(f);
+    return len;
+}
+
+/**
+ * Запускает генератор и сравнивает заголовок с ожидаемым.
+ *
+ * @param srcgen   [in] путь генератора (!= NULL)
+ * @param manifest [in] манифест (!= NULL)
+ * @param out      [in] путь заголовка (!= NULL)
+ * @param expected [in] ожидаемый заголовок (!= NULL)
+ * @param len      [in] размер ожидаемого заголовка в байтах
+ */
+static
+void check_generated(const char *srcgen,
+                     const char *manifest,
+                     const char *out,
+                     const char *expected,
+                     size_t      len)
+{
+    static char actual[TEST_MAX_HEADER_SIZE];
+    char cmd[1024];
+
+    snprintf(cmd, sizeof(cmd), "'%s' -o '%s' -m '%s'", srcgen, out, manifest);
+    CHECK(system(cmd) == 0);
+    CHECK(read_file(out, actual) == len);
+    CHECK(memcmp(actual, expected, len) == 0);
+    remove(out);
+}
+
+/**
+ * Записывает строки манифеста в обратном порядке.
+ *
+ * @param manifest [in] манифест (!= NULL)
+ * @param out      [in] путь нового манифеста (!= NULL)
+ */
+static
+void reverse_manifest(const char *manifest,
+                      const char *out)
+{
+    static char lines[TEST_MAX_LINES][256];
+    size_t num_lines = 0;
+    FILE *in = fopen(manifest, "r");
+    FILE *f;
+
+    CHECK(in != NULL);
+    while (num_lines < TEST_MAX_LINES && fgets(lines[num_lines], sizeof(lines[0]), in))
+    {
+        num_lines++;
+    }
+    CHECK(feof(in));
+    fclose(in);
+    f = fopen(out, "w");
+    CHECK(f != NULL);
+    while (num_lines > 0)
+    {
+        const char *line = lines[--num_lines];
+
+        fprintf(f, "%s%s", line, (line[strlen(line) - 1] == '\n') ? "" : "\n");
+    }
+    CHECK(fclose(f) == 0);
+}
+
+/**
+ * Проверяет идентификаторы, вычисленные LOG_SRC_MANIFEST_ID() (идентификаторы вычисляются
+ * выражениями со сравнением строк, поэтому таблицы - автоматические).
+ */
+static
+void check_ids(void)
+{
+    /* имена srcgen_test.manifest без повторов (количество сверяется с LOG_SRC_MANIFEST_COUNT) */
+    const test_entry_t manifest_entries[] =
+    {
+        TEST_ENTRY("A"), TEST_ENTRY("B"), TEST_ENTRY("AB"), TEST_ENTRY("BA"), TEST_ENTRY("ABC"),
+        TEST_ENTRY("NET"), TEST_ENTRY("NET_RX"), TEST_ENTRY("NET_TX"), TEST_ENTRY("NET_RX0"), TEST_ENTRY("NET_RX1"),
+        TEST_ENTRY("NET_TX0"), TEST_ENTRY("NET_TX1"), TEST_ENTRY("NETWORK"),
+        TEST_ENTRY("DISK"), TEST_ENTRY("DISK0"), TEST_ENTRY("DISK1"), TEST_ENTRY("DISK_IO"),
+        TEST_ENTRY("STORAGE"), TEST_ENTRY("STORAGE_META"), TEST_ENTRY("STORAGE_DATA"),
+        TEST_ENTRY("SCHEDULER"), TEST_ENTRY("SCHEDULER_RT"), TEST_ENTRY("TIMER"), TEST_ENTRY("TIMERS"),
+        TEST_ENTRY("MEMORY"), TEST_ENTRY("MEMORY_POOL"), TEST_ENTRY("IPC"), TEST_ENTRY("RPC"),
+        TEST_ENTRY("RPC_CLIENT"), TEST_ENTRY("RPC_SERVER"), TEST_ENTRY("HTTP"), TEST_ENTRY("HTTPS"),
+        TEST_ENTRY("CONFIG"), TEST_ENTRY("CONFIG_WATCH"),
+        TEST_ENTRY("WORKER_00"), TEST_ENTRY("WORKER_01"), TEST_ENTRY("WORKER_10"), TEST_ENTRY("WORKER_11"),
+        TEST_ENTRY("VERY_LONG_SOURCE_NAME_THAT_DIFFERS_ONLY_AT_THE_END_1"),
+        TEST_ENTRY("VERY_LONG_SOURCE_NAME_THAT_DIFFERS_ONLY_AT_THE_END_2"),
+    };
+
+    /* имена, которых нет в манифесте (в том числе отличающиеся от имён манифеста одним символом) */
+    const test_entry_t foreign_entries[] =
+    {
+        TEST_ENTRY(""), TEST_ENTRY("C"), TEST_ENTRY("NET_"), TEST_ENTRY("net_rx"), TEST_ENTRY("NET_RX2"),
+        TEST_ENTRY("DISK2"), TEST_ENTRY("TIMERSS"), TEST_ENTRY("WORKER_02"), TEST_ENTRY("UNKNOWN"),
+        TEST_ENTRY("VERY_LONG_SOURCE_NAME_THAT_DIFFERS_ONLY_AT_THE_END_3"),
+    };
+    bool used[LOG_SRC_MANIFEST_SIZE];
+    size_t i;
+
+    /* все имена манифеста получили различные идентификаторы своих слотов */
+    CHECK(sizeof(manifest_entries) / sizeof(manifest_entries[0]) == LOG_SRC_MANIFEST_COUNT);
+    memset(used, 0, sizeof(used));
+    for (i = 0; i < sizeof(manifest_entries) / sizeof(manifest_entries[0]); i++)
+    {
+        int id = manifest_entries[i].id;
+
+        CHECK(id >= 0 && (unsigned)id < LOG_SRC_MANIFEST_SIZE);
+        CHECK(!used[id]);
+        used[id] = true;
+        CHECK(strcmp(log_src_manifest_names[id], manifest_entries[i].name) == 0);
+    }
+    for (i = 0; i < sizeof(foreign_entries) / sizeof(foreign_entries[0]); i++)
+    {
+        CHECK(foreign_entries[i].id == -1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static char header[TEST_MAX_HEADER_SIZE];
+    char reversed[512];
+    char out[512];
+    size_t header_len;
+
+    if (argc != 5)
+    {
+        fprintf(stderr, "usage: %s <cos_log_srcgen> <manifest> <header> <work path prefix>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    check_ids();
+
+    /* заголовок не зависит от запуска и порядка имён в манифесте */
+    header_len = read_file(argv[3], header);
+    snprintf(out, sizeof(out), "%s.h", argv[4]);
+    check_generated(argv[1], argv[2], out, header, header_len);
+    snprintf(reversed, sizeof(reversed), "%s_reversed.manifest", argv[4]);
+    reverse_manifest(argv[2], reversed);
+    check_generated(argv[1], reversed, out, header, header_len);
+    remove(reversed);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,448 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _LOG_SRC "DECODE"
+#include "log_deferred.h"
+
+/**
+ * Размер буфера для текста одной записи
+ */
+#define DECODE_RECORD_MAX_SIZE 8192
+
+/**
+ * Размер буфера для распакованной записи (заголовок, источник, аргументы)
+ */
+#define DECODE_UNPACKED_MAX_SIZE (sizeof(log_deferred_hdr_t) + LOG_DEFERRED_SRC_MAX_SIZE + UINT16_MAX)
+
+/**
+ * Размер блока чтения входного файла
+ */
+#define DECODE_READ_CHUNK_SIZE 65536
+
+/**
+ * Словарь точек логгирования сессии
+ */
+typedef struct tag_decode_dict
+{
+    log_deferred_site_t *sites;     /*!< точки по идентификатору - 1 (fmt == NULL - точка отсутствует) */
+    uint32_t             num_sites; /*!< размер массива точек */
+    log_bin_str_t        sources[LOG_BIN_MAX_SOURCES]; /*!< источники по номеру - 1 (ptr == NULL - источник отсутствует) */
+}
+decode_dict_t;
+
+/**
+ * Читает весь входной поток в память.
+ *
+ * @param in   [in]  входной поток (!= NULL)
+ * @param data [out] данные, освобождаются free() (!= NULL)
+ * @param size [out] размер данных в байтах (!= NULL)
+ * @return true - OK, false - Fail
+ */
+static
+bool read_input(FILE    *in,
+                char   **data,
+                size_t  *size) __attribute__((nonnull(1, 2, 3))) __attribute__((warn_unused_result));
+
+/**
+ * Копирует строку кадра в NULL-терминированную строку в куче.
+ *
+ * @param str [in] строка кадра (!= NULL)
+ * @return строка или NULL при нехватке памяти.
+ */
+static
+char *dup_bin_str(const log_bin_str_t *str) __attribute__((nonnull(1))) __attribute__((warn_unused_result));
+
+/**
+ * Добавляет в словарь точку логгирования из кадра точки.
+ *
+ * @param dict    [in/out] словарь (!= NULL)
+ * @param payload [in]     данные кадра (!= NULL)
+ * @param len     [in]     длина данных кадра в байтах
+ * @return true - OK, false - кадр повреждён или не хватает памяти.
+ */
+static
+bool dict_add_site(decode_dict_t *dict,
+                   const char    *payload,
+                   size_t         len) __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+
+/**
+ * Добавляет в словарь источник из кадра источника.
+ *
+ * @param dict    [in/out] словарь (!= NULL)
+ * @param payload [in]     данные кадра (остаются в памяти до очистки словаря) (!= NULL)
+ * @param len     [in]     длина данных кадра в байтах
+ * @return true - OK, false - кадр повреждён.
+ */
+static
+bool dict_add_source(decode_dict_t *dict,
+                     const char    *payload,
+                     size_t         len) __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+
+/**
+ * Очищает словарь.
+ *
+ * @param dict [in/out] словарь (!= NULL)
+ */
+static
+void dict_clear(decode_dict_t *dict) __attribute__((nonnull(1)));
+
+/**
+ * Выводит текст сессии двоичного файла журнала.
+ * Сначала собирается словарь всей сессии, затем выводятся записи.
+ *
+ * @param data [in] кадры сессии (после кадра сессии) (!= NULL)
+ * @param size [in] размер кадров в байтах
+ * @param out  [in] выходной поток (!= NULL)
+ * @return true - OK, false - данные повреждены.
+ */
+static
+bool decode_session(const char *data,
+                    size_t      size,
+                    FILE       *out) __attribute__((nonnull(1, 3))) __attribute__((warn_unused_result));
+
+/**
+ * Читает весь входной поток в память.
+ *
+ * @param in   [in]  входной поток (!= NULL)
+ * @param data [out] данные, освобождаются free() (!= NULL)
+ * @param size [out] размер данных в байтах (!= NULL)
+ * @return true - OK, false - Fail
+ */
+static
+bool read_input(FILE    *in,
+                char   **data,
+                size_t  *size)
+{
+    char *buf = NULL;
+    size_t buf_size = 0;
+    size_t len = 0;
+
+    assert(in != NULL);
+    assert(data != NULL);
+    assert(size != NULL);
+
+    for (;;)
+    {
+        size_t res;
+
+        if (buf_size - len < DECODE_READ_CHUNK_SIZE)
+        {
+            char *new_buf = realloc(buf, buf_size * 2 + DECODE_READ_CHUNK_SIZE);
+
+            if (new_buf == NULL)
+            {
+                free(buf);
+                return false;
+            }
+            buf = new_buf;
+            buf_size = buf_size * 2 + DECODE_READ_CHUNK_SIZE;
+        }
+        res = fread(buf + len, 1, buf_size - len, in);
+        len += res;
+        if (res == 0) break;
+    }
+    if (ferror(in))
+    {
+        free(buf);
+        return false;
+    }
+    *data = buf;
+    *size = len;
+    return true;
+}
+
+/**
+ * Копирует строку кадра в NULL-терминированную строку в куче.
+ *
+ * @param str [in] строка кадра (!= NULL)
+ * @return строка или NULL при нехватке памяти.
+ */
+static
+char *dup_bin_str(const log_bin_str_t *str)
+{
+    char *res = malloc((size_t)str->len + 1);
+
+    assert(str != NULL);
+
+    if (res == NULL) return NULL;
+    memcpy(res, str->ptr, str->len);
+    res[str->len] = '\0';
+    return res;
+}
+
+/**
+ * Добавляет в словарь точку логгирования из кадра точки.
+ *
+ * @param dict    [in/out] словарь (!= NULL)
+ * @param payload [in]     данные кадра (!= NULL)
+ * @param len     [in]     длина данных кадра в байтах
+ * @return true - OK, false - кадр повреждён или не хватает памяти.
+ */
+static
+bool dict_add_site(decode_dict_t *dict,
+                   const char    *payload,
+                   size_t         len)
+{
+    log_bin_str_t strs[4];
+    log_deferred_site_t *site;
+    uint32_t site_id;
+    char *file;
+    char *line;
+    char *function;
+    char *fmt;
+
+    assert(dict != NULL);
+    assert(payload != NULL);
+
+    if (!log_bin_get_site(payload, len, &site_id, strs) || site_id == 0 || site_id == LOG_DEFERRED_UNSUPPORTED)
+    {
+        return false;
+    }
+    if (site_id > dict->num_sites)
+    {
+        uint32_t num_sites = MAX(site_id, dict->num_sites * 2);
+        log_deferred_site_t *sites = realloc(dict->sites, num_sites * sizeof(*sites));
+
+        if (sites == NULL) return false;
+        memset(sites + dict->num_sites, 0, (num_sites - dict->num_sites) * sizeof(*sites));
+        dict->sites = sites;
+        dict->num_sites = num_sites;
+    }
+    site = &dict->sites[site_id - 1];
+    /* повторное описание точки в сессии не ожидается, но безопасно */
+    if (site->fmt) return true;
+    file = dup_bin_str(&strs[0]);
+    line = dup_bin_str(&strs[1]);
+    function = dup_bin_str(&strs[2]);
+    fmt = dup_bin_str(&strs[3]);
+    /* типы аргументов нужны для распаковки записей точки */
+    if (file && line && function && fmt && log_deferred_site_init(site, file, line, function, fmt)) return true;
+    free(file);
+    free(line);
+    free(function);
+    free(fmt);
+    memset(site, 0, sizeof(*site));
+    return false;
+}
+
+/**
+ * Добавляет в словарь источник из кадра источника.
+ *
+ * @param dict    [in/out] словарь (!= NULL)
+ * @param payload [in]     данные кадра (остаются в памяти до очистки словаря) (!= NULL)
+ * @param len     [in]     длина данных кадра в байтах
+ * @return true - OK, false - кадр повреждён.
+ */
+static
+bool dict_add_source(decode_dict_t *dict,
+                     const char    *payload,
+                     size_t         len)
+{
+    log_bin_str_t name;
+    uint32_t source_id;
+
+    assert(dict != NULL);
+    assert(payload != NULL);
+
+    if (!log_bin_get_source(payload, len, &source_id, &name)) return false;
+    dict->sources[source_id - 1] = name;
+    return true;
+}
+
+/**
+ * Очищает словарь.
+ *
+ * @param dict [in/out] словарь (!= NULL)
+ */
+static
+void dict_clear(decode_dict_t *dict)
+{
+    uint32_t i;
+
+    assert(dict != NULL);
+
+    for (i = 0; i < dict->num_sites; i++)
+    {
+        free((char *)dict->sites[i].file);
+        free((char *)dict->sites[i].line);
+        free((char *)dict->sites[i].function);
+        free((char *)dict->sites[i].fmt);
+    }
+    free(dict->sites);
+    dict->sites = NULL;
+    dict->num_sites = 0;
+    memset(dict->sources, 0, sizeof(dict->sources));
+}
+
+/**
+ * Выводит текст сессии двоичного файла журнала.
+ * Сначала собирается словарь всей сессии, затем выводятся записи.
+ *
+ * @param data [in] кадры сессии (после кадра сессии) (!= NULL)
+ * @param size [in] размер кадров в байтах
+ * @param out  [in] выходной поток (!= NULL)
+ * @return true - OK, false - данные повреждены.
+ */
+static
+bool decode_session(const char *data,
+                    size_t      size,
+                    FILE       *out)
+{
+    static char text[DECODE_RECORD_MAX_SIZE];
+    static char rec[DECODE_UNPACKED_MAX_SIZE];
+    static decode_dict_t dict;
+    uint64_t last_ns = 0;
+    size_t pos;
+    size_t frame_len;
+    bool res = true;
+    char type;
+    const char *payload;
+    size_t len;
+
+    assert(data != NULL);
+    assert(out != NULL);
+
+    /* словарь */
+    for (pos = 0; pos < size; pos += frame_len)
+    {
+        frame_len = log_bin_get_frame(data + pos, size - pos, &type, &payload, &len);
+        if (frame_len == 0) break;
+        if (type == LOG_BIN_FRAME_SITE && !dict_add_site(&dict, payload, len))
+        {
+            fprintf(stderr, "cos_log_decode: bad callsite frame\n");
+            res = false;
+        }
+        if (type == LOG_BIN_FRAME_SOURCE && !dict_add_source(&dict, payload, len))
+        {
+            fprintf(stderr, "cos_log_decode: bad source frame\n");
+            res = false;
+        }
+    }
+    /* записи */
+    for (pos = 0; pos < size; pos += frame_len)
+    {
+        frame_len = log_bin_get_frame(data + pos, size - pos, &type, &payload, &len);
+        if (frame_len == 0)
+        {
+            /* файл мог быть обрезан при аварийном завершении процесса */
+            fprintf(stderr, "cos_log_decode: truncated frame (%zu bytes)\n", size - pos);
+            res = false;
+            break;
+        }
+        if (type == LOG_BIN_FRAME_TEXT)
+        {
+            fwrite(payload, 1, len, out);
+        }
+        else if (type == LOG_BIN_FRAME_RECORD)
+        {
+            const log_deferred_site_t *site = NULL;
+            uint32_t site_id = 0;
+            size_t rec_len;
+            size_t text_len = 0;
+
+            if (log_bin_get_record_site(payload, len, &site_id) && site_id <= dict.num_sites &&
+                dict.sites[site_id - 1].fmt != NULL)
+            {
+                site = &dict.sites[site_id - 1];
+            }
+            /* время записей хранится приращениями: запись распаковывается, даже если её точка неизвестна */
+            rec_len = log_bin_unpack_record(payload, len, site, dict.sources, &last_ns, rec, sizeof(rec));
+            if (site == NULL)
+            {
+                fprintf(stderr, "cos_log_decode: unknown callsite %u\n", site_id);
+                res = false;
+                continue;
+            }
+            if (rec_len) text_len = log_deferred_render(rec, rec_len, site, text, sizeof(text));
+            if (text_len == 0)
+            {
+                fprintf(stderr, "cos_log_decode: bad record frame\n");
+                res = false;
+                continue;
+            }
+            fwrite(text, 1, text_len, out);
+        }
+        else if (type != LOG_BIN_FRAME_SITE && type != LOG_BIN_FRAME_SOURCE)
+        {
+            fprintf(stderr, "cos_log_decode: unknown frame type 0x%02x\n", (unsigned char)type);
+            res = false;
+        }
+    }
+    dict_clear(&dict);
+    return res;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *in = stdin;
+    char *data = NULL;
+    size_t size = 0;
+    size_t pos = 0;
+    bool res = true;
+
+    if (argc > 2 || (argc == 2 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))))
+    {
+        fprintf(stderr, "usage: %s [binary_log_file]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (argc == 2 && strcmp(argv[1], "-") != 0)
+    {
+        in = fopen(argv[1], "rb");
+        if (in == NULL)
+        {
+            fprintf(stderr, "cos_log_decode: %s: %s\n", argv[1], strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+    if (!read_input(in, &data, &size))
+    {
+        fprintf(stderr, "cos_log_decode: read error\n");
+        if (in != stdin) fclose(in);
+        return EXIT_FAILURE;
+    }
+    if (in != stdin) fclose(in);
+    /* файл - последовательность сессий, каждая начинается кадром сессии */
+    while (pos < size)
+    {
+        char type;
+        const char *payload;
+        size_t len;
+        size_t session_end;
+        uint16_t version;
+        uint16_t layout;
+        size_t frame_len = log_bin_get_frame(data + pos, size - pos, &type, &payload, &len);
+
+        if (frame_len == 0 || type != LOG_BIN_FRAME_SESSION || !log_bin_get_session(payload, len, &version, &layout))
+        {
+            fprintf(stderr, "cos_log_decode: not a cos_log binary file\n");
+            res = false;
+            break;
+        }
+        if (version != LOG_BIN_VERSION)
+        {
+            fprintf(stderr, "cos_log_decode: unsupported format version %u\n", version);
+            res = false;
+            break;
+        }
+        if (layout != log_deferred_layout())
+        {
+            fprintf(stderr, "cos_log_decode: warning: file was written with other DO_LOG_CURRENT_TIME/DO_LOG_FUNCTION_NAME options\n");
+        }
+        pos += frame_len;
+        /* найти конец сессии */
+        for (session_end = pos; session_end < size; session_end += frame_len)
+        {
+            frame_len = log_bin_get_frame(data + session_end, size - session_end, &type, &payload, &len);
+            if (frame_len == 0 || type == LOG_BIN_FRAME_SESSION) break;
+        }
+        if (frame_len == 0) session_end = size;
+        if (!decode_session(data + pos, session_end - pos, stdout)) res = false;
+        pos = session_end;
+    }
+    free(data);
+    fflush(stdout);
+    return res ? EXIT_SUCCESS : EXIT_FAILURE;
+}
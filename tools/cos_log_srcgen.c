@@ -0,0 +1,869 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Максимальная длина имени источника (совпадает с LOG_SRC_STORED_MAX_SIZE библиотеки)
+ */
+#define SRCGEN_NAME_MAX_SIZE 128
+
+/**
+ * Максимальное количество позиций символов в ключе
+ */
+#define SRCGEN_MAX_KEY_POSITIONS 16
+
+/**
+ * Максимальный log2 размера таблицы (смещения корзин хранятся в uint16_t)
+ */
+#define SRCGEN_MAX_TABLE_BITS 16
+
+/**
+ * Количество множителей, перебираемых для одного размера таблицы
+ */
+#define SRCGEN_SEED_ATTEMPTS 64
+
+/**
+ * Множитель ключа, множитель номера корзины и начальный множитель слота
+ * (первые два должны совпадать с выражениями генерируемого заголовка)
+ */
+#define SRCGEN_KEY_PRIME   16777619u
+#define SRCGEN_BUCKET_MULT 2654435769u
+#define SRCGEN_SEED_BASE   2246822519u
+
+/**
+ * Список имён источников
+ */
+typedef struct tag_srcgen_names
+{
+    char   **names; /*!< имена */
+    size_t   count; /*!< количество имён */
+    size_t   cap;   /*!< ёмкость массива */
+}
+srcgen_names_t;
+
+/**
+ * Совершенный хэш имён: slot = (h1(key) + disp[h0(key)]) & (2^table_bits - 1),
+ * h1(key) = (key * seed) >> (32 - table_bits), h0(key) = (key * SRCGEN_BUCKET_MULT) >> (32 - bucket_bits)
+ */
+typedef struct tag_srcgen_hash
+{
+    int       positions[SRCGEN_MAX_KEY_POSITIONS]; /*!< позиции символов ключа (>= 0 - от начала, < 0 - от конца) */
+    size_t    num_positions;                       /*!< количество позиций */
+    uint32_t  table_bits;                          /*!< log2 размера таблицы */
+    uint32_t  bucket_bits;                         /*!< log2 количества корзин */
+    uint32_t  seed;                                /*!< множитель h1 */
+    uint16_t *disp;                                /*!< смещения корзин */
+    size_t   *slots;                               /*!< индекс имени по слоту (SIZE_MAX - слот свободен) */
+}
+srcgen_hash_t;
+
+/**
+ * Добавляет имя в список (без проверки повторов).
+ *
+ * @param list [in/out] список (!= NULL)
+ * @param name [in]     имя (!= NULL)
+ * @param len  [in]     длина имени
+ * @return true - OK, false - нехватка памяти.
+ */
+static
+bool add_name(srcgen_names_t *list,
+              const char     *name,
+              size_t          len) __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+
+/**
+ * Проверяет имя источника: непустое, не длиннее SRCGEN_NAME_MAX_SIZE,
+ * только печатные символы ASCII кроме '"' и '\'.
+ *
+ * @param name [in] имя (!= NULL)
+ * @param len  [in] длина имени
+ * @return true - допустимо, false - нет.
+ */
+static
+bool is_valid_name(const char *name,
+                   size_t      len) __attribute__((nonnull(1)));
+
+/**
+ * Читает манифест: одно имя на строку, пустые строки и строки с '#' в начале пропускаются.
+ *
+ * @param path [in]     файл манифеста (!= NULL)
+ * @param list [in/out] список имён (!= NULL)
+ * @return true - OK, false - Fail (сообщение уже выведено).
+ */
+static
+bool read_manifest(const char     *path,
+                   srcgen_names_t *list) __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+
+/**
+ * Собирает имена из строк вида #define _LOG_SRC "имя" файла исходного кода.
+ *
+ * @param path [in]     файл (!= NULL)
+ * @param list [in/out] список имён (!= NULL)
+ * @return true - OK, false - Fail (сообщение уже выведено).
+ */
+static
+bool scan_file(const char     *path,
+               srcgen_names_t *list) __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+
+/**
+ * Сканирует файлы, перечисленные в списке (по одному пути на строку).
+ *
+ * @param path [in]     файл со списком (!= NULL)
+ * @param list [in/out] список имён (!= NULL)
+ * @return true - OK, false - Fail (сообщение уже выведено).
+ */
+static
+bool scan_list(const char     *path,
+               srcgen_names_t *list) __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+
+/**
+ * Функция сравнения имён для qsort().
+ */
+static
+int compare_names(const void *a,
+                  const void *b);
+
+/**
+ * Сортирует список и удаляет повторы (вывод не зависит от порядка входных файлов).
+ *
+ * @param list [in/out] список имён (!= NULL)
+ */
+static
+void sort_names(srcgen_names_t *list) __attribute__((nonnull(1)));
+
+/**
+ * Возвращает символ имени в позиции ключа (так же, как выражение генерируемого заголовка:
+ * индекс берётся по модулю размера литерала, включая завершающий 0).
+ *
+ * @param name     [in] имя (!= NULL)
+ * @param len      [in] длина имени
+ * @param position [in] позиция (>= 0 - от начала, < 0 - от конца)
+ * @return символ.
+ */
+static
+uint32_t key_char(const char *name,
+                  size_t      len,
+                  int         position) __attribute__((nonnull(1)));
+
+/**
+ * Функция сравнения ключей для qsort().
+ */
+static
+int compare_keys(const void *a,
+                 const void *b);
+
+/**
+ * Вычисляет ключи имён по длине и символам в позициях ключа.
+ *
+ * @param hash   [in]  параметры хэша (!= NULL)
+ * @param list   [in]  список имён (!= NULL)
+ * @param keys   [out] ключи (list->count элементов) (!= NULL)
+ * @param sorted [-]   рабочий буфер (list->count элементов) (!= NULL)
+ * @return количество различных ключей.
+ */
+static
+size_t compute_keys(const srcgen_hash_t  *hash,
+                    const srcgen_names_t *list,
+                    uint32_t             *keys,
+                    uint32_t             *sorted) __attribute__((nonnull(1, 2, 3, 4)));
+
+/**
+ * Выбирает позиции символов ключа так, чтобы ключи всех имён различались.
+ *
+ * @param hash   [in/out] параметры хэша (!= NULL)
+ * @param list   [in]     список имён (!= NULL)
+ * @param keys   [out]    ключи имён (list->count элементов) (!= NULL)
+ * @param sorted [-]      рабочий буфер (list->count элементов) (!= NULL)
+ * @return true - OK, false - ключи различить не удалось.
+ */
+static
+bool choose_positions(srcgen_hash_t        *hash,
+                      const srcgen_names_t *list,
+                      uint32_t             *keys,
+                      uint32_t             *sorted) __attribute__((nonnull(1, 2, 3, 4))) __attribute__((warn_unused_result));
+
+/**
+ * Подбирает смещения корзин для текущих размеров таблицы и множителя h1.
+ *
+ * @param hash    [in/out] параметры хэша (!= NULL)
+ * @param keys    [in]     ключи имён (!= NULL)
+ * @param count   [in]     количество имён
+ * @param members [-]      рабочий буфер (count элементов) (!= NULL)
+ * @param start   [-]      рабочий буфер (количество корзин + 1 элементов) (!= NULL)
+ * @return true - совершенный хэш построен, false - нужен другой множитель или размер.
+ */
+static
+bool place_buckets(srcgen_hash_t  *hash,
+                   const uint32_t *keys,
+                   size_t          count,
+                   size_t         *members,
+                   size_t         *start) __attribute__((nonnull(1, 2, 4, 5))) __attribute__((warn_unused_result));
+
+/**
+ * Строит совершенный хэш имён.
+ *
+ * @param hash [in/out] параметры хэша (!= NULL)
+ * @param list [in]     список имён (!= NULL)
+ * @return true - OK, false - Fail (сообщение уже выведено).
+ */
+static
+bool build_hash(srcgen_hash_t        *hash,
+                const srcgen_names_t *list) __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+
+/**
+ * Выводит заголовок с таблицей источников манифеста.
+ *
+ * @param out  [in] выходной поток (!= NULL)
+ * @param hash [in] совершенный хэш (!= NULL)
+ * @param list [in] список имён (!= NULL)
+ */
+static
+void write_header(FILE                 *out,
+                  const srcgen_hash_t  *hash,
+                  const srcgen_names_t *list) __attribute__((nonnull(1, 2, 3)));
+
+/**
+ * Добавляет имя в список (без проверки повторов).
+ *
+ * @param list [in/out] список (!= NULL)
+ * @param name [in]     имя (!= NULL)
+ * @param len  [in]     длина имени
+ * @return true - OK, false - нехватка памяти.
+ */
+static
+bool add_name(srcgen_names_t *list,
+              const char     *name,
+              size_t          len)
+{
+    char *copy;
+
+    if (list->count == list->cap)
+    {
+        size_t cap = list->cap ? list->cap * 2 : 64;
+        char **names = realloc(list->names, cap * sizeof(char *));
+
+        if (names == NULL) return false;
+        list->names = names;
+        list->cap = cap;
+    }
+    copy = malloc(len + 1);
+    if (copy == NULL) return false;
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+    list->names[list->count++] = copy;
+    return true;
+}
+
+/**
+ * Проверяет имя источника: непустое, не длиннее SRCGEN_NAME_MAX_SIZE,
+ * только печатные символы ASCII кроме '"' и '\'.
+ *
+ * @param name [in] имя (!= NULL)
+ * @param len  [in] длина имени
+ * @return true - допустимо, false - нет.
+ */
+static
+bool is_valid_name(const char *name,
+                   size_t      len)
+{
+    size_t i;
+
+    if (len == 0 || len > SRCGEN_NAME_MAX_SIZE) return false;
+    for (i = 0; i < len; i++)
+    {
+        if (name[i] < 0x20 || name[i] > 0x7E || name[i] == '"' || name[i] == '\\') return false;
+    }
+    return true;
+}
+
+/**
+ * Читает манифест: одно имя на строку, пустые строки и строки с '#' в начале пропускаются.
+ *
+ * @param path [in]     файл манифеста (!= NULL)
+ * @param list [in/out] список имён (!= NULL)
+ * @return true - OK, false - Fail (сообщение уже выведено).
+ */
+static
+bool read_manifest(const char     *path,
+                   srcgen_names_t *list)
+{
+    FILE *in = fopen(path, "r");
+    char line[1024];
+    unsigned line_no = 0;
+    bool res = true;
+
+    if (in == NULL)
+    {
+        fprintf(stderr, "cos_log_srcgen: %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    while (res && fgets(line, sizeof(line), in))
+    {
+        char *begin = line;
+        char *end = line + strlen(line);
+
+        line_no++;
+        while (*begin == ' ' || *begin == '\t') begin++;
+        while (end > begin && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) end--;
+        if (begin == end || *begin == '#') continue;
+        if (!is_valid_name(begin, (size_t)(end - begin)))
+        {
+            fprintf(stderr, "cos_log_srcgen: %s:%u: invalid source name\n", path, line_no);
+            res = false;
+        }
+        else if (!add_name(list, begin, (size_t)(end - begin)))
+        {
+            fprintf(stderr, "cos_log_srcgen: out of memory\n");
+            res = false;
+        }
+    }
+    fclose(in);
+    return res;
+}
+
+/**
+ * Собирает имена из строк вида #define _LOG_SRC "имя" файла исходного кода.
+ *
+ * @param path [in]     файл (!= NULL)
+ * @param list [in/out] список имён (!= NULL)
+ * @return true - OK, false - Fail (сообщение уже выведено).
+ */
+static
+bool scan_file(const char     *path,
+               srcgen_names_t *list)
+{
+    FILE *in = fopen(path, "r");
+    char line[4096];
+    bool res = true;
+
+    if (in == NULL)
+    {
+        fprintf(stderr, "cos_log_srcgen: %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    while (res && fgets(line, sizeof(line), in))
+    {
+        const char *p = line;
+        const char *end;
+
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p++ != '#') continue;
+        while (*p == ' ' || *p == '\t') p++;
+        if (strncmp(p, "define", 6) != 0) continue;
+        p += 6;
+        if (*p != ' ' && *p != '\t') continue;
+        while (*p == ' ' || *p == '\t') p++;
+        if (strncmp(p, "_LOG_SRC", 8) != 0) continue;
+        p += 8;
+        if (*p != ' ' && *p != '\t') continue;
+        while (*p == ' ' || *p == '\t') p++;
+        /* источник, заданный не строковым литералом, в манифест не попадает (его идентификатор - -1) */
+        if (*p++ != '"') continue;
+        end = strchr(p, '"');
+        if (end == NULL || !is_valid_name(p, (size_t)(end - p))) continue;
+        if (!add_name(list, p, (size_t)(end - p)))
+        {
+            fprintf(stderr, "cos_log_srcgen: out of memory\n");
+            res = false;
+        }
+    }
+    fclose(in);
+    return res;
+}
+
+/**
+ * Сканирует файлы, перечисленные в списке (по одному пути на строку).
+ *
+ * @param path [in]     файл со списком (!= NULL)
+ * @param list [in/out] список имён (!= NULL)
+ * @return true - OK, false - Fail (сообщение уже выведено).
+ */
+static
+bool scan_list(const char     *path,
+               srcgen_names_t *list)
+{
+    FILE *in = fopen(path, "r");
+    char line[4096];
+    bool res = true;
+
+    if (in == NULL)
+    {
+        fprintf(stderr, "cos_log_srcgen: %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    while (res && fgets(line, sizeof(line), in))
+    {
+        size_t len = strlen(line);
+
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+        if (len) res = scan_file(line, list);
+    }
+    fclose(in);
+    return res;
+}
+
+/**
+ * Функция сравнения имён для qsort().
+ */
+static
+int compare_names(const void *a,
+                  const void *b)
+{
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+/**
+ * Сортирует список и удаляет повторы (вывод не зависит от порядка входных файлов).
+ *
+ * @param list [in/out] список имён (!= NULL)
+ */
+static
+void sort_names(srcgen_names_t *list)
+{
+    size_t i, n = 0;
+
+    if (list->count == 0) return;
+    qsort(list->names, list->count, sizeof(char *), compare_names);
+    for (i = 1; i < list->count; i++)
+    {
+        if (strcmp(list->names[n], list->names[i]) == 0)
+        {
+            free(list->names[i]);
+        }
+        else
+        {
+            list->names[++n] = list->names[i];
+        }
+    }
+    list->count = n + 1;
+}
+
+/**
+ * Возвращает символ имени в позиции ключа (так же, как выражение генерируемого заголовка:
+ * индекс берётся по модулю размера литерала, включая завершающий 0).
+ *
+ * @param name     [in] имя (!= NULL)
+ * @param len      [in] длина имени
+ * @param position [in] позиция (>= 0 - от начала, < 0 - от конца)
+ * @return символ.
+ */
+static
+uint32_t key_char(const char *name,
+                  size_t      len,
+                  int         position)
+{
+    size_t size = len + 1;
+
+    if (position >= 0) return (unsigned char)name[(size_t)position % size];
+    return (unsigned char)name[size - 1 - (size_t)-position % size];
+}
+
+/**
+ * Функция сравнения ключей для qsort().
+ */
+static
+int compare_keys(const void *a,
+                 const void *b)
+{
+    uint32_t ka = *(const uint32_t *)a;
+    uint32_t kb = *(const uint32_t *)b;
+
+    return (ka > kb) - (ka < kb);
+}
+
+/**
+ * Вычисляет ключи имён по длине и символам в позициях ключа.
+ *
+ * @param hash   [in]  параметры хэша (!= NULL)
+ * @param list   [in]  список имён (!= NULL)
+ * @param keys   [out] ключи (list->count элементов) (!= NULL)
+ * @param sorted [-]   рабочий буфер (list->count элементов) (!= NULL)
+ * @return количество различных ключей.
+ */
+static
+size_t compute_keys(const srcgen_hash_t  *hash,
+                    const srcgen_names_t *list,
+                    uint32_t             *keys,
+                    uint32_t             *sorted)
+{
+    size_t distinct = 0;
+    size_t i, j;
+
+    for (i = 0; i < list->count; i++)
+    {
+        size_t len = strlen(list->names[i]);
+        uint32_t key = (uint32_t)len;
+
+        for (j = 0; j < hash->num_positions; j++)
+        {
+            key = (uint32_t)(key * SRCGEN_KEY_PRIME) ^ key_char(list->names[i], len, hash->positions[j]);
+        }
+        keys[i] = key;
+        sorted[i] = key;
+    }
+    qsort(sorted, list->count, sizeof(uint32_t), compare_keys);
+    for (i = 0; i < list->count; i++)
+    {
+        if (i == 0 || sorted[i] != sorted[i - 1]) distinct++;
+    }
+    return distinct;
+}
+
+/**
+ * Выбирает позиции символов ключа так, чтобы ключи всех имён различались.
+ *
+ * @param hash   [in/out] параметры хэша (!= NULL)
+ * @param list   [in]     список имён (!= NULL)
+ * @param keys   [out]    ключи имён (list->count элементов) (!= NULL)
+ * @param sorted [-]      рабочий буфер (list->count элементов) (!= NULL)
+ * @return true - OK, false - ключи различить не удалось.
+ */
+static
+bool choose_positions(srcgen_hash_t        *hash,
+                      const srcgen_names_t *list,
+                      uint32_t             *keys,
+                      uint32_t             *sorted)
+{
+    size_t distinct = compute_keys(hash, list, keys, sorted);
+
+    /* позиции добавляются жадно: каждый раз та, что сильнее всего увеличивает количество различных ключей */
+    while (distinct < list->count && hash->num_positions < SRCGEN_MAX_KEY_POSITIONS)
+    {
+        int best = 0;
+        size_t best_distinct = distinct;
+        int position;
+
+        for (position = -SRCGEN_NAME_MAX_SIZE; position < SRCGEN_NAME_MAX_SIZE; position++)
+        {
+            size_t n;
+
+            hash->positions[hash->num_positions++] = position;
+            n = compute_keys(hash, list, keys, sorted);
+            hash->num_positions--;
+            if (n > best_distinct)
+            {
+                best_distinct = n;
+                best = position;
+            }
+        }
+        if (best_distinct == distinct) break;
+        hash->positions[hash->num_positions++] = best;
+        distinct = best_distinct;
+    }
+    return (compute_keys(hash, list, keys, sorted) == list->count);
+}
+
+/**
+ * Подбирает смещения корзин для текущих размеров таблицы и множителя h1.
+ *
+ * @param hash    [in/out] параметры хэша (!= NULL)
+ * @param keys    [in]     ключи имён (!= NULL)
+ * @param count   [in]     количество имён
+ * @param members [-]      рабочий буфер (count элементов) (!= NULL)
+ * @param start   [-]      рабочий буфер (количество корзин + 1 элементов) (!= NULL)
+ * @return true - совершенный хэш построен, false - нужен другой множитель или размер.
+ */
+static
+bool place_buckets(srcgen_hash_t  *hash,
+                   const uint32_t *keys,
+                   size_t          count,
+                   size_t         *members,
+                   size_t         *start)
+{
+    size_t table_size = (size_t)1 << hash->table_bits;
+    size_t num_buckets = (size_t)1 << hash->bucket_bits;
+    size_t max_size = 0;
+    size_t size, b, i;
+
+    /* раскладка имён по корзинам подсчётом: члены корзины b - members[start[b] ... start[b + 1] - 1] */
+    memset(start, 0, (num_buckets + 1) * sizeof(size_t));
+    for (i = 0; i < count; i++) start[((uint32_t)(keys[i] * SRCGEN_BUCKET_MULT) >> (32 - hash->bucket_bits)) + 1]++;
+    for (b = 0; b < num_buckets; b++)
+    {
+        if (start[b + 1] > max_size) max_size = start[b + 1];
+        start[b + 1] += start[b];
+    }
+    for (i = 0; i < count; i++) members[start[(uint32_t)(keys[i] * SRCGEN_BUCKET_MULT) >> (32 - hash->bucket_bits)]++] = i;
+    /* после раскладки start[b] указывает на конец корзины b - вернуть начала */
+    for (b = num_buckets; b > 0; b--) start[b] = start[b - 1];
+    start[0] = 0;
+
+    for (i = 0; i < table_size; i++) hash->slots[i] = SIZE_MAX;
+    memset(hash->disp, 0, num_buckets * sizeof(uint16_t));
+    /* корзины размещаются от больших к меньшим: большие проще разместить, пока таблица свободна */
+    for (size = max_size; size > 0; size--)
+    {
+        for (b = 0; b < num_buckets; b++)
+        {
+            size_t disp;
+
+            if (start[b + 1] - start[b] != size) continue;
+            for (disp = 0; disp < table_size; disp++)
+            {
+                for (i = start[b]; i < start[b + 1]; i++)
+                {
+                    size_t slot = (((uint32_t)(keys[members[i]] * hash->seed) >> (32 - hash->table_bits)) + disp) & (table_size - 1);
+
+                    if (hash->slots[slot] != SIZE_MAX) break;
+                    /* слот занимается сразу: так обнаруживается совпадение слотов двух имён одной корзины */
+                    hash->slots[slot] = members[i];
+                }
+                if (i == start[b + 1]) break;
+                while (i-- > start[b])
+                {
+                    hash->slots[(((uint32_t)(keys[members[i]] * hash->seed) >> (32 - hash->table_bits)) + disp) & (table_size - 1)] = SIZE_MAX;
+                }
+            }
+            if (disp == table_size) return false;
+            hash->disp[b] = (uint16_t)disp;
+        }
+    }
+    return true;
+}
+
+/**
+ * Строит совершенный хэш имён.
+ *
+ * @param hash [in/out] параметры хэша (!= NULL)
+ * @param list [in]     список имён (!= NULL)
+ * @return true - OK, false - Fail (сообщение уже выведено).
+ */
+static
+bool build_hash(srcgen_hash_t        *hash,
+                const srcgen_names_t *list)
+{
+    size_t num_keys = list->count ? list->count : 1;
+    uint32_t *keys = calloc(num_keys, sizeof(uint32_t));
+    uint32_t *sorted = calloc(num_keys, sizeof(uint32_t));
+    size_t *members = calloc(num_keys, sizeof(size_t));
+    size_t *start = NULL;
+    bool res = false;
+
+    if (keys == NULL || sorted == NULL || members == NULL)
+    {
+        fprintf(stderr, "cos_log_srcgen: out of memory\n");
+        goto cleanup;
+    }
+    if (!choose_positions(hash, list, keys, sorted))
+    {
+        fprintf(stderr, "cos_log_srcgen: source names can not be told apart by %d characters\n", SRCGEN_MAX_KEY_POSITIONS);
+        goto cleanup;
+    }
+    /* таблица - наименьшая степень 2, вмещающая все имена; если множитель не подобран, размер удваивается */
+    for (hash->table_bits = 1; ((size_t)1 << hash->table_bits) < list->count; hash->table_bits++) {}
+    for (; !res && hash->table_bits <= SRCGEN_MAX_TABLE_BITS; hash->table_bits++)
+    {
+        size_t num_buckets;
+        unsigned attempt;
+
+        hash->bucket_bits = hash->table_bits > 1 ? hash->table_bits - 1 : 1;
+        num_buckets = (size_t)1 << hash->bucket_bits;
+        free(hash->slots);
+        free(hash->disp);
+        free(start);
+        hash->slots = malloc(((size_t)1 << hash->table_bits) * sizeof(size_t));
+        hash->disp = malloc(num_buckets * sizeof(uint16_t));
+        start = malloc((num_buckets + 1) * sizeof(size_t));
+        if (hash->slots == NULL || hash->disp == NULL || start == NULL)
+        {
+            fprintf(stderr, "cos_log_srcgen: out of memory\n");
+            goto cleanup;
+        }
+        for (attempt = 0; attempt < SRCGEN_SEED_ATTEMPTS; attempt++)
+        {
+            /* множители детерминированы: одинаковый набор имён даёт одинаковый заголовок */
+            hash->seed = (SRCGEN_SEED_BASE + attempt * SRCGEN_BUCKET_MULT) | 1u;
+            res = place_buckets(hash, keys, list->count, members, start);
+            if (res) break;
+        }
+        if (res) break;
+    }
+    if (!res) fprintf(stderr, "cos_log_srcgen: failed to build a perfect hash for %zu source names\n", list->count);
+
+cleanup:
+    free(keys);
+    free(sorted);
+    free(members);
+    free(start);
+    return res;
+}
+
+/**
+ * Выводит заголовок с таблицей источников манифеста.
+ *
+ * @param out  [in] выходной поток (!= NULL)
+ * @param hash [in] совершенный хэш (!= NULL)
+ * @param list [in] список имён (!= NULL)
+ */
+static
+void write_header(FILE                 *out,
+                  const srcgen_hash_t  *hash,
+                  const srcgen_names_t *list)
+{
+    size_t table_size = (size_t)1 << hash->table_bits;
+    size_t num_buckets = (size_t)1 << hash->bucket_bits;
+    size_t i;
+
+    fprintf(out, "/* Сгенерировано cos_log_srcgen из манифеста источников, не редактировать. */\n"
+                 "#ifndef LOG_SRC_MANIFEST_H_\n"
+                 "#define LOG_SRC_MANIFEST_H_\n"
+                 "\n"
+                 "#include <stdint.h>\n"
+                 "\n"
+                 "/**\n"
+                 " * Количество источников манифеста\n"
+                 " */\n"
+                 "#define LOG_SRC_MANIFEST_COUNT %zuu\n"
+                 "\n"
+                 "/**\n"
+                 " * Размер таблицы источников манифеста (идентификаторы - 0 ... LOG_SRC_MANIFEST_SIZE - 1)\n"
+                 " */\n"
+                 "#define LOG_SRC_MANIFEST_SIZE %zuu\n"
+                 "\n"
+                 "/**\n"
+                 " * Имена источников по идентификатору (\"\" - идентификатор не занят)\n"
+                 " */\n"
+                 "static const char *const log_src_manifest_names[LOG_SRC_MANIFEST_SIZE] =\n"
+                 "{\n",
+            list->count, table_size);
+    for (i = 0; i < table_size; i++)
+    {
+        fprintf(out, "    \"%s\",\n", hash->slots[i] == SIZE_MAX ? "" : list->names[hash->slots[i]]);
+    }
+    fprintf(out, "};\n"
+                 "\n"
+                 "/**\n"
+                 " * Смещения корзин совершенного хэша\n"
+                 " */\n"
+                 "static const uint16_t log_src_manifest_disp[%zuu] =\n"
+                 "{\n",
+            num_buckets);
+    for (i = 0; i < num_buckets; i++)
+    {
+        fprintf(out, "%s%u,%s", i % 16 ? " " : "    ", (unsigned)hash->disp[i], (i % 16 == 15 || i + 1 == num_buckets) ? "\n" : "");
+    }
+    fprintf(out, "};\n"
+                 "\n"
+                 "/**\n"
+                 " * Имя источника как строковый литерал (имя, заданное не литералом, не компилируется)\n"
+                 " */\n"
+                 "#define LOG_SRC_MANIFEST_LIT(s) (\"\" s \"\")\n"
+                 "\n"
+                 "/**\n"
+                 " * Символ имени в позиции i от начала или от конца (индекс берётся по модулю размера литерала)\n"
+                 " */\n"
+                 "#define LOG_SRC_MANIFEST_HEAD(s, i) ((uint32_t)(unsigned char)LOG_SRC_MANIFEST_LIT(s)[(i) %% sizeof(LOG_SRC_MANIFEST_LIT(s))])\n"
+                 "#define LOG_SRC_MANIFEST_TAIL(s, i) \\\n"
+                 "    ((uint32_t)(unsigned char)LOG_SRC_MANIFEST_LIT(s)[sizeof(LOG_SRC_MANIFEST_LIT(s)) - 1u - (i) %% sizeof(LOG_SRC_MANIFEST_LIT(s))])\n"
+                 "\n"
+                 "/**\n"
+                 " * Ключ имени: длина и символы в позициях, различающих имена манифеста\n"
+                 " */\n"
+                 "#define LOG_SRC_MANIFEST_KEY(s) \\\n"
+                 "    (");
+    for (i = 0; i < hash->num_positions; i++) fprintf(out, "((uint32_t)(");
+    fprintf(out, "(uint32_t)(sizeof(LOG_SRC_MANIFEST_LIT(s)) - 1u)");
+    for (i = 0; i < hash->num_positions; i++)
+    {
+        int position = hash->positions[i];
+
+        fprintf(out, " * %uu) ^ \\\n     LOG_SRC_MANIFEST_%s(s, %du))",
+                SRCGEN_KEY_PRIME, position >= 0 ? "HEAD" : "TAIL", position >= 0 ? position : -position);
+    }
+    fprintf(out, ")\n"
+                 "\n"
+                 "/**\n"
+                 " * Слот имени в таблице (для имён манифеста - без коллизий)\n"
+                 " */\n"
+                 "#define LOG_SRC_MANIFEST_SLOT(s) \\\n"
+                 "    ((((uint32_t)(LOG_SRC_MANIFEST_KEY(s) * %uu) >> %u) + \\\n"
+                 "      log_src_manifest_disp[(uint32_t)(LOG_SRC_MANIFEST_KEY(s) * %uu) >> %u]) & (LOG_SRC_MANIFEST_SIZE - 1u))\n"
+                 "\n"
+                 "/**\n"
+                 " * Идентификатор источника s в манифесте (-1 - источника нет в манифесте).\n"
+                 " * Для литерала при включённой оптимизации сворачивается компилятором в константу.\n"
+                 " */\n"
+                 "#define LOG_SRC_MANIFEST_ID(s) \\\n"
+                 "    ((LOG_SRC_MANIFEST_LIT(s)[0] != '\\0' && \\\n"
+                 "      __builtin_strcmp(LOG_SRC_MANIFEST_LIT(s), log_src_manifest_names[LOG_SRC_MANIFEST_SLOT(s)]) == 0) ? \\\n"
+                 "     (int)LOG_SRC_MANIFEST_SLOT(s) : -1)\n"
+                 "\n"
+                 "#endif /* LOG_SRC_MANIFEST_H_ */\n",
+            hash->seed, 32 - hash->table_bits, SRCGEN_BUCKET_MULT, 32 - hash->bucket_bits);
+}
+
+int main(int argc, char *argv[])
+{
+    srcgen_names_t list;
+    srcgen_hash_t hash;
+    const char *out_path = NULL;
+    FILE *out;
+    bool usage = false;
+    bool res = true;
+    size_t n;
+    int i;
+
+    memset(&list, 0, sizeof(list));
+    memset(&hash, 0, sizeof(hash));
+    for (i = 1; res && !usage && i < argc; i++)
+    {
+        bool has_value = (i + 1 < argc);
+
+        if (!strcmp(argv[i], "-o") && has_value)
+        {
+            out_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-m") && has_value)
+        {
+            res = read_manifest(argv[++i], &list);
+        }
+        else if (!strcmp(argv[i], "-l") && has_value)
+        {
+            res = scan_list(argv[++i], &list);
+        }
+        else if (argv[i][0] == '-')
+        {
+            usage = true;
+        }
+        else
+        {
+            res = scan_file(argv[i], &list);
+        }
+    }
+    if (usage || (res && out_path == NULL))
+    {
+        fprintf(stderr, "usage: %s -o header [-m manifest]... [-l file_list]... [source_file]...\n", argv[0]);
+        res = false;
+    }
+    else if (res)
+    {
+        sort_names(&list);
+        res = build_hash(&hash, &list);
+    }
+    if (res)
+    {
+        out = fopen(out_path, "w");
+        if (out == NULL)
+        {
+            fprintf(stderr, "cos_log_srcgen: %s: %s\n", out_path, strerror(errno));
+            res = false;
+        }
+        else
+        {
+            write_header(out, &hash, &list);
+            if (fclose(out) != 0)
+            {
+                fprintf(stderr, "cos_log_srcgen: %s: %s\n", out_path, strerror(errno));
+                remove(out_path);
+                res = false;
+            }
+        }
+    }
+    for (n = 0; n < list.count; n++) free(list.names[n]);
+    free(list.names);
+    free(hash.slots);
+    free(hash.disp);
+    return res ? EXIT_SUCCESS : EXIT_FAILURE;
+}